@@ -0,0 +1,28 @@
+import asyncio
+from portcullis.aio import TcpHandle, backend
+
+
+read_timeout = 30
+
+
+async def handler(ctx, client):
+    """Async handlers run in event loop of worker, so any asyncio library may be used here.
+
+    Connection needs no coroutine stack of its own, but blocking calls like ctx.backend() stall
+    the whole loop, use awaitable counterparts from portcullis.aio instead.
+    Client connection is closed when handler returns.
+    """
+    request = await asyncio.wait_for(client.read(), read_timeout)
+    if not request:
+        return
+
+    server = await backend(ctx)
+    try:
+        await server.write_all(request)
+        while True:
+            data = await server.read()
+            if not data:
+                break
+            await client.write_all(data)
+    finally:
+        server.close()
@@ -2,10 +2,35 @@ host = ""
 port = "1339"
 backlog = 128
 handler_file = "../conf/handler.py"
+# "python": every connection is served by `handler` of handler_file,
+#           `async def handler` is run by event loop of worker, see conf/async_handler.py
+# "native": HTTP is relayed to backends natively, `hook` of handler_file is called only for requests matching hook_rules
+handler_mode = "python"
+# rule matches if all fields given match: method, url prefix, presence of header
+hook_rules = [
+    {"url_prefix": "/admin"},
+    {"method": "POST", "header": "X-Debug"},
+]
+keep_alive_timeout = 60  # seconds, native mode only
+relay_timeout = 60  # seconds a relayed request or response may stall, native mode only, 0 means no timeout
 protocol = "tcp"
 backend_ip = "127.0.0.1"
 backend_ipv6 = ""
 backend_port = "8080"
+# group of backends requests are balanced between, overrides backend_ip and backend_port
+# backends = ["tcp://10.0.0.1:8080", "tcp://10.0.0.2:8080"]
+balancing = "round_robin"  # or "least_outstanding", "consistent_hash" (by client address)
+backend_max_fails = 3  # connect failures in a row after which backend is ejected
+backend_ejection_time = 10  # seconds
+backend_connect_timeout = 5  # seconds, 0 means no timeout
 allow_ipv6 = True
 ipv6_only = False
 coroutine_stack_size = 4096 * 100
+workers = 0  # one reactor thread per core
+deadline_queue = "timer_wheel"  # or "heap"
+io_backend = "epoll"  # or "io_uring", falls back to epoll if unavailable
+backend_pool_max_idle = 32  # idle connections kept per backend
+backend_pool_max_total = 0  # open connections per backend, 0 means no limit
+backend_pool_idle_timeout = 60  # seconds
+regexp_stream_pool_size = 4 * 1024 * 1024  # bytes of free Hyperscan stream states kept per reactor
+regexp_cache_dir = ""  # compiled Hyperscan databases are kept here across restarts and reloads, empty disables
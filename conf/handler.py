@@ -1,26 +1,41 @@
-from portcullis.core import TcpHandle, resolve_v4
 from portcullis.http import *
+from portcullis.helpers import requests
 
 
-backend_addr = resolve_v4("tcp://localhost:8080")
+keep_alive_timeout = 60
 
 
 def handler(ctx, clt):
     client = HttpHandle(clt)
-    backend = HttpHandle(TcpHandle.connect(ctx, backend_addr))
 
-    request = client.read_request()
-    backend.write_request(request)
-    client.transfer_body(backend, request)
+    for request in requests(client, keep_alive_timeout):
+        # warm connection to configured backend is taken from reactor's pool
+        backend = HttpHandle(ctx.backend())
 
-    ua = request.headers["User-Agent"]
-    if ua is not None:
-        request.headers["User-Agent"] = "portcullis"
+        backend.write_request(request)
+        client.transfer_body(backend, request)
 
-    response = backend.read_response()
-    response.headers["Server"] = "portcullis"
+        ua = request.headers.get("User-Agent")
+        if ua is not None:
+            request.headers["User-Agent"] = "portcullis"
 
-    client.write_response(response)
-    backend.transfer_body(client, response)
+        response = backend.read_response()
+        response.headers["Server"] = "portcullis"
 
-    # print(request.method, request.url, response.status, response.reason)
+        client.write_response(response)
+        backend.transfer_body(client, response)
+
+        # connection is closed instead, if response does not allow to reuse it
+        ctx.release_backend(backend)
+
+        # print(request.method, request.url, response.status, response.reason)
+
+
+def hook(ctx, request):
+    """Called in native mode for requests matching hook_rules.
+
+    Request may be changed in place; returned response is sent instead of forwarding request.
+    """
+    if request.url.startswith("/admin"):
+        return HttpResponse(403, "Forbidden")
+    return None
@@ -8,7 +8,7 @@ def bad_request(request):
 
 
 def bad_response(response):
-    return "bad_cookie" in response.cookies
+    return "bad_cookie" in (response.headers.get("Set-Cookie") or "")
 
 
 # * Every section starts with default policy: Drop/Allow.
@@ -31,7 +31,7 @@ handler = Sentinel(
         RequestIf(bad_request),
 
         # ban response if function returns True
-        ResponseIf(bad_request)
+        ResponseIf(bad_response)
     ])),
 
     ("/allow", Allow([
@@ -39,17 +39,17 @@ handler = Sentinel(
         RequestHeaderMatches("User-Agent", r"python-requests/\d+.\d+"),
 
         # allow if header presents in request
-        ResponseHasHeader("User-Agent2").
+        ResponseHasHeader("User-Agent2"),
 
         # allow request if function returns True
         RequestIf(bad_request),
 
         # allow response if function returns True
-        ResponseIf(bad_request),
+        ResponseIf(bad_response),
 
         # allow request if functions returns True
         # function should accept body as bytes for first argument
-        RequestBodyIf(lambda body: "admin" not in b64decode(body)),
+        RequestBodyIf(lambda body: b"admin" not in b64decode(body)),
 
         ResponseBodyIf(lambda body: "good_action" in json.loads(body))
     ])),
@@ -0,0 +1,159 @@
+import asyncio
+import selectors
+import socket
+
+from portcullis._aio import register_fd, release_fd, wait_readable, yield_to_reactor, canceled
+
+__all__ = ["ReactorEventLoop", "TcpHandle", "backend"]
+
+
+class ReactorCanceled(Exception):
+    """Reactor cancelled coroutine running the loop, e.g. on shutdown."""
+
+
+class ReactorSelector(selectors.EpollSelector):
+    """Selector which waits for its epoll fd in reactor, so other connections of worker are served meanwhile."""
+
+    # loop which always has ready callbacks selects without timeout, it yields to reactor once in so many selects
+    YIELD_EVERY = 16
+
+    def __init__(self):
+        super().__init__()
+        register_fd(self.fileno())
+        self._busy_selects = 0
+
+    def select(self, timeout=None):
+        if timeout is None or timeout > 0:
+            self._busy_selects = 0
+            if not wait_readable(self.fileno(), timeout) and canceled():
+                raise ReactorCanceled()
+        else:
+            self._busy_selects += 1
+            if self._busy_selects >= self.YIELD_EVERY:
+                self._busy_selects = 0
+                yield_to_reactor()
+                if canceled():
+                    raise ReactorCanceled()
+        return super().select(0)
+
+    def close(self):
+        release_fd(self.fileno())
+        super().close()
+
+
+class ReactorEventLoop(asyncio.SelectorEventLoop):
+    """Event loop of worker, it runs async handlers of all its connections in one reactor coroutine."""
+
+    def __init__(self):
+        super().__init__(ReactorSelector())
+        # client connections whose handlers have not finished yet
+        self.clients = set()
+
+
+class TcpHandle:
+    """Awaitable counterpart of portcullis.core.TcpHandle, it must be used in loop of the worker it was made by."""
+
+    def __init__(self, sock):
+        sock.setblocking(False)
+        self.sock = sock
+
+    @classmethod
+    async def connect(cls, addr):
+        """Address is SocketAddress or (host, port)."""
+        if not isinstance(addr, tuple):
+            addr = (addr.host(), addr.port())
+        family = socket.AF_INET6 if ":" in addr[0] else socket.AF_INET
+        sock = socket.socket(family, socket.SOCK_STREAM)
+        sock.setblocking(False)
+        try:
+            await asyncio.get_running_loop().sock_connect(sock, addr)
+        except BaseException:
+            sock.close()
+            raise
+        return cls(sock)
+
+    async def read(self, size=65536):
+        """Returns data available, empty bytes mean connection is closed by peer."""
+        return await asyncio.get_running_loop().sock_recv(self.sock, size)
+
+    async def read_exactly(self, size):
+        loop = asyncio.get_running_loop()
+        data = bytearray(size)
+        view = memoryview(data)
+        offset = 0
+        while offset < size:
+            n = await loop.sock_recv_into(self.sock, view[offset:])
+            if n == 0:
+                raise asyncio.IncompleteReadError(bytes(data[:offset]), size)
+            offset += n
+        return bytes(data)
+
+    async def write(self, data):
+        await asyncio.get_running_loop().sock_sendall(self.sock, data)
+        return len(data)
+
+    async def write_all(self, data):
+        await asyncio.get_running_loop().sock_sendall(self.sock, data)
+
+    async def transfer_exactly(self, other, size, chunk_size=65536):
+        loop = asyncio.get_running_loop()
+        buffer = bytearray(min(size, chunk_size))
+        view = memoryview(buffer)
+        left = size
+        while left > 0:
+            n = await loop.sock_recv_into(self.sock, view[:min(left, len(buffer))])
+            if n == 0:
+                raise asyncio.IncompleteReadError(b"", size)
+            await loop.sock_sendall(other.sock, view[:n])
+            left -= n
+        return size
+
+    def close(self):
+        self.sock.close()
+
+
+async def backend(ctx):
+    """Connects to backend chosen from configured group by its balancing policy."""
+    return await TcpHandle.connect(ctx.pick_backend())
+
+
+async def _serve(handler, ctx, client):
+    try:
+        await handler(ctx, client)
+    except asyncio.CancelledError:
+        pass
+    except Exception as e:
+        ctx.log_error(f"exception in handler: {e!r}")
+    finally:
+        client.close()
+        asyncio.get_running_loop().clients.discard(client)
+
+
+def serve(loop, handler, ctx, fd):
+    """Schedules handler for client connection `fd` in worker's loop, called by service."""
+    client = TcpHandle(socket.socket(fileno=fd))
+    loop.clients.add(client)
+    # loop waits in reactor, so it is woken up through its self-pipe
+    loop.call_soon_threadsafe(loop.create_task, _serve(handler, ctx, client))
+
+
+def run(loop):
+    """Runs worker's loop until reactor cancels it, then handlers left are cancelled."""
+    try:
+        loop.run_forever()
+    except ReactorCanceled:
+        pass
+
+    tasks = asyncio.all_tasks(loop)
+    for task in tasks:
+        task.cancel()
+    if tasks:
+        try:
+            loop.run_until_complete(asyncio.gather(*tasks, return_exceptions=True))
+        except ReactorCanceled:
+            # handlers still waiting for I/O are dropped
+            pass
+    for client in loop.clients:
+        client.close()
+    loop.clients.clear()
+    loop.close()
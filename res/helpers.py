@@ -10,3 +10,12 @@ def read_packed(handle, fmt):
 def write_packed(handle, fmt, *args, **kwargs):
     size = struct.calcsize(fmt)
     return handle.write_all(struct.pack(fmt, *args, **kwargs))
+
+
+def requests(handle, idle_timeout=None):
+    """Yields requests of persistent connection until it is over."""
+    while True:
+        request = handle.read_next_request(idle_timeout)
+        if request is None:
+            return
+        yield request
@@ -1,19 +1,11 @@
 from portcullis._re import StreamRegexpDatabase, RegexpDef, StreamRegexpMatcher
+from portcullis._re import VectoredRegexpDatabase, VectoredRegexpMatcher
+from portcullis._re import BlockRegexpDatabase, BlockRegexpMatcher, HeaderRegexpDatabase
 from portcullis._re import CASELESS, DOTALL, MULTILINE, SINGLEMATCH, ALLOWEMPTY, UTF8, UCP, PREFILTER, SOM_LEFTMOST
 from portcullis._re import MODE_SOM_HORIZON_SMALL, MODE_SOM_HORIZON_MEDIUM, MODE_SOM_HORIZON_LARGE
 
 
-def compile_stream(*args, report_leftmost=False, mode="medium"):
-    mode = mode.lower()
-    if mode == "small":
-        mode = MODE_SOM_HORIZON_SMALL
-    elif mode == "medium":
-        mode = MODE_SOM_HORIZON_MEDIUM
-    elif mode == "large":
-        mode = MODE_SOM_HORIZON_LARGE
-    else:
-        raise ValueError(f"unknown mode '{mode}'")
-
+def _regexp_defs(args, report_leftmost):
     regexps = []
     som_used = report_leftmost
     for r in args:
@@ -34,7 +26,54 @@ def compile_stream(*args, report_leftmost=False, mode="medium"):
 
         regexps.append(RegexpDef(regexp, flags))
 
+    return regexps, som_used
+
+
+def compile_stream(*args, report_leftmost=False, mode="medium"):
+    mode = mode.lower()
+    if mode == "small":
+        mode = MODE_SOM_HORIZON_SMALL
+    elif mode == "medium":
+        mode = MODE_SOM_HORIZON_MEDIUM
+    elif mode == "large":
+        mode = MODE_SOM_HORIZON_LARGE
+    else:
+        raise ValueError(f"unknown mode '{mode}'")
+
+    regexps, som_used = _regexp_defs(args, report_leftmost)
+
     if not report_leftmost and not som_used:
         mode = 0
 
     return StreamRegexpDatabase(regexps, mode=mode)
+
+
+def compile_vectored(*args, report_leftmost=False):
+    """Database for VectoredRegexpMatcher, which scans list of chunks as one piece of data."""
+    regexps, _ = _regexp_defs(args, report_leftmost)
+    return VectoredRegexpDatabase(regexps)
+
+
+def compile_block(*args):
+    """Database for BlockRegexpMatcher, which matches short complete inputs like url or header value."""
+    regexps, _ = _regexp_defs(args, False)
+    return BlockRegexpDatabase(regexps)
+
+
+URL = ":url"
+
+
+def compile_headers(*rules):
+    """Rules are (header, regexp) or (header, regexp, flags), header URL targets request url.
+    All headers of message are matched with one call of match(), which returns ids of matched rules."""
+    defs = []
+    for rule in rules:
+        if len(rule) == 2:
+            header, regexp = rule
+            flags = 0
+        elif len(rule) == 3:
+            header, regexp, flags = rule
+        else:
+            raise ValueError(f"unexpected rule: {rule}")
+        defs.append((header, regexp, flags))
+    return HeaderRegexpDatabase(defs)
@@ -0,0 +1,87 @@
+from portcullis._sentinel import Program, Condition, ALLOW, DENY
+
+__all__ = [
+    "Sentinel", "Allow", "Deny", "And",
+    "RequestHasHeader", "ResponseHasHeader", "RequestHeaderMatches",
+    "RequestBodyContainsRegexp", "ResponseBodyContainsRegexp",
+    "RequestIf", "ResponseIf", "RequestBodyIf", "ResponseBodyIf",
+]
+
+
+def RequestHasHeader(name):
+    return Condition.has_header(False, name)
+
+
+def ResponseHasHeader(name):
+    return Condition.has_header(True, name)
+
+
+def RequestHeaderMatches(name, regexp, flags=0):
+    return Condition.header_matches(False, name, regexp, flags)
+
+
+def RequestBodyContainsRegexp(regexp, flags=0):
+    return Condition.body_contains(False, regexp, flags)
+
+
+def ResponseBodyContainsRegexp(regexp, flags=0, threshold=None, streaming=True):
+    """Body is scanned as it is relayed, unless streaming is off. Then it is accumulated whole first,
+    and response bigger than threshold is discarded."""
+    if streaming and threshold is not None:
+        raise ValueError("threshold is used only for non-streaming scan")
+    return Condition.body_contains(True, regexp, flags, buffered=not streaming, threshold=threshold or 0)
+
+
+def RequestIf(predicate):
+    return Condition.request_if(predicate)
+
+
+def ResponseIf(predicate):
+    return Condition.response_if(predicate)
+
+
+def RequestBodyIf(predicate):
+    """Predicate gets whole body as bytes."""
+    return Condition.body_if(False, predicate)
+
+
+def ResponseBodyIf(predicate):
+    return Condition.body_if(True, predicate)
+
+
+class And:
+    def __init__(self, *conditions):
+        if not conditions:
+            raise ValueError("And needs at least one condition")
+        self.conditions = list(conditions)
+
+
+def _blocks(blocks):
+    return [b.conditions if isinstance(b, And) else [b] for b in blocks]
+
+
+class Allow:
+    """Allows conversation if at least one block is satisfied, denies it otherwise."""
+    policy = ALLOW
+
+    def __init__(self, blocks):
+        self.blocks = _blocks(blocks)
+
+
+class Deny:
+    """Denies conversation if at least one block is satisfied, allows it otherwise."""
+    policy = DENY
+
+    def __init__(self, blocks):
+        self.blocks = _blocks(blocks)
+
+
+class Sentinel:
+    """HTTP handler relaying requests to backends, sections are matched by url prefix in order.
+    Rules are compiled once, requests out of sections are relayed as is."""
+
+    def __init__(self, *sections):
+        self.program = Program([(prefix, section.policy, section.blocks) for prefix, section in sections])
+
+    def __call__(self, ctx, client):
+        return self.program.serve(ctx, client)
@@ -0,0 +1,170 @@
+#include "backend_group.h"
+
+#include <algorithm>
+
+static uint64_t Mix(uint64_t x) {
+    /* splitmix64 finalizer, spreads similar inputs over the whole ring */
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+TBackendGroup::TLease::TLease(std::shared_ptr<TBackendGroup> group, size_t index)
+    : Group_(std::move(group))
+    , Index_(index)
+{
+    Group_->Backends_[Index_].Outstanding.fetch_add(1, std::memory_order_relaxed);
+}
+
+TBackendGroup::TLease::~TLease() {
+    Group_->Backends_[Index_].Outstanding.fetch_sub(1, std::memory_order_relaxed);
+}
+
+TBackendGroup::TBackendGroup(std::vector<TSocketAddress> addresses, TOptions options)
+    : Backends_(addresses.size())
+    , Options_(options)
+{
+    if (addresses.empty()) {
+        throw TException() << "backend group is empty";
+    }
+
+    for (size_t i = 0; i < addresses.size(); i++) {
+        Backends_[i].Address = addresses[i];
+    }
+
+    if (Options_.Policy == BpConsistentHash) {
+        Ring_.reserve(Backends_.size() * VirtualNodes);
+        for (size_t i = 0; i < Backends_.size(); i++) {
+            uint64_t seed = Backends_[i].Address.Hash();
+            for (size_t node = 0; node < VirtualNodes; node++) {
+                seed = Mix(seed);
+                Ring_.push_back({ seed, i });
+            }
+        }
+        std::sort(Ring_.begin(), Ring_.end());
+    }
+}
+
+TResult<TBackendGroup::TConnection> TBackendGroup::Connect(TConnectionPool* pool, const TSocketAddress* client, TReactor::TDeadline deadline, bool fresh) {
+    TTried tried;
+    TResult<TTcpHandlePtr> res;
+
+    for (size_t attempt = 0; attempt < Backends_.size(); attempt++) {
+        size_t index = Pick(client, tried);
+        tried.PushBack(index);
+
+        TReactor::TDeadline attemptDeadline = deadline;
+        if (Options_.ConnectTimeout != std::chrono::steady_clock::duration::zero()) {
+            attemptDeadline = std::min(deadline, Reactor()->Now() + Options_.ConnectTimeout);
+        }
+
+        std::shared_ptr<TLease> lease = std::make_shared<TLease>(shared_from_this(), index);
+        const TSocketAddress& addr = Backends_[index].Address;
+        bool reused = false;
+        if (pool) {
+            res = fresh ? pool->Connect(addr, attemptDeadline) : pool->Acquire(addr, attemptDeadline, &reused);
+        } else {
+            TTcpHandlePtr handle = TTcpHandle::Create(addr.Ipv6());
+            TResult<bool> connected = handle->Connect(addr, attemptDeadline);
+            res = connected ? TResult<TTcpHandlePtr>::MakeSuccess(std::move(handle)) : TResult<TTcpHandlePtr>::ForwardError(connected);
+        }
+
+        if (res) {
+            ReportSuccess(index);
+            return TResult<TConnection>::MakeSuccess({ std::move(res.Result()), std::move(lease), reused });
+        }
+
+        if (res.Canceled()) {
+            break;
+        }
+
+        /* pool limit says nothing about health of backend */
+        if (res.Error() != EBUSY) {
+            ReportFailure(index);
+        }
+    }
+
+    return TResult<TConnection>::ForwardError(res);
+}
+
+size_t TBackendGroup::Pick(const TSocketAddress* client, const TTried& tried) {
+    int64_t now = Reactor()->Now().time_since_epoch().count();
+
+    if (Options_.Policy == BpConsistentHash && client) {
+        uint64_t point = Mix(client->HostHash());
+        auto it = std::lower_bound(Ring_.begin(), Ring_.end(), TRingPoint{ point, 0 });
+        for (size_t i = 0; i < Ring_.size(); i++, it++) {
+            if (it == Ring_.end()) {
+                it = Ring_.begin();
+            }
+            if (Available(it->Backend, tried, now)) {
+                return it->Backend;
+            }
+        }
+        return FirstAvailable(0, tried, now);
+    }
+
+    size_t start = Next_.fetch_add(1, std::memory_order_relaxed) % Backends_.size();
+
+    if (Options_.Policy == BpLeastOutstanding) {
+        /* scan starts from rotating position, so ties are broken in turn */
+        size_t best = Backends_.size();
+        for (size_t i = 0; i < Backends_.size(); i++) {
+            size_t index = (start + i) % Backends_.size();
+            if (!Available(index, tried, now)) {
+                continue;
+            }
+            if (best == Backends_.size() || Outstanding(index) < Outstanding(best)) {
+                best = index;
+            }
+        }
+        if (best != Backends_.size()) {
+            return best;
+        }
+    }
+
+    return FirstAvailable(start, tried, now);
+}
+
+void TBackendGroup::ReportSuccess(size_t index) {
+    Backends_[index].Fails.store(0, std::memory_order_relaxed);
+}
+
+void TBackendGroup::ReportFailure(size_t index) {
+    if (Options_.MaxFails == 0) {
+        return;
+    }
+
+    TBackend& backend = Backends_[index];
+    if (backend.Fails.fetch_add(1, std::memory_order_relaxed) + 1 >= Options_.MaxFails) {
+        backend.Fails.store(0, std::memory_order_relaxed);
+        backend.EjectedUntil.store((Reactor()->Now() + Options_.EjectionTime).time_since_epoch().count(), std::memory_order_relaxed);
+    }
+}
+
+bool TBackendGroup::Available(size_t index, const TTried& tried, int64_t now) const {
+    if (std::find(tried.begin(), tried.end(), index) != tried.end()) {
+        return false;
+    }
+    return Backends_[index].EjectedUntil.load(std::memory_order_relaxed) <= now;
+}
+
+size_t TBackendGroup::FirstAvailable(size_t start, const TTried& tried, int64_t now) const {
+    for (size_t i = 0; i < Backends_.size(); i++) {
+        size_t index = (start + i) % Backends_.size();
+        if (Available(index, tried, now)) {
+            return index;
+        }
+    }
+
+    /* every backend is ejected, they are used anyway */
+    for (size_t i = 0; i < Backends_.size(); i++) {
+        size_t index = (start + i) % Backends_.size();
+        if (std::find(tried.begin(), tried.end(), index) == tried.end()) {
+            return index;
+        }
+    }
+
+    return start;
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include <handles/connection_pool.h>
+#include <handles/tcp.h>
+#include <util/small_vector.h>
+
+/*
+ * Set of interchangeable backends requests are balanced between.
+ *
+ * Group is a part of context and is shared by all reactors, so its state is kept in relaxed atomics:
+ * exact numbers are not needed for balancing. Backend which failed to accept connection `MaxFails`
+ * times in a row is ejected for `EjectionTime`, requests go to other backends meanwhile.
+ * If every backend is ejected, they are used anyway.
+ */
+class TBackendGroup : public std::enable_shared_from_this<TBackendGroup>, TMoveOnly {
+public:
+    enum EPolicy {
+        /* backends are taken in turn */
+        BpRoundRobin = 0,
+        /* backend with the least number of requests in flight */
+        BpLeastOutstanding = 1,
+        /* client address is mapped to backend, so requests of one client go to the same backend */
+        BpConsistentHash = 2,
+    };
+
+    enum {
+        /* points per backend on consistent hash ring */
+        VirtualNodes = 160,
+    };
+
+    struct TOptions {
+        EPolicy Policy = BpRoundRobin;
+        /* consecutive connect failures after which backend is ejected, 0 disables ejection */
+        size_t MaxFails = 3;
+        std::chrono::steady_clock::duration EjectionTime = std::chrono::seconds(10);
+        /* zero means no timeout */
+        std::chrono::steady_clock::duration ConnectTimeout = std::chrono::seconds(5);
+    };
+
+    /*
+     * Request in flight to backend, it is counted as outstanding until lease is destroyed.
+     */
+    class TLease : TMoveOnly {
+    public:
+        TLease(std::shared_ptr<TBackendGroup> group, size_t index);
+        ~TLease();
+
+        size_t Index() const {
+            return Index_;
+        }
+
+        const TSocketAddress& Address() const {
+            return Group_->Address(Index_);
+        }
+
+    private:
+        std::shared_ptr<TBackendGroup> Group_;
+        size_t Index_;
+    };
+
+    struct TConnection {
+        TTcpHandlePtr Handle;
+        std::shared_ptr<TLease> Lease;
+        /* connection was idle in pool, so backend may have closed it meanwhile */
+        bool Reused = false;
+    };
+
+    using TTried = TSmallVector<size_t, 8>;
+
+    TBackendGroup(std::vector<TSocketAddress> addresses, TOptions options);
+
+    /*
+     * Connects to backend chosen for `client` (may be null) taking connection from `pool`, if it is set.
+     * On failure the next backend is tried, until every backend was tried once.
+     * @param fresh -- idle connections of `pool` are not taken, new one is connected.
+     */
+    TResult<TConnection> Connect(TConnectionPool* pool, const TSocketAddress* client, TReactor::TDeadline deadline = TReactor::TDeadline::max(), bool fresh = false);
+
+    /*
+     * Chooses backend for `client`, backends in `tried` are skipped while possible.
+     */
+    size_t Pick(const TSocketAddress* client, const TTried& tried = TTried());
+
+    size_t Size() const {
+        return Backends_.size();
+    }
+
+    const TSocketAddress& Address(size_t index) const {
+        return Backends_[index].Address;
+    }
+
+    size_t Outstanding(size_t index) const {
+        return Backends_[index].Outstanding.load(std::memory_order_relaxed);
+    }
+
+    bool Ejected(size_t index) const {
+        return Backends_[index].EjectedUntil.load(std::memory_order_relaxed) > Reactor()->Now().time_since_epoch().count();
+    }
+
+    void ReportSuccess(size_t index);
+    void ReportFailure(size_t index);
+
+    const TOptions& Options() const {
+        return Options_;
+    }
+
+private:
+    struct TBackend {
+        TSocketAddress Address;
+        std::atomic<size_t> Outstanding = 0;
+        std::atomic<size_t> Fails = 0;
+        /* steady clock ticks */
+        std::atomic<int64_t> EjectedUntil = 0;
+    };
+
+    struct TRingPoint {
+        uint64_t Point;
+        size_t Backend;
+
+        bool operator<(const TRingPoint& other) const {
+            return Point < other.Point;
+        }
+    };
+
+    bool Available(size_t index, const TTried& tried, int64_t now) const;
+
+    /*
+     * The first available backend starting from `start`, if there is none, the first one not tried.
+     */
+    size_t FirstAvailable(size_t start, const TTried& tried, int64_t now) const;
+
+    std::vector<TBackend> Backends_;
+    std::vector<TRingPoint> Ring_;
+    TOptions Options_;
+    std::atomic<size_t> Next_ = 0;
+};
+
+using TBackendGroupPtr = std::shared_ptr<TBackendGroup>;
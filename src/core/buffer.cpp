@@ -1 +1,33 @@
 #include "buffer.h"
+
+TSocketBuffer::TSocketBuffer(TSocketBuffer&& other) noexcept
+    : Begin_(other.Begin_)
+    , Size_(other.Size_)
+    , Capacity_(other.Capacity_)
+    , Data_(other.Data_)
+    , Mirrored_(other.Mirrored_)
+    , Block_(std::move(other.Block_))
+    , Registration_(std::move(other.Registration_))
+{
+    other.Data_ = nullptr;
+    other.Capacity_ = 0;
+    other.Reset();
+}
+
+TSocketBuffer& TSocketBuffer::operator=(TSocketBuffer&& other) noexcept {
+    std::swap(Begin_, other.Begin_);
+    std::swap(Size_, other.Size_);
+    std::swap(Capacity_, other.Capacity_);
+    std::swap(Data_, other.Data_);
+    std::swap(Mirrored_, other.Mirrored_);
+    std::swap(Block_, other.Block_);
+    std::swap(Registration_, other.Registration_);
+    return *this;
+}
+
+void TSocketBuffer::Compact() {
+    if (Size_ > 0) {
+        ::memmove(Data_, Data_ + Begin_, Size_);
+    }
+    Begin_ = 0;
+}
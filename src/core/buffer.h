@@ -1,10 +1,13 @@
 #pragma once
 
+#include <cstring>
 #include <memory>
 #include <vector>
-#include <list>
 
 #include "util/generic.h"
+#include <util/buffer_pool.h>
+#include <util/small_vector.h>
+#include <coro/reactor.h>
 
 class TMemoryRegion {
 public:
@@ -74,8 +77,16 @@ private:
     size_t Size_ = 0;
 };
 
+/*
+ * Sequence of memory regions written with one vectored write.
+ * Short chains are stored inline, so building a chain does not allocate.
+ */
 class TMemoryRegionChain {
 public:
+    enum {
+        InlineCapacity = 8
+    };
+
     TMemoryRegionChain() = default;
     TMemoryRegionChain(std::initializer_list<TMemoryRegion> chain)
         : Chain_(chain)
@@ -83,36 +94,55 @@ public:
     }
 
     void Add(TMemoryRegion region) {
-        Chain_.push_back(region);
+        Chain_.PushBack(region);
     }
 
+    /*
+     * Drops `bytes` bytes from the head of chain, fully consumed regions are skipped without moving the rest.
+     */
     void Advance(size_t bytes) {
-        while (!Chain_.empty() && bytes >= Chain_.begin()->Size()) {
-            bytes -= Chain_.begin()->Size();
-            Chain_.erase(Chain_.begin());
+        while (Head_ < Chain_.Size() && bytes >= Chain_[Head_].Size()) {
+            bytes -= Chain_[Head_].Size();
+            Head_++;
         }
 
-        if (!Chain_.empty()) {
-            *Chain_.begin() = Chain_.begin()->Slice(bytes);
+        if (Head_ < Chain_.Size()) {
+            Chain_[Head_] = Chain_[Head_].Slice(bytes);
         }
     }
 
-    const std::list<TMemoryRegion>& Regions() const {
-        return Chain_;
+    const TMemoryRegion* begin() const {
+        return Chain_.begin() + Head_;
     }
 
-    std::list<TMemoryRegion>& Regions() {
-        return Chain_;
+    const TMemoryRegion* end() const {
+        return Chain_.end();
+    }
+
+    /*
+     * Number of regions left.
+     */
+    size_t Size() const {
+        return Chain_.Size() - Head_;
     }
 
     bool Empty() const {
-        return Chain_.empty();
+        return Head_ == Chain_.Size();
     }
 
 private:
-    std::list<TMemoryRegion> Chain_;
+    TSmallVector<TMemoryRegion, InlineCapacity> Chain_;
+    size_t Head_ = 0;
 };
 
+/*
+ * Byte queue used for socket reads: data is appended at `End()` and consumed with `ChopBegin()`.
+ * Both stored data and free space are always contiguous, so they can be handed to parser or syscalls as is.
+ *
+ * If memory block is mirrored (see `TBufferBlock`), buffer is a ring, so chopping is O(1) and data never moves.
+ * Otherwise it is a plain array, chopping is still O(1), but remaining data is moved to the beginning
+ * before the next append.
+ */
 class TSocketBuffer : public TMoveOnly {
 public:
     enum {
@@ -121,12 +151,33 @@ public:
 
     TSocketBuffer() = default;
 
+    /*
+     * Allocates standalone buffer of exactly `capacity` bytes.
+     */
     TSocketBuffer(size_t capacity)
-        : Capacity_(capacity)
-        , Data_(new uint8_t[capacity])
+        : TSocketBuffer(TBufferBlock::Allocate(capacity))
     {
     }
 
+    /*
+     * Takes buffer from `pool`, its capacity is `capacity` rounded up to pool's size class.
+     */
+    TSocketBuffer(TBufferPool& pool, size_t capacity)
+        : TSocketBuffer(pool.Acquire(capacity))
+    {
+    }
+
+    TSocketBuffer(TBufferBlock block)
+        : Capacity_(block.Size())
+        , Data_(block.Data())
+        , Mirrored_(block.Mirrored())
+        , Block_(std::move(block))
+    {
+    }
+
+    TSocketBuffer(TSocketBuffer&& other) noexcept;
+    TSocketBuffer& operator=(TSocketBuffer&& other) noexcept;
+
     void FillWithZero() {
         ::memset(Data(), '\0', Size());
     }
@@ -143,12 +194,21 @@ public:
         return Size_;
     }
 
-    const void* End() const {
-        return Data_.get() + Size_;
+    /*
+     * Whether buffer is a ring of twice mapped memory.
+     */
+    bool Mirrored() const {
+        return Mirrored_;
     }
 
+    /*
+     * Beginning of free space, at least `Remaining()` bytes can be written there.
+     */
     void* End() {
-        return Data_.get() + Size_;
+        if (!Mirrored_ && Begin_ > 0) {
+            Compact();
+        }
+        return Data_ + Begin_ + Size_;
     }
 
     void Advance(size_t n) {
@@ -162,7 +222,10 @@ public:
         if (n == Size()) {
             Reset();
         } else {
-            ::memmove(Data(), DataAs<const uint8_t*>() + n, Size() - n);
+            Begin_ += n;
+            if (Mirrored_ && Begin_ >= Capacity_) {
+                Begin_ -= Capacity_;
+            }
             Size_ -= n;
         }
     }
@@ -184,11 +247,11 @@ public:
     }
 
     const void* Data() const {
-        return Data_.get();
+        return Data_ + Begin_;
     }
 
     void* Data() {
-        return Data_.get();
+        return Data_ + Begin_;
     }
 
     TMemoryRegion BackwardSlice(size_t size) {
@@ -197,10 +260,11 @@ public:
 
     template<class T>
     const T DataAs() const {
-        return reinterpret_cast<T>(Data_.get());
+        return reinterpret_cast<T>(Data_ + Begin_);
     }
 
     void Reset() {
+        Begin_ = 0;
         Size_ = 0;
     }
 
@@ -213,13 +277,53 @@ public:
     }
 
     TMemoryRegion CurrentMemoryRegion() const {
-        return TMemoryRegion(Data_.get(), Size_);
+        return TMemoryRegion(Data_ + Begin_, Size_);
+    }
+
+    /*
+     * Registers buffer as io_uring fixed buffer of `reactor`, so reads into it are cheaper.
+     * Has no effect if reactor does not use io_uring. Buffer must not outlive reactor.
+     * Pooled buffer must come from pool of the same reactor, its registration is reused with memory.
+     */
+    void Register(TReactor* reactor) {
+        if (Block_.FixedIndex() >= 0) {
+            return;
+        }
+
+        TRegisteredBuffer registration = reactor->RegisterBuffer(Data_, Block_.MappedSize());
+        if (Block_.Pooled()) {
+            /* slot is kept while block is reused, pool releases it via reactor's free hook */
+            Block_.SetFixedIndex(registration.Release());
+        } else {
+            Registration_ = std::move(registration);
+        }
+    }
+
+    /*
+     * Index of fixed buffer or -1 if buffer is not registered.
+     */
+    int BufferIndex() const {
+        return Block_.FixedIndex() >= 0 ? Block_.FixedIndex() : Registration_.Index();
+    }
+
+    /*
+     * Whether buffer has memory, default constructed and moved out buffers have not.
+     */
+    bool Allocated() const {
+        return Data_ != nullptr;
     }
 
 private:
+    void Compact();
+
+    size_t Begin_ = 0;
     size_t Size_ = 0;
     size_t Capacity_ = 0;
-    std::unique_ptr<uint8_t[]> Data_ = nullptr;
+    uint8_t* Data_ = nullptr;
+    bool Mirrored_ = false;
+    TBufferBlock Block_;
+    /* declared after block, so kernel forgets about memory before it returns to pool */
+    TRegisteredBuffer Registration_;
 };
 
 using TSocketBufferPtr = std::shared_ptr<TSocketBuffer>;
@@ -1,10 +1,13 @@
 #include <core/context.h>
 
 #include <pybind11/eval.h>
+#include <pybind11/stl.h>
 #include <util/python.h>
 
 TSocketBufferPtr TContext::AllocBuffer(size_t size) {
-    return std::make_shared<TSocketBuffer>(size);
+    TSocketBufferPtr buffer = std::make_shared<TSocketBuffer>(Reactor()->BufferPool(), size);
+    buffer->Register(Reactor());
+    return buffer;
 }
 
 template <typename T>
@@ -15,17 +18,113 @@ static inline T ReadFromConfig(py::object pyConfig, const std::string& key) {
     return pyConfig[key.c_str()].cast<T>();
 }
 
+template <typename T>
+static inline T ReadFromConfig(py::object pyConfig, const std::string& key, T defaultValue) {
+    if (!pyConfig.contains(key)) {
+        return defaultValue;
+    }
+    return pyConfig[key.c_str()].cast<T>();
+}
+
+static TReactor::EDeadlineQueueKind ParseDeadlineQueueKind(const std::string& kind) {
+    if (kind == "heap") {
+        return TReactor::DqHeap;
+    } else if (kind == "timer_wheel") {
+        return TReactor::DqTimerWheel;
+    }
+    throw TException() << "unknown deadline queue '" << kind << "', expected 'heap' or 'timer_wheel'";
+}
+
+static TBackendGroup::EPolicy ParseBalancingPolicy(const std::string& policy) {
+    if (policy == "round_robin") {
+        return TBackendGroup::BpRoundRobin;
+    } else if (policy == "least_outstanding") {
+        return TBackendGroup::BpLeastOutstanding;
+    } else if (policy == "consistent_hash") {
+        return TBackendGroup::BpConsistentHash;
+    }
+    throw TException() << "unknown balancing policy '" << policy << "', expected 'round_robin', 'least_outstanding' or 'consistent_hash'";
+}
+
+static std::chrono::steady_clock::duration ReadDuration(py::object pyConfig, const std::string& key, std::chrono::steady_clock::duration defaultValue) {
+    double seconds = ReadFromConfig<double>(pyConfig, key, std::chrono::duration<double>(defaultValue).count());
+    return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+}
+
+static TConfig::EHandlerMode ParseHandlerMode(const std::string& mode) {
+    if (mode == "python") {
+        return TConfig::HmPython;
+    } else if (mode == "native") {
+        return TConfig::HmNative;
+    }
+    throw TException() << "unknown handler mode '" << mode << "', expected 'python' or 'native'";
+}
+
+static std::vector<THttpProxy::TRule> ReadHookRules(py::object pyConfig) {
+    std::vector<THttpProxy::TRule> rules;
+    if (!pyConfig.contains("hook_rules")) {
+        return rules;
+    }
+
+    for (py::handle item : pyConfig["hook_rules"]) {
+        py::object rule = py::reinterpret_borrow<py::object>(item);
+        THttpProxy::TRule parsed;
+        parsed.Method = ReadFromConfig<std::string>(rule, "method", "");
+        parsed.UrlPrefix = ReadFromConfig<std::string>(rule, "url_prefix", "");
+        parsed.Header = ReadFromConfig<std::string>(rule, "header", "");
+        rules.push_back(std::move(parsed));
+    }
+    return rules;
+}
+
+static TReactor::EIoBackend ParseIoBackend(const std::string& backend) {
+    if (backend == "epoll") {
+        return TReactor::IoEpoll;
+    } else if (backend == "io_uring") {
+        return TReactor::IoUring;
+    }
+    throw TException() << "unknown io backend '" << backend << "', expected 'epoll' or 'io_uring'";
+}
+
 TConfig ReadConfigFromFile(std::string filename) {
     TConfig config;
     py::object pyConfig = PyEvalFile(filename);
     config.Host = ReadFromConfig<std::string>(pyConfig, "host");
     config.Port = ReadFromConfig<std::string>(pyConfig, "port");
     config.Backlog = ReadFromConfig<size_t>(pyConfig, "backlog");
-    config.HandlerFile = ReadFromConfig<std::string>(pyConfig, "handler_file");
-    config.BackendIp = ReadFromConfig<std::string>(pyConfig, "backend_ip");
-    config.BackendIpv6 = ReadFromConfig<std::string>(pyConfig, "backend_ipv6");
-    config.BackendPort = ReadFromConfig<std::string>(pyConfig, "backend_port");
+    config.HandlerMode = ParseHandlerMode(ReadFromConfig<std::string>(pyConfig, "handler_mode", "python"));
+    if (config.HandlerMode == TConfig::HmPython) {
+        config.HandlerFile = ReadFromConfig<std::string>(pyConfig, "handler_file");
+    } else {
+        config.HandlerFile = ReadFromConfig<std::string>(pyConfig, "handler_file", "");
+    }
+    config.HttpProxy.IdleTimeout = ReadDuration(pyConfig, "keep_alive_timeout", config.HttpProxy.IdleTimeout);
+    config.HttpProxy.RelayTimeout = ReadDuration(pyConfig, "relay_timeout", config.HttpProxy.RelayTimeout);
+    config.HttpProxy.Rules = ReadHookRules(pyConfig);
+    config.Backends = ReadFromConfig<std::vector<std::string>>(pyConfig, "backends", {});
+    if (config.Backends.empty()) {
+        config.BackendIp = ReadFromConfig<std::string>(pyConfig, "backend_ip");
+        config.BackendPort = ReadFromConfig<std::string>(pyConfig, "backend_port");
+    }
+    config.BackendIpv6 = ReadFromConfig<std::string>(pyConfig, "backend_ipv6", "");
+    config.BackendGroup.Policy = ParseBalancingPolicy(ReadFromConfig<std::string>(pyConfig, "balancing", "round_robin"));
+    config.BackendGroup.MaxFails = ReadFromConfig<size_t>(pyConfig, "backend_max_fails", config.BackendGroup.MaxFails);
+    config.BackendGroup.EjectionTime = ReadDuration(pyConfig, "backend_ejection_time", config.BackendGroup.EjectionTime);
+    config.BackendGroup.ConnectTimeout = ReadDuration(pyConfig, "backend_connect_timeout", config.BackendGroup.ConnectTimeout);
     config.Protocol = ReadFromConfig<std::string>(pyConfig, "protocol");
     config.CoroutineStackSize = ReadFromConfig<size_t>(pyConfig, "coroutine_stack_size");
+    config.StackPoolSize = ReadFromConfig<size_t>(pyConfig, "stack_pool_size", config.StackPoolSize);
+    config.StackPoolHotSize = ReadFromConfig<size_t>(pyConfig, "stack_pool_hot_size", config.StackPoolHotSize);
+    config.PipePoolSize = ReadFromConfig<size_t>(pyConfig, "pipe_pool_size", config.PipePoolSize);
+    config.BufferPoolSize = ReadFromConfig<size_t>(pyConfig, "buffer_pool_size", config.BufferPoolSize);
+    config.BufferPoolHugePages = ReadFromConfig<bool>(pyConfig, "buffer_pool_hugepages", config.BufferPoolHugePages);
+    config.RegexpStreamPoolSize = ReadFromConfig<size_t>(pyConfig, "regexp_stream_pool_size", config.RegexpStreamPoolSize);
+    config.RegexpCacheDir = ReadFromConfig<std::string>(pyConfig, "regexp_cache_dir", "");
+    config.BackendPoolMaxIdle = ReadFromConfig<size_t>(pyConfig, "backend_pool_max_idle", config.BackendPoolMaxIdle);
+    config.BackendPoolMaxTotal = ReadFromConfig<size_t>(pyConfig, "backend_pool_max_total", config.BackendPoolMaxTotal);
+    config.BackendPoolIdleTimeout = ReadDuration(pyConfig, "backend_pool_idle_timeout", config.BackendPoolIdleTimeout);
+    config.Workers = ReadFromConfig<size_t>(pyConfig, "workers", 1);
+    config.DeadlineQueue = ParseDeadlineQueueKind(ReadFromConfig<std::string>(pyConfig, "deadline_queue", "heap"));
+    config.IoBackend = ParseIoBackend(ReadFromConfig<std::string>(pyConfig, "io_backend", "epoll"));
     return config;
 }
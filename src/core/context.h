@@ -1,5 +1,7 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <spdlog/spdlog.h>
 #include <pybind11/pybind11.h>
@@ -7,12 +9,25 @@
 #include <unordered_map>
 
 #include "fwd.h"
+#include <core/backend_group.h>
+#include <core/http_proxy.h>
+#include <handles/connection_pool.h>
 #include <handles/tcp.h>
+#include <regexp/pool.h>
 
 namespace py = pybind11;
 
 struct TConfig {
+    enum EHandlerMode {
+        /* every connection is served by `handler` of handler file */
+        HmPython = 0,
+        /* HTTP requests are relayed to backends by `THttpProxy`, `hook` of handler file is called for matching ones */
+        HmNative = 1,
+    };
+
+    EHandlerMode HandlerMode = HmPython;
     std::string HandlerFile;
+    THttpProxy::TOptions HttpProxy;
 
     std::string Host;
     std::string Port;
@@ -24,7 +39,52 @@ struct TConfig {
     std::string BackendIpv6;
     std::string BackendPort;
 
+    /* backends like "tcp://host:port", every address of host is a member of group; if empty, backend_ip is used */
+    std::vector<std::string> Backends;
+    TBackendGroup::TOptions BackendGroup;
+
     size_t CoroutineStackSize = 0;
+    /* how many stacks of finished coroutines are kept for reuse */
+    size_t StackPoolSize = TCoroStackPool::DefaultMaxSize;
+    /* how many of pooled stacks are kept without releasing their pages */
+    size_t StackPoolHotSize = TCoroStackPool::DefaultHotSize;
+    /* how many empty pipes for splicing are kept for reuse */
+    size_t PipePoolSize = TPipePool::DefaultMaxSize;
+    /* how many bytes of free socket buffers are kept for reuse */
+    size_t BufferPoolSize = TBufferPool::DefaultMaxFreeBytes;
+    /* whether socket buffers are allocated from huge pages */
+    bool BufferPoolHugePages = false;
+    /* how many bytes of free Hyperscan stream states are kept for reuse */
+    size_t RegexpStreamPoolSize = TRegexpPool::DefaultMaxFreeStreamBytes;
+    /* directory of compiled Hyperscan databases, empty disables cache */
+    std::string RegexpCacheDir;
+
+    /* how many idle connections are kept per backend */
+    size_t BackendPoolMaxIdle = TConnectionPool::DefaultMaxIdle;
+    /* how many connections per backend may be open at once, 0 means no limit */
+    size_t BackendPoolMaxTotal = TConnectionPool::DefaultMaxTotal;
+    /* idle backend connections are closed after this time */
+    std::chrono::steady_clock::duration BackendPoolIdleTimeout = TConnectionPool::DefaultIdleTimeout;
+
+    /* number of reactor threads, 0 means one per core */
+    size_t Workers = 1;
+
+    TReactor::EDeadlineQueueKind DeadlineQueue = TReactor::DqHeap;
+
+    /* it is chosen once at startup, reload does not change it */
+    TReactor::EIoBackend IoBackend = TReactor::IoEpoll;
+};
+
+/*
+ * Reloads of service, shared by all its contexts.
+ */
+struct TReloadStats {
+    std::atomic<bool> InProgress = false;
+    std::atomic<size_t> Reloads = 0;
+    std::atomic<size_t> Failures = 0;
+    /* from signal to published context, in microseconds */
+    std::atomic<uint64_t> LastLatency = 0;
+    std::atomic<uint64_t> MaxLatency = 0;
 };
 
 class TContext {
@@ -32,8 +92,15 @@ public:
     std::shared_ptr<spdlog::logger> Logger;
     TConfig Config;
     py::object HandlerObject;
+    /* handler is `async def`, it is run by event loop of worker instead of coroutine of its own */
+    bool AsyncHandler = false;
+    /* hook of native mode, may be unset */
+    py::object HookObject;
     py::object HandlerModule;
+    /* the first backend of group */
     TSocketAddress BackendAddr;
+    TBackendGroupPtr Backends;
+    std::shared_ptr<TReloadStats> ReloadStats;
 
     ~TContext() {
         Logger->info("context destroyed");
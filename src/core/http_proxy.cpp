@@ -0,0 +1,241 @@
+#include "http_proxy.h"
+
+#include <limits>
+
+bool THttpProxy::TRule::Matches(const THttpRequest& request) const {
+    if (!Method.empty() && Method != request.Method) {
+        return false;
+    }
+    if (!UrlPrefix.empty() && request.Url.compare(0, UrlPrefix.size(), UrlPrefix) != 0) {
+        return false;
+    }
+    if (!Header.empty() && !request.Headers.Has(Header)) {
+        return false;
+    }
+    return true;
+}
+
+TResult<size_t> THttpProxy::Serve(TTcpHandlePtr client) {
+    TSocketAddress clientAddr = client->PeerAddress();
+    THttpHandle handle(std::move(client));
+
+    return handle.ServeRequests([this, &handle, &clientAddr](THttpRequest& request) {
+        /* waiting for the next request is limited by idle timeout only */
+        handle.Handle()->SetIoTimeout(Options_.RelayTimeout);
+        bool more = Relay(handle, request, clientAddr);
+        handle.Handle()->SetIoTimeout(std::chrono::steady_clock::duration::zero());
+        return more;
+    }, Options_.IdleTimeout);
+}
+
+bool THttpProxy::Relay(THttpHandle& client, THttpRequest& request, const TSocketAddress& clientAddr) {
+    if (Hooked(request)) {
+        std::optional<THttpResponse> response = Hook_(request);
+        if (response) {
+            if (!response->Headers.Has("Content-Length") && !response->Headers.Has("Transfer-Encoding")) {
+                response->Headers.Set("Content-Length", "0");
+            }
+            return static_cast<bool>(client.WriteResponse(*response));
+        }
+    }
+
+    std::optional<TSentinel::TInspection> inspection;
+    /* request body which sentinel inspects whole is read before backend is chosen */
+    std::optional<TMemoryRegion> requestBody;
+    if (Sentinel_) {
+        inspection.emplace(*Sentinel_, request, Runner_);
+        if (!Denied(inspection)) {
+            BufferBody(client, request, *inspection, false, requestBody);
+        }
+        /* request without body is whole once its head is sent, so verdict on body is taken before */
+        if (!requestBody && !Streamed(request)) {
+            inspection->BodyEnd(false);
+        }
+        if (Denied(inspection)) {
+            return Reply(client, 403, "Forbidden");
+        }
+    }
+
+    std::optional<THttpHandle> backend;
+    TResult<THttpResponse> response;
+    /* idle connection may be closed by backend just as request is sent on it, then safe request is repeated on new one */
+    for (bool fresh = false; ; fresh = true) {
+        TResult<TBackendGroup::TConnection> connection = Backends_->Connect(Pool_, &clientAddr, ConnectDeadline(), fresh);
+        if (!connection) {
+            return Reply(client, 502, "Bad Gateway");
+        }
+
+        connection.Result().Handle->SetIoTimeout(Options_.RelayTimeout);
+        backend.emplace(connection.Result().Handle);
+
+        /* whether body was read from client, so it cannot be sent again */
+        bool consumed = false;
+        /* whether backend started to answer */
+        bool answered = false;
+        TResult<size_t> sent = backend->WriteRequest(request);
+        if (sent) {
+            consumed = !requestBody && Streamed(request);
+            sent = requestBody
+                ? backend->Handle()->WriteAll(*requestBody)
+                : TransferBody(client, *backend, request, inspection ? &*inspection : nullptr, false);
+
+            if (Denied(inspection)) {
+                /* backend has not got whole request or it is not answered, so connection is not reused */
+                backend->Close();
+                return Reply(client, 403, "Forbidden") && sent;
+            }
+        }
+
+        if (sent) {
+            /* interim responses are not relayed, client gets final one only */
+            response = backend->ReadResponse();
+            while (response && Interim(response.Result())) {
+                answered = true;
+                response = backend->ReadResponse();
+            }
+        } else {
+            response = TResult<THttpResponse>::ForwardError(sent);
+        }
+
+        if (response) {
+            break;
+        }
+
+        backend->Close();
+        answered = answered || backend->BufferedSize() > 0;
+        if (fresh || !connection.Result().Reused || consumed || answered || !Dropped(response) || !Idempotent(request)) {
+            /* connection to client is not reused, if its request was not read completely */
+            return Reply(client, 502, "Bad Gateway");
+        }
+    }
+
+    /* protocol switched by backend cannot be relayed as HTTP */
+    if (response.Result().Status == 101) {
+        backend->Close();
+        Reply(client, 502, "Bad Gateway");
+        return false;
+    }
+
+    /* response to HEAD, 204 and 304 have no body whatever their headers say */
+    bool head = request.Method == "HEAD";
+    bool bodyless = head || response.Result().Status == 204 || response.Result().Status == 304;
+    std::optional<TMemoryRegion> responseBody;
+    if (inspection) {
+        if (inspection->ResponseHead(response.Result()) != TSentinel::SvDeny) {
+            if (bodyless || response.Result().Headers.Get("Content-Length").value_or("") == "0") {
+                inspection->BodyEnd(true);
+            } else {
+                BufferBody(*backend, response.Result(), *inspection, true, responseBody);
+            }
+        }
+        if (Denied(inspection)) {
+            backend->Close();
+            return Reply(client, 403, "Forbidden");
+        }
+    }
+
+    if (!client.WriteResponse(response.Result())) {
+        backend->Close();
+        return false;
+    }
+
+    /* connection is not reused after HEAD, as body framing of response cannot be trusted */
+    if (head) {
+        backend->Close();
+        return client.KeepAlive();
+    }
+
+    TResult<size_t> transfered = TResult<size_t>::MakeSuccess(0);
+    if (responseBody) {
+        transfered = client.Handle()->WriteAll(*responseBody);
+    } else if (!bodyless) {
+        transfered = TransferBody(*backend, client, response.Result(), inspection ? &*inspection : nullptr, true);
+    }
+
+    if (!transfered || Denied(inspection)) {
+        /* response denied on its way to client can only be cut off */
+        backend->Close();
+        return false;
+    }
+
+    if (Pool_ && backend->Idle()) {
+        /* pooled connection may be taken by python handler next */
+        backend->Handle()->SetIoTimeout(std::chrono::steady_clock::duration::zero());
+        Pool_->Release(backend->Handle());
+    } else {
+        backend->Close();
+    }
+
+    /* body without framing is relayed until backend closes connection, so client sees its end only by close too */
+    return client.KeepAlive();
+}
+
+void THttpProxy::BufferBody(THttpHandle& handle, THttpMessage& message, TSentinel::TInspection& inspection, bool response, std::optional<TMemoryRegion>& body) {
+    std::optional<size_t> limit = inspection.BufferedBody(response);
+    /* end of body delimited by close cannot be held back, so such body is inspected whole before it is sent */
+    bool untilClose = response && !message.Headers.Has("Content-Length") && !message.Headers.Has("Transfer-Encoding");
+    if (!limit && untilClose && inspection.InspectsBody(response)) {
+        limit = std::numeric_limits<size_t>::max();
+    }
+    if (!limit) {
+        return;
+    }
+
+    TResult<TMemoryRegion> res = handle.ReadBody(message);
+    if (!res || res.Result().Size() > *limit) {
+        inspection.BodyTooBig();
+        return;
+    }
+
+    inspection.BodyEnd(response, res.Result());
+    body = res.Result();
+
+    /* message without body is sent as it came */
+    if (untilClose || message.Headers.Has("Content-Length") || message.Headers.Has("Transfer-Encoding")) {
+        message.Headers.Remove("Transfer-Encoding");
+        message.Headers.Set("Content-Length", std::to_string(body->Size()));
+    }
+}
+
+TResult<size_t> THttpProxy::TransferBody(THttpHandle& from, THttpHandle& to, const THttpMessage& message, TSentinel::TInspection* inspection, bool response) {
+    if (!inspection || !inspection->InspectsBody(response)) {
+        return from.TransferBody(to, message);
+    }
+
+    /* verdict taken at the end of body comes before its last piece is sent, so denied body never arrives whole */
+    return from.TransferScannedBody(to, message, [inspection, response](TMemoryRegion piece) -> size_t {
+        return inspection->BodyPiece(response, piece) != TSentinel::SvDeny ? piece.Size() : 0;
+    }, [inspection, response]() {
+        return inspection->BodyEnd(response) != TSentinel::SvDeny;
+    });
+}
+
+bool THttpProxy::Hooked(const THttpRequest& request) const {
+    if (!Hook_) {
+        return false;
+    }
+
+    for (const TRule& rule : Options_.Rules) {
+        if (rule.Matches(request)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+TReactor::TDeadline THttpProxy::ConnectDeadline() const {
+    if (Options_.RelayTimeout == std::chrono::steady_clock::duration::zero()) {
+        return TReactor::TDeadline::max();
+    }
+    return Reactor()->Now() + Options_.RelayTimeout;
+}
+
+bool THttpProxy::Reply(THttpHandle& client, int status, const std::string& reason) {
+    THttpResponse response;
+    response.MajorVersion = 1;
+    response.MinorVersion = 1;
+    response.Status = status;
+    response.Reason = reason;
+    response.Headers.Set("Content-Length", "0");
+    return static_cast<bool>(client.WriteResponse(response));
+}
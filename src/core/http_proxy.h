@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cerrno>
+#include <chrono>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <core/backend_group.h>
+#include <core/sentinel.h>
+#include <handles/connection_pool.h>
+#include <handles/http.h>
+
+/*
+ * Relays HTTP requests of client connection to backend group and responses back without
+ * touching Python. Hook is called only for requests which match one of rules, it may change
+ * request or answer it instead of backend. Conversations may be inspected by sentinel, denied ones
+ * are answered with 403 or dropped, if response is already on its way to client.
+ */
+class THttpProxy {
+public:
+    /*
+     * Request matches rule if it matches all non-empty fields of rule.
+     */
+    struct TRule {
+        std::string Method;
+        std::string UrlPrefix;
+        /* request has header with such name */
+        std::string Header;
+
+        bool Matches(const THttpRequest& request) const;
+    };
+
+    /*
+     * Returns response which is sent to client instead of forwarding request to backend.
+     * Response is sent without body, so Content-Length is set to 0 unless framing is set by hook.
+     */
+    using THook = std::function<std::optional<THttpResponse>(THttpRequest& request)>;
+
+    struct TOptions {
+        std::chrono::steady_clock::duration IdleTimeout = std::chrono::seconds(60);
+        /*
+         * Relaying fails, if connection to backend is not established within it or if client or backend
+         * connection makes no progress for so long while request is relayed. Long bodies are not limited by it.
+         * Zero means no timeout.
+         */
+        std::chrono::steady_clock::duration RelayTimeout = std::chrono::seconds(60);
+        std::vector<TRule> Rules;
+    };
+
+    /*
+     * @param pool -- reactor's pool backend connections are taken from, may be null.
+     * @param hook -- may be empty, then rules are ignored.
+     */
+    THttpProxy(const TOptions& options, TBackendGroupPtr backends, TConnectionPool* pool, THook hook = THook())
+        : Options_(options)
+        , Backends_(std::move(backends))
+        , Pool_(pool)
+        , Hook_(std::move(hook))
+    {}
+
+    /*
+     * Serves persistent client connection until it is over.
+     * @return how many requests were served.
+     */
+    TResult<size_t> Serve(TTcpHandlePtr client);
+
+    /*
+     * Inspects every request and response with `sentinel`, its predicates are called through `runner`.
+     * Both must outlive proxy.
+     */
+    void SetSentinel(const TSentinel* sentinel, const TSentinel::TRunner* runner = nullptr) {
+        Sentinel_ = sentinel;
+        Runner_ = runner;
+    }
+
+private:
+    /*
+     * Answers one request, @return whether connection may serve more requests.
+     */
+    bool Relay(THttpHandle& client, THttpRequest& request, const TSocketAddress& clientAddr);
+
+    /*
+     * Reads body of message whole, if sentinel needs it to decide or its end is delimited by close, and inspects it.
+     * Framing of message with body is changed to `Content-Length` then, too big body is denied.
+     */
+    static void BufferBody(THttpHandle& handle, THttpMessage& message, TSentinel::TInspection& inspection, bool response, std::optional<TMemoryRegion>& body);
+
+    /*
+     * Transfers body passing it through sentinel, if it is still undecided.
+     * The last piece of body is sent only after verdict on whole body allows it.
+     */
+    static TResult<size_t> TransferBody(THttpHandle& from, THttpHandle& to, const THttpMessage& message, TSentinel::TInspection* inspection, bool response);
+
+    static bool Denied(const std::optional<TSentinel::TInspection>& inspection) {
+        return inspection && inspection->Verdict() == TSentinel::SvDeny;
+    }
+
+    /* 101 is final, as connection is not HTTP after it */
+    static bool Interim(const THttpResponse& response) {
+        return response.Status / 100 == 1 && response.Status != 101;
+    }
+
+    /* request which may be repeated, if it is not known whether backend got it */
+    static bool Idempotent(const THttpRequest& request) {
+        const std::string& method = request.Method;
+        return method == "GET" || method == "HEAD" || method == "OPTIONS" || method == "TRACE" || method == "PUT" || method == "DELETE";
+    }
+
+    /*
+     * Pooled connection failed the way connection closed by backend does: by reset or end of stream.
+     * Backend which merely timed out may still process request.
+     */
+    static bool Dropped(const TResult<THttpResponse>& response) {
+        return !response.TimedOut() && !response.Canceled() && (response.Error() == -2 || response.Error() == ECONNRESET || response.Error() == EPIPE);
+    }
+
+    /* body of request is read from client while it is sent to backend */
+    static bool Streamed(const THttpRequest& request) {
+        return request.Headers.Has("Transfer-Encoding") || request.Headers.Get("Content-Length").value_or("0") != "0";
+    }
+
+    bool Hooked(const THttpRequest& request) const;
+
+    /*
+     * Deadline of connecting to backend started now.
+     */
+    TReactor::TDeadline ConnectDeadline() const;
+
+    /*
+     * Sends response without body generated by proxy itself.
+     */
+    static bool Reply(THttpHandle& client, int status, const std::string& reason);
+
+    const TOptions& Options_;
+    TBackendGroupPtr Backends_;
+    TConnectionPool* Pool_;
+    THook Hook_;
+    const TSentinel* Sentinel_ = nullptr;
+    const TSentinel::TRunner* Runner_ = nullptr;
+};
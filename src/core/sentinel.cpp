@@ -0,0 +1,337 @@
+#include "sentinel.h"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+
+TSentinel::TCondition TSentinel::TCondition::HasHeader(bool response, std::string name) {
+    TCondition condition;
+    condition.Kind = CkHasHeader;
+    condition.Response = response;
+    condition.Header = std::move(name);
+    return condition;
+}
+
+TSentinel::TCondition TSentinel::TCondition::HeaderMatches(bool response, std::string name, TRegexpDef regexp) {
+    TCondition condition;
+    condition.Kind = CkHeaderMatches;
+    condition.Response = response;
+    condition.Header = std::move(name);
+    condition.Regexp = std::move(regexp);
+    return condition;
+}
+
+TSentinel::TCondition TSentinel::TCondition::BodyContains(bool response, TRegexpDef regexp, bool buffered, size_t threshold) {
+    TCondition condition;
+    condition.Kind = CkBodyContains;
+    condition.Response = response;
+    condition.Regexp = std::move(regexp);
+    condition.Buffered = buffered;
+    condition.Threshold = threshold;
+    return condition;
+}
+
+TSentinel::TCondition TSentinel::TCondition::RequestIf(TRequestPredicate predicate) {
+    TCondition condition;
+    condition.Kind = CkIf;
+    condition.RequestPredicate = std::move(predicate);
+    return condition;
+}
+
+TSentinel::TCondition TSentinel::TCondition::ResponseIf(TResponsePredicate predicate) {
+    TCondition condition;
+    condition.Kind = CkIf;
+    condition.Response = true;
+    condition.ResponsePredicate = std::move(predicate);
+    return condition;
+}
+
+TSentinel::TCondition TSentinel::TCondition::BodyIf(bool response, TBodyPredicate predicate) {
+    TCondition condition;
+    condition.Kind = CkBodyIf;
+    condition.Response = response;
+    condition.Buffered = true;
+    condition.BodyPredicate = std::move(predicate);
+    return condition;
+}
+
+TSentinel::TSentinel(std::vector<TSectionDef> sections, const TRunner* compiler) {
+    Sections_.reserve(sections.size());
+
+    /* regexps of every section, they are compiled after all conditions are taken */
+    std::vector<std::array<std::vector<THeaderRegexpDef>, 2>> headerRegexps(sections.size());
+    std::vector<std::array<std::vector<TRegexpDef>, 2>> bodyRegexps(sections.size());
+
+    for (size_t i = 0; i < sections.size(); i++) {
+        TSectionDef& def = sections[i];
+        TSection& section = Sections_.emplace_back();
+        section.UrlPrefix = std::move(def.UrlPrefix);
+        section.Policy = def.Policy;
+
+        for (TBlock& block : def.Blocks) {
+            if (block.empty()) {
+                throw TException() << "empty block in section '" << section.UrlPrefix << "'";
+            }
+
+            std::vector<size_t>& indices = section.Blocks.emplace_back();
+            for (TCondition& condition : block) {
+                size_t index = section.Conditions.size();
+                indices.push_back(index);
+                section.BlockOf.push_back(section.Blocks.size() - 1);
+
+                /* a condition is satisfied by its first match, the rest are not reported */
+                if (condition.Kind == CkHeaderMatches) {
+                    headerRegexps[i][condition.Response].push_back({ condition.Header, *condition.Regexp });
+                    section.HeaderRegexps[condition.Response].push_back(index);
+                } else if (condition.Kind == CkBodyContains) {
+                    bodyRegexps[i][condition.Response].emplace_back(condition.Regexp->Expr, condition.Regexp->Flags | HS_FLAG_SINGLEMATCH);
+                    section.BodyRegexps[condition.Response].push_back(index);
+                }
+
+                section.Conditions.push_back(std::move(condition));
+            }
+        }
+    }
+
+    /* databases are built of regexps only, so compiler may run this without GIL */
+    auto compile = [this, &headerRegexps, &bodyRegexps]() {
+        for (size_t i = 0; i < Sections_.size(); i++) {
+            for (size_t response = 0; response < 2; response++) {
+                if (!headerRegexps[i][response].empty()) {
+                    Sections_[i].HeaderDb[response] = std::make_unique<THeaderRegexpDatabase>(std::move(headerRegexps[i][response]));
+                }
+                if (!bodyRegexps[i][response].empty()) {
+                    Sections_[i].BodyDb[response] = std::make_unique<TStreamRegexpDatabase>(std::move(bodyRegexps[i][response]));
+                }
+            }
+        }
+        return true;
+    };
+
+    if (compiler && *compiler) {
+        (*compiler)(compile);
+    } else {
+        compile();
+    }
+}
+
+const TSentinel::TSection* TSentinel::Match(const THttpRequest& request) const {
+    for (const TSection& section : Sections_) {
+        if (request.Url.compare(0, section.UrlPrefix.size(), section.UrlPrefix) == 0) {
+            return &section;
+        }
+    }
+    return nullptr;
+}
+
+TSentinel::TInspection::TInspection(const TSentinel& sentinel, const THttpRequest& request, const TRunner* runner)
+    : Section_(sentinel.Match(request))
+    , Runner_(runner)
+{
+    if (!Section_) {
+        Verdict_ = SvAllow;
+        return;
+    }
+
+    States_.assign(Section_->Conditions.size(), CsUnknown);
+    UpdateVerdict();
+
+    InspectHeaders(false, request.Headers);
+    CallPredicates([](const TCondition& condition) {
+        return condition.Kind == CkIf && !condition.Response;
+    }, [&request](const TCondition& condition) {
+        return condition.RequestPredicate(request);
+    });
+}
+
+TSentinel::EVerdict TSentinel::TInspection::ResponseHead(const THttpResponse& response) {
+    InspectHeaders(true, response.Headers);
+    CallPredicates([](const TCondition& condition) {
+        return condition.Kind == CkIf && condition.Response;
+    }, [&response](const TCondition& condition) {
+        return condition.ResponsePredicate(response);
+    });
+    return Verdict_;
+}
+
+bool TSentinel::TInspection::InspectsBody(bool response) const {
+    if (Verdict_ != SvUndecided) {
+        return false;
+    }
+
+    for (size_t index = 0; index < States_.size(); index++) {
+        const TCondition& condition = Section_->Conditions[index];
+        if (condition.Response == response && (condition.Kind == CkBodyContains || condition.Kind == CkBodyIf)
+            && States_[index] == CsUnknown && Alive(Section_->BlockOf[index]))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::optional<size_t> TSentinel::TInspection::BufferedBody(bool response) const {
+    if (Verdict_ != SvUndecided) {
+        return std::nullopt;
+    }
+
+    bool buffered = false;
+    size_t limit = std::numeric_limits<size_t>::max();
+    for (size_t index = 0; index < States_.size(); index++) {
+        const TCondition& condition = Section_->Conditions[index];
+        if (condition.Response != response || !condition.Buffered || States_[index] != CsUnknown || !Alive(Section_->BlockOf[index])) {
+            continue;
+        }
+        buffered = true;
+        if (condition.Threshold != 0) {
+            limit = std::min(limit, condition.Threshold);
+        }
+    }
+
+    if (!buffered) {
+        return std::nullopt;
+    }
+    return limit;
+}
+
+TSentinel::EVerdict TSentinel::TInspection::BodyPiece(bool response, TMemoryRegion piece) {
+    if (Verdict_ != SvUndecided || !Section_->BodyDb[response] || piece.Empty()) {
+        return Verdict_;
+    }
+
+    if (!Matcher_ || MatcherResponse_ != response) {
+        Matcher_ = std::make_unique<TStreamRegexpMatcher>(*Section_->BodyDb[response], [this, response](unsigned int id, size_t, size_t) {
+            size_t index = Section_->BodyRegexps[response][id];
+            if (States_[index] == CsUnknown) {
+                States_[index] = CsTrue;
+                UpdateVerdict();
+            }
+            /* the rest of body is not scanned once verdict is known */
+            return Verdict_ != SvUndecided;
+        });
+        MatcherResponse_ = response;
+    }
+
+    Matcher_->Scan(piece);
+    return Verdict_;
+}
+
+TSentinel::EVerdict TSentinel::TInspection::BodyEnd(bool response, TMemoryRegion body) {
+    BodyPiece(response, body);
+    Matcher_.reset();
+
+    ResolveUnknown([response](const TCondition& condition) {
+        return condition.Kind == CkBodyContains && condition.Response == response;
+    });
+    CallPredicates([response](const TCondition& condition) {
+        return condition.Kind == CkBodyIf && condition.Response == response;
+    }, [body](const TCondition& condition) {
+        return condition.BodyPredicate(body);
+    });
+    return Verdict_;
+}
+
+TSentinel::EVerdict TSentinel::TInspection::BodyTooBig() {
+    Verdict_ = SvDeny;
+    return Verdict_;
+}
+
+void TSentinel::TInspection::InspectHeaders(bool response, const THttpHeaders& headers) {
+    if (Verdict_ != SvUndecided) {
+        return;
+    }
+
+    for (size_t index = 0; index < States_.size(); index++) {
+        const TCondition& condition = Section_->Conditions[index];
+        if (condition.Kind == CkHasHeader && condition.Response == response && States_[index] == CsUnknown && headers.Has(condition.Header)) {
+            States_[index] = CsTrue;
+        }
+    }
+
+    if (Section_->HeaderDb[response]) {
+        for (unsigned int id : Section_->HeaderDb[response]->Match(headers)) {
+            States_[Section_->HeaderRegexps[response][id]] = CsTrue;
+        }
+    }
+
+    ResolveUnknown([response](const TCondition& condition) {
+        return (condition.Kind == CkHasHeader || condition.Kind == CkHeaderMatches) && condition.Response == response;
+    });
+}
+
+template <typename Filter, typename Call>
+void TSentinel::TInspection::CallPredicates(Filter&& filter, Call&& call) {
+    for (size_t index = 0; index < States_.size() && Verdict_ == SvUndecided; index++) {
+        const TCondition& condition = Section_->Conditions[index];
+        if (States_[index] != CsUnknown || !filter(condition) || !Alive(Section_->BlockOf[index])) {
+            continue;
+        }
+
+        bool result = false;
+        if (Runner_ && *Runner_) {
+            result = (*Runner_)([&call, &condition]() {
+                return call(condition);
+            });
+        } else {
+            result = call(condition);
+        }
+
+        States_[index] = result ? CsTrue : CsFalse;
+        UpdateVerdict();
+    }
+}
+
+template <typename Filter>
+void TSentinel::TInspection::ResolveUnknown(Filter&& filter) {
+    if (Verdict_ != SvUndecided) {
+        return;
+    }
+
+    for (size_t index = 0; index < States_.size(); index++) {
+        if (States_[index] == CsUnknown && filter(Section_->Conditions[index])) {
+            States_[index] = CsFalse;
+        }
+    }
+    UpdateVerdict();
+}
+
+bool TSentinel::TInspection::Alive(size_t block) const {
+    for (size_t index : Section_->Blocks[block]) {
+        if (States_[index] == CsFalse) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void TSentinel::TInspection::UpdateVerdict() {
+    bool alive = false;
+
+    for (size_t block = 0; block < Section_->Blocks.size(); block++) {
+        bool satisfied = true;
+        bool dead = false;
+        for (size_t index : Section_->Blocks[block]) {
+            if (States_[index] == CsFalse) {
+                dead = true;
+                break;
+            }
+            if (States_[index] != CsTrue) {
+                satisfied = false;
+            }
+        }
+
+        if (dead) {
+            continue;
+        }
+
+        if (satisfied) {
+            Verdict_ = Section_->Policy == SpAllow ? SvAllow : SvDeny;
+            return;
+        }
+        alive = true;
+    }
+
+    if (!alive) {
+        Verdict_ = Section_->Policy == SpAllow ? SvDeny : SvAllow;
+    }
+}
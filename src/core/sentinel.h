@@ -0,0 +1,208 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <handles/http.h>
+#include <regexp/database.h>
+#include <regexp/headers.h>
+#include <regexp/matchers.h>
+#include <util/generic.h>
+
+/*
+ * Compiled rules of HTTP sentinel. Requests are split into sections by url prefix, section
+ * allows (or denies) conversation if at least one of its blocks is satisfied and does the opposite
+ * if none is. Block is a conjunction of conditions on request and response.
+ *
+ * Rules are compiled once, when config is loaded: body regexps of section are merged into one stream
+ * database per direction, header regexps into one header database per direction, which looks names up itself.
+ * Conditions are resolved as parts of conversation arrive, native ones first, predicates are called
+ * only while verdict is still unknown and their block may be satisfied.
+ */
+class TSentinel : TMoveOnly {
+public:
+    enum EPolicy {
+        /* conversation is allowed if some block is satisfied, denied otherwise */
+        SpAllow = 0,
+        /* conversation is denied if some block is satisfied, allowed otherwise */
+        SpDeny = 1,
+    };
+
+    enum EVerdict {
+        SvUndecided = 0,
+        SvAllow = 1,
+        SvDeny = 2,
+    };
+
+    enum EKind {
+        CkHasHeader = 0,
+        CkHeaderMatches = 1,
+        CkBodyContains = 2,
+        /* predicate on request or response head */
+        CkIf = 3,
+        /* predicate on whole body */
+        CkBodyIf = 4,
+    };
+
+    using TRequestPredicate = std::function<bool(const THttpRequest& request)>;
+    using TResponsePredicate = std::function<bool(const THttpResponse& response)>;
+    using TBodyPredicate = std::function<bool(TMemoryRegion body)>;
+
+    /*
+     * Calls predicate, e.g. with GIL taken. Empty runner calls it directly.
+     */
+    using TRunner = std::function<bool(const std::function<bool()>& predicate)>;
+
+    struct TCondition {
+        EKind Kind = CkHasHeader;
+        /* condition is on response, otherwise on request */
+        bool Response = false;
+        std::string Header;
+        std::optional<TRegexpDef> Regexp;
+        /* body is read whole before it is inspected, instead of streaming it */
+        bool Buffered = false;
+        /* bigger buffered body denies conversation, 0 means it is limited by buffer only */
+        size_t Threshold = 0;
+        TRequestPredicate RequestPredicate;
+        TResponsePredicate ResponsePredicate;
+        TBodyPredicate BodyPredicate;
+
+        static TCondition HasHeader(bool response, std::string name);
+        static TCondition HeaderMatches(bool response, std::string name, TRegexpDef regexp);
+        static TCondition BodyContains(bool response, TRegexpDef regexp, bool buffered = false, size_t threshold = 0);
+        static TCondition RequestIf(TRequestPredicate predicate);
+        static TCondition ResponseIf(TResponsePredicate predicate);
+        static TCondition BodyIf(bool response, TBodyPredicate predicate);
+    };
+
+    /* conditions of block are and'ed */
+    using TBlock = std::vector<TCondition>;
+
+    struct TSectionDef {
+        std::string UrlPrefix;
+        EPolicy Policy = SpDeny;
+        std::vector<TBlock> Blocks;
+    };
+
+private:
+    struct TSection {
+        std::string UrlPrefix;
+        EPolicy Policy = SpDeny;
+        std::vector<TCondition> Conditions;
+        /* indices of conditions of every block */
+        std::vector<std::vector<size_t>> Blocks;
+        /* block of every condition */
+        std::vector<size_t> BlockOf;
+        /* databases and conditions their regexps belong to, databases are not built if there are no regexps */
+        std::unique_ptr<THeaderRegexpDatabase> HeaderDb[2];
+        std::vector<size_t> HeaderRegexps[2];
+        std::unique_ptr<TStreamRegexpDatabase> BodyDb[2];
+        std::vector<size_t> BodyRegexps[2];
+    };
+
+public:
+    /*
+     * State of one request and response passing through sentinel. Inspection of request
+     * which matches no section allows conversation at once.
+     */
+    class TInspection : TMoveOnly {
+    public:
+        /*
+         * Inspects request head.
+         */
+        TInspection(const TSentinel& sentinel, const THttpRequest& request, const TRunner* runner = nullptr);
+
+        EVerdict Verdict() const {
+            return Verdict_;
+        }
+
+        EVerdict ResponseHead(const THttpResponse& response);
+
+        /*
+         * Whether body of request (or response) has to be inspected.
+         */
+        bool InspectsBody(bool response) const;
+
+        /*
+         * Whether body has to be read whole before inspection, @return the biggest allowed size of it.
+         */
+        std::optional<size_t> BufferedBody(bool response) const;
+
+        /*
+         * Inspects piece of streamed body.
+         */
+        EVerdict BodyPiece(bool response, TMemoryRegion piece);
+
+        /*
+         * Resolves conditions on body once it is over, buffered body is passed whole.
+         */
+        EVerdict BodyEnd(bool response, TMemoryRegion body = TMemoryRegion(nullptr, 0));
+
+        /*
+         * Body to be buffered is too big, conversation is denied.
+         */
+        EVerdict BodyTooBig();
+
+    private:
+        enum EState : int8_t {
+            CsUnknown = -1,
+            CsFalse = 0,
+            CsTrue = 1,
+        };
+
+        /*
+         * Resolves native conditions on headers of message.
+         */
+        void InspectHeaders(bool response, const THttpHeaders& headers);
+
+        /*
+         * Calls predicates of unresolved conditions selected by `filter` until verdict is known.
+         */
+        template <typename Filter, typename Call>
+        void CallPredicates(Filter&& filter, Call&& call);
+
+        /*
+         * Unresolved conditions selected by `filter` become false.
+         */
+        template <typename Filter>
+        void ResolveUnknown(Filter&& filter);
+
+        /*
+         * Whether block may be still satisfied.
+         */
+        bool Alive(size_t block) const;
+
+        void UpdateVerdict();
+
+        const TSection* Section_ = nullptr;
+        const TRunner* Runner_;
+        std::vector<EState> States_;
+        std::unique_ptr<TStreamRegexpMatcher> Matcher_;
+        bool MatcherResponse_ = false;
+        EVerdict Verdict_ = SvUndecided;
+    };
+
+    /*
+     * Regexp databases of sections are compiled by `compiler`, e.g. with GIL released, as it may take seconds.
+     * Conditions are taken before, so predicates they hold are not touched by it.
+     */
+    explicit TSentinel(std::vector<TSectionDef> sections, const TRunner* compiler = nullptr);
+
+    size_t Size() const {
+        return Sections_.size();
+    }
+
+private:
+    /*
+     * The first section which url prefix request url starts with.
+     */
+    const TSection* Match(const THttpRequest& request) const;
+
+    std::vector<TSection> Sections_;
+};
+
+using TSentinelPtr = std::shared_ptr<TSentinel>;
@@ -4,6 +4,7 @@
 #include <csignal>
 #include <deque>
 #include <list>
+#include <algorithm>
 #include <exception>
 #include <functional>
 
@@ -11,18 +12,33 @@
 
 #include <coro/reactor.h>
 #include <python/wrappers.h>
+#include <regexp/cache.h>
 #include <util/python.h>
 #include <handles/http.h>
 
 using namespace std::placeholders;
 
 TService::TService(std::shared_ptr<spdlog::logger> logger, const std::string& configPath)
-    : ConfigPath_(configPath)
-    , Logger_(std::move(logger))
-    , Listener_(Logger_)
+    : Logger_(std::move(logger))
+    , ConfigPath_(configPath)
 {
 }
 
+static void ConfigureReactor(TReactor* reactor, const TConfig& config) {
+    reactor->SetCoroutineStackSize(config.CoroutineStackSize);
+    reactor->StackPool().SetLimits(config.StackPoolSize, config.StackPoolHotSize);
+    reactor->PipePool().SetMaxSize(config.PipePoolSize);
+    reactor->BufferPool().SetMaxFreeBytes(config.BufferPoolSize);
+    reactor->BufferPool().SetHugePages(config.BufferPoolHugePages);
+    reactor->RegexpPool().SetMaxFreeStreamBytes(config.RegexpStreamPoolSize);
+    reactor->SetDeadlineQueue(config.DeadlineQueue);
+}
+
+static void ConfigureBackendPool(TConnectionPool& pool, const TConfig& config) {
+    pool.SetLimits(config.BackendPoolMaxIdle, config.BackendPoolMaxTotal);
+    pool.SetIdleTimeout(config.BackendPoolIdleTimeout);
+}
+
 std::shared_ptr<TContext> TService::ReloadContext() {
     std::shared_ptr<TContext> oldContext = std::atomic_load(&Context_);
 
@@ -30,39 +46,113 @@ std::shared_ptr<TContext> TService::ReloadContext() {
 
     TConfig config = ReadConfigFromFile(ConfigPath_);
 
-    py::object handlerModule = PyEvalFile(config.HandlerFile);
-
     TContextPtr context = std::make_shared<TContext>();
     context->Config = config;
-    context->HandlerObject = handlerModule["handler"];
-    context->HandlerModule = std::move(handlerModule);
     context->Logger = Logger_;
+    context->ReloadStats = ReloadStats_;
+
+    /* databases compiled by handler file are looked up in cache */
+    TRegexpCache::SetDirectory(config.RegexpCacheDir);
+    size_t cacheHits = TRegexpCache::Hits();
+    size_t cacheMisses = TRegexpCache::Misses();
+
+    if (!config.HandlerFile.empty()) {
+        py::object handlerModule = PyEvalFile(config.HandlerFile);
+        if (config.HandlerMode == TConfig::HmPython) {
+            context->HandlerObject = handlerModule["handler"];
+            context->AsyncHandler = py::module::import("inspect").attr("iscoroutinefunction")(context->HandlerObject).cast<bool>();
+        } else if (!config.HttpProxy.Rules.empty()) {
+            context->HookObject = handlerModule["hook"];
+        }
+        context->HandlerModule = std::move(handlerModule);
+    }
 
-    context->BackendAddr = GetAddrInfo(
-        context->Config.BackendIp,
-        context->Config.BackendPort,
-        false,
-        context->Config.Protocol
-    )[0];
+    if (!config.RegexpCacheDir.empty()) {
+        Logger_->info("regexp databases: {} loaded from cache, {} compiled", TRegexpCache::Hits() - cacheHits, TRegexpCache::Misses() - cacheMisses);
+    }
 
-    Reactor()->SetCoroutineStackSize(config.CoroutineStackSize);
+    std::vector<TSocketAddress> backends;
+    if (config.Backends.empty()) {
+        backends = GetAddrInfo(config.BackendIp, config.BackendPort, false, config.Protocol);
+    }
+    for (const std::string& backend : config.Backends) {
+        for (const TSocketAddress& addr : ResolveAll(backend, V4_AND_V6)) {
+            if (std::find(backends.begin(), backends.end(), addr) == backends.end()) {
+                backends.push_back(addr);
+            }
+        }
+    }
+
+    context->Backends = std::make_shared<TBackendGroup>(backends, config.BackendGroup);
+    context->BackendAddr = backends[0];
+    Logger_->info("{} backend(s) in group", backends.size());
 
     return context;
 }
 
+void TService::Reload(std::chrono::steady_clock::time_point started) {
+    {
+        py::gil_scoped_acquire gil;
+        try {
+            std::shared_ptr<TContext> newContext = ReloadContext();
+            PublishContext(newContext);
+            /* delete python objects that hold old context */
+            py::module::import("gc").attr("collect")();
+
+            TConfig config = newContext->Config;
+            for (std::unique_ptr<TWorker>& worker : Workers_) {
+                worker->Reactor->Post([config, &pool = worker->BackendPool]() {
+                    ConfigureReactor(Reactor(), config);
+                    ConfigureBackendPool(pool, config);
+                });
+            }
+
+            uint64_t latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count();
+            ReloadStats_->LastLatency = latency;
+            if (latency > ReloadStats_->MaxLatency) {
+                ReloadStats_->MaxLatency = latency;
+            }
+            ReloadStats_->Reloads++;
+
+            newContext->Logger->info("context reloaded in {:.3f}s", latency / 1e6);
+            ::sd_notify(0, "STATUS=Reload succesful");
+        } catch (const std::exception& e) {
+            ReloadStats_->Failures++;
+            ::sd_notify(0, "STATUS=Reload failed");
+            Logger_->error("context reload failed: {}", e.what());
+        }
+    }
+
+    ReloadStats_->InProgress = false;
+    ::sd_notify(0, "READY=1");
+}
+
+void TService::PublishContext(std::shared_ptr<TContext> context) {
+    std::shared_ptr<const TNativeContext> native;
+    if (context->Config.HandlerMode == TConfig::HmNative) {
+        native = std::make_shared<const TNativeContext>(TNativeContext{
+            context->Backends,
+            context->Config.HttpProxy,
+            static_cast<bool>(context->HookObject),
+        });
+    }
+
+    AsyncHandler_ = context->AsyncHandler;
+    std::atomic_store(&Native_, std::move(native));
+    std::atomic_store(&Context_, std::move(context));
+}
+
 void TService::Start() {
     /* import portcullis module to initialize binding of C++ wrappers */
     py::module::import("portcullis");
 
     std::shared_ptr<TContext> context = ReloadContext();
-    atomic_store(&Context_, context);
+    PublishContext(context);
 
     if (!Context_) {
         return;
     }
 
-    MainState_ = PyThreadState_Swap(nullptr);
-
     TSignalSet shutdownSignals;
     shutdownSignals.Add(SIGINT);
     shutdownSignals.Add(SIGTERM);
@@ -78,88 +168,269 @@ void TService::Start() {
     }
 
     std::vector<TSocketAddress> listeningAddresses = GetAddrInfo(context->Config.Host, context->Config.Port, true, "tcp", ipVersion);
-    Listener_.ReuseAddr();
-    Listener_.Bind(listeningAddresses);
+    size_t backlog = context->Config.Backlog;
+    TConfig config = context->Config;
+
+    size_t workersCount = context->Config.Workers;
+    if (workersCount == 0) {
+        workersCount = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    /* python objects must not be touched without GIL from now on */
+    context = nullptr;
+
+    /* worker reactors are created with default backend */
+    TReactor::SetDefaultIoBackend(config.IoBackend);
+    Reactor()->SetIoBackend(config.IoBackend);
+    ConfigureReactor(Reactor(), config);
 
+    /* signals must be blocked before spawning workers, so they are inherited by them */
     Reactor()->OnSignals(shutdownSignals, [this](TSignalInfo info) {
-        Context_->Logger->info("caught shutdown signal from pid {}", info.Sender());
-        Reactor()->CancelAll();
+        Logger_->info("caught shutdown signal from pid {}", info.Sender());
+        for (std::unique_ptr<TWorker>& worker : Workers_) {
+            worker->Reactor->Post([]() {
+                Reactor()->CancelAll();
+            });
+        }
     });
 
     Reactor()->OnSignal(SIGUSR1, [this](TSignalInfo info) {
+        Logger_->info("caught SIGUSR1 from {}", info.Sender());
+        if (ReloadStats_->InProgress.exchange(true)) {
+            Logger_->warn("reload is in progress already, signal is ignored");
+            return;
+        }
+
+        /* previous reload is finished, its thread only needs to be joined */
+        if (ReloadThread_.joinable()) {
+            ReloadThread_.join();
+        }
+
         ::sd_notify(0, "RELOADING=1");
-        std::shared_ptr<TContext> oldContext = std::atomic_load(&Context_);
-        oldContext->Logger->info("caught SIGUSR1 from {}", info.Sender());
+        ReloadThread_ = std::thread([this, started = std::chrono::steady_clock::now()]() {
+            Reload(started);
+        });
+    });
+
+    MainState_ = PyEval_SaveThread();
+    Interpreter_ = MainState_->interp;
+
+    Logger_->info("starting {} worker(s)", workersCount);
+
+    for (size_t i = 0; i < workersCount; i++) {
+        std::unique_ptr<TWorker> worker = std::make_unique<TWorker>();
+        if (i == 0) {
+            worker->Reactor = Reactor();
+        } else {
+            worker->OwnedReactor = std::make_unique<TReactor>(spdlog::get("reactor"), config.CoroutineStackSize);
+            worker->Reactor = worker->OwnedReactor.get();
+            ConfigureReactor(worker->Reactor, config);
+        }
+        ConfigureBackendPool(worker->BackendPool, config);
+        worker->PyStates.Attach(worker->Reactor, Interpreter_);
+        worker->Listener = std::make_unique<TTcpListener>(Logger_);
+        Workers_.emplace_back(std::move(worker));
+    }
+
+    /* workers are created before any of them starts, so `Workers_` is never modified concurrently */
+    for (size_t i = 1; i < Workers_.size(); i++) {
+        TWorker& worker = *Workers_[i];
+        worker.Thread = std::thread([this, &worker, listeningAddresses, backlog]() {
+            worker.Reactor->StartCoroutine([this, &worker, &listeningAddresses, backlog]() {
+                RunWorker(worker, listeningAddresses, backlog);
+            });
+            worker.Reactor->Run();
+        });
+    }
+
+    ::sd_notify(0, "READY=1");
+    ::sd_notify(0, "STATUS=Started");
+
+    RunWorker(*Workers_[0], listeningAddresses, backlog);
+}
+
+void TService::RunWorker(TWorker& worker, const std::vector<TSocketAddress>& addresses, size_t backlog) {
+    worker.Listener->ReuseAddr();
+    if (Workers_.size() > 1) {
+        worker.Listener->ReusePort();
+    }
+    worker.Listener->Bind(addresses);
+
+    worker.Listener->OnAccepted([this, &worker](TTcpHandlePtr accepted) {
+        if (AsyncHandler_) {
+            HandleClientAsync(worker, std::move(accepted));
+            return;
+        }
+
+        Reactor()->StartCoroutine([this, &worker, accepted]() {
+            HandleClient(worker, accepted);
+        });
+        Reactor()->Yield();
+    });
+
+    worker.Listener->Run(backlog);
+}
+
+bool TService::EnterPython(TWorker& worker) {
+    if (!worker.PyStates.Enter()) {
+        Logger_->critical("cannot create python thread state");
+        return false;
+    }
+    return true;
+}
+
+void TService::HandleClient(TWorker& worker, TTcpHandlePtr accepted) {
+    std::shared_ptr<const TNativeContext> native = std::atomic_load(&Native_);
+    if (native) {
+        HandleClientNative(worker, *native, std::move(accepted));
+        return;
+    }
+
+    if (!EnterPython(worker)) {
+        return;
+    }
+
+    {
+        /* context holds python objects, so it must be released under GIL */
+        TContextPtr context = std::atomic_load(&Context_);
+        TContextWrapper wrapper(context, &worker.BackendPool, accepted->PeerAddress());
+
         try {
-            PyThreadState_Swap(MainState_);
-            std::shared_ptr<TContext> newContext = ReloadContext();
-            std::atomic_store(&Context_, newContext);
-            /* delete python objects that hold old context */
-            py::module::import("gc").attr("collect")();
-            newContext->Logger->info("context reloaded");
-            ::sd_notify(0, "STATUS=Reload succesful");
-            MainState_ = PyThreadState_Swap(nullptr);
+            context->HandlerObject(wrapper, TTcpHandleWrapper(context, accepted));
+
+            /* if handler still holds pointer to accepted */
+            accepted->Close();
         } catch (const std::exception& e) {
-            ::sd_notify(0, "STATUS=Reload failed");
-            oldContext->Logger->error("context reload failed: {}", e.what());
+            context->Logger->error("exception in handler: {}", e.what());
+            accepted->Close();
         }
-        ::sd_notify(0, "READY=1");
-    });
+    }
 
-    PyInterpreterState* interpreter = MainState_->interp;
+    worker.PyStates.Leave();
+}
 
-    Listener_.OnAccepted([this, interpreter](TTcpHandlePtr accepted) {
-        Reactor()->StartCoroutine([this, interpreter, accepted]() {
-            TContextPtr context = std::atomic_load(&Context_);
-            TContextWrapper wrapper(context);
+void TService::HandleClientAsync(TWorker& worker, TTcpHandlePtr accepted) {
+    if (!EnterPython(worker)) {
+        accepted->Close();
+        return;
+    }
 
-            PyThreadState* newState = nullptr;
-            if (PyStates_.empty()) {
-                newState = PyThreadState_New(interpreter);
-            } else {
-                newState = *PyStates_.begin();
-                PyStates_.pop_front();
+    {
+        TContextPtr context = std::atomic_load(&Context_);
+        try {
+            /* context may be reloaded with blocking handler meanwhile */
+            if (!context->AsyncHandler) {
+                throw TException() << "handler is not async anymore";
             }
-            if (!newState) {
-                context->Logger->critical("cannot create python thread state");
-                return;
+
+            py::module aio = py::module::import("portcullis.aio");
+            if (!worker.AsyncLoop) {
+                worker.AsyncLoop = aio.attr("ReactorEventLoop")();
+                Reactor()->StartCoroutine([this, &worker]() {
+                    RunAsyncLoop(worker);
+                });
             }
 
-            PyThreadState_Swap(newState);
-            const auto& internals = py::detail::get_internals();
-            PyThread_set_key_value(internals.tstate, newState);
+            TContextWrapper wrapper(context, &worker.BackendPool, accepted->PeerAddress());
+            /* socket of loop owns fd from now on */
+            aio.attr("serve")(worker.AsyncLoop, context->HandlerObject, wrapper, accepted->Release());
+        } catch (const std::exception& e) {
+            context->Logger->error("cannot serve client by async handler: {}", e.what());
+            accepted->Close();
+        }
+    }
 
-            try {
-                context->HandlerObject(wrapper, TTcpHandleWrapper(context, accepted));
+    worker.PyStates.Leave();
+}
 
-                /* if handler still holds pointer to accepted */
-                accepted->Close();
-            } catch (const std::exception& e) {
-                context->Logger->error("exception in handler: {}", e.what());
-                accepted->Close();
-            }
+void TService::RunAsyncLoop(TWorker& worker) {
+    if (!EnterPython(worker)) {
+        return;
+    }
+
+    try {
+        py::module::import("portcullis.aio").attr("run")(worker.AsyncLoop);
+    } catch (const std::exception& e) {
+        Logger_->error("event loop failed: {}", e.what());
+    }
+    /* connections accepted later get new loop */
+    worker.AsyncLoop = py::object();
 
-            PyThreadState* oldState = PyThreadState_Swap(nullptr);
-            ASSERT(oldState == newState);
+    worker.PyStates.Leave();
+}
 
-            PyStates_.push_back(newState);
-        });
-        Reactor()->Yield();
-    });
+void TService::HandleClientNative(TWorker& worker, const TNativeContext& native, TTcpHandlePtr accepted) {
+    THttpProxy::THook hook;
+    if (native.Hooked) {
+        TSocketAddress client = accepted->PeerAddress();
+        hook = [this, &worker, client](THttpRequest& request) {
+            return RunHook(worker, request, client);
+        };
+    }
 
-    ::sd_notify(0, "READY=1");
-    ::sd_notify(0, "STATUS=Started");
+    THttpProxy proxy(native.HttpProxy, native.Backends, &worker.BackendPool, std::move(hook));
+    TResult<size_t> served = proxy.Serve(accepted);
+    if (!served && !served.Canceled()) {
+        Logger_->debug("client connection failed: {}", ErrorDescription(served.Error()));
+    }
+    accepted->Close();
+}
+
+std::optional<THttpResponse> TService::RunHook(TWorker& worker, THttpRequest& request, const TSocketAddress& client) {
+    if (!EnterPython(worker)) {
+        return std::nullopt;
+    }
+
+    std::optional<THttpResponse> response;
+    {
+        TContextPtr context = std::atomic_load(&Context_);
+        /* context may be reloaded without hook meanwhile */
+        if (context->HookObject) {
+            try {
+                /* hook changes request in place, it must not keep reference to it */
+                py::object result = context->HookObject(
+                    TContextWrapper(context, &worker.BackendPool, client),
+                    py::cast(&request, py::return_value_policy::reference)
+                );
+                if (!result.is_none()) {
+                    response = result.cast<THttpResponse>();
+                }
+            } catch (const std::exception& e) {
+                context->Logger->error("exception in hook: {}", e.what());
+                response = THttpResponse();
+                response->MajorVersion = 1;
+                response->MinorVersion = 1;
+                response->Status = 500;
+                response->Reason = "Internal Server Error";
+                response->Headers.Set("Connection", "close");
+            }
+        }
+    }
 
-    Listener_.Run(context->Config.Backlog);
+    worker.PyStates.Leave();
+    return response;
 }
 
 TService::~TService() {
-    PyThreadState_Swap(MainState_);
-    const auto& internals = py::detail::get_internals();
-    PyThread_set_key_value(internals.tstate, MainState_);
+    for (std::unique_ptr<TWorker>& worker : Workers_) {
+        if (worker->Thread.joinable()) {
+            worker->Thread.join();
+        }
+    }
+
+    /* reload thread takes GIL, so it is joined before GIL is taken back here */
+    if (ReloadThread_.joinable()) {
+        ReloadThread_.join();
+    }
+
+    if (MainState_) {
+        PyEval_RestoreThread(MainState_);
+        const auto& internals = py::detail::get_internals();
+        PyThread_set_key_value(internals.tstate, MainState_);
+    }
 
-    for (PyThreadState* state : PyStates_) {
-        PyThreadState_Clear(state);
-        PyThreadState_Delete(state);
+    for (std::unique_ptr<TWorker>& worker : Workers_) {
+        worker->AsyncLoop = py::object();
+        worker->PyStates.Clear();
     }
 }
@@ -2,11 +2,17 @@
 
 #include <stdio.h>
 
+#include <chrono>
 #include <deque>
+#include <optional>
+#include <thread>
 
 #include <core/context.h>
+#include <core/http_proxy.h>
 #include <coro/reactor.h>
+#include <handles/connection_pool.h>
 #include <handles/tcp.h>
+#include <python/thread_states.h>
 
 namespace py = pybind11;
 
@@ -17,12 +23,69 @@ public:
     ~TService();
 
 private:
+    /*
+     * Every worker runs its own reactor with its own listener bound to the same
+     * address (SO_REUSEPORT), so kernel spreads accepted connections between them.
+     * Python code is executed under GIL, which is handed over when coroutine running it is switched.
+     */
+    struct TWorker {
+        TReactor* Reactor = nullptr;
+        /* null for the first worker, which runs on the main reactor */
+        std::unique_ptr<TReactor> OwnedReactor;
+        /* declared after reactor, so pooled connections are closed while it is alive */
+        TConnectionPool BackendPool;
+        std::unique_ptr<TTcpListener> Listener;
+        /* declared after reactor, so its switch hook is removed first */
+        TPyThreadStates PyStates;
+        /* `ReactorEventLoop` of async handlers, it is created with the first connection served by them */
+        py::object AsyncLoop;
+        std::thread Thread;
+    };
+
+    /*
+     * Part of context used by native handler mode, it holds no python objects,
+     * so connections are served without GIL.
+     */
+    struct TNativeContext {
+        TBackendGroupPtr Backends;
+        THttpProxy::TOptions HttpProxy;
+        bool Hooked = false;
+    };
+
     std::shared_ptr<TContext> ReloadContext();
+    /*
+     * Runs on reload thread: builds new context under GIL, publishes it and reconfigures workers.
+     */
+    void Reload(std::chrono::steady_clock::time_point started);
+    void PublishContext(std::shared_ptr<TContext> context);
+
+    void RunWorker(TWorker& worker, const std::vector<TSocketAddress>& addresses, size_t backlog);
+    void HandleClient(TWorker& worker, TTcpHandlePtr accepted);
+    void HandleClientNative(TWorker& worker, const TNativeContext& native, TTcpHandlePtr accepted);
+    /*
+     * Hands connection over to event loop of worker, it runs on listener coroutine and returns without waiting.
+     */
+    void HandleClientAsync(TWorker& worker, TTcpHandlePtr accepted);
+    void RunAsyncLoop(TWorker& worker);
+    std::optional<THttpResponse> RunHook(TWorker& worker, THttpRequest& request, const TSocketAddress& client);
+
+    /*
+     * Binds python thread state of worker to current coroutine and acquires GIL with it.
+     * @return false if state cannot be created.
+     */
+    bool EnterPython(TWorker& worker);
 
     std::shared_ptr<spdlog::logger> Logger_;
     std::shared_ptr<TContext> Context_;
-    TTcpListener Listener_;
+    /* null in python handler mode */
+    std::shared_ptr<const TNativeContext> Native_;
+    /* whether context has async handler, it is read without GIL */
+    std::atomic<bool> AsyncHandler_ = false;
     std::string ConfigPath_;
     PyThreadState* MainState_ = nullptr;
-    std::list<PyThreadState*> PyStates_;
+    PyInterpreterState* Interpreter_ = nullptr;
+    std::vector<std::unique_ptr<TWorker>> Workers_;
+    std::shared_ptr<TReloadStats> ReloadStats_ = std::make_shared<TReloadStats>();
+    /* reload is done off reactor, so connections are served while config is evaluated */
+    std::thread ReloadThread_;
 };
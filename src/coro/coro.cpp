@@ -1,17 +1,48 @@
 #include <coro/coro.h>
 #include <sys/mman.h>
 
-TCoroStack::TCoroStack(size_t stackSize) {
-    Start_ = mmap(nullptr, stackSize + 2 * 4096, PROT_NONE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
-    if (Start_ == MAP_FAILED) {
+static constexpr size_t GuardSize = 4096;
+
+static void* MapStack(size_t stackSize) {
+    void* start = mmap(nullptr, stackSize + 2 * GuardSize, PROT_NONE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (start == MAP_FAILED) {
         ThrowErrno("mmap failed");
     }
-    int res = mprotect(reinterpret_cast<uint8_t*>(Start_) + 4096, stackSize, PROT_READ | PROT_WRITE);
+    int res = mprotect(reinterpret_cast<uint8_t*>(start) + GuardSize, stackSize, PROT_READ | PROT_WRITE);
     if (res == -1) {
         ThrowErrno("mprotect failed");
     }
-    Size_ = stackSize;
-    Start_ = reinterpret_cast<uint8_t*>(Start_) + 4096;
+    return reinterpret_cast<uint8_t*>(start) + GuardSize;
+}
+
+static void UnmapStack(void* start, size_t stackSize) {
+    munmap(reinterpret_cast<uint8_t*>(start) - GuardSize, stackSize + 2 * GuardSize);
+}
+
+TCoroStack::TCoroStack(size_t stackSize)
+    : Start_(MapStack(stackSize))
+    , Size_(stackSize)
+{
+}
+
+TCoroStack::TCoroStack(TCoroStack&& other) noexcept
+    : Start_(other.Start_)
+    , Size_(other.Size_)
+    , Pos_(other.Pos_)
+    , Pool_(other.Pool_)
+{
+    other.Start_ = nullptr;
+    other.Size_ = 0;
+    other.Pos_ = 0;
+    other.Pool_ = nullptr;
+}
+
+TCoroStack& TCoroStack::operator=(TCoroStack&& other) noexcept {
+    std::swap(Start_, other.Start_);
+    std::swap(Size_, other.Size_);
+    std::swap(Pos_, other.Pos_);
+    std::swap(Pool_, other.Pool_);
+    return *this;
 }
 
 void TCoroStack::Push(uint64_t val) {
@@ -20,5 +51,70 @@ void TCoroStack::Push(uint64_t val) {
 }
 
 TCoroStack::~TCoroStack() {
-    munmap(reinterpret_cast<uint8_t*>(Start_) - 4096, Size_ + 2 * 4096);
+    if (!Start_) {
+        return;
+    }
+
+    if (Pool_) {
+        Pool_->Release(Start_, Size_);
+    } else {
+        UnmapStack(Start_, Size_);
+    }
+}
+
+TCoroStack TCoroStackPool::Acquire(size_t stackSize) {
+    if (stackSize != StackSize_) {
+        /* stack size was changed, old stacks are useless now */
+        Clear();
+        StackSize_ = stackSize;
+    }
+
+    if (Free_.empty()) {
+        Misses_++;
+        return TCoroStack(MapStack(stackSize), stackSize, this);
+    }
+
+    Hits_++;
+    void* start = Free_.back().Start;
+    Free_.pop_back();
+    return TCoroStack(start, stackSize, this);
+}
+
+void TCoroStackPool::Release(void* start, size_t stackSize) {
+    if (stackSize != StackSize_ || Free_.size() >= MaxSize_) {
+        UnmapStack(start, stackSize);
+        return;
+    }
+
+    Free_.push_back({ start, false });
+
+    /* stacks are reused in LIFO order, so the one crossing hot limit is the coldest one */
+    if (Free_.size() > HotSize_) {
+        TFreeStack& cold = Free_[Free_.size() - HotSize_ - 1];
+        if (!cold.Cold) {
+            madvise(cold.Start, StackSize_, MADV_DONTNEED);
+            cold.Cold = true;
+        }
+    }
+}
+
+void TCoroStackPool::SetLimits(size_t maxSize, size_t hotSize) {
+    MaxSize_ = maxSize;
+    HotSize_ = hotSize;
+
+    while (Free_.size() > MaxSize_) {
+        UnmapStack(Free_.front().Start, StackSize_);
+        Free_.erase(Free_.begin());
+    }
+}
+
+void TCoroStackPool::Clear() {
+    for (TFreeStack& stack : Free_) {
+        UnmapStack(stack.Start, StackSize_);
+    }
+    Free_.clear();
+}
+
+TCoroStackPool::~TCoroStackPool() {
+    Clear();
 }
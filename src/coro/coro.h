@@ -3,14 +3,19 @@
 #include <functional>
 #include <list>
 #include <memory>
+#include <vector>
 
 #include <coro/context.h>
 #include <util/generic.h>
 
-class TCoroStack {
+class TCoroStackPool;
+
+class TCoroStack : TMoveOnly {
 public:
     TCoroStack() = default;
     TCoroStack(size_t stackSize);
+    TCoroStack(TCoroStack&& other) noexcept;
+    TCoroStack& operator=(TCoroStack&& other) noexcept;
 
     inline void* Pointer() const {
         return reinterpret_cast<uint8_t*>(Start_) + Size_ - Pos_;
@@ -29,7 +34,75 @@ public:
     ~TCoroStack();
 
 private:
+    friend class TCoroStackPool;
+
+    TCoroStack(void* start, size_t stackSize, TCoroStackPool* pool)
+        : Start_(start)
+        , Size_(stackSize)
+        , Pool_(pool)
+    {
+    }
+
     void* Start_ = nullptr;
     size_t Size_ = 0;
     size_t Pos_ = 0;
+    /* if set, stack is returned to this pool on destruction */
+    TCoroStackPool* Pool_ = nullptr;
+};
+
+/*
+ * Keeps stacks of finished coroutines (with their guard pages intact) for reuse,
+ * so starting a coroutine does not cost mmap + mprotect + munmap.
+ * Free stacks beyond `hotSize` most recently used ones are considered cold,
+ * their pages are given back to the kernel with MADV_DONTNEED.
+ */
+class TCoroStackPool : TMoveOnly {
+public:
+    enum {
+        DefaultMaxSize = 1024,
+        DefaultHotSize = 128,
+    };
+
+    TCoroStackPool() = default;
+
+    TCoroStack Acquire(size_t stackSize);
+
+    /*
+     * @param maxSize -- maximum number of free stacks kept in pool.
+     * @param hotSize -- number of free stacks kept without MADV_DONTNEED.
+     */
+    void SetLimits(size_t maxSize, size_t hotSize);
+
+    size_t Size() const {
+        return Free_.size();
+    }
+
+    size_t Hits() const {
+        return Hits_;
+    }
+
+    size_t Misses() const {
+        return Misses_;
+    }
+
+    ~TCoroStackPool();
+
+private:
+    friend class TCoroStack;
+
+    struct TFreeStack {
+        void* Start = nullptr;
+        bool Cold = false;
+    };
+
+    void Release(void* start, size_t stackSize);
+    void Clear();
+
+    std::vector<TFreeStack> Free_;
+    size_t StackSize_ = 0;
+    size_t MaxSize_ = DefaultMaxSize;
+    size_t HotSize_ = DefaultHotSize;
+
+    size_t Hits_ = 0;
+    size_t Misses_ = 0;
 };
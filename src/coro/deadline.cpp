@@ -0,0 +1,252 @@
+#include "reactor.h"
+
+#include <algorithm>
+#include <limits>
+
+static inline size_t Parent(size_t idx) {
+    return (idx - 1) / 2;
+}
+
+static inline size_t LeftChild(size_t idx) {
+    return idx * 2 + 1;
+}
+
+static inline size_t RightChild(size_t idx) {
+    return idx * 2 + 2;
+}
+
+void TReactor::THeapDeadlineQueue::Push(TCoroutine* coro) {
+    ASSERT(coro->PosInDeadlineQueue == InvalidPos);
+    Queue_.push_back(coro);
+    coro->PosInDeadlineQueue = Queue_.size() - 1;
+    SiftUp(Queue_.size() - 1);
+}
+
+void TReactor::THeapDeadlineQueue::Remove(TCoroutine* coro) {
+    ASSERT(coro->PosInDeadlineQueue != InvalidPos);
+    size_t pos = coro->PosInDeadlineQueue;
+    coro->PosInDeadlineQueue = InvalidPos;
+
+    if (pos == Queue_.size() - 1) {
+        Queue_.pop_back();
+        return;
+    }
+
+    Queue_[pos] = Queue_.back();
+    Queue_[pos]->PosInDeadlineQueue = pos;
+    Queue_.pop_back();
+
+    /* moved element may violate heap property in any direction */
+    SiftUp(pos);
+    SiftDown(Queue_[pos]->PosInDeadlineQueue);
+}
+
+void TReactor::THeapDeadlineQueue::PopExpired(TDeadline now, const TCallback& onExpired) {
+    while (!Queue_.empty() && Queue_[0]->Deadline <= now) {
+        TCoroutine* coro = Queue_[0];
+        Remove(coro);
+        onExpired(coro);
+    }
+}
+
+void TReactor::THeapDeadlineQueue::PopAll(const TCallback& onPopped) {
+    std::vector<TCoroutine*> queue;
+    queue.swap(Queue_);
+    for (TCoroutine* coro : queue) {
+        coro->PosInDeadlineQueue = InvalidPos;
+        onPopped(coro);
+    }
+}
+
+void TReactor::THeapDeadlineQueue::SiftUp(size_t idx) {
+    while (idx > 0 && Queue_[idx]->Deadline < Queue_[Parent(idx)]->Deadline) {
+        Swap(idx, Parent(idx));
+        idx = Parent(idx);
+    }
+}
+
+void TReactor::THeapDeadlineQueue::SiftDown(size_t idx) {
+    while (LeftChild(idx) < Queue_.size()) {
+        size_t j = LeftChild(idx);
+
+        if (RightChild(idx) < Queue_.size() &&
+            Queue_[RightChild(idx)]->Deadline < Queue_[LeftChild(idx)]->Deadline) {
+            j = RightChild(idx);
+        }
+
+        if (Queue_[idx]->Deadline <= Queue_[j]->Deadline) {
+            break;
+        }
+
+        Swap(idx, j);
+        idx = j;
+    }
+}
+
+/*
+ * Deadlines are rounded up, so coroutine is never woken up before its deadline.
+ */
+static inline uint64_t CeilTick(TReactor::TDeadline deadline) {
+    return std::chrono::ceil<std::chrono::milliseconds>(deadline.time_since_epoch()).count();
+}
+
+static inline uint64_t FloorTick(TReactor::TDeadline deadline) {
+    return std::chrono::floor<std::chrono::milliseconds>(deadline.time_since_epoch()).count();
+}
+
+template <size_t Size>
+static inline void SetBit(std::array<uint64_t, Size>& bits, size_t pos) {
+    bits[pos / 64] |= 1ull << (pos % 64);
+}
+
+template <size_t Size>
+static inline void ClearBit(std::array<uint64_t, Size>& bits, size_t pos) {
+    bits[pos / 64] &= ~(1ull << (pos % 64));
+}
+
+/*
+ * Returns the least `offset` in [1, 64 * Size] such that bit `(pos + offset) % (64 * Size)` is set,
+ * or 0 if there are no set bits.
+ */
+template <size_t Size>
+static inline size_t NextBitOffset(const std::array<uint64_t, Size>& bits, size_t pos) {
+    constexpr size_t totalBits = 64 * Size;
+    size_t offset = 1;
+    while (offset <= totalBits) {
+        size_t cur = (pos + offset) % totalBits;
+        uint64_t word = bits[cur / 64] >> (cur % 64);
+        if (word) {
+            return offset + __builtin_ctzll(word);
+        }
+        offset += 64 - cur % 64;
+    }
+    return 0;
+}
+
+TReactor::TTimerWheel::TTimerWheel(TDeadline now)
+    : CurrentTick_(FloorTick(now))
+{
+}
+
+void TReactor::TTimerWheel::Push(TCoroutine* coro) {
+    Insert(coro);
+    Size_++;
+}
+
+void TReactor::TTimerWheel::Remove(TCoroutine* coro) {
+    ASSERT(Contains(coro));
+    /* slot's occupied bit is left as is and cleared when slot is visited */
+    TSlot::Remove(coro);
+    Size_--;
+}
+
+void TReactor::TTimerWheel::Insert(TCoroutine* coro) {
+    uint64_t tick = CeilTick(coro->Deadline);
+
+    if (tick <= CurrentTick_) {
+        Expired_.PushBack(coro);
+        return;
+    }
+
+    uint64_t delta = tick - CurrentTick_;
+    size_t level = 0;
+    while (level + 1 < LevelsCount && delta >= (1ull << ((level + 1) * LevelBits))) {
+        level++;
+    }
+
+    if (delta >= (1ull << (LevelsCount * LevelBits))) {
+        /* too far away: park it in the farthest slot, it is reinserted on cascade */
+        tick = CurrentTick_ + (1ull << (LevelsCount * LevelBits)) - 1;
+    }
+
+    size_t idx = (tick >> (level * LevelBits)) & LevelMask;
+    Levels_[level].Slots[idx].PushBack(coro);
+    SetBit(Levels_[level].Occupied, idx);
+}
+
+void TReactor::TTimerWheel::Cascade(size_t level) {
+    size_t idx = (CurrentTick_ >> (level * LevelBits)) & LevelMask;
+
+    if (idx == 0 && level + 1 < LevelsCount) {
+        Cascade(level + 1);
+    }
+
+    TSlot cascaded;
+    cascaded.Append(Levels_[level].Slots[idx]);
+    ClearBit(Levels_[level].Occupied, idx);
+
+    while (!cascaded.Empty()) {
+        Insert(cascaded.PopFront());
+    }
+}
+
+void TReactor::TTimerWheel::Advance(uint64_t tick) {
+    while (CurrentTick_ < tick) {
+        /* skip ticks without timers at once */
+        uint64_t nextTick = NextTick();
+        if (nextTick > tick) {
+            CurrentTick_ = tick;
+            break;
+        }
+        CurrentTick_ = std::max(CurrentTick_ + 1, nextTick);
+
+        size_t idx = CurrentTick_ & LevelMask;
+        if (idx == 0) {
+            Cascade(1);
+        }
+
+        Expired_.Append(Levels_[0].Slots[idx]);
+        ClearBit(Levels_[0].Occupied, idx);
+    }
+}
+
+uint64_t TReactor::TTimerWheel::NextTick() const {
+    uint64_t next = std::numeric_limits<uint64_t>::max();
+    for (size_t level = 0; level < LevelsCount; level++) {
+        size_t shift = level * LevelBits;
+        size_t offset = NextBitOffset(Levels_[level].Occupied, (CurrentTick_ >> shift) & LevelMask);
+        if (offset != 0) {
+            /* slots of upper levels are cascaded at the beginning of their span */
+            next = std::min(next, ((CurrentTick_ >> shift) + offset) << shift);
+        }
+    }
+    return next;
+}
+
+TReactor::TDeadline TReactor::TTimerWheel::NextDeadline() const {
+    if (!Expired_.Empty()) {
+        return TDeadline::min();
+    }
+
+    if (Size_ == 0) {
+        return TDeadline::max();
+    }
+
+    return TDeadline(std::chrono::milliseconds(NextTick()));
+}
+
+void TReactor::TTimerWheel::PopExpired(TDeadline now, const TCallback& onExpired) {
+    Advance(FloorTick(now));
+
+    while (!Expired_.Empty()) {
+        TCoroutine* coro = Expired_.PopFront();
+        Size_--;
+        onExpired(coro);
+    }
+}
+
+void TReactor::TTimerWheel::PopAll(const TCallback& onPopped) {
+    TSlot all;
+    all.Append(Expired_);
+    for (TLevel& level : Levels_) {
+        for (TSlot& slot : level.Slots) {
+            all.Append(slot);
+        }
+        level.Occupied.fill(0);
+    }
+    Size_ = 0;
+
+    while (!all.Empty()) {
+        onPopped(all.PopFront());
+    }
+}
@@ -0,0 +1,93 @@
+#include <coro/pipe.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+TPipe::TPipe(TPipe&& other) noexcept
+    : ReadFd_(other.ReadFd_)
+    , WriteFd_(other.WriteFd_)
+    , Capacity_(other.Capacity_)
+    , Dirty_(other.Dirty_)
+    , Pool_(other.Pool_)
+{
+    other.ReadFd_ = -1;
+    other.WriteFd_ = -1;
+    other.Pool_ = nullptr;
+}
+
+TPipe& TPipe::operator=(TPipe&& other) noexcept {
+    std::swap(ReadFd_, other.ReadFd_);
+    std::swap(WriteFd_, other.WriteFd_);
+    std::swap(Capacity_, other.Capacity_);
+    std::swap(Dirty_, other.Dirty_);
+    std::swap(Pool_, other.Pool_);
+    return *this;
+}
+
+TPipe::~TPipe() {
+    if (ReadFd_ == -1) {
+        return;
+    }
+
+    if (Pool_ && !Dirty_) {
+        Pool_->Release(ReadFd_, WriteFd_, Capacity_);
+    } else {
+        Close();
+    }
+}
+
+void TPipe::Close() {
+    ::close(ReadFd_);
+    ::close(WriteFd_);
+    ReadFd_ = -1;
+    WriteFd_ = -1;
+}
+
+TPipe TPipePool::Acquire() {
+    if (!Free_.empty()) {
+        Hits_++;
+        TFreePipe pipe = Free_.back();
+        Free_.pop_back();
+        return TPipe(pipe.ReadFd, pipe.WriteFd, pipe.Capacity, this);
+    }
+
+    Misses_++;
+
+    int fds[2];
+    if (::pipe2(fds, O_NONBLOCK | O_CLOEXEC) == -1) {
+        return TPipe();
+    }
+
+    /* bigger pipe means less splice calls per transfer, failure is not fatal */
+    ::fcntl(fds[1], F_SETPIPE_SZ, DefaultPipeSize);
+    int capacity = ::fcntl(fds[1], F_GETPIPE_SZ);
+    if (capacity <= 0) {
+        capacity = 65536;
+    }
+
+    return TPipe(fds[0], fds[1], capacity, this);
+}
+
+void TPipePool::Release(int readFd, int writeFd, size_t capacity) {
+    if (Free_.size() >= MaxSize_) {
+        ::close(readFd);
+        ::close(writeFd);
+        return;
+    }
+
+    Free_.push_back({ readFd, writeFd, capacity });
+}
+
+void TPipePool::SetMaxSize(size_t maxSize) {
+    MaxSize_ = maxSize;
+
+    while (Free_.size() > MaxSize_) {
+        ::close(Free_.back().ReadFd);
+        ::close(Free_.back().WriteFd);
+        Free_.pop_back();
+    }
+}
+
+TPipePool::~TPipePool() {
+    SetMaxSize(0);
+}
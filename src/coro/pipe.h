@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <util/generic.h>
+
+class TPipePool;
+
+/*
+ * Pipe used as in-kernel buffer for splice(2).
+ * Empty pipe is returned to pool on destruction, pipe with data left in it is closed.
+ */
+class TPipe : TMoveOnly {
+public:
+    TPipe() = default;
+    TPipe(TPipe&& other) noexcept;
+    TPipe& operator=(TPipe&& other) noexcept;
+    ~TPipe();
+
+    explicit operator bool() const {
+        return ReadFd_ != -1;
+    }
+
+    int ReadFd() const {
+        return ReadFd_;
+    }
+
+    int WriteFd() const {
+        return WriteFd_;
+    }
+
+    /*
+     * How many bytes pipe holds.
+     */
+    size_t Capacity() const {
+        return Capacity_;
+    }
+
+    /*
+     * Marks pipe as holding garbage, so it is not reused.
+     */
+    void Discard() {
+        Dirty_ = true;
+    }
+
+private:
+    friend class TPipePool;
+
+    TPipe(int readFd, int writeFd, size_t capacity, TPipePool* pool)
+        : ReadFd_(readFd)
+        , WriteFd_(writeFd)
+        , Capacity_(capacity)
+        , Pool_(pool)
+    {
+    }
+
+    void Close();
+
+    int ReadFd_ = -1;
+    int WriteFd_ = -1;
+    size_t Capacity_ = 0;
+    bool Dirty_ = false;
+    TPipePool* Pool_ = nullptr;
+};
+
+/*
+ * Keeps empty pipes for reuse, so splicing does not cost pipe2 + fcntl + 2 close per transfer.
+ */
+class TPipePool : TMoveOnly {
+public:
+    enum {
+        DefaultMaxSize = 64,
+        /* capacity requested for new pipes, kernel may give less */
+        DefaultPipeSize = 256 * 1024,
+    };
+
+    TPipePool() = default;
+    ~TPipePool();
+
+    /*
+     * Returns empty pipe with O_NONBLOCK set on both ends.
+     * On failure returns invalid pipe, errno is set.
+     */
+    TPipe Acquire();
+
+    /*
+     * @param maxSize -- maximum number of free pipes kept in pool.
+     */
+    void SetMaxSize(size_t maxSize);
+
+    size_t Size() const {
+        return Free_.size();
+    }
+
+    size_t Hits() const {
+        return Hits_;
+    }
+
+    size_t Misses() const {
+        return Misses_;
+    }
+
+private:
+    friend class TPipe;
+
+    struct TFreePipe {
+        int ReadFd;
+        int WriteFd;
+        size_t Capacity;
+    };
+
+    void Release(int readFd, int writeFd, size_t capacity);
+
+    std::vector<TFreePipe> Free_;
+    size_t MaxSize_ = DefaultMaxSize;
+
+    size_t Hits_ = 0;
+    size_t Misses_ = 0;
+};
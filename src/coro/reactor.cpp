@@ -1,22 +1,53 @@
 #include "reactor.h"
 
+#include <algorithm>
+#include <atomic>
+#include <climits>
+
+#include <fcntl.h>
+#include <poll.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/signalfd.h>
 
-static TReactor* CurrentReactor = nullptr;
-static TCoroutine* CurrentCoro = nullptr;
+#include <coro/uring.h>
+
+struct TReactor::TIoRequest {
+    TCoroutine* Coro = nullptr;
+    int Result = 0;
+    bool Completed = false;
+    bool CancelRequested = false;
+};
+
+static std::atomic<TReactor::EIoBackend> DefaultBackend(TReactor::IoEpoll);
+
+/* each thread runs its own reactor */
+static thread_local TReactor* CurrentReactor = nullptr;
+static thread_local TCoroutine* CurrentCoro = nullptr;
 
 TReactor* Reactor() {
     ASSERT(CurrentReactor);
     return CurrentReactor;
 }
 
+TReactor* ReactorIfAny() {
+    return CurrentReactor;
+}
+
+void TReactor::SetDefaultIoBackend(EIoBackend backend) {
+    DefaultBackend = backend;
+}
+
+TReactor::EIoBackend TReactor::DefaultIoBackend() {
+    return DefaultBackend;
+}
+
 /*
  * Wrapper for launching coroutine.
  */
 void TReactor::CoroWrapper() {
     /* if coroutine has not performed SwitchCouroutine */
-    Reactor()->FinishedCoroutine_ = nullptr;
+    Reactor()->DestroyFinished();
 
     TCoroutine* coro = CurrentCoro;
     coro->Context.OnStart();
@@ -28,7 +59,9 @@ void TReactor::CoroWrapper() {
 }
 
 TReactor::TReactor(std::shared_ptr<spdlog::logger> logger, size_t stackSize)
-    : Logger_(std::move(logger))
+    : DeadlineQueue_(std::make_unique<THeapDeadlineQueue>())
+    , Now_(std::chrono::steady_clock::now())
+    , Logger_(std::move(logger))
 {
     SetCoroutineStackSize(stackSize);
 
@@ -37,10 +70,48 @@ TReactor::TReactor(std::shared_ptr<spdlog::logger> logger, size_t stackSize)
         ThrowErrno("epoll_create failed");
     }
 
+    PostedFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (PostedFd_ == -1) {
+        ThrowErrno("eventfd failed");
+    }
+    EpollOp(EPOLL_CTL_ADD, PostedFd_, EPOLLIN);
+
     std::fill(SignalHandlers_.begin(), SignalHandlers_.end(), nullptr);
 
     InitialCoro_.Reactor = this;
     InitialCoro_.Context.MarkAsMain();
+
+    /* pooled buffers keep their fixed buffer slots while they are reused */
+    BufferPool_.OnFree([this](int index) {
+        UnregisterBuffer(index);
+    });
+
+    if (DefaultIoBackend() != IoEpoll) {
+        SetIoBackend(DefaultIoBackend());
+    }
+}
+
+TReactor::~TReactor() {
+    /* in-flight operations refer to coroutines' stacks, they are canceled with ring */
+    Uring_.reset();
+    for (auto& [fd, stream] : AcceptStreams_) {
+        for (int accepted : stream->Accepted) {
+            ::close(accepted);
+        }
+    }
+
+    DestroyFinished();
+
+    while (!ActiveCoroutines_.Empty()) {
+        CoroutineSlab_.Delete(ActiveCoroutines_.PopFront());
+    }
+
+    while (!ZombieCoroutines_.Empty()) {
+        CoroutineSlab_.Delete(ZombieCoroutines_.PopFront());
+    }
+
+    /* pool outlives the rest of reactor, there is no ring to unregister from anymore */
+    BufferPool_.OnFree(nullptr);
 }
 
 TCoroutine* TReactor::Current() const {
@@ -49,11 +120,9 @@ TCoroutine* TReactor::Current() const {
 }
 
 TCoroutine* TReactor::StartCoroutine(TCoroEntry entry, bool awaitable) {
-    std::unique_ptr<TCoroutine> coro = std::make_unique<TCoroutine>(this, std::move(entry), CoroutineStackSize_);
-    TCoroutine* coroPtr = coro.get();
-    ScheduledNextCoroutines_.push_back(coroPtr);
-    ActiveCoroutines_.push_back(std::move(coro));
-    coroPtr->ListIter = std::next(ActiveCoroutines_.end(), -1);
+    TCoroutine* coroPtr = CoroutineSlab_.New(this, std::move(entry), StackPool_.Acquire(CoroutineStackSize_));
+    ScheduledNextCoroutines_.PushBack(coroPtr);
+    ActiveCoroutines_.PushBack(coroPtr);
     coroPtr->Awaitable(awaitable);
     SPDLOG_DEBUG(Logger_, "started coroutine {}", reinterpret_cast<void*>(coroPtr));
     return coroPtr;
@@ -62,28 +131,30 @@ TCoroutine* TReactor::StartCoroutine(TCoroEntry entry, bool awaitable) {
 void TReactor::Finish(TCoroutine* coro) {
     ASSERT(CurrentCoro == coro);
     ASSERT(!FinishedCoroutine_);
-    ASSERT(coro->PosInDeadlineQueue == -1);
+    ASSERT(!DeadlineQueue_->Contains(coro));
+
+    /* finished coroutine must not be switched to, even if it woke itself up */
+    TScheduleQueue::Remove(coro);
 
+    TCoroutineList::Remove(coro);
     if (coro->Awaitable()) {
-        std::unique_ptr<TCoroutine>& zombie = ZombieCoroutines_.emplace_back(std::move(*coro->ListIter));
-        ASSERT(zombie.get() == coro);
-        ActiveCoroutines_.erase(coro->ListIter);
-        coro->ListIter = std::next(ZombieCoroutines_.end(), -1);
+        ZombieCoroutines_.PushBack(coro);
     } else {
         /*
-         * Coroutine destroying leads to stack unmapping, so coroutine is going
+         * Coroutine destroying leads to stack reuse, so coroutine is going
          * to be deleted after performing SwitchCoroutine.
          */
-        FinishedCoroutine_ = std::move(*coro->ListIter);
-        ASSERT(FinishedCoroutine_.get() == coro);
-        ActiveCoroutines_.erase(coro->ListIter);
+        FinishedCoroutine_ = coro;
     }
 
     coro->Finished(true);
     SPDLOG_DEBUG(Logger_, "{} finished", reinterpret_cast<void*>(coro));
 
-    if (ActiveCoroutines_.empty()) {
+    if (ActiveCoroutines_.Empty()) {
         SPDLOG_DEBUG(Logger_, "no active coroutines left");
+        if (SwitchHook_) {
+            SwitchHook_(SwitchHookArg_, coro, nullptr);
+        }
         coro->Context.SwitchTo(InitialCoro_.Context, nullptr, 0, true);
     }
 
@@ -104,35 +175,46 @@ void TReactor::Yield() {
 }
 
 void TReactor::Run() {
-    if (ActiveCoroutines_.empty()) {
+    if (ActiveCoroutines_.Empty()) {
         return;
     }
 
     CurrentCoro = &InitialCoro_;
     CurrentReactor = this;
+    /* reactor may be created on another thread than one running it */
+    BufferPool_.BindToThread();
     SwitchCoroutine(false);
 
     /* finish the last one */
-    FinishedCoroutine_ = nullptr;
+    DestroyFinished();
     CurrentCoro = nullptr;
     CurrentReactor = nullptr;
 }
 
 void TReactor::SwitchCoroutine(bool exitOld) {
-    if (ScheduledCoroutines_.empty()) {
-        if (!ScheduledNextCoroutines_.empty()) {
-            ScheduledCoroutines_ = std::move(ScheduledNextCoroutines_);
+    TCoroutine* old = CurrentCoro;
+    /* the last coroutine switch hook was told about */
+    TCoroutine* left = old == &InitialCoro_ ? nullptr : old;
+
+    if (ScheduledCoroutines_.Empty()) {
+        /* nobody runs while reactor polls */
+        if (SwitchHook_ && left) {
+            SwitchHook_(SwitchHookArg_, left, nullptr);
+        }
+        left = nullptr;
+
+        if (!ScheduledNextCoroutines_.Empty()) {
+            ScheduledCoroutines_.Append(ScheduledNextCoroutines_);
             DoPoll();
         } else {
-            while (ScheduledNextCoroutines_.empty()) {
+            while (ScheduledNextCoroutines_.Empty()) {
                 DoPoll();
             }
-            ScheduledCoroutines_ = std::move(ScheduledNextCoroutines_);
+            ScheduledCoroutines_.Append(ScheduledNextCoroutines_);
         }
     }
 
-    TCoroutine* ready = ScheduledCoroutines_.front();
-    ScheduledCoroutines_.pop_front();
+    TCoroutine* ready = ScheduledCoroutines_.PopFront();
 
     ready->Wakedup(false);
 
@@ -143,8 +225,10 @@ void TReactor::SwitchCoroutine(bool exitOld) {
         ready->Context.SetInstructionPointer(reinterpret_cast<void*>(&TReactor::CoroWrapper));
     }
 
-    TCoroutine* old = CurrentCoro;
     CurrentCoro = ready;
+    if (SwitchHook_ && left != ready) {
+        SwitchHook_(SwitchHookArg_, left, ready);
+    }
 
     SPDLOG_DEBUG(Logger_, "switch: {} -> {}", reinterpret_cast<void*>(old), reinterpret_cast<void*>(ready));
     old->Context.SwitchTo(
@@ -154,7 +238,14 @@ void TReactor::SwitchCoroutine(bool exitOld) {
     );
 
     /* destroy previous coroutine */
-    FinishedCoroutine_ = nullptr;
+    DestroyFinished();
+}
+
+void TReactor::DestroyFinished() {
+    if (FinishedCoroutine_) {
+        CoroutineSlab_.Delete(FinishedCoroutine_);
+        FinishedCoroutine_ = nullptr;
+    }
 }
 
 void TReactor::Wakeup(TCoroutine* coro) {
@@ -162,7 +253,7 @@ void TReactor::Wakeup(TCoroutine* coro) {
     ASSERT(!coro->Finished());
 
     if (!coro->Wakedup()) {
-        ScheduledNextCoroutines_.push_back(coro);
+        ScheduledNextCoroutines_.PushBack(coro);
         coro->Wakedup(true);
     }
 }
@@ -187,6 +278,25 @@ TResult<int> TReactor::WaitFor(int fd, uint32_t waitEvents, TDeadline deadline)
         return TResult<int>::MakeCanceled();
     }
 
+    if (Uring_) {
+        io_uring_sqe* sqe = PrepareIo(IORING_OP_POLL_ADD, fd);
+        sqe->poll32_events = ((waitEvents & EvRead) ? POLLIN : 0) | ((waitEvents & EvWrite) ? POLLOUT : 0);
+
+        TResult<int> res = AwaitIo(sqe, fd, waitEvents, deadline);
+        if (!res) {
+            return res;
+        }
+
+        int readyMask = 0;
+        if (res.Result() & (POLLIN | POLLHUP | POLLERR)) {
+            readyMask |= EvRead;
+        }
+        if (res.Result() & (POLLOUT | POLLHUP | POLLERR)) {
+            readyMask |= EvWrite;
+        }
+        return TResult<int>::MakeSuccess(readyMask & waitEvents);
+    }
+
     int readyMask = WaitState_[fd].ReadyEvents & waitEvents;
     if (WaitState_[fd].ReadyEvents & waitEvents) {
         SPDLOG_DEBUG(Logger_, "{} woken up immediately", reinterpret_cast<void*>(CurrentCoro));
@@ -199,14 +309,20 @@ TResult<int> TReactor::WaitFor(int fd, uint32_t waitEvents, TDeadline deadline)
 
     SPDLOG_DEBUG(Logger_, "{} starts WaitFor(fd={}, waitEvents={})", reinterpret_cast<void*>(CurrentCoro), fd, waitEvents);
 
+    /* flag may be left from previous wait */
+    CurrentCoro->DeadlineReached(false);
     if (deadline != TDeadline::max()) {
-        CurrentCoro->DeadlineReached(false);
         CurrentCoro->Deadline = deadline;
-        DeadlineQueue_.Push(CurrentCoro);
+        DeadlineQueue_->Push(CurrentCoro);
     }
 
     SwitchCoroutine(false);
 
+    /* woken up by event before deadline */
+    if (DeadlineQueue_->Contains(CurrentCoro)) {
+        DeadlineQueue_->Remove(CurrentCoro);
+    }
+
     if (CurrentCoro->DeadlineReached()) {
         SPDLOG_DEBUG(Logger_, "{} deadline reached while WaitFor(fd={}, waitEvents={})", reinterpret_cast<void*>(CurrentCoro), fd, waitEvents);
         UpdateWaitState(fd, waitEvents, nullptr);
@@ -241,7 +357,15 @@ void TReactor::OnSignals(TSignalSet signals, TSignalHandler handler) {
         ThrowErrno("signalfd failed");
     }
 
-    EpollOp(EPOLL_CTL_ADD, SignalFd_, EPOLLIN);
+    if (Uring_) {
+        /* cancel poll of previous signalfd, removal is submitted before new poll */
+        io_uring_sqe* sqe = PrepareIo(IORING_OP_POLL_REMOVE, -1);
+        sqe->addr = UdSignal;
+        sqe->user_data = UdIgnore;
+        ArmPoll(SignalFd_, UdSignal);
+    } else {
+        EpollOp(EPOLL_CTL_ADD, SignalFd_, EPOLLIN);
+    }
 
     for (size_t sig = SIGMIN; sig < SIGMAX; sig++) {
         if (signals.Has(sig)) {
@@ -250,8 +374,71 @@ void TReactor::OnSignals(TSignalSet signals, TSignalHandler handler) {
     }
 }
 
+void TReactor::Post(TPostedCallback callback) {
+    {
+        std::lock_guard<std::mutex> guard(PostedLock_);
+        Posted_.push_back(std::move(callback));
+    }
+
+    uint64_t one = 1;
+    if (::write(PostedFd_, &one, sizeof(one)) == -1 && errno != EAGAIN) {
+        ThrowErrno("eventfd write failed");
+    }
+}
+
+TResult<int> TReactor::WaitForLevel(int fd, uint32_t waitEvents, TDeadline deadline) {
+    pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = ((waitEvents & EvRead) ? POLLIN : 0) | ((waitEvents & EvWrite) ? POLLOUT : 0);
+
+    while (true) {
+        pfd.revents = 0;
+        if (::poll(&pfd, 1, 0) == -1) {
+            return TResult<int>::MakeFail(errno);
+        }
+
+        int readyMask = 0;
+        if (pfd.revents & (POLLIN | POLLHUP | POLLERR)) {
+            readyMask |= EvRead;
+        }
+        if (pfd.revents & (POLLOUT | POLLHUP | POLLERR)) {
+            readyMask |= EvWrite;
+        }
+        if (readyMask & waitEvents) {
+            return TResult<int>::MakeSuccess(readyMask & waitEvents);
+        }
+
+        if (Uring_) {
+            /* poll request reports current readiness */
+            return WaitFor(fd, waitEvents, deadline);
+        }
+
+        /* edge was consumed by other code, so only the next one is waited for */
+        WaitState_[fd].ReadyEvents &= ~waitEvents;
+        TResult<int> res = WaitFor(fd, waitEvents, deadline);
+        if (!res) {
+            return res;
+        }
+    }
+}
+
 TResult<size_t> TReactor::Read(int fd, void* to, size_t sz, TDeadline deadline) {
     ASSERT(sz > 0);
+
+    if (Uring_) {
+        io_uring_sqe* sqe = PrepareIo(IORING_OP_READ, fd);
+        sqe->addr = reinterpret_cast<uint64_t>(to);
+        sqe->len = sz;
+        sqe->off = -1;
+
+        TResult<int> res = AwaitIo(sqe, fd, EvRead, deadline);
+        SPDLOG_DEBUG(Logger_, "{} performed Read({}, {}, {}) = {}", reinterpret_cast<void*>(CurrentCoro), fd, to, sz, res ? res.Result() : -res.Error());
+        if (!res) {
+            return TResult<size_t>::ForwardError(res);
+        }
+        return TResult<size_t>::MakeSuccess(res.Result());
+    }
+
     while (true) {
         TResult<int> eventsMask = Reactor()->WaitFor(fd, TReactor::EvRead, deadline);
         if (!eventsMask) {
@@ -272,8 +459,43 @@ TResult<size_t> TReactor::Read(int fd, void* to, size_t sz, TDeadline deadline)
     }
 }
 
+TResult<size_t> TReactor::ReadFixed(int fd, void* to, size_t sz, int bufferIndex, TDeadline deadline) {
+    if (!Uring_ || bufferIndex < 0) {
+        return Read(fd, to, sz, deadline);
+    }
+
+    ASSERT(sz > 0);
+
+    io_uring_sqe* sqe = PrepareIo(IORING_OP_READ_FIXED, fd);
+    sqe->addr = reinterpret_cast<uint64_t>(to);
+    sqe->len = sz;
+    sqe->off = -1;
+    sqe->buf_index = bufferIndex;
+
+    TResult<int> res = AwaitIo(sqe, fd, EvRead, deadline);
+    if (!res) {
+        return TResult<size_t>::ForwardError(res);
+    }
+    return TResult<size_t>::MakeSuccess(res.Result());
+}
+
 TResult<size_t> TReactor::Write(int fd, const void* from, size_t sz, TDeadline deadline) {
     ASSERT(sz > 0);
+
+    if (Uring_) {
+        io_uring_sqe* sqe = PrepareIo(IORING_OP_WRITE, fd);
+        sqe->addr = reinterpret_cast<uint64_t>(from);
+        sqe->len = sz;
+        sqe->off = -1;
+
+        TResult<int> res = AwaitIo(sqe, fd, EvWrite, deadline);
+        SPDLOG_DEBUG(Logger_, "{} performed Write({}, {}, {}) = {}", reinterpret_cast<void*>(CurrentCoro), fd, from, sz, res ? res.Result() : -res.Error());
+        if (!res) {
+            return TResult<size_t>::ForwardError(res);
+        }
+        return TResult<size_t>::MakeSuccess(res.Result());
+    }
+
     while (true) {
         TResult<int> eventsMask = Reactor()->WaitFor(fd, TReactor::EvWrite, deadline);
         if (!eventsMask) {
@@ -296,6 +518,20 @@ TResult<size_t> TReactor::Write(int fd, const void* from, size_t sz, TDeadline d
 
 TResult<size_t> TReactor::Writev(int fd, const iovec* iov, int iovcnt, TDeadline deadline) {
     ASSERT(iovcnt > 0);
+
+    if (Uring_) {
+        io_uring_sqe* sqe = PrepareIo(IORING_OP_WRITEV, fd);
+        sqe->addr = reinterpret_cast<uint64_t>(iov);
+        sqe->len = iovcnt;
+        sqe->off = -1;
+
+        TResult<int> res = AwaitIo(sqe, fd, EvWrite, deadline);
+        if (!res) {
+            return TResult<size_t>::ForwardError(res);
+        }
+        return TResult<size_t>::MakeSuccess(res.Result());
+    }
+
     while (true) {
         TResult<int> eventsMask = Reactor()->WaitFor(fd, TReactor::EvWrite, deadline);
         if (!eventsMask) {
@@ -315,6 +551,10 @@ TResult<size_t> TReactor::Writev(int fd, const iovec* iov, int iovcnt, TDeadline
 }
 
 TResult<int> TReactor::Accept(int fd, TSocketAddress* sockAddr, TDeadline deadline) {
+    if (Uring_) {
+        return UringAccept(fd, sockAddr, deadline);
+    }
+
     while (true) {
         TResult<int> eventsMask = Reactor()->WaitFor(fd, TReactor::EvRead, deadline);
         if (!eventsMask) {
@@ -339,6 +579,19 @@ TResult<int> TReactor::Accept(int fd, TSocketAddress* sockAddr, TDeadline deadli
 }
 
 TResult<bool> TReactor::Connect(int fd, const TSocketAddress& addr, TDeadline deadline) {
+    if (Uring_) {
+        io_uring_sqe* sqe = PrepareIo(IORING_OP_CONNECT, fd);
+        sqe->addr = reinterpret_cast<uint64_t>(addr.AddressAs<const sockaddr*>());
+        sqe->off = addr.Length();
+
+        TResult<int> res = AwaitIo(sqe, fd, EvWrite, deadline);
+        SPDLOG_DEBUG(Logger_, "{} performed Connect({}, \"{}:{}\") = {}", reinterpret_cast<void*>(CurrentCoro), fd, addr.Host(), addr.Port(), res ? 0 : -res.Error());
+        if (!res) {
+            return TResult<bool>::ForwardError(res);
+        }
+        return TResult<bool>::MakeSuccess(true);
+    }
+
     int res = ::connect(fd, addr.AddressAs<const sockaddr*>(), addr.Length());
     if (res == -1) {
         if (errno == EINPROGRESS) {
@@ -368,6 +621,53 @@ TResult<bool> TReactor::Connect(int fd, const TSocketAddress& addr, TDeadline de
     return TResult<bool>::MakeSuccess(true);
 }
 
+TResult<size_t> TReactor::SpliceToPipe(int fd, int pipeFd, size_t sz, TDeadline deadline) {
+    return DoSplice(fd, pipeFd, fd, EvRead, sz, deadline);
+}
+
+TResult<size_t> TReactor::SpliceFromPipe(int pipeFd, int fd, size_t sz, TDeadline deadline) {
+    return DoSplice(pipeFd, fd, fd, EvWrite, sz, deadline);
+}
+
+TResult<size_t> TReactor::DoSplice(int fdIn, int fdOut, int fd, uint32_t event, size_t sz, TDeadline deadline) {
+    ASSERT(sz > 0);
+
+    if (Uring_) {
+        io_uring_sqe* sqe = PrepareIo(IORING_OP_SPLICE, fdOut);
+        sqe->splice_fd_in = fdIn;
+        sqe->splice_off_in = -1;
+        sqe->off = -1;
+        sqe->len = sz;
+        sqe->splice_flags = SPLICE_F_MOVE;
+
+        TResult<int> res = AwaitIo(sqe, fd, event, deadline);
+        SPDLOG_DEBUG(Logger_, "{} performed Splice({}, {}, {}) = {}", reinterpret_cast<void*>(CurrentCoro), fdIn, fdOut, sz, res ? res.Result() : -res.Error());
+        if (!res) {
+            return TResult<size_t>::ForwardError(res);
+        }
+        return TResult<size_t>::MakeSuccess(res.Result());
+    }
+
+    while (true) {
+        TResult<int> eventsMask = WaitFor(fd, event, deadline);
+        if (!eventsMask) {
+            return TResult<size_t>::ForwardError(eventsMask);
+        }
+        /* pipe is never full when spliced to and never empty when spliced from, so EAGAIN is about socket */
+        ssize_t res = ::splice(fdIn, nullptr, fdOut, nullptr, sz, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (res == -1) {
+            if (errno == EAGAIN) {
+                WaitState_[fd].ReadyEvents &= ~event;
+                continue;
+            }
+            SPDLOG_DEBUG(Logger_, "{} performed Splice({}, {}, {}) = {}", reinterpret_cast<void*>(CurrentCoro), fdIn, fdOut, sz, -errno);
+            return TResult<size_t>::MakeFail(errno);
+        }
+        SPDLOG_DEBUG(Logger_, "{} performed Splice({}, {}, {}) = {}", reinterpret_cast<void*>(CurrentCoro), fdIn, fdOut, sz, res);
+        return TResult<size_t>::MakeSuccess(res);
+    }
+}
+
 int TReactor::EpollOp(int op, int fd, int events) {
     epoll_event ctl_event;
     ctl_event.events = events;
@@ -392,23 +692,58 @@ void TReactor::DoSignal() {
     }
 }
 
-void TReactor::DoPoll() {
-    static constexpr size_t MaxEvents = 256;
+void TReactor::DoPosted() {
+    uint64_t counter = 0;
+    if (::read(PostedFd_, &counter, sizeof(counter)) == -1) {
+        return;
+    }
 
-    epoll_event events[MaxEvents];
+    std::vector<TPostedCallback> posted;
+    {
+        std::lock_guard<std::mutex> guard(PostedLock_);
+        posted.swap(Posted_);
+    }
 
+    for (TPostedCallback& callback : posted) {
+        callback();
+    }
+}
+
+int TReactor::PollTimeout() {
     int timeout = -1;
 
-    if (ScheduledCoroutines_.size() != 0) {
+    if (!ScheduledCoroutines_.Empty()) {
         timeout = 0;
-    } else if (!DeadlineQueue_.Empty()) {
-        if (DeadlineQueue_.Top()->Deadline <= std::chrono::steady_clock::now()) {
+    } else if (!DeadlineQueue_->Empty()) {
+        TDeadline nextDeadline = DeadlineQueue_->NextDeadline();
+        if (nextDeadline <= Now_) {
             timeout = 0;
         } else {
-            timeout = std::chrono::duration_cast<std::chrono::milliseconds>(DeadlineQueue_.Top()->Deadline - std::chrono::steady_clock::now()).count();
+            /* going to sleep, so cached time must be precise */
+            Now_ = std::chrono::steady_clock::now();
+            if (nextDeadline <= Now_) {
+                timeout = 0;
+            } else {
+                timeout = std::min<int64_t>(std::chrono::ceil<std::chrono::milliseconds>(nextDeadline - Now_).count(), INT_MAX);
+            }
         }
     }
 
+    return timeout;
+}
+
+void TReactor::DoPoll() {
+    static constexpr size_t MaxEvents = 256;
+
+    if (Uring_) {
+        DoUringPoll();
+        return;
+    }
+
+    epoll_event events[MaxEvents];
+
+    int timeout = PollTimeout();
+
     int res = 0;
     while (true) {
         res = ::epoll_wait(EpollFd_, events, MaxEvents, timeout);
@@ -424,11 +759,15 @@ void TReactor::DoPoll() {
         break;
     }
 
+    Now_ = std::chrono::steady_clock::now();
+
     for (int i = 0; i < res; i++) {
         int fd = events[i].data.fd;
 
         if (fd == SignalFd_) {
             DoSignal();
+        } else if (fd == PostedFd_) {
+            DoPosted();
         } else {
             if (events[i].events & EPOLLIN) {
                 WaitState_[fd].ReadyEvents |= TReactor::EvRead;
@@ -450,25 +789,401 @@ void TReactor::DoPoll() {
         }
     }
 
-    while (!DeadlineQueue_.Empty() && DeadlineQueue_.Top()->Deadline <= std::chrono::steady_clock::now()) {
-        TCoroutine* coro = DeadlineQueue_.Peek();
+    DeadlineQueue_->PopExpired(Now_, [this](TCoroutine* coro) {
+        coro->DeadlineReached(true);
+        Wakeup(coro);
+    });
+}
+
+void TReactor::DoUringPoll() {
+    int timeout = PollTimeout();
+
+    /* operations queued by all coroutines since previous poll are submitted at once */
+    Uring_->Submit(timeout == 0 ? 0 : 1, timeout);
+
+    Now_ = std::chrono::steady_clock::now();
+
+    Uring_->ForEachCompletion([this](const io_uring_cqe* cqe) {
+        HandleCompletion(cqe);
+    });
+
+    DeadlineQueue_->PopExpired(Now_, [this](TCoroutine* coro) {
         coro->DeadlineReached(true);
         Wakeup(coro);
+    });
+}
+
+bool TReactor::SetIoBackend(EIoBackend backend) {
+    if (backend == IoBackend()) {
+        return true;
+    }
+
+    /* slots belong to fixed buffers table of the old ring */
+    BufferPool_.ForgetFixedIndices();
+
+    if (backend == IoEpoll) {
+        Uring_.reset();
+        FreeBufferSlots_.clear();
+        return true;
+    }
+
+    try {
+        Uring_ = std::make_unique<TUring>(UringEntries);
+    } catch (const TException& e) {
+        Logger_->warn("cannot use io_uring, falling back to epoll: {}", e.what());
+        return false;
+    }
+
+    if (Uring_->RegisterBuffers(UringBuffers)) {
+        for (int i = UringBuffers - 1; i >= 0; i--) {
+            FreeBufferSlots_.push_back(i);
+        }
+    } else {
+        Logger_->warn("io_uring fixed buffers are disabled: {}", ErrorDescription(errno));
+    }
+
+    ArmPoll(PostedFd_, UdPosted);
+    if (SignalFd_ != -1) {
+        ArmPoll(SignalFd_, UdSignal);
+    }
+
+    Logger_->info("using io_uring backend");
+    return true;
+}
+
+TRegisteredBuffer TReactor::RegisterBuffer(void* data, size_t size) {
+    if (!Uring_ || FreeBufferSlots_.empty()) {
+        return TRegisteredBuffer();
+    }
+
+    int index = FreeBufferSlots_.back();
+    iovec iov = { data, size };
+    if (!Uring_->UpdateBuffer(index, iov)) {
+        SPDLOG_DEBUG(Logger_, "cannot register fixed buffer: {}", ErrorDescription(errno));
+        return TRegisteredBuffer();
+    }
+
+    FreeBufferSlots_.pop_back();
+    return TRegisteredBuffer(this, index);
+}
+
+void TReactor::UnregisterBuffer(int index) {
+    if (!Uring_ || index < 0) {
+        return;
+    }
+
+    iovec iov = { nullptr, 0 };
+    Uring_->UpdateBuffer(index, iov);
+    FreeBufferSlots_.push_back(index);
+}
+
+io_uring_sqe* TReactor::PrepareIo(uint8_t opcode, int fd) {
+    io_uring_sqe* sqe = Uring_->GetSqe();
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    return sqe;
+}
+
+TResult<int> TReactor::AwaitIo(io_uring_sqe* sqe, int fd, uint32_t events, TDeadline deadline) {
+    if (CurrentCoro->Canceled()) {
+        /* entry is already taken from ring, so it is turned into no-op */
+        sqe->opcode = IORING_OP_NOP;
+        sqe->user_data = UdIgnore;
+        SPDLOG_DEBUG(Logger_, "{} canceled immediately", reinterpret_cast<void*>(CurrentCoro));
+        return TResult<int>::MakeCanceled();
+    }
+
+    TIoRequest request;
+    request.Coro = CurrentCoro;
+    sqe->user_data = reinterpret_cast<uint64_t>(&request);
+
+    CurrentCoro->IoRequest = &request;
+    UpdateWaitState(fd, events, CurrentCoro);
+
+    CurrentCoro->DeadlineReached(false);
+    if (deadline != TDeadline::max()) {
+        CurrentCoro->Deadline = deadline;
+        DeadlineQueue_->Push(CurrentCoro);
+    }
+
+    while (!request.Completed) {
+        SwitchCoroutine(false);
+
+        if (!request.Completed && (CurrentCoro->Canceled() || CurrentCoro->DeadlineReached())) {
+            /* kernel may still write to caller's memory, so completion is awaited anyway */
+            CancelIo(&request);
+        }
+    }
+
+    if (DeadlineQueue_->Contains(CurrentCoro)) {
+        DeadlineQueue_->Remove(CurrentCoro);
+    }
+
+    CurrentCoro->IoRequest = nullptr;
+    UpdateWaitState(fd, events, nullptr);
+
+    if (request.Result == -ECANCELED) {
+        if (CurrentCoro->Canceled()) {
+            return TResult<int>::MakeCanceled();
+        }
+        if (CurrentCoro->DeadlineReached()) {
+            return TResult<int>::MakeTimedOut();
+        }
+    }
+
+    if (request.Result < 0) {
+        return TResult<int>::MakeFail(-request.Result);
+    }
+
+    /* operation may complete successfully even if it was canceled, its result must not be lost */
+    return TResult<int>::MakeSuccess(request.Result);
+}
+
+void TReactor::CancelIo(TIoRequest* request) {
+    if (request->CancelRequested) {
+        return;
+    }
+
+    io_uring_sqe* sqe = PrepareIo(IORING_OP_ASYNC_CANCEL, -1);
+    sqe->addr = reinterpret_cast<uint64_t>(request);
+    sqe->user_data = UdIgnore;
+    request->CancelRequested = true;
+}
+
+void TReactor::ArmPoll(int fd, uint64_t userData) {
+    io_uring_sqe* sqe = PrepareIo(IORING_OP_POLL_ADD, fd);
+    sqe->poll32_events = POLLIN;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = userData;
+}
+
+void TReactor::HandleCompletion(const io_uring_cqe* cqe) {
+    uint64_t userData = cqe->user_data;
+
+    if (userData == UdIgnore) {
+        return;
+    }
+
+    if (userData == UdPosted || userData == UdSignal) {
+        int fd = userData == UdPosted ? PostedFd_ : SignalFd_;
+        if (cqe->res > 0) {
+            if (userData == UdPosted) {
+                DoPosted();
+            } else {
+                DoSignal();
+            }
+        }
+        /* multishot poll may be terminated by kernel, it is rearmed unless it was removed */
+        if (!(cqe->flags & IORING_CQE_F_MORE) && cqe->res != -ECANCELED) {
+            ArmPoll(fd, userData);
+        }
+        return;
+    }
+
+    if (userData & UdAcceptStream) {
+        HandleAcceptCompletion(reinterpret_cast<TAcceptStream*>(userData & ~UdAcceptStream), cqe);
+        return;
+    }
+
+    TIoRequest* request = reinterpret_cast<TIoRequest*>(userData);
+    request->Result = cqe->res;
+    request->Completed = true;
+    Wakeup(request->Coro);
+}
+
+void TReactor::HandleAcceptCompletion(TAcceptStream* stream, const io_uring_cqe* cqe) {
+    if (cqe->res >= 0) {
+        if (stream->Orphaned) {
+            ::close(cqe->res);
+        } else {
+            stream->Accepted.push_back(cqe->res);
+        }
+    } else if (cqe->res != -ECANCELED) {
+        stream->Error = -cqe->res;
+    }
+
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        stream->Armed = false;
+
+        if (stream->Orphaned) {
+            auto it = std::find_if(OrphanedAcceptStreams_.begin(), OrphanedAcceptStreams_.end(), [stream](const std::unique_ptr<TAcceptStream>& orphaned) {
+                return orphaned.get() == stream;
+            });
+            ASSERT(it != OrphanedAcceptStreams_.end());
+            OrphanedAcceptStreams_.erase(it);
+            return;
+        }
+    }
+
+    if (stream->Waiter) {
+        Wakeup(stream->Waiter);
     }
 }
 
+TResult<int> TReactor::UringAccept(int fd, TSocketAddress* sockAddr, TDeadline deadline) {
+    while (true) {
+        auto it = AcceptStreams_.find(fd);
+        if (it == AcceptStreams_.end()) {
+            it = AcceptStreams_.emplace(fd, std::make_unique<TAcceptStream>()).first;
+            it->second->Fd = fd;
+        }
+        TAcceptStream* stream = it->second.get();
+
+        if (!stream->Accepted.empty()) {
+            int newFd = stream->Accepted.front();
+            stream->Accepted.pop_front();
+
+            /* multishot accept cannot return peer addresses */
+            sockaddr_storage addr;
+            socklen_t len = sizeof(addr);
+            if (::getpeername(newFd, reinterpret_cast<sockaddr*>(&addr), &len) == -1) {
+                /* connection was reset while waiting in queue */
+                ::close(newFd);
+                continue;
+            }
+
+            *sockAddr = TSocketAddress(reinterpret_cast<sockaddr*>(&addr), len);
+            SPDLOG_DEBUG(Logger_, "{} performed Accept({}) = [ {}, \"{}:{}\" ]", reinterpret_cast<void*>(CurrentCoro), fd, newFd, sockAddr->Host(), sockAddr->Port());
+            return TResult<int>::MakeSuccess(newFd);
+        }
+
+        if (stream->Error != 0) {
+            int err = stream->Error;
+            stream->Error = 0;
+            SPDLOG_DEBUG(Logger_, "{} performed Accept({}) = {}", reinterpret_cast<void*>(CurrentCoro), fd, -err);
+            return TResult<int>::MakeFail(err);
+        }
+
+        if (CurrentCoro->Canceled()) {
+            return TResult<int>::MakeCanceled();
+        }
+
+        if (!stream->Armed) {
+            /* one submission keeps accepting connections until error or cancellation */
+            io_uring_sqe* sqe = PrepareIo(IORING_OP_ACCEPT, fd);
+            sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+            sqe->accept_flags = SOCK_NONBLOCK;
+            sqe->user_data = reinterpret_cast<uint64_t>(stream) | UdAcceptStream;
+            stream->Armed = true;
+        }
+
+        ASSERT(!stream->Waiter);
+        stream->Waiter = CurrentCoro;
+
+        CurrentCoro->DeadlineReached(false);
+        if (deadline != TDeadline::max()) {
+            CurrentCoro->Deadline = deadline;
+            DeadlineQueue_->Push(CurrentCoro);
+        }
+
+        SwitchCoroutine(false);
+
+        if (DeadlineQueue_->Contains(CurrentCoro)) {
+            DeadlineQueue_->Remove(CurrentCoro);
+        }
+
+        it = AcceptStreams_.find(fd);
+        if (it == AcceptStreams_.end()) {
+            /* fd was closed while waiting */
+            return TResult<int>::MakeFail(EBADF);
+        }
+        it->second->Waiter = nullptr;
+
+        if (CurrentCoro->DeadlineReached()) {
+            return TResult<int>::MakeTimedOut();
+        }
+
+        if (CurrentCoro->Canceled()) {
+            return TResult<int>::MakeCanceled();
+        }
+    }
+}
+
+void TReactor::SetDeadlineQueue(EDeadlineQueueKind kind) {
+    /* it is called on every reload, so pending deadlines are not moved needlessly */
+    if (kind == DeadlineQueueKind_) {
+        return;
+    }
+
+    std::unique_ptr<TDeadlineQueue> queue;
+    switch (kind) {
+        case DqHeap:
+            queue = std::make_unique<THeapDeadlineQueue>();
+            break;
+        case DqTimerWheel:
+            queue = std::make_unique<TTimerWheel>(Now_);
+            break;
+        default:
+            throw TException() << "unknown deadline queue kind " << kind;
+    }
+
+    DeadlineQueue_->PopAll([&queue](TCoroutine* coro) {
+        queue->Push(coro);
+    });
+    DeadlineQueue_ = std::move(queue);
+    DeadlineQueueKind_ = kind;
+}
+
 void TReactor::RegisterNonBlockingFd(int fd) {
     SPDLOG_DEBUG(Logger_, "fd={} registered", fd);
     if (WaitState_.size() <= fd) {
         WaitState_.resize(fd + 1);
     }
     WaitState_[fd].ReadyEvents = 0;
+
+    if (Uring_) {
+        /*
+         * io_uring completes operations on O_NONBLOCK files with EAGAIN instead of
+         * waiting for readiness, so fd is switched back to blocking mode.
+         */
+        SetBlocking(fd);
+        return;
+    }
+
     EpollOp(EPOLL_CTL_ADD, fd, EPOLLIN | EPOLLOUT | EPOLLET);
 }
 
 void TReactor::CloseFd(int fd) {
     SPDLOG_DEBUG(Logger_, "fd={} closed", fd);
 
+    if (Uring_) {
+        /* in-flight operations hold the file, so fd closing does not interrupt them */
+        for (TCoroutine* coro : { WaitState_[fd].Reader, WaitState_[fd].Writer }) {
+            if (coro && coro->IoRequest) {
+                CancelIo(coro->IoRequest);
+            }
+        }
+
+        auto it = AcceptStreams_.find(fd);
+        if (it != AcceptStreams_.end()) {
+            std::unique_ptr<TAcceptStream> stream = std::move(it->second);
+            AcceptStreams_.erase(it);
+
+            for (int accepted : stream->Accepted) {
+                ::close(accepted);
+            }
+            stream->Accepted.clear();
+
+            if (stream->Waiter) {
+                Wakeup(stream->Waiter);
+                stream->Waiter = nullptr;
+            }
+
+            if (stream->Armed) {
+                io_uring_sqe* sqe = PrepareIo(IORING_OP_ASYNC_CANCEL, -1);
+                sqe->addr = reinterpret_cast<uint64_t>(stream.get()) | UdAcceptStream;
+                sqe->user_data = UdIgnore;
+                stream->Orphaned = true;
+                OrphanedAcceptStreams_.push_back(std::move(stream));
+            }
+        }
+
+        WaitState_[fd].Writer = nullptr;
+        WaitState_[fd].Reader = nullptr;
+        WaitState_[fd].ReadyEvents = 0;
+        return;
+    }
+
     if (WaitState_[fd].Writer) {
         Wakeup(WaitState_[fd].Writer);
     }
@@ -482,6 +1197,13 @@ void TReactor::CloseFd(int fd) {
     WaitState_[fd].ReadyEvents = 0;
 }
 
+void TReactor::ReleaseFd(int fd) {
+    CloseFd(fd);
+    if (!Uring_) {
+        EpollOp(EPOLL_CTL_DEL, fd, 0);
+    }
+}
+
 void TReactor::Cancel(TCoroutine* coro) {
     SPDLOG_DEBUG(Logger_, "cancel {}", reinterpret_cast<void*>(coro));
 
@@ -489,16 +1211,16 @@ void TReactor::Cancel(TCoroutine* coro) {
         return;
     }
 
-    if (coro->PosInDeadlineQueue != TDeadlineQueue::InvalidPos) {
-        DeadlineQueue_.Remove(coro);
+    if (DeadlineQueue_->Contains(coro)) {
+        DeadlineQueue_->Remove(coro);
     }
     coro->Canceled(true);
     Wakeup(coro);
 }
 
 void TReactor::CancelAll() {
-    for (std::unique_ptr<TCoroutine>& coro : ActiveCoroutines_) {
-        coro->Cancel();
+    for (TCoroutine& coro : ActiveCoroutines_) {
+        coro.Cancel();
     }
 }
 
@@ -554,40 +1276,3 @@ TResult<bool> TReactor::AwaitAll(std::vector<TCoroutine*> coros) {
 
     return TResult<bool>::MakeSuccess(true);
 }
-
-static inline size_t Parent(size_t idx) {
-    return (idx - 1) / 2;
-}
-
-static inline size_t LeftChild(size_t idx) {
-    return idx * 2 + 1;
-}
-
-static inline size_t RightChild(size_t idx) {
-    return idx * 2 + 2;
-}
-
-void TReactor::TDeadlineQueue::SiftUp(size_t idx) {
-    while (idx > 0 && Queue_[idx]->Deadline < Queue_[Parent(idx)]->Deadline) {
-        Swap(idx, Parent(idx));
-        idx = Parent(idx);
-    }
-}
-
-void TReactor::TDeadlineQueue::SiftDown(size_t idx) {
-    while (LeftChild(idx) < Queue_.size()) {
-        size_t j = LeftChild(idx);
-
-        if (RightChild(idx) < Queue_.size() &&
-            Queue_[RightChild(idx)]->Deadline < Queue_[LeftChild(idx)]->Deadline) {
-            j = RightChild(idx);
-        }
-
-        if (Queue_[idx]->Deadline <= Queue_[j]->Deadline) {
-            break;
-        }
-
-        Swap(idx, j);
-        idx = j;
-    }
-}
@@ -1,9 +1,13 @@
 #pragma once
 
+#include <array>
+#include <deque>
 #include <vector>
 #include <list>
+#include <unordered_map>
 #include <memory>
 #include <chrono>
+#include <mutex>
 
 #include <spdlog/spdlog.h>
 
@@ -11,16 +15,34 @@
 
 #include <coro/context.h>
 #include <coro/coro.h>
+#include <coro/pipe.h>
+#include <regexp/pool.h>
+#include <util/buffer_pool.h>
+#include <util/intrusive_list.h>
+#include <util/slab.h>
 #include <util/system.h>
 #include <util/signal.h>
 #include <util/network/address.h>
 
 using TSignalHandler = std::function<void(TSignalInfo info)>;
+using TPostedCallback = std::function<void()>;
+
+class TUring;
+class TRegisteredBuffer;
+struct io_uring_sqe;
+struct io_uring_cqe;
 
 class TReactor : TMoveOnly {
 public:
     using TCoroEntry = std::function<void()>;
 
+    class TCoroutine;
+
+    /*
+     * See `SetSwitchHook`, null coroutine stands for reactor itself.
+     */
+    using TSwitchHook = void (*)(void* arg, TCoroutine* from, TCoroutine* to);
+
     /*
      * Event types used in `WaitFor`.
      */
@@ -32,18 +54,37 @@ public:
 
     using TDeadline = std::chrono::steady_clock::time_point;
 
+    /*
+     * I/O backends, see `SetIoBackend`.
+     */
+    enum EIoBackend {
+        IoEpoll = 0,
+        IoUring = 1,
+    };
+
+    /* io_uring operation coroutine is waiting for */
+    struct TIoRequest;
+
+    /* tags of intrusive lists coroutine is linked to */
+    struct TOwnerListTag {};
+    struct TScheduleListTag {};
+    struct TDeadlineListTag {};
+
     /*
      * Represents coroutine inside reactor.
      */
-    class TCoroutine : TMoveOnly {
+    class TCoroutine
+        : public TIntrusiveListItem<TOwnerListTag>
+        , public TIntrusiveListItem<TScheduleListTag>
+        , public TIntrusiveListItem<TDeadlineListTag>
+    {
     public:
         TCoroutine() = default;
-        TCoroutine(TCoroutine&&) = default;
 
-        TCoroutine(TReactor* reactor, TCoroEntry entry, size_t stackSize)
+        TCoroutine(TReactor* reactor, TCoroEntry entry, TCoroStack stack)
             : Reactor(reactor)
             , Entry(std::move(entry))
-            , Stack(stackSize)
+            , Stack(std::move(stack))
         {
         }
 
@@ -123,14 +164,16 @@ public:
 
         TCoroutine* Awaiter = nullptr;
 
+        /* in-flight io_uring operation, if any */
+        TIoRequest* IoRequest = nullptr;
+
+        /* state of embedding code carried with coroutine by switch hook, reactor does not touch it */
+        void* HookData = nullptr;
+
         /* for deadline queue */
         TDeadline Deadline;
         size_t PosInDeadlineQueue = -1;
 
-        /* holding an iterator in ActiveCoroutines_ or ZombieCoroutines lists
-         * for fast removal */
-        std::list<std::unique_ptr<TCoroutine>>::iterator ListIter;
-
     private:
         void SetFlag(int flag, bool set) {
             if (set) {
@@ -141,45 +184,61 @@ public:
         }
     };
 
+    /*
+     * Queue of coroutines sleeping until their `Deadline`.
+     */
     class TDeadlineQueue {
     public:
-        static constexpr size_t InvalidPos = -1;
+        using TCallback = std::function<void(TCoroutine*)>;
 
-        TCoroutine* Top() const {
-            return Queue_[0];
-        }
+        virtual ~TDeadlineQueue() = default;
 
-        TCoroutine* Peek() {
-            TCoroutine* res = Queue_[0];
-            Pop();
-            return res;
-        }
+        virtual void Push(TCoroutine* coro) = 0;
+        virtual void Remove(TCoroutine* coro) = 0;
+        virtual bool Contains(const TCoroutine* coro) const = 0;
+        virtual bool Empty() const = 0;
 
-        void Pop() {
-            if (Queue_.size() == 1) {
-                Queue_.resize(0);
-                return;
-            }
+        /*
+         * Returns time point which is not later than the earliest deadline in queue.
+         */
+        virtual TDeadline NextDeadline() const = 0;
 
-            Remove(Top());
-        }
+        /*
+         * Removes all coroutines with deadline not later than `now` from queue.
+         */
+        virtual void PopExpired(TDeadline now, const TCallback& onExpired) = 0;
 
-        void Push(TCoroutine* coro) {
-            Queue_.push_back(coro);
-            SiftUp(Queue_.size() - 1);
-        }
+        /*
+         * Removes all coroutines from queue.
+         */
+        virtual void PopAll(const TCallback& onPopped) = 0;
+    };
+
+    /*
+     * Binary heap of coroutines: O(log n) insertion and removal, precise deadlines.
+     */
+    class THeapDeadlineQueue : public TDeadlineQueue {
+    public:
+        static constexpr size_t InvalidPos = -1;
 
-        void Remove(TCoroutine* coro) {
-            ASSERT(coro->PosInDeadlineQueue != InvalidPos);
-            Queue_[coro->PosInDeadlineQueue] = Queue_.back();
-            Queue_.resize(Queue_.size() - 1);
-            SiftDown(0);
+        void Push(TCoroutine* coro) override;
+        void Remove(TCoroutine* coro) override;
+
+        bool Contains(const TCoroutine* coro) const override {
+            return coro->PosInDeadlineQueue != InvalidPos;
         }
 
-        bool Empty() const {
+        bool Empty() const override {
             return Queue_.empty();
         }
 
+        TDeadline NextDeadline() const override {
+            return Queue_.empty() ? TDeadline::max() : Queue_[0]->Deadline;
+        }
+
+        void PopExpired(TDeadline now, const TCallback& onExpired) override;
+        void PopAll(const TCallback& onPopped) override;
+
     private:
         inline void Swap(size_t l, size_t r) {
             ASSERT(l < Queue_.size() && r < Queue_.size());
@@ -198,7 +257,72 @@ public:
         std::vector<TCoroutine*> Queue_;
     };
 
+    /*
+     * Hierarchical timing wheel with millisecond ticks: O(1) insertion and removal.
+     * Deadlines are rounded up to whole milliseconds.
+     */
+    class TTimerWheel : public TDeadlineQueue {
+    public:
+        TTimerWheel(TDeadline now);
+
+        void Push(TCoroutine* coro) override;
+        void Remove(TCoroutine* coro) override;
+
+        bool Contains(const TCoroutine* coro) const override {
+            return static_cast<const TIntrusiveListItem<TDeadlineListTag>*>(coro)->Linked();
+        }
+
+        bool Empty() const override {
+            return Size_ == 0;
+        }
+
+        TDeadline NextDeadline() const override;
+        void PopExpired(TDeadline now, const TCallback& onExpired) override;
+        void PopAll(const TCallback& onPopped) override;
+
+    private:
+        static constexpr size_t LevelBits = 8;
+        static constexpr size_t LevelSize = 1 << LevelBits;
+        static constexpr size_t LevelMask = LevelSize - 1;
+        static constexpr size_t LevelsCount = 4;
+
+        using TSlot = TIntrusiveList<TCoroutine, TDeadlineListTag>;
+
+        struct TLevel {
+            std::array<TSlot, LevelSize> Slots;
+            /* bit is set if slot may be non-empty */
+            std::array<uint64_t, LevelSize / 64> Occupied = {};
+        };
+
+        void Insert(TCoroutine* coro);
+        void Advance(uint64_t tick);
+        void Cascade(size_t level);
+        /* first tick at which some slot is expired or cascaded */
+        uint64_t NextTick() const;
+
+        std::array<TLevel, LevelsCount> Levels_;
+        /* coroutines which deadline has already come */
+        TSlot Expired_;
+        uint64_t CurrentTick_ = 0;
+        size_t Size_ = 0;
+    };
+
+    /*
+     * Kinds of deadline queue, see `SetDeadlineQueue`.
+     */
+    enum EDeadlineQueueKind {
+        DqHeap = 0,
+        DqTimerWheel = 1,
+    };
+
+    /*
+     * Sets backend new reactors are created with, it is meant to be called once at startup.
+     */
+    static void SetDefaultIoBackend(EIoBackend backend);
+    static EIoBackend DefaultIoBackend();
+
     TReactor(std::shared_ptr<spdlog::logger> logger, size_t stackSize = 4096 * 10);
+    ~TReactor();
 
     /*
      * Start a new coroutine. On exit, coroutine will be destroyed.
@@ -248,6 +372,11 @@ public:
      */
     void CloseFd(int fd);
 
+    /*
+     * Unregisters file descriptor without closing it, so it is served by other code then.
+     */
+    void ReleaseFd(int fd);
+
     /*
      * Wake up the coroutine. If coroutine sleeps it is scheduled to execution,
      * otherwise function has no effect.
@@ -279,6 +408,12 @@ public:
      */
     TResult<int> WaitFor(int fd, uint32_t events, TDeadline deadline = TDeadline::max());
 
+    /*
+     * Same as `WaitFor`, but readiness is checked by poll(2) first. It suits fds which are read
+     * by code other than reactor, e.g. epoll fd of foreign event loop, so readiness reactor saw last may be stale.
+     */
+    TResult<int> WaitForLevel(int fd, uint32_t events, TDeadline deadline = TDeadline::max());
+
     /*
      * Reads at most `size` bytes to memory pointer by `to`.
      * @return how many bytes were read.
@@ -305,6 +440,18 @@ public:
      */
     TResult<bool> Connect(int fd, const TSocketAddress& addr, TDeadline deadline = TDeadline::max());
 
+    /*
+     * Moves at most `size` bytes from socket `fd` to pipe `pipeFd` without copying them to user space.
+     * @return how many bytes were moved, 0 means end of stream.
+     */
+    TResult<size_t> SpliceToPipe(int fd, int pipeFd, size_t size, TDeadline deadline = TDeadline::max());
+
+    /*
+     * Moves at most `size` bytes from pipe `pipeFd` to socket `fd` without copying them to user space.
+     * @return how many bytes were moved.
+     */
+    TResult<size_t> SpliceFromPipe(int pipeFd, int fd, size_t size, TDeadline deadline = TDeadline::max());
+
     /*
      * Registers signal handler.
      */
@@ -315,47 +462,190 @@ public:
         OnSignals(sigs, std::move(handler));
     }
 
+    /*
+     * Schedules `callback` to be executed inside reactor's thread.
+     * Unlike other methods, it is safe to call from any thread.
+     */
+    void Post(TPostedCallback callback);
+
     /*
      * Transfer execution to next scheduled coroutine.
      */
     void Yield();
 
+    /*
+     * Sets function called whenever execution leaves coroutine `from` for coroutine `to`, before stack is switched.
+     * Reactor itself is null: hook is called with null `to` before reactor polls and with null `from` after it.
+     * Coroutines switching to themselves are not reported. Hook is called on every switch, so it must be cheap.
+     */
+    void SetSwitchHook(TSwitchHook hook, void* arg) {
+        SwitchHook_ = hook;
+        SwitchHookArg_ = arg;
+    }
+
+    /*
+     * Switches reactor to readiness-based epoll or completion-based io_uring backend.
+     * Must be called before any fd is registered in reactor.
+     * If io_uring is not available reactor stays on epoll.
+     * @return whether requested backend is used.
+     */
+    bool SetIoBackend(EIoBackend backend);
+
+    EIoBackend IoBackend() const {
+        return Uring_ ? IoUring : IoEpoll;
+    }
+
+    /*
+     * Registers memory region as io_uring fixed buffer, so kernel does not map its pages on every read.
+     * Returned registration is empty, if reactor does not use io_uring or fixed buffers table is full.
+     */
+    TRegisteredBuffer RegisterBuffer(void* data, size_t size);
+    void UnregisterBuffer(int index);
+
+    /*
+     * Same as `Read`, but `to` must lie inside fixed buffer `bufferIndex` returned by `RegisterBuffer`.
+     * Negative `bufferIndex` means ordinary read.
+     */
+    TResult<size_t> ReadFixed(int fd, void* to, size_t size, int bufferIndex, TDeadline deadline = TDeadline::max());
+
+    /*
+     * Returns time cached at the beginning of current reactor loop iteration.
+     * It is cheaper than `std::chrono::steady_clock::now()` and precise enough for deadlines.
+     */
+    TDeadline Now() const {
+        return Now_;
+    }
+
+    /*
+     * Replaces deadline queue implementation, sleeping coroutines are moved to the new one.
+     * Queue of the same kind is kept as is.
+     */
+    void SetDeadlineQueue(EDeadlineQueueKind kind);
+
+    EDeadlineQueueKind DeadlineQueueKind() const {
+        return DeadlineQueueKind_;
+    }
+
     void SetCoroutineStackSize(size_t size) {
         CoroutineStackSize_ = size;
         Logger_->info("coroutine stack size is {} bytes ({} KBytes)", size, size / 1024);
     }
 
+    /*
+     * Pool of stacks of finished coroutines.
+     */
+    TCoroStackPool& StackPool() {
+        return StackPool_;
+    }
+
+    /*
+     * Pool of empty pipes used for splicing.
+     */
+    TPipePool& PipePool() {
+        return PipePool_;
+    }
+
+    /*
+     * Pool of memory for socket buffers of connections served by this reactor.
+     */
+    TBufferPool& BufferPool() {
+        return BufferPool_;
+    }
+
+    /*
+     * Hyperscan scratch and stream states of regexp matchers running on this reactor.
+     */
+    TRegexpPool& RegexpPool() {
+        return RegexpPool_;
+    }
+
 private:
+    /* io_uring user_data of completions not related to coroutines' requests */
+    enum : uint64_t {
+        UdIgnore = 0,
+        UdPosted = 2,
+        UdSignal = 4,
+        /* low bit is set for pointers to TAcceptStream */
+        UdAcceptStream = 1,
+    };
+
+    /* number of entries in io_uring submission queue */
+    static constexpr unsigned UringEntries = 1024;
+    /* size of io_uring fixed buffers table */
+    static constexpr unsigned UringBuffers = 1024;
+
+    /*
+     * Connections accepted by multishot accept and not yet taken by `Accept`.
+     */
+    struct TAcceptStream {
+        int Fd = -1;
+        std::deque<int> Accepted;
+        TCoroutine* Waiter = nullptr;
+        int Error = 0;
+        /* multishot accept is in flight */
+        bool Armed = false;
+        /* fd was closed, stream is destroyed on the last completion */
+        bool Orphaned = false;
+    };
+
     struct TWaitState {
         uint32_t ReadyEvents = 0;
         TCoroutine* Writer;
         TCoroutine* Reader;
     };
 
+    using TCoroutineList = TIntrusiveList<TCoroutine, TOwnerListTag>;
+    using TScheduleQueue = TIntrusiveList<TCoroutine, TScheduleListTag>;
+
     TCoroutine* StartCoroutine(TCoroEntry entry, bool awaitable);
 
     void UpdateWaitState(int fd, uint32_t events, TCoroutine* value);
 
     void Finish(TCoroutine*);
+    void DestroyFinished();
 
     void SwitchCoroutine(bool exitOld);
     void DoSignal();
+    void DoPosted();
+    int PollTimeout();
     void DoPoll();
+    void DoUringPoll();
+
+    io_uring_sqe* PrepareIo(uint8_t opcode, int fd);
+    TResult<int> AwaitIo(io_uring_sqe* sqe, int fd, uint32_t events, TDeadline deadline);
+    void CancelIo(TIoRequest* request);
+    void ArmPoll(int fd, uint64_t userData);
+    void HandleCompletion(const io_uring_cqe* cqe);
+    void HandleAcceptCompletion(TAcceptStream* stream, const io_uring_cqe* cqe);
+    TResult<int> UringAccept(int fd, TSocketAddress* addr, TDeadline deadline);
+
+    /* `fd` is the socket end of splice, it is waited for `event` */
+    TResult<size_t> DoSplice(int fdIn, int fdOut, int fd, uint32_t event, size_t size, TDeadline deadline);
 
     int EpollOp(int op, int fd, int events);
 
     static void CoroWrapper();
 
+    /* must outlive all coroutines, since they return their stacks here */
+    TCoroStackPool StackPool_;
+    TPipePool PipePool_;
+    TBufferPool BufferPool_;
+    TRegexpPool RegexpPool_;
+
+    /* coroutines are allocated from slab and linked into intrusive lists,
+     * so starting, waking up and switching never touches malloc */
+    TSlab<TCoroutine> CoroutineSlab_;
+
     /* all sleeping, running or scheduled coroutines is placed here */
-    std::list<std::unique_ptr<TCoroutine>> ActiveCoroutines_;
+    TCoroutineList ActiveCoroutines_;
 
     /* each exited awaitable coroutine is placed here */
-    std::list<std::unique_ptr<TCoroutine>> ZombieCoroutines_;
+    TCoroutineList ZombieCoroutines_;
 
-    std::unique_ptr<TCoroutine> FinishedCoroutine_;
+    TCoroutine* FinishedCoroutine_ = nullptr;
 
-    std::list<TCoroutine*> ScheduledCoroutines_;
-    std::list<TCoroutine*> ScheduledNextCoroutines_;
+    TScheduleQueue ScheduledCoroutines_;
+    TScheduleQueue ScheduledNextCoroutines_;
 
     /* fake coroutine holding initial context where TReactor::Run was called */
     TCoroutine InitialCoro_;
@@ -368,16 +658,93 @@ private:
     TSignalSet BlockedSignals_;
     std::array<TSignalHandler, SIGMAX> SignalHandlers_;
 
-    TDeadlineQueue DeadlineQueue_;
+    /* callbacks posted from other threads, guarded by PostedLock_ */
+    int PostedFd_ = -1;
+    std::mutex PostedLock_;
+    std::vector<TPostedCallback> Posted_;
+
+    std::unique_ptr<TDeadlineQueue> DeadlineQueue_;
+    EDeadlineQueueKind DeadlineQueueKind_ = DqHeap;
+    TDeadline Now_;
+
+    /* set if io_uring backend is used */
+    std::unique_ptr<TUring> Uring_;
+    std::vector<int> FreeBufferSlots_;
+    std::unordered_map<int, std::unique_ptr<TAcceptStream>> AcceptStreams_;
+    /* streams of closed fds waiting for their last completion */
+    std::vector<std::unique_ptr<TAcceptStream>> OrphanedAcceptStreams_;
 
     std::shared_ptr<spdlog::logger> Logger_;
 
     size_t CoroutineStackSize_ = 0;
+
+    TSwitchHook SwitchHook_ = nullptr;
+    void* SwitchHookArg_ = nullptr;
 };
 
 using TCoroutine = TReactor::TCoroutine;
 
 /*
- * Returns current reactor.
+ * Slot of memory region in io_uring fixed buffers table, released on destruction.
+ */
+class TRegisteredBuffer : TMoveOnly {
+public:
+    TRegisteredBuffer() = default;
+
+    TRegisteredBuffer(TReactor* reactor, int index)
+        : Reactor_(reactor)
+        , Index_(index)
+    {
+    }
+
+    TRegisteredBuffer(TRegisteredBuffer&& other) noexcept
+        : Reactor_(other.Reactor_)
+        , Index_(other.Index_)
+    {
+        other.Reactor_ = nullptr;
+        other.Index_ = -1;
+    }
+
+    TRegisteredBuffer& operator=(TRegisteredBuffer&& other) noexcept {
+        std::swap(Reactor_, other.Reactor_);
+        std::swap(Index_, other.Index_);
+        return *this;
+    }
+
+    ~TRegisteredBuffer() {
+        if (Reactor_) {
+            Reactor_->UnregisterBuffer(Index_);
+        }
+    }
+
+    /*
+     * Index in fixed buffers table or -1 if buffer is not registered.
+     */
+    int Index() const {
+        return Index_;
+    }
+
+    /*
+     * Stops managing the slot, caller becomes responsible for `TReactor::UnregisterBuffer`.
+     */
+    int Release() {
+        int index = Index_;
+        Reactor_ = nullptr;
+        Index_ = -1;
+        return index;
+    }
+
+private:
+    TReactor* Reactor_ = nullptr;
+    int Index_ = -1;
+};
+
+/*
+ * Returns current reactor of the calling thread.
  */
 TReactor* Reactor();
+
+/*
+ * Returns current reactor of the calling thread or null, if thread runs no reactor.
+ */
+TReactor* ReactorIfAny();
@@ -0,0 +1,184 @@
+#include <coro/uring.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static int IoUringSetup(unsigned entries, io_uring_params* params) {
+    return ::syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int IoUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags, const void* arg, size_t argSize) {
+    return ::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argSize);
+}
+
+static int IoUringRegister(int fd, unsigned opcode, const void* arg, unsigned nrArgs) {
+    return ::syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs);
+}
+
+template <typename T>
+static T* RingField(void* ring, uint32_t offset) {
+    return reinterpret_cast<T*>(reinterpret_cast<uint8_t*>(ring) + offset);
+}
+
+TUring::TUring(unsigned entries) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+
+    Fd_ = IoUringSetup(entries, &params);
+    if (Fd_ == -1) {
+        ThrowErrno("io_uring_setup failed");
+    }
+
+    /* timeouts of io_uring_enter are required to wait for completions and deadlines at once */
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_EXT_ARG)) {
+        ::close(Fd_);
+        throw TException() << "io_uring is too old";
+    }
+
+    SqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    CqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    SqRingSize_ = CqRingSize_ = std::max(SqRingSize_, CqRingSize_);
+
+    SqRing_ = ::mmap(nullptr, SqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Fd_, IORING_OFF_SQ_RING);
+    if (SqRing_ == MAP_FAILED) {
+        int err = errno;
+        SqRing_ = nullptr;
+        Unmap();
+        ThrowErr(err, "mmap of io_uring rings failed");
+    }
+    /* both rings share single mapping */
+    CqRing_ = SqRing_;
+
+    SqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = ::mmap(nullptr, SqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Fd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        int err = errno;
+        Unmap();
+        ThrowErr(err, "mmap of io_uring submission entries failed");
+    }
+    Sqes_ = reinterpret_cast<io_uring_sqe*>(sqes);
+
+    SqHead_ = RingField<unsigned>(SqRing_, params.sq_off.head);
+    SqTail_ = RingField<unsigned>(SqRing_, params.sq_off.tail);
+    SqMask_ = *RingField<unsigned>(SqRing_, params.sq_off.ring_mask);
+    SqEntries_ = *RingField<unsigned>(SqRing_, params.sq_off.ring_entries);
+    SqArray_ = RingField<unsigned>(SqRing_, params.sq_off.array);
+
+    CqHead_ = RingField<unsigned>(CqRing_, params.cq_off.head);
+    CqTail_ = RingField<unsigned>(CqRing_, params.cq_off.tail);
+    CqMask_ = *RingField<unsigned>(CqRing_, params.cq_off.ring_mask);
+    Cqes_ = RingField<io_uring_cqe>(CqRing_, params.cq_off.cqes);
+
+    /* identity mapping, so entries are consumed in order they were queued */
+    for (unsigned i = 0; i < SqEntries_; i++) {
+        SqArray_[i] = i;
+    }
+
+    SqeHead_ = SqeTail_ = *SqTail_;
+}
+
+TUring::~TUring() {
+    Unmap();
+}
+
+void TUring::Unmap() {
+    if (Sqes_) {
+        ::munmap(Sqes_, SqesSize_);
+        Sqes_ = nullptr;
+    }
+
+    if (SqRing_) {
+        ::munmap(SqRing_, SqRingSize_);
+        SqRing_ = nullptr;
+        CqRing_ = nullptr;
+    }
+
+    if (Fd_ != -1) {
+        ::close(Fd_);
+        Fd_ = -1;
+    }
+}
+
+io_uring_sqe* TUring::GetSqe() {
+    if (SqeTail_ - __atomic_load_n(SqHead_, __ATOMIC_ACQUIRE) >= SqEntries_) {
+        Submit();
+        if (SqeTail_ - __atomic_load_n(SqHead_, __ATOMIC_ACQUIRE) >= SqEntries_) {
+            throw TException() << "io_uring submission queue is full";
+        }
+    }
+
+    io_uring_sqe* sqe = &Sqes_[SqeTail_ & SqMask_];
+    SqeTail_++;
+    std::memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+void TUring::Submit(unsigned waitNr, int timeoutMs) {
+    /* publish queued entries to kernel */
+    __atomic_store_n(SqTail_, SqeTail_, __ATOMIC_RELEASE);
+
+    __kernel_timespec ts;
+    ts.tv_sec = timeoutMs / 1000;
+    ts.tv_nsec = (timeoutMs % 1000) * 1000000ll;
+
+    io_uring_getevents_arg arg;
+    std::memset(&arg, 0, sizeof(arg));
+    arg.sigmask_sz = _NSIG / 8;
+    arg.ts = timeoutMs < 0 ? 0 : reinterpret_cast<uint64_t>(&ts);
+
+    unsigned flags = IORING_ENTER_EXT_ARG;
+    if (waitNr > 0) {
+        flags |= IORING_ENTER_GETEVENTS;
+    }
+
+    while (true) {
+        unsigned toSubmit = SqeTail_ - SqeHead_;
+        if (toSubmit == 0 && waitNr == 0) {
+            return;
+        }
+
+        int res = IoUringEnter(Fd_, toSubmit, waitNr, flags, &arg, sizeof(arg));
+        if (res == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            /* on EAGAIN and EBUSY completions must be reaped before kernel accepts more */
+            if (errno == ETIME || errno == EAGAIN || errno == EBUSY) {
+                return;
+            }
+            ThrowErrno("io_uring_enter failed");
+        }
+
+        SqeHead_ += res;
+
+        if (waitNr > 0 || SqeHead_ == SqeTail_) {
+            return;
+        }
+    }
+}
+
+bool TUring::RegisterBuffers(unsigned count) {
+    io_uring_rsrc_register reg;
+    std::memset(&reg, 0, sizeof(reg));
+    reg.nr = count;
+    reg.flags = IORING_RSRC_REGISTER_SPARSE;
+
+    return IoUringRegister(Fd_, IORING_REGISTER_BUFFERS2, &reg, sizeof(reg)) == 0;
+}
+
+bool TUring::UpdateBuffer(unsigned index, const iovec& iov) {
+    io_uring_rsrc_update2 update;
+    std::memset(&update, 0, sizeof(update));
+    update.offset = index;
+    update.data = reinterpret_cast<uint64_t>(&iov);
+    update.nr = 1;
+
+    return IoUringRegister(Fd_, IORING_REGISTER_BUFFERS_UPDATE, &update, sizeof(update)) >= 0;
+}
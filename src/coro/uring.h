@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <linux/io_uring.h>
+#include <sys/uio.h>
+
+#include <util/generic.h>
+
+/*
+ * Thin wrapper around io_uring instance: submission and completion rings
+ * mapped into user space and raw io_uring_* syscalls, no liburing needed.
+ * Submission queue entries are only queued by `GetSqe`, kernel sees them
+ * on the next `Submit`, so many operations are submitted with one syscall.
+ */
+class TUring : TMoveOnly {
+public:
+    /*
+     * Creates ring with at least `entries` submission queue entries.
+     * Throws if io_uring is not supported by kernel or forbidden by seccomp.
+     */
+    TUring(unsigned entries);
+    ~TUring();
+
+    int Fd() const {
+        return Fd_;
+    }
+
+    /*
+     * Returns zeroed submission queue entry. If submission queue is full,
+     * queued entries are submitted first.
+     */
+    io_uring_sqe* GetSqe();
+
+    /*
+     * Submits all queued entries and waits for at least `waitNr` completions.
+     * @param timeoutMs -- how long to wait for completions, negative means forever.
+     */
+    void Submit(unsigned waitNr = 0, int timeoutMs = -1);
+
+    /*
+     * Calls `callback` for every available completion and consumes it.
+     * @return number of processed completions.
+     */
+    template <typename TCallback>
+    size_t ForEachCompletion(TCallback&& callback) {
+        size_t count = 0;
+        unsigned head = *CqHead_;
+        /* kernel publishes completions with release store of tail */
+        unsigned tail = __atomic_load_n(CqTail_, __ATOMIC_ACQUIRE);
+
+        while (head != tail) {
+            /* slot is copied out and released before callback, since it may submit new entries and kernel may reuse it then */
+            const io_uring_cqe cqe = Cqes_[head & CqMask_];
+            head++;
+            count++;
+            __atomic_store_n(CqHead_, head, __ATOMIC_RELEASE);
+            callback(&cqe);
+            tail = __atomic_load_n(CqTail_, __ATOMIC_ACQUIRE);
+        }
+
+        return count;
+    }
+
+    /*
+     * Registers sparse table of `count` fixed buffers, slots are filled with `UpdateBuffer`.
+     * @return false if kernel does not support it, errno is set.
+     */
+    bool RegisterBuffers(unsigned count);
+
+    /*
+     * Puts buffer `iov` to slot `index` of fixed buffers table, empty `iov` clears the slot.
+     * @return false on failure (e.g. RLIMIT_MEMLOCK is exceeded), errno is set.
+     */
+    bool UpdateBuffer(unsigned index, const iovec& iov);
+
+private:
+    void Unmap();
+
+    int Fd_ = -1;
+
+    void* SqRing_ = nullptr;
+    size_t SqRingSize_ = 0;
+    void* CqRing_ = nullptr;
+    size_t CqRingSize_ = 0;
+    io_uring_sqe* Sqes_ = nullptr;
+    size_t SqesSize_ = 0;
+
+    unsigned* SqHead_ = nullptr;
+    unsigned* SqTail_ = nullptr;
+    unsigned SqMask_ = 0;
+    unsigned SqEntries_ = 0;
+    unsigned* SqArray_ = nullptr;
+
+    unsigned* CqHead_ = nullptr;
+    unsigned* CqTail_ = nullptr;
+    unsigned CqMask_ = 0;
+    io_uring_cqe* Cqes_ = nullptr;
+
+    /* entries in [SqeHead_, SqeTail_) are queued, but not submitted yet */
+    unsigned SqeHead_ = 0;
+    unsigned SqeTail_ = 0;
+};
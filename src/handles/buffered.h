@@ -2,22 +2,31 @@
 
 #include "common.h"
 
+#include <algorithm>
+
 #include <util/generic.h>
 #include <regexp/database.h>
 #include <regexp/matchers.h>
 
 
+/*
+ * Reads from handle through buffer. Buffer is taken from reactor's pool only when handle
+ * becomes readable and is given back once everything is consumed, so idle connections
+ * hold no buffer memory.
+ */
 template <typename UnderlyingPtr>
 class TBufferedReader : public TMoveOnly {
 public:
     TBufferedReader(UnderlyingPtr handle, size_t bufferSize = TSocketBuffer::DefaultSize)
         : Handle_(std::move(handle))
-        , Buffer_(bufferSize)
-    {}
+        , BufferSize_(bufferSize)
+    {
+    }
 
     TBufferedReader(UnderlyingPtr handle, TSocketBuffer buffer)
         : Handle_(std::move(handle))
         , Buffer_(std::move(buffer))
+        , BufferSize_(Buffer_.Capacity())
     {}
 
     TResult<TMemoryRegion> Read(TReactor::TDeadline deadline = TReactor::TDeadline::max()) {
@@ -32,19 +41,19 @@ public:
     }
 
     TResult<size_t> ReadMore(TReactor::TDeadline deadline = TReactor::TDeadline::max()) {
-        if (Buffer_.Full()) {
+        if (Full()) {
             return TResult<size_t>::MakeSuccess(0);
         }
-        return Handle_->Read(Buffer_, deadline);
+        return Fill(deadline);
     }
 
     TResult<TMemoryRegion> ReadExactly(size_t size, TReactor::TDeadline deadline = TReactor::TDeadline::max()) {
-        if (size > Buffer_.Capacity()) {
+        if (size > Capacity()) {
             return TResult<TMemoryRegion>::MakeFail(-1);
         }
 
         while (Buffer_.Size() < size) {
-            TResult<size_t> res = Handle_->Read(Buffer_, deadline);
+            TResult<size_t> res = Fill(deadline);
 
             if (!res) {
                 return TResult<TMemoryRegion>::ForwardError(res);
@@ -92,16 +101,22 @@ public:
         size_t transfered = 0;
 
         if (!Buffer_.Empty()) {
-            TResult<size_t> res = to.WriteAll(Buffer_.CurrentMemoryRegion().FitSize(maxSize));
+            TResult<size_t> res = to.WriteAll(Buffer_.CurrentMemoryRegion().FitSize(maxSize), deadline);
             if (!res) {
                 return res;
             }
             transfered = res.Result();
-            Buffer_.Reset();
+            /* pipelined data after body stays in buffer */
+            if (transfered > 0) {
+                ChopBegin(transfered);
+            }
         }
 
         if (transfered < maxSize) {
+            /* connection is busy with body, so buffer is taken without waiting for readiness */
+            Attach();
             TResult<size_t> res = Handle_->TransferExactly(to, Buffer_, maxSize - transfered, deadline);
+            Detach();
 
             if (!res) {
                 return res;
@@ -113,44 +128,58 @@ public:
         return TResult<size_t>::MakeSuccess(transfered);
     }
 
-    template <typename Other>
-    TResult<size_t> TransferUntil(Other& to, size_t maxSize, TStreamRegexpMatcher& matcher, TReactor::TDeadline deadline = TReactor::TDeadline::max()) {
-        if (!Buffer_.Empty()) {
-            if (matcher.Scan(Buffer_.CurrentMemoryRegion().FitSize(maxSize))) {
-                
-            }
-        }
+    /*
+     * Forwards at most `maxSize` bytes to `to` through buffer, every piece read is passed to `scan` before it is sent.
+     * `scan` returns how many bytes of piece may be sent, transfer stops once it holds some back, they stay in buffer.
+     */
+    template <typename Other, typename Scanner>
+    TResult<size_t> TransferScanned(Other& to, size_t maxSize, Scanner&& scan, TReactor::TDeadline deadline = TReactor::TDeadline::max()) {
+        size_t transfered = 0;
 
         while (transfered < maxSize) {
-            TResult<size_t> res = Handle_->Read(Buffer_, bytesCount - transfered, deadline);
-
+            TResult<TMemoryRegion> res = Read(deadline);
             if (!res) {
-                return res;
+                return TResult<size_t>::ForwardError(res);
             }
 
-            if (res.Result() == 0) {
+            if (res.Result().Empty()) {
                 break;
             }
 
-            // TODO: check for bug
-            TMemoryRegion region = Buffer_.CurrentMemoryRegion().FitSize(maxSize - transfered);
-            if (matcher.Scan(region)) {
-                break;
+            TMemoryRegion piece = res.Result().FitSize(maxSize - transfered);
+            size_t allowed = std::min<size_t>(scan(piece), piece.Size());
+
+            if (allowed > 0) {
+                TResult<size_t> written = to.WriteAll(piece.FitSize(allowed), deadline);
+                if (!written) {
+                    return written;
+                }
+                ChopBegin(allowed);
+                transfered += allowed;
             }
 
-            res = to.WriteAll(region);
-            if (!res) {
-                return res;
+            if (allowed < piece.Size()) {
+                break;
             }
-            Buffer_.Reset();
-            transfered += res.Result();
         }
 
-        return TResult<size_t>::MakeSuccess();
+        return TResult<size_t>::MakeSuccess(transfered);
+    }
+
+    /*
+     * Forwards at most `maxSize` bytes scanning them with `matcher`, stops right before match which stopped scan,
+     * see `TStreamRegexpMatcher::ScanPrefix`. Data from the match on is left in buffer.
+     */
+    template <typename Other>
+    TResult<size_t> TransferUntil(Other& to, size_t maxSize, TStreamRegexpMatcher& matcher, TReactor::TDeadline deadline = TReactor::TDeadline::max()) {
+        return TransferScanned(to, maxSize, [&matcher](TMemoryRegion piece) {
+            return matcher.ScanPrefix(piece);
+        }, deadline);
     }
 
     void ChopBegin(size_t size) {
         Buffer_.ChopBegin(size);
+        Detach();
     }
 
     size_t BufferedSize() const {
@@ -162,7 +191,14 @@ public:
     }
 
     bool Full() const {
-        return Buffer_.Full();
+        return Buffer_.Allocated() && Buffer_.Full();
+    }
+
+    /*
+     * How many bytes can be buffered.
+     */
+    size_t Capacity() const {
+        return Buffer_.Allocated() ? Buffer_.Capacity() : BufferSize_;
     }
 
     void Finish() {
@@ -170,7 +206,39 @@ public:
     }
 
 private:
+    /*
+     * Reads more data to buffer, buffer is attached once there is something to read.
+     */
+    TResult<size_t> Fill(TReactor::TDeadline deadline) {
+        if (!Buffer_.Allocated()) {
+            TResult<int> ready = Reactor()->WaitFor(Handle_->Fd(), TReactor::EvRead, Handle_->IoDeadline(deadline));
+            if (!ready) {
+                return TResult<size_t>::ForwardError(ready);
+            }
+            Attach();
+        }
+
+        return Handle_->Read(Buffer_, deadline);
+    }
+
+    void Attach() {
+        if (!Buffer_.Allocated()) {
+            Buffer_ = TSocketBuffer(Reactor()->BufferPool(), BufferSize_);
+            Buffer_.Register(Reactor());
+        }
+    }
+
+    /*
+     * Gives drained buffer back to pool.
+     */
+    void Detach() {
+        if (Buffer_.Allocated() && Buffer_.Empty()) {
+            Buffer_ = TSocketBuffer();
+        }
+    }
+
     UnderlyingPtr Handle_;
     TSocketBuffer Buffer_;
+    size_t BufferSize_ = 0;
     bool Finished_ = false;
 };
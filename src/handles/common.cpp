@@ -1,6 +1,6 @@
 #include "common.h"
 
-#include <vector>
+#include <algorithm>
 
 #include <sys/types.h>
 #include <sys/uio.h>
@@ -30,13 +30,29 @@ void THandle::Close() {
     }
 }
 
+size_t THandle::Release() {
+    size_t fd = Fd_;
+    if (fd != InvalidFd) {
+        Fd_ = InvalidFd;
+        Reactor_->ReleaseFd(fd);
+    }
+    return fd;
+}
+
+TReactor::TDeadline THandle::IoDeadline(TReactor::TDeadline deadline) const {
+    if (IoTimeout_ == std::chrono::steady_clock::duration::zero()) {
+        return deadline;
+    }
+    return std::min(deadline, Reactor_->Now() + IoTimeout_);
+}
+
 TResult<size_t> THandle::Read(TMemoryRegion region, TReactor::TDeadline deadline) {
-    return Reactor()->Read(Fd(), region.Data(), region.Size(), deadline);
+    return Reactor()->Read(Fd(), region.Data(), region.Size(), IoDeadline(deadline));
 }
 
 TResult<size_t> THandle::Read(TSocketBuffer& to, size_t size, TReactor::TDeadline deadline) {
     size = std::min(size, to.Remaining());
-    TResult<size_t> res = Reactor()->Read(Fd(), to.End(), std::min(size, to.Remaining()), deadline);
+    TResult<size_t> res = Reactor()->ReadFixed(Fd(), to.End(), std::min(size, to.Remaining()), to.BufferIndex(), IoDeadline(deadline));
     if (res) {
         to.Advance(res.Result());
     }
@@ -44,22 +60,24 @@ TResult<size_t> THandle::Read(TSocketBuffer& to, size_t size, TReactor::TDeadlin
 }
 
 TResult<size_t> THandle::Write(TMemoryRegion region, TReactor::TDeadline deadline) {
-    return Reactor()->Write(Fd(), region.Data(), region.Size(), deadline);
+    return Reactor()->Write(Fd(), region.Data(), region.Size(), IoDeadline(deadline));
 }
 
 TResult<size_t> THandle::Write(TMemoryRegionChain& chain, TReactor::TDeadline deadline) {
-    std::list<TMemoryRegion>& regions = chain.Regions();
-
-    std::unique_ptr<iovec[]> iovecs = std::make_unique<iovec[]>(regions.size());
+    /* longer chains are written by several calls, WriteAll loops anyway */
+    iovec iovecs[MaxWriteIovecs];
 
-    size_t i = 0;
-    for (TMemoryRegion& region : regions) {
-        iovecs[i].iov_base = region.Data();
-        iovecs[i].iov_len = region.Size();
-        i++;
+    size_t count = 0;
+    for (const TMemoryRegion& region : chain) {
+        if (count == MaxWriteIovecs) {
+            break;
+        }
+        iovecs[count].iov_base = const_cast<void*>(region.Data());
+        iovecs[count].iov_len = region.Size();
+        count++;
     }
 
-    TResult<size_t> res = Reactor()->Writev(Fd(), iovecs.get(), regions.size());
+    TResult<size_t> res = Reactor()->Writev(Fd(), iovecs, count, IoDeadline(deadline));
 
     if (!res) {
         return TResult<size_t>::ForwardError(res);
@@ -102,6 +120,20 @@ TResult<size_t> THandle::WriteAll(TMemoryRegionChain& chain, TReactor::TDeadline
 TResult<size_t> THandle::TransferExactly(THandle& to, TSocketBuffer& buffer, size_t bytesCount, TReactor::TDeadline deadline) {
     ASSERT(buffer.Empty());
 
+    /* small bodies fit into buffer in one read, splicing them only costs extra syscalls */
+    if (bytesCount > buffer.Capacity() && IsSocket() && to.IsSocket()) {
+        TResult<size_t> res = SpliceExactly(to, bytesCount, deadline);
+        if (res || res.Error() != EINVAL) {
+            return res;
+        }
+    }
+
+    return CopyExactly(to, buffer, bytesCount, deadline);
+}
+
+TResult<size_t> THandle::CopyExactly(THandle& to, TSocketBuffer& buffer, size_t bytesCount, TReactor::TDeadline deadline) {
+    ASSERT(buffer.Empty());
+
     size_t transfered = 0;
 
     while (transfered < bytesCount) {
@@ -129,3 +161,42 @@ TResult<size_t> THandle::TransferExactly(THandle& to, TSocketBuffer& buffer, siz
     ASSERT(transfered == bytesCount);
     return TResult<size_t>::MakeSuccess(transfered);
 }
+
+TResult<size_t> THandle::SpliceExactly(THandle& to, size_t bytesCount, TReactor::TDeadline deadline) {
+    TPipe pipe = Reactor_->PipePool().Acquire();
+    if (!pipe) {
+        return TResult<size_t>::MakeFail(EINVAL);
+    }
+
+    size_t transfered = 0;
+
+    while (transfered < bytesCount) {
+        size_t chunk = std::min(bytesCount - transfered, pipe.Capacity());
+        TResult<size_t> res = Reactor_->SpliceToPipe(Fd(), pipe.WriteFd(), chunk, IoDeadline(deadline));
+
+        if (!res) {
+            return res;
+        }
+
+        if (res.Result() == 0) {
+            return TResult<size_t>::MakeSuccess(0);
+        }
+
+        size_t inPipe = res.Result();
+        while (inPipe > 0) {
+            res = Reactor_->SpliceFromPipe(pipe.ReadFd(), to.Fd(), inPipe, to.IoDeadline(deadline));
+
+            if (!res) {
+                /* data left in pipe belongs to this transfer, pipe cannot be reused */
+                pipe.Discard();
+                return res;
+            }
+
+            inPipe -= res.Result();
+            transfered += res.Result();
+        }
+    }
+
+    ASSERT(transfered == bytesCount);
+    return TResult<size_t>::MakeSuccess(transfered);
+}
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <algorithm>
+#include <chrono>
 #include <functional>
 #include <cstring>
+#include <climits>
 #include <memory>
 #include <netinet/ip.h>
 #include <fcntl.h>
@@ -21,6 +24,9 @@ protected:
     TReactor* Reactor_ = nullptr;
 
 public:
+    /* iovecs passed to one writev, they are kept on stack */
+    static constexpr size_t MaxWriteIovecs = std::min<size_t>(64, IOV_MAX);
+
     THandle(TReactor* reactor, size_t fd);
 
     virtual ~THandle() {
@@ -62,7 +68,8 @@ public:
     TResult<size_t> Write(TMemoryRegion region, TReactor::TDeadline deadline = TReactor::TDeadline::max());
 
     /*
-     * Performs single write on head of `chain`.
+     * Performs single write on head of `chain`, at most `MaxWriteIovecs` regions are written.
+     * Written bytes are dropped from `chain`.
      * @return how many bytes were written.
      */
     TResult<size_t> Write(TMemoryRegionChain& chain, TReactor::TDeadline deadline = TReactor::TDeadline::max());
@@ -73,12 +80,56 @@ public:
 
     /*
      * Transfers exactly `size` bytes to other handle `to` through empty buffer `buffer`.
+     * Transfers larger than buffer between sockets are spliced, so payload is not copied to user space.
      * @return how many bytes were transfered.
      */
     TResult<size_t> TransferExactly(THandle& to, TSocketBuffer& buffer, size_t size, TReactor::TDeadline deadline = TReactor::TDeadline::max());
 
+    /*
+     * Same as `TransferExactly`, but payload always goes through `buffer`.
+     */
+    TResult<size_t> CopyExactly(THandle& to, TSocketBuffer& buffer, size_t size, TReactor::TDeadline deadline = TReactor::TDeadline::max());
+
+    /*
+     * Same as `TransferExactly`, but payload always goes through pipe from reactor's pipe pool.
+     * Fails with EINVAL if nothing was transfered because handles do not support splicing.
+     */
+    TResult<size_t> SpliceExactly(THandle& to, size_t size, TReactor::TDeadline deadline = TReactor::TDeadline::max());
+
+    /*
+     * Every read, write or splice of handle times out, if it makes no progress within `timeout`,
+     * however far deadline of the whole operation is. So it limits inactivity, not duration of transfer.
+     * Zero turns it off.
+     */
+    void SetIoTimeout(std::chrono::steady_clock::duration timeout) {
+        IoTimeout_ = timeout;
+    }
+
+    std::chrono::steady_clock::duration IoTimeout() const {
+        return IoTimeout_;
+    }
+
+    /*
+     * Deadline of single wait for readiness or completion of operation which must end by `deadline`.
+     */
+    TReactor::TDeadline IoDeadline(TReactor::TDeadline deadline) const;
+
+    /*
+     * Whether handle is a socket, so it can be spliced.
+     */
+    virtual bool IsSocket() const {
+        return false;
+    }
+
     virtual void Close();
 
+    /*
+     * Gives fd up to caller: it is released from reactor and is not closed by handle anymore.
+     * @return fd or `InvalidFd` if handle is closed.
+     */
+    size_t Release();
+
 private:
     size_t Fd_ = InvalidFd;
+    std::chrono::steady_clock::duration IoTimeout_ = std::chrono::steady_clock::duration::zero();
 };
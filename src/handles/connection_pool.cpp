@@ -0,0 +1,159 @@
+#include "connection_pool.h"
+
+#include <sys/socket.h>
+
+/* how often idle connections of all backends are checked for timeout */
+static constexpr std::chrono::seconds SweepInterval = std::chrono::seconds(1);
+
+TResult<TTcpHandlePtr> TConnectionPool::Acquire(const TSocketAddress& addr, TReactor::TDeadline deadline, bool* reused) {
+    Sweep();
+
+    TBackend& backend = Backends_[addr];
+    EvictExpired(backend);
+
+    while (!backend.Idle.empty()) {
+        TTcpHandlePtr handle = std::move(backend.Idle.back().Handle);
+        backend.Idle.pop_back();
+        Size_--;
+
+        if (!Alive(*handle)) {
+            Evicted_++;
+            continue;
+        }
+
+        Hits_++;
+        backend.Active.emplace_back(handle);
+        if (reused) {
+            *reused = true;
+        }
+        return TResult<TTcpHandlePtr>::MakeSuccess(std::move(handle));
+    }
+
+    if (reused) {
+        *reused = false;
+    }
+    return Connect(addr, deadline);
+}
+
+TResult<TTcpHandlePtr> TConnectionPool::Connect(const TSocketAddress& addr, TReactor::TDeadline deadline) {
+    TBackend& backend = Backends_[addr];
+
+    if (MaxTotal_ > 0 && ActiveCount(backend) >= MaxTotal_) {
+        Rejected_++;
+        return TResult<TTcpHandlePtr>::MakeFail(EBUSY);
+    }
+
+    Misses_++;
+    TTcpHandlePtr handle = TTcpHandle::Create(addr.Ipv6());
+    TResult<bool> connected = handle->Connect(addr, deadline);
+    if (!connected) {
+        return TResult<TTcpHandlePtr>::ForwardError(connected);
+    }
+
+    backend.Active.emplace_back(handle);
+    return TResult<TTcpHandlePtr>::MakeSuccess(std::move(handle));
+}
+
+void TConnectionPool::Release(TTcpHandlePtr handle) {
+    const TSocketAddress& addr = handle->PeerAddress();
+    if (!addr.Ipv4() && !addr.Ipv6()) {
+        /* handle was never connected */
+        handle->Close();
+        return;
+    }
+
+    auto it = Backends_.find(addr);
+    if (it == Backends_.end()) {
+        handle->Close();
+        return;
+    }
+
+    TBackend& backend = it->second;
+    for (size_t i = 0; i < backend.Active.size(); i++) {
+        if (backend.Active[i].lock() == handle) {
+            backend.Active[i] = std::move(backend.Active.back());
+            backend.Active.pop_back();
+            break;
+        }
+    }
+
+    EvictExpired(backend);
+
+    if (!handle->Active() || !Alive(*handle) || backend.Idle.size() >= MaxIdle_) {
+        handle->Close();
+        return;
+    }
+
+    backend.Idle.push_back({ std::move(handle), Reactor()->Now() });
+    Size_++;
+}
+
+void TConnectionPool::SetLimits(size_t maxIdle, size_t maxTotal) {
+    MaxIdle_ = maxIdle;
+    MaxTotal_ = maxTotal;
+
+    for (auto& [addr, backend] : Backends_) {
+        while (backend.Idle.size() > MaxIdle_) {
+            backend.Idle.pop_front();
+            Size_--;
+        }
+    }
+}
+
+void TConnectionPool::Clear() {
+    for (auto& [addr, backend] : Backends_) {
+        backend.Idle.clear();
+    }
+    Size_ = 0;
+}
+
+bool TConnectionPool::Alive(const TTcpHandle& handle) {
+    if (!handle.Active()) {
+        return false;
+    }
+
+    /* idle connection must have nothing to read: data there is garbage, EOF means backend closed it */
+    char byte;
+    ssize_t res = ::recv(handle.Fd(), &byte, sizeof(byte), MSG_PEEK | MSG_DONTWAIT);
+    return res == -1 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+void TConnectionPool::EvictExpired(TBackend& backend) {
+    TReactor::TDeadline now = Reactor()->Now();
+    while (!backend.Idle.empty() && backend.Idle.front().ReleasedAt + IdleTimeout_ <= now) {
+        backend.Idle.pop_front();
+        Size_--;
+        Evicted_++;
+    }
+}
+
+void TConnectionPool::Sweep() {
+    TReactor::TDeadline now = Reactor()->Now();
+    if (now < NextSweep_) {
+        return;
+    }
+    NextSweep_ = now + SweepInterval;
+
+    for (auto it = Backends_.begin(); it != Backends_.end();) {
+        EvictExpired(it->second);
+        if (it->second.Idle.empty() && ActiveCount(it->second) == 0) {
+            it = Backends_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+size_t TConnectionPool::ActiveCount(TBackend& backend) {
+    std::vector<std::weak_ptr<TTcpHandle>>& active = backend.Active;
+    for (size_t i = 0; i < active.size();) {
+        TTcpHandlePtr handle = active[i].lock();
+        if (!handle || !handle->Active()) {
+            active[i] = std::move(active.back());
+            active.pop_back();
+        } else {
+            i++;
+        }
+    }
+    return active.size();
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <handles/tcp.h>
+
+/*
+ * Keeps idle connections to backends, so handlers do not pay for TCP handshake on every request.
+ * Pool belongs to one reactor, connections are keyed by backend address.
+ *
+ * Connection is taken with `Acquire` and given back with `Release` once exchange on it is over
+ * and nothing is left unread. Released connections which stay idle longer than idle timeout
+ * are closed. On checkout connection is probed without blocking, so connections closed
+ * by backend meanwhile are not handed out.
+ */
+class TConnectionPool : TMoveOnly {
+public:
+    enum : size_t {
+        DefaultMaxIdle = 32,
+        /* 0 means that number of connections is not limited */
+        DefaultMaxTotal = 0,
+    };
+
+    static constexpr std::chrono::seconds DefaultIdleTimeout = std::chrono::seconds(60);
+
+    TConnectionPool() = default;
+
+    /*
+     * Returns idle connection to `addr` or connects a new one.
+     * Fails with EBUSY if `addr` has max total connections open already.
+     * @param reused -- may be null, set to whether idle connection was handed out.
+     */
+    TResult<TTcpHandlePtr> Acquire(const TSocketAddress& addr, TReactor::TDeadline deadline = TReactor::TDeadline::max(), bool* reused = nullptr);
+
+    /*
+     * Connects a new connection to `addr` even if idle ones are kept, e.g. to repeat request
+     * which failed on idle connection closed by backend meanwhile. It is handed out like one of `Acquire`.
+     */
+    TResult<TTcpHandlePtr> Connect(const TSocketAddress& addr, TReactor::TDeadline deadline = TReactor::TDeadline::max());
+
+    /*
+     * Gives connection taken with `Acquire` back to pool. Connection with data pending on it,
+     * closed one or one beyond max idle limit is closed.
+     */
+    void Release(TTcpHandlePtr handle);
+
+    /*
+     * @param maxIdle -- how many idle connections are kept per backend.
+     * @param maxTotal -- how many connections per backend may be open at once, including handed out ones.
+     */
+    void SetLimits(size_t maxIdle, size_t maxTotal);
+
+    void SetIdleTimeout(std::chrono::steady_clock::duration timeout) {
+        IdleTimeout_ = timeout;
+    }
+
+    /*
+     * Closes all idle connections.
+     */
+    void Clear();
+
+    /* idle connections to all backends */
+    size_t Size() const {
+        return Size_;
+    }
+
+    /* checkouts served with idle connection */
+    size_t Hits() const {
+        return Hits_;
+    }
+
+    /* checkouts which had to connect */
+    size_t Misses() const {
+        return Misses_;
+    }
+
+    /* idle connections closed because of timeout or because backend closed them */
+    size_t Evicted() const {
+        return Evicted_;
+    }
+
+    /* checkouts failed because of max total limit */
+    size_t Rejected() const {
+        return Rejected_;
+    }
+
+private:
+    struct TIdleConnection {
+        TTcpHandlePtr Handle;
+        TReactor::TDeadline ReleasedAt;
+    };
+
+    struct TBackend {
+        /* the most recently released connection is at the back */
+        std::deque<TIdleConnection> Idle;
+        /* handed out connections, ones closed by their users are dropped lazily */
+        std::vector<std::weak_ptr<TTcpHandle>> Active;
+    };
+
+    /*
+     * Whether idle connection may be reused: it is open and backend sent nothing on it.
+     */
+    static bool Alive(const TTcpHandle& handle);
+
+    void EvictExpired(TBackend& backend);
+    void Sweep();
+    size_t ActiveCount(TBackend& backend);
+
+    std::unordered_map<TSocketAddress, TBackend> Backends_;
+    TReactor::TDeadline NextSweep_ = TReactor::TDeadline::min();
+
+    size_t MaxIdle_ = DefaultMaxIdle;
+    size_t MaxTotal_ = DefaultMaxTotal;
+    std::chrono::steady_clock::duration IdleTimeout_ = DefaultIdleTimeout;
+
+    size_t Size_ = 0;
+    size_t Hits_ = 0;
+    size_t Misses_ = 0;
+    size_t Evicted_ = 0;
+    size_t Rejected_ = 0;
+};
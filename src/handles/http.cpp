@@ -1,6 +1,8 @@
 #include "http.h"
 
-#include <sstream>
+#include <algorithm>
+#include <charconv>
+#include <limits>
 
 #include <picohttpparser/picohttpparser.h>
 
@@ -10,7 +12,151 @@ enum {
 
 static std::string CRLF = "\r\n";
 
+/*
+ * Copies message head of `headSize` bytes out of connection buffer and makes parsed fields point into the copy.
+ */
+static THttpHeaders ParseHeaders(TMemoryRegion region, size_t headSize, const phr_header* headers, size_t numHeaders) {
+    const char* data = region.DataAs<const char*>();
+    std::shared_ptr<const std::string> head = std::make_shared<const std::string>(data, headSize);
+
+    auto rebase = [&head, data](const char* ptr, size_t len) {
+        /* continuation lines of folded fields have no name */
+        return ptr ? std::string_view(head->data() + (ptr - data), len) : std::string_view();
+    };
+
+    THttpHeaders result(head);
+    for (size_t i = 0; i < numHeaders; i++) {
+        result.AddParsed(rebase(headers[i].name, headers[i].name_len), rebase(headers[i].value, headers[i].value_len));
+    }
+    return result;
+}
+
+/*
+ * Parses Content-Length fields, `length` is left empty if there are none.
+ * @return false if value is not a number or fields disagree.
+ */
+static bool ParseContentLength(const THttpMessage& message, std::optional<size_t>& length) {
+    length.reset();
+    for (const THttpHeaders::THeader& header : message.Headers) {
+        if (!THttpHeaders::NameEqual(header.Name, "Content-Length")) {
+            continue;
+        }
+
+        size_t size = 0;
+        const char* end = header.Value.data() + header.Value.size();
+        std::from_chars_result res = std::from_chars(header.Value.data(), end, size);
+        if (res.ec != std::errc() || res.ptr != end) {
+            return false;
+        }
+        if (length && *length != size) {
+            return false;
+        }
+        length = size;
+    }
+    return true;
+}
+
+/*
+ * Value of Content-Length, if there is a valid one.
+ */
+static std::optional<size_t> ContentLength(const THttpMessage& message) {
+    std::optional<size_t> length;
+    if (!ParseContentLength(message, length)) {
+        return std::nullopt;
+    }
+    return length;
+}
+
+/*
+ * Finds out whether chunked is the last transfer coding of all Transfer-Encoding fields together,
+ * `chunked` is left empty if there are none.
+ * @return false if chunked is applied before the last coding or a field lists no codings.
+ */
+static bool ParseTransferCodings(const THttpMessage& message, std::optional<bool>& chunked) {
+    chunked.reset();
+    for (const THttpHeaders::THeader& header : message.Headers) {
+        if (!THttpHeaders::NameEqual(header.Name, "Transfer-Encoding")) {
+            continue;
+        }
+
+        bool empty = true;
+        std::string_view value = header.Value;
+        while (!value.empty()) {
+            size_t comma = value.find(',');
+            std::string_view coding = value.substr(0, std::min(comma, value.find(';')));
+            value = comma == std::string_view::npos ? std::string_view() : value.substr(comma + 1);
+
+            size_t begin = coding.find_first_not_of(" \t");
+            if (begin == std::string_view::npos) {
+                continue;
+            }
+            if (chunked.value_or(false)) {
+                return false;
+            }
+            size_t end = coding.find_last_not_of(" \t");
+            chunked = THttpHeaders::NameEqual(coding.substr(begin, end - begin + 1), "chunked");
+            empty = false;
+        }
+        if (empty) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Whether length of body is unambiguous. Otherwise peers may disagree where the next message starts,
+ * so request could be smuggled past proxy. Body of request must be chunked, if it has transfer codings,
+ * as only response may be delimited by close.
+ */
+static bool ValidFraming(const THttpMessage& message, bool request) {
+    std::optional<size_t> length;
+    std::optional<bool> chunked;
+    if (!ParseContentLength(message, length) || !ParseTransferCodings(message, chunked)) {
+        return false;
+    }
+    if (length && chunked) {
+        return false;
+    }
+    return !request || chunked.value_or(true);
+}
+
+/*
+ * Whether comma separated list `value` of header field contains `token`.
+ */
+static bool HasToken(std::string_view value, std::string_view token) {
+    while (!value.empty()) {
+        size_t comma = value.find(',');
+        std::string_view item = value.substr(0, comma);
+        value = comma == std::string_view::npos ? std::string_view() : value.substr(comma + 1);
+
+        size_t begin = item.find_first_not_of(" \t");
+        size_t end = item.find_last_not_of(" \t");
+        if (begin != std::string_view::npos && THttpHeaders::NameEqual(item.substr(begin, end - begin + 1), token)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Whether response never has body, whatever its header fields say.
+ */
+static bool Bodyless(const THttpResponse& response) {
+    return response.Status / 100 == 1 || response.Status == 204 || response.Status == 304;
+}
+
+/*
+ * Whether body of message is chunked, i.e. chunked is the last transfer coding.
+ */
+static bool Chunked(const THttpMessage& message) {
+    std::optional<bool> chunked;
+    return ParseTransferCodings(message, chunked) && chunked.value_or(false);
+}
+
 TResult<THttpRequest> THttpHandle::ReadRequest(TReactor::TDeadline deadline) {
+    ConsumeReadBody();
+
     TResult<THttpRequest> result;
     size_t prevBufLen = 0;
 
@@ -39,13 +185,7 @@ TResult<THttpRequest> THttpHandle::ReadRequest(TReactor::TDeadline deadline) {
             request.Method = std::string(method, methodLen);
             request.Url = std::string(path, pathLen);
             request.MinorVersion = minorVersion;
-            request.Headers.reserve(numHeaders);
-            for (size_t i = 0; i < numHeaders; i++) {
-                request.Headers.emplace(
-                    std::string(headers[i].name, headers[i].name_len),
-                    std::string(headers[i].value, headers[i].value_len)
-                );
-            }
+            request.Headers = ParseHeaders(region, res, headers, numHeaders);
             Reader_.ChopBegin(res);
             result = TResult<THttpRequest>::MakeSuccess(std::move(request));
             return true;
@@ -59,10 +199,28 @@ TResult<THttpRequest> THttpHandle::ReadRequest(TReactor::TDeadline deadline) {
         return false;
     }, deadline);
 
+    if (!res) {
+        /* nothing was parsed */
+        result = TResult<THttpRequest>::ForwardError(res);
+    }
+
+    if (result && !ValidFraming(result.Result(), true)) {
+        result = TResult<THttpRequest>::MakeFail(-2);
+    }
+
+    if (result) {
+        StartBody(result.Result());
+        KeepAlive_ = KeepAlive_ && Persistent(result.Result());
+    } else {
+        KeepAlive_ = false;
+    }
+
     return result;
 }
 
 TResult<THttpResponse> THttpHandle::ReadResponse(TReactor::TDeadline deadline) {
+    ConsumeReadBody();
+
     TResult<THttpResponse> result;
     size_t prevBufLen = 0;
 
@@ -90,13 +248,7 @@ TResult<THttpResponse> THttpHandle::ReadResponse(TReactor::TDeadline deadline) {
             response.Status = status;
             response.Reason = std::string(reason, reasonLen);
             response.MinorVersion = minorVersion;
-            response.Headers.reserve(numHeaders);
-            for (size_t i = 0; i < numHeaders; i++) {
-                response.Headers.emplace(
-                    std::string(headers[i].name, headers[i].name_len),
-                    std::string(headers[i].value, headers[i].value_len)
-                );
-            }
+            response.Headers = ParseHeaders(region, ret, headers, numHeaders);
             Reader_.ChopBegin(ret);
             result = TResult<THttpResponse>::MakeSuccess(std::move(response));
             return true;
@@ -110,88 +262,497 @@ TResult<THttpResponse> THttpHandle::ReadResponse(TReactor::TDeadline deadline) {
         return false;
     }, deadline);
 
+    if (!res) {
+        result = TResult<THttpResponse>::ForwardError(res);
+    }
+
+    if (result && !ValidFraming(result.Result(), false)) {
+        result = TResult<THttpResponse>::MakeFail(-2);
+    }
+
+    if (result) {
+        StartBody(result.Result());
+        const THttpResponse& response = result.Result();
+        if (Bodyless(response)) {
+            /* framing fields of such response describe body it would have, not one which follows */
+            UnreadBody_ = 0;
+            UnreadChunked_ = false;
+        }
+        UnreadUntilClose_ = !Bodyless(response) && !UnreadChunked_ && !response.Headers.Has("Content-Length");
+        KeepAlive_ = KeepAlive_ && Persistent(response);
+    } else {
+        KeepAlive_ = false;
+    }
+
     return result;
 }
 
-static std::string MergeHeaders(const THeaders& headers) {
-    std::string result;
+TResult<std::optional<THttpRequest>> THttpHandle::ReadNextRequest(TReactor::TDeadline deadline) {
+    using TNextRequest = std::optional<THttpRequest>;
+
+    if (!KeepAlive_) {
+        return TResult<TNextRequest>::MakeSuccess(std::nullopt);
+    }
+
+    TResult<size_t> skipped = SkipBody(deadline);
+    if (!skipped) {
+        return TResult<TNextRequest>::ForwardError(skipped);
+    }
+
+    TResult<THttpRequest> res = ReadRequest(deadline);
+    if (!res) {
+        /* client closed idle connection or kept silent for too long, which is the usual end of it */
+        if (Reader_.BufferedSize() == 0) {
+            return TResult<TNextRequest>::MakeSuccess(std::nullopt);
+        }
+        return TResult<TNextRequest>::ForwardError(res);
+    }
 
-    size_t resultingSize = 0;
-    for (const auto& header : headers) {
-        resultingSize += header.first.size();
+    return TResult<TNextRequest>::MakeSuccess(std::move(res.Result()));
+}
+
+bool THttpHandle::Persistent(const THttpMessage& message) {
+    /* body with other transfer codings lasts until connection is closed */
+    if (message.Headers.Has("Transfer-Encoding") && !Chunked(message)) {
+        return false;
+    }
+
+    std::optional<std::string_view> connection = message.Headers.Get("Connection");
+    if (message.MinorVersion >= 1) {
+        return !connection || !HasToken(*connection, "close");
+    }
+    return connection && HasToken(*connection, "keep-alive");
+}
+
+bool THttpHandle::Persistent(const THttpResponse& response) {
+    /* otherwise body lasts until connection is closed */
+    bool delimited = Bodyless(response) || Chunked(response) || response.Headers.Has("Content-Length");
+    return delimited && Persistent(static_cast<const THttpMessage&>(response));
+}
+
+/*
+ * Appends header fields and empty line ending message head to `result`.
+ */
+static void AppendHeaders(std::string& result, const THttpHeaders& headers) {
+    size_t resultingSize = result.size();
+    for (const THttpHeaders::THeader& header : headers) {
+        resultingSize += header.Name.size();
         resultingSize += 2; // ": "
-        resultingSize += header.second.size();
+        resultingSize += header.Value.size();
         resultingSize += 2; // "\r\n"
     }
     resultingSize += 2; // "\r\n"
 
     result.reserve(resultingSize);
 
-    for (const auto& header : headers) {
-        result += fmt::format("{}: {}\r\n", header.first, header.second);
+    for (const THttpHeaders::THeader& header : headers) {
+        result.append(header.Name);
+        result.append(": ");
+        result.append(header.Value);
+        result.append(CRLF);
     }
 
-    result += "\r\n";
-
-    return result;
+    result.append(CRLF);
 }
 
 TResult<size_t> THttpHandle::WriteRequest(const THttpRequest& request, TReactor::TDeadline deadline) {
-    TMemoryRegionChain chain;
-
-    std::string requestLine = fmt::format(
+    /* whole head is written from one string */
+    std::string head = fmt::format(
         "{} {} HTTP/1.{}\r\n",
         request.Method,
         request.Url,
         request.MinorVersion
     );
-    chain.Add(requestLine);
-
-    std::string headers = MergeHeaders(request.Headers);
-    chain.Add(headers);
+    AppendHeaders(head, request.Headers);
+    KeepAlive_ = KeepAlive_ && Persistent(request);
 
-    return Handle_->WriteAll(chain);
+    return Handle_->WriteAll(TMemoryRegion(head), deadline);
 }
 
 TResult<size_t> THttpHandle::WriteResponse(const THttpResponse& response, TReactor::TDeadline deadline) {
-    TMemoryRegionChain chain;
-
-    std::string responseLine = fmt::format(
+    std::string head = fmt::format(
         "HTTP/1.{} {} {}\r\n",
         response.MinorVersion,
         response.Status,
         response.Reason
     );
-    chain.Add(responseLine);
-
-    std::string headers = MergeHeaders(response.Headers);
-    chain.Add(headers);
+    AppendHeaders(head, response.Headers);
+    KeepAlive_ = KeepAlive_ && Persistent(response);
 
-    return Handle_->WriteAll(chain);
+    return Handle_->WriteAll(TMemoryRegion(head), deadline);
 }
 
 TResult<size_t> THttpHandle::TransferBody(THttpHandle& other, const THttpMessage& message, TReactor::TDeadline deadline) {
-    auto it = message.Headers.find("Content-Length");
+    return TransferBody(other, message, TBodyInspector(), deadline);
+}
 
-    if (it != message.Headers.end()) {
-        std::stringstream ss(it->second);
-        size_t size = 0;
-        ss >> size;
-        return Reader_.TransferExactly(*other.Handle_, size, deadline);
+TResult<size_t> THttpHandle::TransferBody(THttpHandle& other, const THttpMessage& message, const TBodyInspector& inspector, TReactor::TDeadline deadline) {
+    if (!inspector) {
+        return TransferScannedBody(other, message, TBodyScanner(), deadline);
+    }
+
+    return TransferScannedBody(other, message, [&inspector](TMemoryRegion piece) -> size_t {
+        return inspector(piece) ? piece.Size() : 0;
+    }, deadline);
+}
+
+TResult<size_t> THttpHandle::TransferBody(THttpHandle& other, const THttpMessage& message, TStreamRegexpMatcher& matcher, TReactor::TDeadline deadline) {
+    return TransferScannedBody(other, message, [&matcher](TMemoryRegion piece) {
+        return matcher.ScanPrefix(piece);
+    }, deadline);
+}
+
+TResult<size_t> THttpHandle::TransferScannedBody(THttpHandle& other, const THttpMessage& message, const TBodyScanner& scanner, TReactor::TDeadline deadline) {
+    return TransferScannedBody(other, message, scanner, TBodyFinisher(), deadline);
+}
+
+TResult<size_t> THttpHandle::TransferScannedBody(THttpHandle& other, const THttpMessage& message, const TBodyScanner& scanner, const TBodyFinisher& finish, TReactor::TDeadline deadline) {
+    ConsumeReadBody();
+
+    const TBodyFinisher* finisher = finish ? &finish : nullptr;
+    if (Chunked(message)) {
+        TResult<size_t> res = ForwardChunked(&other, scanner ? &scanner : nullptr, finisher, deadline);
+        if (!res) {
+            KeepAlive_ = false;
+        }
+        UnreadChunked_ = false;
+        return res;
+    }
+
+    if (std::optional<size_t> size = ContentLength(message)) {
+        TResult<size_t> res = scanner || finisher
+            ? ScanExactly(other, *size, scanner, finisher, deadline)
+            : Reader_.TransferExactly(*other.Handle_, *size, deadline);
+        if (!res || res.Result() != *size) {
+            KeepAlive_ = false;
+        }
+        UnreadBody_ = 0;
+        return res;
+    }
+
+    if (message.Headers.Has("Content-Length")) {
+        KeepAlive_ = false;
+        return TResult<size_t>::MakeFail(-2);
+    }
+
+    if (UnreadUntilClose_) {
+        /* body of response lasts until connection is closed, so it cannot be reused */
+        UnreadUntilClose_ = false;
+        KeepAlive_ = false;
+        size_t size = std::numeric_limits<size_t>::max();
+        if (scanner || finisher) {
+            return ScanExactly(other, size, scanner, finisher, deadline);
+        }
+        return Reader_.TransferScanned(*other.Handle_, size, [](TMemoryRegion piece) {
+            return piece.Size();
+        }, deadline);
     }
 
     return TResult<size_t>::MakeSuccess(0);
 }
 
+TResult<size_t> THttpHandle::ScanExactly(THttpHandle& other, size_t size, const TBodyScanner& scanner, const TBodyFinisher* finish, TReactor::TDeadline deadline) {
+    bool stopped = false;
+    bool finished = false;
+    size_t scanned = 0;
+    TResult<size_t> res = Reader_.TransferScanned(*other.Handle_, size, [&](TMemoryRegion piece) {
+        size_t allowed = scanner ? std::min(scanner(piece), piece.Size()) : piece.Size();
+        /* pieces are cut at `size`, so the last one ends exactly there */
+        if (finish && allowed == piece.Size() && scanned + allowed == size) {
+            finished = true;
+            if (!(*finish)()) {
+                allowed = 0;
+            }
+        }
+        stopped = allowed < piece.Size();
+        scanned += allowed;
+        return allowed;
+    }, deadline);
+
+    /* empty body and body delimited by close have no last piece to hold back */
+    if (res && !stopped && finish && !finished && (res.Result() == size || size == std::numeric_limits<size_t>::max())) {
+        stopped = !(*finish)();
+    }
+
+    if (res && stopped) {
+        return TResult<size_t>::MakeFail(ECONNABORTED);
+    }
+    return res;
+}
+
 TResult<TMemoryRegion> THttpHandle::ReadBody(const THttpMessage& message, TReactor::TDeadline deadline) {
-    auto it = message.Headers.find("Content-Length");
+    ConsumeReadBody();
 
-    if (it != message.Headers.end()) {
-        std::stringstream ss(it->second);
-        size_t size = 0;
-        ss >> size;
-        return Reader_.ReadExactly(size, deadline);
+    if (Chunked(message)) {
+        TResult<TMemoryRegion> res = ReadChunked(deadline);
+        if (!res) {
+            KeepAlive_ = false;
+        }
+        UnreadChunked_ = false;
+        return res;
+    }
+
+    if (std::optional<size_t> size = ContentLength(message)) {
+        TResult<TMemoryRegion> res = Reader_.ReadExactly(*size, deadline);
+        if (!res) {
+            KeepAlive_ = false;
+            return res;
+        }
+        /* returned region stays in buffer until the next read */
+        ReadBody_ = *size;
+        UnreadBody_ = 0;
+        return res;
+    }
+
+    if (message.Headers.Has("Content-Length")) {
+        KeepAlive_ = false;
+        return TResult<TMemoryRegion>::MakeFail(-2);
+    }
+
+    if (UnreadUntilClose_) {
+        UnreadUntilClose_ = false;
+        KeepAlive_ = false;
+        return ReadUntilClose(deadline);
     }
 
     return TResult<TMemoryRegion>::MakeSuccess(TMemoryRegion(nullptr, 0));
 }
+
+TResult<TMemoryRegion> THttpHandle::ReadUntilClose(TReactor::TDeadline deadline) {
+    while (true) {
+        if (Reader_.Full()) {
+            return TResult<TMemoryRegion>::MakeFail(-1);
+        }
+
+        TResult<size_t> res = Reader_.ReadMore(deadline);
+        if (!res) {
+            return TResult<TMemoryRegion>::ForwardError(res);
+        }
+
+        if (res.Result() == 0) {
+            break;
+        }
+    }
+
+    ReadBody_ = Reader_.BufferedSize();
+    return TResult<TMemoryRegion>::MakeSuccess(Reader_.CurrentMemoryRegion());
+}
+
+TResult<size_t> THttpHandle::ForwardChunked(THttpHandle* other, const TBodyScanner* scanner, const TBodyFinisher* finish, TReactor::TDeadline deadline) {
+    phr_chunked_decoder decoder = {};
+    size_t transfered = 0;
+
+    while (true) {
+        TResult<TMemoryRegion> res = Reader_.Read(deadline);
+        if (!res) {
+            return TResult<size_t>::ForwardError(res);
+        }
+
+        TMemoryRegion region = res.Result();
+        if (region.Empty()) {
+            return TResult<size_t>::MakeFail(-2);
+        }
+
+        /* chunk headers are cut out in place, so the first `size` bytes of region are payload */
+        char* data = region.DataAs<char*>();
+        size_t size = region.Size();
+        ssize_t ret = phr_decode_chunked(&decoder, data, &size);
+        if (ret == -1) {
+            return TResult<size_t>::MakeFail(-2);
+        }
+
+        size_t allowed = size;
+        if (scanner && size > 0) {
+            allowed = std::min((*scanner)(TMemoryRegion(data, size)), size);
+        }
+        bool stopped = allowed < size;
+
+        /* payload of region which ends body goes out only with consent, so the last chunk is not sent without it */
+        if (finish && !stopped && ret != -2 && !(*finish)()) {
+            allowed = 0;
+            stopped = true;
+        }
+
+        if (other && allowed > 0) {
+            /* each piece of payload goes out as one chunk as soon as it is read */
+            char chunkHeader[32];
+            int chunkHeaderSize = ::snprintf(chunkHeader, sizeof(chunkHeader), "%zx\r\n", allowed);
+            TMemoryRegionChain chain = {
+                TMemoryRegion(chunkHeader, chunkHeaderSize),
+                TMemoryRegion(data, allowed),
+                TMemoryRegion(CRLF),
+            };
+            TResult<size_t> written = other->Handle_->WriteAll(chain, deadline);
+            if (!written) {
+                return written;
+            }
+        }
+        transfered += allowed;
+
+        if (stopped) {
+            return TResult<size_t>::MakeFail(ECONNABORTED);
+        }
+
+        if (ret == -2) {
+            Reader_.ChopBegin(region.Size());
+            continue;
+        }
+
+        /* decoder leaves unparsed rest (trailer and pipelined messages) right after payload, it is moved to the end of buffer */
+        size_t rest = ret;
+        ::memmove(data + region.Size() - rest, data + size, rest);
+        if (region.Size() > rest) {
+            Reader_.ChopBegin(region.Size() - rest);
+        }
+        break;
+    }
+
+    TResult<size_t> trailer = ReadTrailer(0, deadline);
+    if (!trailer) {
+        return trailer;
+    }
+
+    if (other) {
+        static const std::string lastChunk = "0\r\n";
+        TMemoryRegionChain chain = {
+            TMemoryRegion(lastChunk),
+            Reader_.CurrentMemoryRegion().FitSize(trailer.Result()),
+        };
+        TResult<size_t> written = other->Handle_->WriteAll(chain, deadline);
+        if (!written) {
+            return written;
+        }
+    }
+    Reader_.ChopBegin(trailer.Result());
+
+    return TResult<size_t>::MakeSuccess(transfered);
+}
+
+TResult<TMemoryRegion> THttpHandle::ReadChunked(TReactor::TDeadline deadline) {
+    phr_chunked_decoder decoder = {};
+    /* decoded payload is accumulated at the beginning of buffer */
+    size_t decoded = 0;
+
+    while (true) {
+        TMemoryRegion region = Reader_.CurrentMemoryRegion();
+
+        if (region.Size() > decoded) {
+            char* data = region.DataAs<char*>();
+            size_t size = region.Size() - decoded;
+            ssize_t ret = phr_decode_chunked(&decoder, data + decoded, &size);
+            if (ret == -1) {
+                return TResult<TMemoryRegion>::MakeFail(-2);
+            }
+
+            /* payload and unparsed rest are followed by stale bytes of cut out chunk headers, so they are moved to the end */
+            size_t keep = decoded + size + (ret >= 0 ? ret : 0);
+            size_t stale = region.Size() - keep;
+            if (stale > 0) {
+                ::memmove(data + stale, data, keep);
+                Reader_.ChopBegin(stale);
+            }
+            decoded += size;
+
+            if (ret >= 0) {
+                break;
+            }
+        }
+
+        if (Reader_.Full()) {
+            return TResult<TMemoryRegion>::MakeFail(-1);
+        }
+
+        TResult<size_t> res = Reader_.ReadMore(deadline);
+        if (!res) {
+            return TResult<TMemoryRegion>::ForwardError(res);
+        }
+
+        if (res.Result() == 0) {
+            return TResult<TMemoryRegion>::MakeFail(-2);
+        }
+    }
+
+    TResult<size_t> trailer = ReadTrailer(decoded, deadline);
+    if (!trailer) {
+        return TResult<TMemoryRegion>::ForwardError(trailer);
+    }
+
+    /* returned payload and trailer stay in buffer until the next read */
+    ReadBody_ = decoded + trailer.Result();
+    return TResult<TMemoryRegion>::MakeSuccess(Reader_.CurrentMemoryRegion().FitSize(decoded));
+}
+
+TResult<size_t> THttpHandle::ReadTrailer(size_t offset, TReactor::TDeadline deadline) {
+    TResult<size_t> result;
+    size_t prevBufLen = 0;
+
+    TResult<size_t> res = Reader_.ReadUntil([this, &result, &prevBufLen, offset](TMemoryRegion region) {
+        region = region.Slice(offset);
+        size_t numHeaders = MAX_HEADERS;
+        struct phr_header headers[MAX_HEADERS] = {};
+
+        int ret = phr_parse_headers(region.DataAs<const char*>(), region.Size(), headers, &numHeaders, prevBufLen);
+
+        prevBufLen = region.Size();
+
+        if (ret > 0) {
+            Trailers_ = ParseHeaders(region, ret, headers, numHeaders);
+            result = TResult<size_t>::MakeSuccess(ret);
+            return true;
+        } else if (ret == -1) {
+            result = TResult<size_t>::MakeFail(-2);
+            return true;
+        }
+
+        return false;
+    }, deadline);
+
+    if (!res) {
+        return res;
+    }
+
+    return result;
+}
+
+TResult<size_t> THttpHandle::SkipBody(TReactor::TDeadline deadline) {
+    ConsumeReadBody();
+
+    if (UnreadChunked_) {
+        UnreadChunked_ = false;
+        TResult<size_t> res = ForwardChunked(nullptr, nullptr, nullptr, deadline);
+        if (!res) {
+            KeepAlive_ = false;
+        }
+        return res;
+    }
+
+    size_t skipped = 0;
+    while (UnreadBody_ > 0) {
+        TResult<TMemoryRegion> res = Reader_.Read(deadline);
+        if (!res || res.Result().Empty()) {
+            KeepAlive_ = false;
+            return res ? TResult<size_t>::MakeFail(-2) : TResult<size_t>::ForwardError(res);
+        }
+
+        size_t size = std::min(UnreadBody_, res.Result().Size());
+        Reader_.ChopBegin(size);
+        UnreadBody_ -= size;
+        skipped += size;
+    }
+
+    return TResult<size_t>::MakeSuccess(skipped);
+}
+
+void THttpHandle::StartBody(const THttpMessage& message) {
+    UnreadChunked_ = Chunked(message);
+    UnreadBody_ = UnreadChunked_ ? 0 : ContentLength(message).value_or(0);
+    UnreadUntilClose_ = false;
+    Trailers_ = THttpHeaders();
+}
+
+void THttpHandle::ConsumeReadBody() {
+    if (ReadBody_ > 0) {
+        Reader_.ChopBegin(ReadBody_);
+        ReadBody_ = 0;
+    }
+}
@@ -1,26 +1,28 @@
 #pragma once
 
 #include "buffered.h"
+#include "http_headers.h"
 #include "tcp.h"
 
 #include <util/generic.h>
 
+#include <chrono>
+#include <functional>
+#include <optional>
 #include <vector>
 #include <string>
 
-using THeaders = std::unordered_map<std::string, std::string>;
-
 class THttpMessage {
 public:
     THttpMessage() = default;
 
-    THttpMessage(THeaders headers, int major, int minor)
+    THttpMessage(THttpHeaders headers, int major, int minor)
         : Headers(std::move(headers))
         , MajorVersion(major)
         , MinorVersion(minor)
     {}
 
-    THeaders Headers;
+    THttpHeaders Headers;
     int MajorVersion = 0;
     int MinorVersion = 0;
 };
@@ -48,21 +50,196 @@ public:
     TResult<THttpRequest> ReadRequest(TReactor::TDeadline deadline = TReactor::TDeadline::max());
     TResult<THttpResponse> ReadResponse(TReactor::TDeadline deadline = TReactor::TDeadline::max());
 
+    /*
+     * Reads next request of persistent connection, unread body of the previous request is skipped.
+     * Pipelined requests are parsed from buffer without waiting.
+     * @return nothing if connection cannot be reused or client closed it or sent nothing until `deadline`.
+     */
+    TResult<std::optional<THttpRequest>> ReadNextRequest(TReactor::TDeadline deadline = TReactor::TDeadline::max());
+
+    /*
+     * Serves persistent client connection: calls `handler(request)` for every request until connection
+     * is over or handler returns false. Handler is expected to answer with `WriteResponse`,
+     * so connection is not reused after response which closes it.
+     * @return how many requests were served.
+     */
+    template <typename Handler>
+    TResult<size_t> ServeRequests(Handler&& handler, std::chrono::steady_clock::duration idleTimeout) {
+        size_t served = 0;
+
+        while (true) {
+            TResult<std::optional<THttpRequest>> res = ReadNextRequest(Reactor()->Now() + idleTimeout);
+            if (!res) {
+                return TResult<size_t>::ForwardError(res);
+            }
+
+            if (!res.Result()) {
+                break;
+            }
+
+            served++;
+            if (!handler(*res.Result())) {
+                break;
+            }
+        }
+
+        return TResult<size_t>::MakeSuccess(served);
+    }
+
     TResult<size_t> WriteRequest(const THttpRequest& request, TReactor::TDeadline deadline = TReactor::TDeadline::max());
     TResult<size_t> WriteResponse(const THttpResponse& response, TReactor::TDeadline deadline = TReactor::TDeadline::max());
 
     TResult<size_t> TransferAll(THttpHandle& other, size_t size, TReactor::TDeadline deadline = TReactor::TDeadline::max());
+    /*
+     * Transfers body of `message` read from this handle to `other`. Chunked body is decoded and sent
+     * chunk by chunk as it arrives, trailer is forwarded as is. Body of response without length
+     * is transfered until connection is closed.
+     * @return size of payload.
+     */
     TResult<size_t> TransferBody(THttpHandle& other, const THttpMessage& message, TReactor::TDeadline deadline = TReactor::TDeadline::max());
 
+    /*
+     * Called for every piece of payload before it is sent, returns false to stop transfer.
+     */
+    using TBodyInspector = std::function<bool(TMemoryRegion piece)>;
+
+    /*
+     * Transfers body like `TransferBody` passing it through `inspector` on the way, so it is copied
+     * through buffer instead of splicing. Transfer stopped by inspector fails with ECONNABORTED.
+     */
+    TResult<size_t> TransferBody(THttpHandle& other, const THttpMessage& message, const TBodyInspector& inspector, TReactor::TDeadline deadline = TReactor::TDeadline::max());
+
+    /*
+     * Called for every piece of payload before it is sent, returns how many bytes of it may be sent.
+     */
+    using TBodyScanner = std::function<size_t(TMemoryRegion piece)>;
+
+    /*
+     * Transfers body like `TransferBody` with inspector, but bytes let through by `scanner` are sent
+     * before transfer is stopped. Stopped transfer fails with ECONNABORTED.
+     */
+    TResult<size_t> TransferScannedBody(THttpHandle& other, const THttpMessage& message, const TBodyScanner& scanner, TReactor::TDeadline deadline = TReactor::TDeadline::max());
+
+    /*
+     * Called once whole payload is read and scanned, returns false to stop transfer.
+     */
+    using TBodyFinisher = std::function<bool()>;
+
+    /*
+     * Transfers body like `TransferScannedBody`, but the last piece of payload (or the last chunk)
+     * is held back until `finish` lets it through, so `other` never gets whole body of stopped transfer.
+     * End of body delimited by close cannot be held back, `finish` is called after it is sent.
+     */
+    TResult<size_t> TransferScannedBody(THttpHandle& other, const THttpMessage& message, const TBodyScanner& scanner, const TBodyFinisher& finish, TReactor::TDeadline deadline = TReactor::TDeadline::max());
+
+    /*
+     * Transfers body scanning it with `matcher`, payload is sent up to the match which stopped scan,
+     * see `TStreamRegexpMatcher::ScanPrefix`.
+     */
+    TResult<size_t> TransferBody(THttpHandle& other, const THttpMessage& message, TStreamRegexpMatcher& matcher, TReactor::TDeadline deadline = TReactor::TDeadline::max());
+
+    /*
+     * Reads whole body of `message`, it must fit into buffer. Chunked body is decoded.
+     * Returned region is valid until the next operation on handle.
+     */
     TResult<TMemoryRegion> ReadBody(const THttpMessage& message, TReactor::TDeadline deadline = TReactor::TDeadline::max());
 
+    /*
+     * Trailer fields of the last chunked body read or transfered.
+     */
+    const THttpHeaders& Trailers() const {
+        return Trailers_;
+    }
+
     void Close() {
         Handle_->Close();
     }
 
+    /*
+     * Whether connection can carry another message: all messages read or written so far
+     * allow persistent connection and their bodies were consumed completely.
+     */
+    bool KeepAlive() const {
+        return KeepAlive_;
+    }
+
+    /*
+     * Whether connection may be given to another user, e.g. returned to connection pool:
+     * it can be reused, body of the last message is consumed and nothing else is buffered.
+     */
+    bool Idle() const {
+        return KeepAlive_ && UnreadBody_ == 0 && !UnreadChunked_ && !UnreadUntilClose_ && Reader_.BufferedSize() == ReadBody_;
+    }
+
+    TTcpHandlePtr Handle() const {
+        return Handle_;
+    }
+
+    /*
+     * How many bytes are read from connection but not consumed yet.
+     */
+    size_t BufferedSize() const {
+        return Reader_.BufferedSize();
+    }
+
+    /*
+     * Whether message allows to reuse connection after it: `Connection` header and HTTP version agree
+     * and end of body is known without closing connection.
+     */
+    static bool Persistent(const THttpMessage& message);
+    static bool Persistent(const THttpResponse& response);
+
 private:
+    /*
+     * Reads and drops the rest of body of the last read message.
+     */
+    TResult<size_t> SkipBody(TReactor::TDeadline deadline);
+
+    /*
+     * Decodes chunked body and sends it to `other` re-encoded, body is dropped if `other` is null.
+     */
+    TResult<size_t> ForwardChunked(THttpHandle* other, const TBodyScanner* scanner, const TBodyFinisher* finish, TReactor::TDeadline deadline);
+
+    /*
+     * Copies `size` bytes of body to `other` through buffer passing them through `scanner`.
+     */
+    TResult<size_t> ScanExactly(THttpHandle& other, size_t size, const TBodyScanner& scanner, const TBodyFinisher* finish, TReactor::TDeadline deadline);
+
+    TResult<TMemoryRegion> ReadChunked(TReactor::TDeadline deadline);
+
+    /*
+     * Reads body which lasts until connection is closed, it must fit into buffer.
+     */
+    TResult<TMemoryRegion> ReadUntilClose(TReactor::TDeadline deadline);
+
+    /*
+     * Parses trailer section, which starts at `offset` of buffer, and leaves it in buffer.
+     * @return size of trailer section including terminating empty line.
+     */
+    TResult<size_t> ReadTrailer(size_t offset, TReactor::TDeadline deadline);
+
+    /*
+     * Remembers framing of body of just read message.
+     */
+    void StartBody(const THttpMessage& message);
+
+    /*
+     * Drops body returned by `ReadBody` from buffer.
+     */
+    void ConsumeReadBody();
+
     TTcpHandlePtr Handle_;
     TBufferedReader<TTcpHandlePtr> Reader_;
+    /* bytes of body of the last read message which are not consumed yet */
+    size_t UnreadBody_ = 0;
+    /* body of the last read message is chunked and not consumed yet */
+    bool UnreadChunked_ = false;
+    /* body of the last read response lasts until connection is closed and is not consumed yet */
+    bool UnreadUntilClose_ = false;
+    /* body returned by `ReadBody`, it is kept in buffer until the next read */
+    size_t ReadBody_ = 0;
+    bool KeepAlive_ = true;
+    THttpHeaders Trailers_;
 };
 
 using THttpHandlePtr = std::shared_ptr<THttpHandle>;
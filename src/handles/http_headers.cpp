@@ -0,0 +1,86 @@
+#include "http_headers.h"
+
+#include <strings.h>
+
+bool THttpHeaders::NameEqual(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && ::strncasecmp(a.data(), b.data(), a.size()) == 0;
+}
+
+size_t THttpHeaders::Find(std::string_view name, size_t from) const {
+    for (size_t i = from; i < Headers_.Size(); i++) {
+        if (NameEqual(Headers_[i].Name, name)) {
+            return i;
+        }
+    }
+    return Headers_.Size();
+}
+
+std::optional<std::string_view> THttpHeaders::Get(std::string_view name) const {
+    size_t i = Find(name);
+    if (i == Headers_.Size()) {
+        return std::nullopt;
+    }
+    return Headers_[i].Value;
+}
+
+void THttpHeaders::Set(std::string_view name, std::string_view value) {
+    size_t i = Find(name);
+    if (i == Headers_.Size()) {
+        Add(name, value);
+        return;
+    }
+
+    /* original spelling of name is kept */
+    THeader replaced = Headers_[i];
+    Headers_[i] = Own(replaced.Name, value);
+    Release(replaced);
+
+    size_t duplicate = Find(name, i + 1);
+    while (duplicate != Headers_.Size()) {
+        Release(Headers_[duplicate]);
+        Headers_.Erase(duplicate);
+        duplicate = Find(name, duplicate);
+    }
+}
+
+void THttpHeaders::Add(std::string_view name, std::string_view value) {
+    Headers_.PushBack(Own(name, value));
+}
+
+bool THttpHeaders::Remove(std::string_view name) {
+    bool removed = false;
+    size_t i = Find(name);
+    while (i != Headers_.Size()) {
+        Release(Headers_[i]);
+        Headers_.Erase(i);
+        removed = true;
+        i = Find(name, i);
+    }
+    return removed;
+}
+
+THttpHeaders::THeader THttpHeaders::Own(std::string_view name, std::string_view value) {
+    /* name and value share one allocation */
+    std::string field;
+    field.reserve(name.size() + value.size());
+    field.append(name);
+    field.append(value);
+
+    std::shared_ptr<const std::string> storage = std::make_shared<const std::string>(std::move(field));
+    THeader header = {
+        std::string_view(storage->data(), name.size()),
+        std::string_view(storage->data() + name.size(), value.size()),
+    };
+    Owned_.push_back(std::move(storage));
+    return header;
+}
+
+void THttpHeaders::Release(const THeader& header) {
+    for (size_t i = 0; i < Owned_.size(); i++) {
+        if (Owned_[i]->data() == header.Name.data()) {
+            std::swap(Owned_[i], Owned_.back());
+            Owned_.pop_back();
+            return;
+        }
+    }
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <util/small_vector.h>
+
+/*
+ * Header fields of HTTP message, lookup by name is case-insensitive and order of fields is kept.
+ *
+ * Fields are views into immutable storage shared between copies: parsed fields point into
+ * message head, which is copied out of connection buffer once per message, fields set later
+ * get storage of their own. So reading a message costs one allocation regardless of number
+ * of fields, and copying headers never copies strings.
+ */
+class THttpHeaders {
+public:
+    struct THeader {
+        std::string_view Name;
+        std::string_view Value;
+    };
+
+    enum {
+        InlineCapacity = 16
+    };
+
+    THttpHeaders() = default;
+
+    /*
+     * Creates headers over message head `head`, fields are added with `AddParsed`.
+     */
+    explicit THttpHeaders(std::shared_ptr<const std::string> head)
+        : Head_(std::move(head))
+    {
+    }
+
+    /*
+     * Adds field which points into head.
+     */
+    void AddParsed(std::string_view name, std::string_view value) {
+        Headers_.PushBack({ name, value });
+    }
+
+    /*
+     * Value of the first field named `name`.
+     */
+    std::optional<std::string_view> Get(std::string_view name) const;
+
+    bool Has(std::string_view name) const {
+        return Find(name) != Headers_.Size();
+    }
+
+    /*
+     * Replaces value of field `name` or adds it, if there is no such field.
+     * Other fields with the same name are removed.
+     */
+    void Set(std::string_view name, std::string_view value);
+
+    /*
+     * Adds field even if there is one with the same name already.
+     */
+    void Add(std::string_view name, std::string_view value);
+
+    /*
+     * Removes all fields named `name`.
+     * @return whether anything was removed.
+     */
+    bool Remove(std::string_view name);
+
+    size_t Size() const {
+        return Headers_.Size();
+    }
+
+    bool Empty() const {
+        return Headers_.Empty();
+    }
+
+    /* fields set after parsing, each of them has storage of its own */
+    size_t OwnedSize() const {
+        return Owned_.size();
+    }
+
+    const THeader* begin() const {
+        return Headers_.begin();
+    }
+
+    const THeader* end() const {
+        return Headers_.end();
+    }
+
+    /*
+     * Case-insensitive comparison of field names.
+     */
+    static bool NameEqual(std::string_view a, std::string_view b);
+
+private:
+    size_t Find(std::string_view name, size_t from = 0) const;
+
+    /*
+     * Copies `name` and `value` to owned storage.
+     */
+    THeader Own(std::string_view name, std::string_view value);
+
+    /*
+     * Drops storage of replaced or removed field, if it has one. Copies of headers keep theirs.
+     */
+    void Release(const THeader& header);
+
+    TSmallVector<THeader, InlineCapacity> Headers_;
+    std::shared_ptr<const std::string> Head_;
+    /* storage of fields set after parsing, one per field; it is never changed, so copies may share it */
+    std::vector<std::shared_ptr<const std::string>> Owned_;
+};
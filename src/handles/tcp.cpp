@@ -23,7 +23,11 @@ TResult<TTcpHandlePtr> TTcpHandle::Accept(TReactor::TDeadline deadline) {
 }
 
 TResult<bool> TTcpHandle::Connect(const TSocketAddress& addr, TReactor::TDeadline deadline) {
-    return Reactor()->Connect(Fd(), addr, deadline);
+    TResult<bool> res = Reactor()->Connect(Fd(), addr, deadline);
+    if (res) {
+        PeerAddress_ = addr;
+    }
+    return res;
 }
 
 void TTcpHandle::ShutdownAll() {
@@ -11,6 +11,10 @@ public:
 
     static TTcpHandlePtr Create(bool ipv6);
 
+    bool IsSocket() const override {
+        return true;
+    }
+
     void Bind(const TSocketAddress& addr);
     void Listen(int backlog);
 
@@ -51,12 +55,23 @@ public:
         ReuseAddr_ = true;
     }
 
+    /*
+     * Allows several listeners (e.g. one per reactor thread) to bind the same
+     * address, so kernel balances incoming connections between them.
+     */
+    void ReusePort() {
+        ReusePort_ = true;
+    }
+
     void Bind(std::vector<TSocketAddress> addresses) {
         for (const TSocketAddress& addr : addresses) {
             TTcpHandlePtr handle = TTcpHandle::Create(addr.Ipv6());
             if (ReuseAddr_) {
                 handle->ReuseAddr();
             }
+            if (ReusePort_) {
+                handle->ReusePort();
+            }
             if (addr.Ipv6()) {
                 /* by default IPv6 socket listens on both IPv6 and IPv4 addresses */
                 handle->Ipv6Only();
@@ -106,4 +121,5 @@ private:
     std::vector<TTcpHandlePtr> Listeners_;
     std::shared_ptr<spdlog::logger> Logger_;
     bool ReuseAddr_ = false;
+    bool ReusePort_ = false;
 };
@@ -1,16 +1,22 @@
 #include "module.h"
 
+#include <chrono>
+
 #include <pybind11/functional.h>
 #include <pybind11/stl.h>
 #include <pybind11/stl_bind.h>
 
 #include <core/buffer.h>
 #include <core/context.h>
+#include <core/sentinel.h>
+
+#include <coro/reactor.h>
 
 #include <handles/tcp.h>
 #include <handles/http.h>
 
 #include <regexp/database.h>
+#include <regexp/headers.h>
 #include <regexp/matchers.h>
 
 #include <util/network/address.h>
@@ -19,8 +25,6 @@
 
 #include <python/wrappers.h>
 
-PYBIND11_MAKE_OPAQUE(std::unordered_map<std::string, std::string>);
-
 void LoadPortcullisSubModule(py::module& m, const char* submoduleName, const std::string& submoduleResName) {
     TResource helpersSource = GlobalResourceManager.Get(submoduleResName);
     std::string source(helpersSource.Data(), helpersSource.Size());
@@ -41,9 +45,44 @@ void InitCoreModule(py::module& core) {
         .def("write", &TTcpHandleWrapper::Write)
         .def("write_all", &TTcpHandleWrapper::WriteAll)
         .def("transfer_exactly", &TTcpHandleWrapper::TransferExactly)
+        .def("transfer_until", &TTcpHandleWrapper::TransferUntil)
         .def("close", &TTcpHandleWrapper::Close);
 
-    py::class_<TContextWrapper>(core, "Context");
+    py::class_<TContextWrapper>(core, "Context")
+        .def("backend", &TContextWrapper::Backend, py::arg("addr") = py::none())
+        .def("pick_backend", &TContextWrapper::PickBackend)
+        .def("release_backend", py::overload_cast<THttpHandleWrapper&>(&TContextWrapper::ReleaseBackend))
+        .def("release_backend", py::overload_cast<TTcpHandleWrapper&>(&TContextWrapper::ReleaseBackend))
+        .def("backend_pool_stats", &TContextWrapper::BackendPoolStats)
+        .def("backend_group_stats", &TContextWrapper::BackendGroupStats)
+        .def("reload_stats", &TContextWrapper::ReloadStats)
+        .def("log_error", &TContextWrapper::LogError);
+
+    core.def("reactor_stats", []() {
+        const TCoroStackPool& stacks = Reactor()->StackPool();
+        py::dict stats;
+        stats["stack_pool_size"] = stacks.Size();
+        stats["stack_pool_hits"] = stacks.Hits();
+        stats["stack_pool_misses"] = stacks.Misses();
+        const TPipePool& pipes = Reactor()->PipePool();
+        stats["pipe_pool_size"] = pipes.Size();
+        stats["pipe_pool_hits"] = pipes.Hits();
+        stats["pipe_pool_misses"] = pipes.Misses();
+        const TBufferPool& buffers = Reactor()->BufferPool();
+        stats["buffer_pool_allocated_bytes"] = buffers.AllocatedBytes();
+        stats["buffer_pool_used_bytes"] = buffers.UsedBytes();
+        stats["buffer_pool_free_bytes"] = buffers.FreeBytes();
+        stats["buffer_pool_hits"] = buffers.Hits();
+        stats["buffer_pool_misses"] = buffers.Misses();
+        const TRegexpPool& regexps = Reactor()->RegexpPool();
+        stats["regexp_scratch_count"] = regexps.ScratchCount();
+        stats["regexp_scratch_hits"] = regexps.ScratchHits();
+        stats["regexp_scratch_misses"] = regexps.ScratchMisses();
+        stats["regexp_stream_pool_free_bytes"] = regexps.FreeStreamBytes();
+        stats["regexp_stream_pool_hits"] = regexps.StreamHits();
+        stats["regexp_stream_pool_misses"] = regexps.StreamMisses();
+        return stats;
+    });
 
     core.def("resolve", ResolveV46);
     core.def("resolve_v4", ResolveV4);
@@ -52,12 +91,21 @@ void InitCoreModule(py::module& core) {
 
 void InitHttpModule(py::module& http) {
     py::class_<THttpRequest>(http, "HttpRequest")
+        .def(py::init<>())
         .def_readwrite("method", &THttpRequest::Method)
         .def_readwrite("url", &THttpRequest::Url)
         .def_readwrite("minor_version", &THttpRequest::MinorVersion)
         .def_readwrite("headers", &THttpRequest::Headers);
 
     py::class_<THttpResponse>(http, "HttpResponse")
+        .def(py::init([](int status, std::string reason) {
+            THttpResponse response;
+            response.MajorVersion = 1;
+            response.MinorVersion = 1;
+            response.Status = status;
+            response.Reason = std::move(reason);
+            return response;
+        }), py::arg("status") = 200, py::arg("reason") = "OK")
         .def_readwrite("status", &THttpResponse::Status)
         .def_readwrite("reason", &THttpResponse::Reason)
         .def_readwrite("minor_version", &THttpResponse::MinorVersion)
@@ -67,57 +115,76 @@ void InitHttpModule(py::module& http) {
         .def(py::init<TTcpHandleWrapper>())
         .def("read_request", &THttpHandleWrapper::ReadRequest)
         .def("read_response", &THttpHandleWrapper::ReadResponse)
+        .def("read_next_request", &THttpHandleWrapper::ReadNextRequest, py::arg("idle_timeout") = py::none())
+        .def("keep_alive", &THttpHandleWrapper::KeepAlive)
+        .def("trailers", &THttpHandleWrapper::Trailers)
         .def("write_request", &THttpHandleWrapper::WriteRequest)
         .def("write_response", &THttpHandleWrapper::WriteResponse)
         .def("transfer_body", py::overload_cast<THttpHandleWrapper&, const THttpRequest&>(&THttpHandleWrapper::TransferBody))
         .def("transfer_body", py::overload_cast<THttpHandleWrapper&, const THttpResponse&>(&THttpHandleWrapper::TransferBody))
+        .def("transfer_body", py::overload_cast<THttpHandleWrapper&, const THttpRequest&, TStreamRegexpMatcher&>(&THttpHandleWrapper::TransferBody))
+        .def("transfer_body", py::overload_cast<THttpHandleWrapper&, const THttpResponse&, TStreamRegexpMatcher&>(&THttpHandleWrapper::TransferBody))
         .def("close", &THttpHandleWrapper::Close);
 }
 
 void BindMap(py::module& m) {
-    using TMap = std::unordered_map<std::string, std::string>;
-    py::class_<TMap>(m, "UnorderedMapStringString")
+    py::class_<THttpHeaders>(m, "HttpHeaders")
         .def(py::init<>())
-        .def("get", [](const TMap& map, const std::string& value) -> py::object {
-            auto it = map.find(value);
-            if (it != map.end()) {
-                return py::str(it->second);
+        .def("get", [](const THttpHeaders& headers, std::string_view name) -> py::object {
+            if (std::optional<std::string_view> value = headers.Get(name)) {
+                return py::str(value->data(), value->size());
             }
             return py::none();
         })
-        .def("__setitem__", [](TMap& map, const std::string& key, const std::string& value) {
-            auto it = map.find(key);
-            if (it != map.end()) {
-                it->second = value;
-            } else {
-                map.emplace(key, value);
-            }
+        .def("__setitem__", [](THttpHeaders& headers, std::string_view name, std::string_view value) {
+            headers.Set(name, value);
         })
-        .def("__getitem__", [](const TMap& map, const std::string& key) {
-            auto it = map.find(key);
-            if (it == map.end()) {
+        .def("__getitem__", [](const THttpHeaders& headers, std::string_view name) {
+            std::optional<std::string_view> value = headers.Get(name);
+            if (!value) {
                 throw py::key_error();
             }
-            return it->second;
+            return py::str(value->data(), value->size());
+        })
+        .def("__contains__", [](const THttpHeaders& headers, std::string_view name) {
+            return headers.Has(name);
+        })
+        .def("__len__", &THttpHeaders::Size)
+        .def("__bool__", [](const THttpHeaders& headers) -> bool {
+            return !headers.Empty();
+        })
+        .def("__iter__", [](const THttpHeaders& headers) {
+            py::list names;
+            for (const THttpHeaders::THeader& header : headers) {
+                names.append(py::str(header.Name.data(), header.Name.size()));
+            }
+            return py::iter(names);
         })
-        .def("__bool__", [](const TMap& m) -> bool {
-            return !m.empty();
+        .def("items", [](const THttpHeaders& headers) {
+            py::list items;
+            for (const THttpHeaders::THeader& header : headers) {
+                items.append(py::make_tuple(
+                    py::str(header.Name.data(), header.Name.size()),
+                    py::str(header.Value.data(), header.Value.size())
+                ));
+            }
+            return py::iter(items);
         })
-        .def("__iter__", [](TMap& m) {
-            return py::make_key_iterator(m.begin(), m.end());
-        }, py::keep_alive<0, 1>())
-        .def("items", [](TMap& m) {
-            return py::make_iterator(m.begin(), m.end());
-        }, py::keep_alive<0, 1>())
-        .def("__delitem__", [](TMap& m, const std::string& key) {
-               auto it = m.find(key);
-               if (it == m.end()) {
-                   throw py::key_error();
-               }
-               m.erase(it);
+        .def("__delitem__", [](THttpHeaders& headers, std::string_view name) {
+            if (!headers.Remove(name)) {
+                throw py::key_error();
+            }
         });
 }
 
+static TMemoryRegionChain MakeChain(const std::vector<std::string_view>& chunks) {
+    TMemoryRegionChain chain;
+    for (std::string_view chunk : chunks) {
+        chain.Add(TMemoryRegion(chunk));
+    }
+    return chain;
+}
+
 void InitReModule(py::module& m) {
     m.attr("CASELESS") = py::int_(HS_FLAG_CASELESS);
     m.attr("DOTALL") = py::int_(HS_FLAG_DOTALL);
@@ -137,15 +204,143 @@ void InitReModule(py::module& m) {
         .def(py::init<std::string, unsigned int>());
 
     py::class_<TStreamRegexpDatabase>(m, "StreamRegexpDatabase")
-        .def(py::init<std::vector<TRegexpDef>, unsigned int>(), py::arg("regexps"), py::arg("mode") = 0);
+        /* compilation may take seconds, handlers and reload are not blocked meanwhile */
+        .def(py::init<std::vector<TRegexpDef>, unsigned int>(), py::arg("regexps"), py::arg("mode") = 0, py::call_guard<py::gil_scoped_release>());
 
+    /* matchers refer to database, so it is kept alive while they are */
     py::class_<TStreamRegexpMatcher>(m, "StreamRegexpMatcher")
-        .def(py::init<TStreamRegexpDatabase, TStreamRegexpMatcher::TMatchCallback>())
+        .def(py::init<const TStreamRegexpDatabase&, TStreamRegexpMatcher::TMatchCallback>(), py::keep_alive<1, 2>())
         .def("scan", [](TStreamRegexpMatcher& matcher, std::string_view chunk) {
             matcher.Scan(chunk);
+        })
+        /* chunks are scanned in place in one call */
+        .def("scan", [](TStreamRegexpMatcher& matcher, const std::vector<std::string_view>& chunks) {
+            matcher.Scan(MakeChain(chunks));
+        })
+        .def_property_readonly("stopped", &TStreamRegexpMatcher::Stopped);
+
+    py::class_<TBlockRegexpDatabase>(m, "BlockRegexpDatabase")
+        .def(py::init<std::vector<TRegexpDef>, unsigned int>(), py::arg("regexps"), py::arg("mode") = 0, py::call_guard<py::gil_scoped_release>());
+
+    py::class_<TBlockRegexpMatcher>(m, "BlockRegexpMatcher")
+        .def(py::init<const TBlockRegexpDatabase&, TBlockRegexpMatcher::TMatchCallback>(), py::keep_alive<1, 2>())
+        .def("scan", [](TBlockRegexpMatcher& matcher, std::string_view data) {
+            matcher.Scan(data);
+        });
+
+    /* rules are (header, regexp, flags), header ":url" targets request url */
+    using THeaderRule = std::tuple<std::string, std::string, unsigned int>;
+    py::class_<THeaderRegexpDatabase>(m, "HeaderRegexpDatabase")
+        .def(py::init([](std::vector<THeaderRule> rules) {
+            std::vector<THeaderRegexpDef> defs;
+            for (THeaderRule& rule : rules) {
+                defs.push_back({ std::move(std::get<0>(rule)), TRegexpDef(std::move(std::get<1>(rule)), std::get<2>(rule)) });
+            }
+            return std::make_unique<THeaderRegexpDatabase>(std::move(defs));
+        }), py::call_guard<py::gil_scoped_release>())
+        .def("match", py::overload_cast<const THttpRequest&>(&THeaderRegexpDatabase::Match, py::const_))
+        .def("match", py::overload_cast<const THttpResponse&>(&THeaderRegexpDatabase::Match, py::const_))
+        .def("__len__", &THeaderRegexpDatabase::Size);
+
+    py::class_<TVectoredRegexpDatabase>(m, "VectoredRegexpDatabase")
+        .def(py::init<std::vector<TRegexpDef>, unsigned int>(), py::arg("regexps"), py::arg("mode") = 0, py::call_guard<py::gil_scoped_release>());
+
+    py::class_<TVectoredRegexpMatcher>(m, "VectoredRegexpMatcher")
+        .def(py::init<const TVectoredRegexpDatabase&, TVectoredRegexpMatcher::TMatchCallback>(), py::keep_alive<1, 2>())
+        .def("scan", [](TVectoredRegexpMatcher& matcher, const std::vector<std::string_view>& chunks) {
+            matcher.Scan(MakeChain(chunks));
         });
 }
 
+void InitSentinelModule(py::module& m) {
+    m.attr("ALLOW") = py::int_(static_cast<int>(TSentinel::SpAllow));
+    m.attr("DENY") = py::int_(static_cast<int>(TSentinel::SpDeny));
+
+    /* predicates are called with GIL taken by sentinel runner */
+    py::class_<TSentinel::TCondition>(m, "Condition")
+        .def_static("has_header", &TSentinel::TCondition::HasHeader, py::arg("response"), py::arg("name"))
+        .def_static("header_matches", [](bool response, std::string name, std::string regexp, unsigned int flags) {
+            return TSentinel::TCondition::HeaderMatches(response, std::move(name), TRegexpDef(std::move(regexp), flags));
+        }, py::arg("response"), py::arg("name"), py::arg("regexp"), py::arg("flags") = 0)
+        .def_static("body_contains", [](bool response, std::string regexp, unsigned int flags, bool buffered, size_t threshold) {
+            return TSentinel::TCondition::BodyContains(response, TRegexpDef(std::move(regexp), flags), buffered, threshold);
+        }, py::arg("response"), py::arg("regexp"), py::arg("flags") = 0, py::arg("buffered") = false, py::arg("threshold") = 0)
+        .def_static("request_if", [](py::function predicate) {
+            return TSentinel::TCondition::RequestIf([predicate](const THttpRequest& request) {
+                return static_cast<bool>(py::bool_(predicate(request)));
+            });
+        })
+        .def_static("response_if", [](py::function predicate) {
+            return TSentinel::TCondition::ResponseIf([predicate](const THttpResponse& response) {
+                return static_cast<bool>(py::bool_(predicate(response)));
+            });
+        })
+        .def_static("body_if", [](bool response, py::function predicate) {
+            return TSentinel::TCondition::BodyIf(response, [predicate](TMemoryRegion body) {
+                return static_cast<bool>(py::bool_(predicate(py::bytes(body.DataAs<const char*>(), body.Size()))));
+            });
+        }, py::arg("response"), py::arg("predicate"));
+
+    using TSectionTuple = std::tuple<std::string, int, std::vector<TSentinel::TBlock>>;
+    py::class_<TSentinel, std::shared_ptr<TSentinel>>(m, "Program")
+        .def(py::init([](std::vector<TSectionTuple> sections) {
+            std::vector<TSentinel::TSectionDef> defs;
+            for (TSectionTuple& section : sections) {
+                TSentinel::TSectionDef& def = defs.emplace_back();
+                def.UrlPrefix = std::move(std::get<0>(section));
+                def.Policy = static_cast<TSentinel::EPolicy>(std::get<1>(section));
+                def.Blocks = std::move(std::get<2>(section));
+            }
+            /* predicates hold python objects, so only compilation of databases is done without GIL */
+            TSentinel::TRunner compiler = [](const std::function<bool()>& compile) {
+                py::gil_scoped_release release;
+                return compile();
+            };
+            return std::make_shared<TSentinel>(std::move(defs), &compiler);
+        }))
+        .def("serve", [](const TSentinel& sentinel, TContextWrapper& context, TTcpHandleWrapper& client) {
+            return context.ServeSentinel(sentinel, client);
+        })
+        .def("__len__", &TSentinel::Size);
+}
+
+/*
+ * Reactor side of `ReactorEventLoop`, see aio.py.
+ */
+void InitAioModule(py::module& m) {
+    m.def("register_fd", [](int fd) {
+        Reactor()->RegisterNonBlockingFd(fd);
+    });
+    m.def("release_fd", [](int fd) {
+        Reactor()->ReleaseFd(fd);
+    });
+    /* GIL is handed over to other coroutines of worker meanwhile, so it is not released here */
+    m.def("wait_readable", [](int fd, std::optional<double> timeout) {
+        TReactor::TDeadline deadline = TReactor::TDeadline::max();
+        if (timeout) {
+            deadline = Reactor()->Now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(*timeout)
+            );
+        }
+
+        TResult<int> res = Reactor()->WaitForLevel(fd, TReactor::EvRead, deadline);
+        if (!res) {
+            if (res.TimedOut() || res.Canceled()) {
+                return false;
+            }
+            ThrowErr(res.Error(), "wait_readable failed");
+        }
+        return true;
+    }, py::arg("fd"), py::arg("timeout") = py::none());
+    /* lets other coroutines of worker run while loop has ready callbacks and does not wait */
+    m.def("yield_to_reactor", []() {
+        Reactor()->Yield();
+    });
+    m.def("canceled", []() {
+        return Reactor()->Current()->Canceled();
+    });
+}
+
 void InitPortcullisModule(py::module& m) {
     BindMap(m);
 
@@ -163,5 +358,16 @@ void InitPortcullisModule(py::module& m) {
 
     py::module re = m.def_submodule("re");
     LoadPortcullisSubModule(m, "re", "re.py");
+
+    py::module _sentinel = m.def_submodule("_sentinel");
+    InitSentinelModule(_sentinel);
+
+    LoadPortcullisSubModule(http, "sentinel", "sentinel.py");
+
+    py::module _aio = m.def_submodule("_aio");
+    InitAioModule(_aio);
+
+    py::module aio = m.def_submodule("aio");
+    LoadPortcullisSubModule(m, "aio", "aio.py");
 }
 
@@ -0,0 +1,125 @@
+#include "thread_states.h"
+
+#include <optional>
+#include <string>
+
+#include <util/exception.h>
+
+/*
+ * pybind11 looks up thread state of the thread by this key, e.g. in `gil_scoped_acquire`.
+ */
+static void BindPybindState(PyThreadState* state) {
+    const auto& internals = py::detail::get_internals();
+    PyThread_set_key_value(internals.tstate, state);
+}
+
+TPyThreadStates::~TPyThreadStates() {
+    if (Reactor_) {
+        Reactor_->SetSwitchHook(nullptr, nullptr);
+    }
+}
+
+void TPyThreadStates::Attach(TReactor* reactor, PyInterpreterState* interpreter) {
+    Reactor_ = reactor;
+    Interpreter_ = interpreter;
+    Reactor_->SetSwitchHook(&TPyThreadStates::OnSwitch, this);
+}
+
+bool TPyThreadStates::Enter() {
+    TCoroutine* coro = Reactor_->Current();
+    ASSERT(!coro->HookData);
+
+    PyThreadState* state = nullptr;
+    if (Free_.empty()) {
+        state = PyThreadState_New(Interpreter_);
+        if (!state) {
+            return false;
+        }
+        Created_++;
+    } else {
+        state = Free_.back();
+        Free_.pop_back();
+    }
+
+    coro->HookData = state;
+    PyEval_RestoreThread(state);
+    BindPybindState(state);
+    return true;
+}
+
+void TPyThreadStates::Leave() {
+    TCoroutine* coro = Reactor_->Current();
+    PyThreadState* state = static_cast<PyThreadState*>(coro->HookData);
+    ASSERT(state);
+
+    PyThreadState* oldState = PyEval_SaveThread();
+    ASSERT(oldState == state);
+
+    coro->HookData = nullptr;
+    Free_.push_back(state);
+}
+
+void TPyThreadStates::Clear() {
+    for (PyThreadState* state : Free_) {
+        PyThreadState_Clear(state);
+        PyThreadState_Delete(state);
+    }
+    Free_.clear();
+}
+
+void TPyThreadStates::OnSwitch(void*, TCoroutine* from, TCoroutine* to) {
+    PyThreadState* fromState = from ? static_cast<PyThreadState*>(from->HookData) : nullptr;
+    PyThreadState* toState = to ? static_cast<PyThreadState*>(to->HookData) : nullptr;
+
+    if (fromState && toState) {
+        /* GIL stays with this thread, python checks for other threads waiting for it anyway */
+        PyThreadState_Swap(toState);
+        BindPybindState(toState);
+    } else if (fromState) {
+        PyEval_SaveThread();
+    } else if (toState) {
+        PyEval_RestoreThread(toState);
+        BindPybindState(toState);
+    }
+}
+
+TPyReleaseGuard::TPyReleaseGuard()
+    : Coroutine_(Reactor()->Current())
+    , HookData_(Coroutine_->HookData)
+{
+    Release();
+}
+
+TPyReleaseGuard::~TPyReleaseGuard() {
+    Acquire();
+}
+
+void TPyReleaseGuard::Acquire() {
+    PyEval_RestoreThread(State_);
+    BindPybindState(State_);
+    Coroutine_->HookData = HookData_;
+}
+
+void TPyReleaseGuard::Release() {
+    /* switch hook must not hand over GIL which is not held */
+    Coroutine_->HookData = nullptr;
+    State_ = PyEval_SaveThread();
+}
+
+bool TPyReleaseGuard::Reenter(const std::function<bool()>& call) {
+    Acquire();
+
+    std::optional<std::string> error;
+    bool result = false;
+    try {
+        result = call();
+    } catch (const std::exception& e) {
+        error = e.what();
+    }
+
+    Release();
+    if (error) {
+        throw TException() << *error;
+    }
+    return result;
+}
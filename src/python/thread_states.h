@@ -0,0 +1,90 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include <pybind11/pybind11.h>
+
+#include <coro/reactor.h>
+#include <util/generic.h>
+
+namespace py = pybind11;
+
+/*
+ * Python thread states of coroutines running on one reactor.
+ *
+ * Coroutine entered python keeps its thread state in `HookData` until it leaves python, and holds GIL
+ * whenever it runs. Reactor's switch hook hands GIL over: it swaps thread states between python coroutines
+ * and releases GIL when reactor polls or runs native coroutine. So blocking calls of python code
+ * cost nothing unless coroutine is really switched.
+ *
+ * Code which releases GIL by itself must not switch coroutines, use `TPyReleaseGuard` for that.
+ */
+class TPyThreadStates : TMoveOnly {
+public:
+    TPyThreadStates() = default;
+    ~TPyThreadStates();
+
+    /*
+     * Installs switch hook to `reactor`, states are created in `interpreter`.
+     */
+    void Attach(TReactor* reactor, PyInterpreterState* interpreter);
+
+    /*
+     * Binds free thread state to current coroutine and acquires GIL with it.
+     * @return false if state cannot be created.
+     */
+    bool Enter();
+
+    /*
+     * Releases GIL and gives thread state of current coroutine back.
+     */
+    void Leave();
+
+    /*
+     * Deletes free states, must be called with GIL.
+     */
+    void Clear();
+
+    /* free states */
+    size_t Size() const {
+        return Free_.size();
+    }
+
+    /* states created so far */
+    size_t Created() const {
+        return Created_;
+    }
+
+private:
+    static void OnSwitch(void* arg, TCoroutine* from, TCoroutine* to);
+
+    TReactor* Reactor_ = nullptr;
+    PyInterpreterState* Interpreter_ = nullptr;
+    std::vector<PyThreadState*> Free_;
+    size_t Created_ = 0;
+};
+
+/*
+ * Releases GIL for the time of long native work of current coroutine, e.g. connection served by C++ code,
+ * so other threads are able to run python code meanwhile.
+ */
+class TPyReleaseGuard : TMoveOnly {
+public:
+    TPyReleaseGuard();
+    ~TPyReleaseGuard();
+
+    /*
+     * Runs python code in the middle of native work with thread state of this coroutine.
+     * Exception is turned into TException, as it propagates when GIL is released again.
+     */
+    bool Reenter(const std::function<bool()>& call);
+
+private:
+    void Acquire();
+    void Release();
+
+    TCoroutine* Coroutine_;
+    void* HookData_;
+    PyThreadState* State_ = nullptr;
+};
@@ -1,12 +1,9 @@
 #include "wrappers.h"
+#include "thread_states.h"
 #include <handles/buffered.h>
 
 py::bytes TTcpHandleWrapper::Read(ssize_t size) {
-    TResult<TMemoryRegion> res;
-    {
-        TPyContextSwitchGuard guard(Context_);
-        res = Reader_->Read();
-    }
+    TResult<TMemoryRegion> res = Reader_->Read();
 
     if (!res) {
         ThrowErr(res.Error(), "read failed");
@@ -18,11 +15,7 @@ py::bytes TTcpHandleWrapper::Read(ssize_t size) {
 }
 
 py::bytes TTcpHandleWrapper::ReadExactly(ssize_t size) {
-    TResult<TMemoryRegion> res;
-    {
-        TPyContextSwitchGuard guard(Context_);
-        res = Reader_->ReadExactly(size);
-    }
+    TResult<TMemoryRegion> res = Reader_->ReadExactly(size);
 
     if (!res) {
         ThrowErr(res.Error(), "read_exactly failed");
@@ -36,11 +29,7 @@ py::bytes TTcpHandleWrapper::ReadExactly(ssize_t size) {
 size_t TTcpHandleWrapper::Write(std::string_view buf) {
     TMemoryRegion region(const_cast<char*>(buf.data()), buf.size());
 
-    TResult<size_t> res;
-    {
-        TPyContextSwitchGuard guard(Context_);
-        res = Handle_->Write(region);
-    }
+    TResult<size_t> res = Handle_->Write(region);
     if (!res) {
         ThrowErr(res.Error(), "write failed");
     }
@@ -48,11 +37,7 @@ size_t TTcpHandleWrapper::Write(std::string_view buf) {
 }
 
 void TTcpHandleWrapper::WriteAll(std::string_view buf) {
-    TResult<size_t> res;
-    {
-        TPyContextSwitchGuard guard(Context_);
-        res = Handle_->WriteAll({ const_cast<char*>(buf.data()), buf.size() });
-    }
+    TResult<size_t> res = Handle_->WriteAll({ const_cast<char*>(buf.data()), buf.size() });
     if (!res) {
         ThrowErr(res.Error(), "write failed");
     }
@@ -60,11 +45,7 @@ void TTcpHandleWrapper::WriteAll(std::string_view buf) {
 
 TTcpHandleWrapper TTcpHandleWrapper::Connect(TContextWrapper context, TSocketAddress addr) {
     TTcpHandlePtr handle = TTcpHandle::Create(addr.Ipv6());
-    TResult<bool> res;
-    {
-        TPyContextSwitchGuard guard(context);
-        res = handle->Connect(addr);
-    }
+    TResult<bool> res = handle->Connect(addr);
     if (!res) {
         ThrowErr(res.Error(), "connect failed");
     }
@@ -72,15 +53,137 @@ TTcpHandleWrapper TTcpHandleWrapper::Connect(TContextWrapper context, TSocketAdd
 }
 
 size_t TTcpHandleWrapper::TransferExactly(TTcpHandleWrapper other, size_t size) {
+    TResult<size_t> res = Reader_->TransferExactly(*other.Handle_, size);
+
+    if (!res) {
+        ThrowErr(res.Error(), "transfer_all failed");
+    }
+
+    return size;
+}
+
+size_t TTcpHandleWrapper::TransferUntil(TTcpHandleWrapper other, size_t size, TStreamRegexpMatcher& matcher) {
+    TResult<size_t> res = Reader_->TransferScanned(*other.Handle_, size, [&matcher](TMemoryRegion piece) {
+        return matcher.ScanPrefix(piece);
+    });
+
+    if (!res) {
+        ThrowErr(res.Error(), "transfer_until failed");
+    }
+
+    return res.Result();
+}
+
+TTcpHandleWrapper TContextWrapper::Backend(std::optional<TSocketAddress> addr) {
+    if (addr) {
+        if (!Pool_) {
+            return TTcpHandleWrapper::Connect(*this, *addr);
+        }
+
+        TResult<TTcpHandlePtr> res = Pool_->Acquire(*addr);
+        if (!res) {
+            ThrowErr(res.Error(), "backend connect failed");
+        }
+        return TTcpHandleWrapper(*this, std::move(res.Result()));
+    }
+
+    TResult<TBackendGroup::TConnection> res = Context_->Backends->Connect(Pool_, Client_ ? &*Client_ : nullptr);
+    if (!res) {
+        ThrowErr(res.TimedOut() ? ETIMEDOUT : res.Error(), "backend connect failed");
+    }
+
+    TTcpHandleWrapper handle(*this, std::move(res.Result().Handle));
+    handle.Lease() = std::move(res.Result().Lease);
+    return handle;
+}
+
+TSocketAddress TContextWrapper::PickBackend() {
+    TBackendGroup& group = *Context_->Backends;
+    return group.Address(group.Pick(Client_ ? &*Client_ : nullptr));
+}
+
+void TContextWrapper::ReleaseBackend(TTcpHandleWrapper& handle) {
+    handle.Lease().reset();
+    if (!Pool_ || !handle.Drained()) {
+        handle.Close();
+        return;
+    }
+    Pool_->Release(handle.Handle());
+}
+
+void TContextWrapper::ReleaseBackend(THttpHandleWrapper& handle) {
+    handle.Lease().reset();
+    if (!Pool_ || !handle.Idle()) {
+        handle.Close();
+        return;
+    }
+    Pool_->Release(handle.Handle());
+}
+
+size_t TContextWrapper::ServeSentinel(const TSentinel& sentinel, TTcpHandleWrapper& client) {
+    if (!client.Drained()) {
+        throw TException() << "client connection has buffered data";
+    }
+
+    THttpProxy proxy(Context_->Config.HttpProxy, Context_->Backends, Pool_);
     TResult<size_t> res;
     {
-        TPyContextSwitchGuard guard(Context_);
-        res = Reader_->TransferExactly(*other.Handle_, size);
+        /* connection is served natively, GIL is needed only for python predicates */
+        TPyReleaseGuard guard;
+        TSentinel::TRunner runner = [&guard](const std::function<bool()>& predicate) {
+            return guard.Reenter(predicate);
+        };
+        proxy.SetSentinel(&sentinel, &runner);
+        res = proxy.Serve(client.Handle());
     }
 
     if (!res) {
-        ThrowErr(res.Error(), "transfer_all failed");
+        ThrowErr(res.Error(), "sentinel failed");
     }
+    return res.Result();
+}
 
-    return size;
+py::dict TContextWrapper::BackendPoolStats() {
+    py::dict stats;
+    if (!Pool_) {
+        return stats;
+    }
+
+    size_t checkouts = Pool_->Hits() + Pool_->Misses();
+    stats["size"] = Pool_->Size();
+    stats["hits"] = Pool_->Hits();
+    stats["misses"] = Pool_->Misses();
+    stats["evicted"] = Pool_->Evicted();
+    stats["rejected"] = Pool_->Rejected();
+    stats["hit_rate"] = checkouts > 0 ? static_cast<double>(Pool_->Hits()) / checkouts : 0.0;
+    return stats;
+}
+
+py::dict TContextWrapper::ReloadStats() {
+    py::dict stats;
+    if (!Context_->ReloadStats) {
+        return stats;
+    }
+
+    const TReloadStats& reloads = *Context_->ReloadStats;
+    stats["in_progress"] = reloads.InProgress.load();
+    stats["reloads"] = reloads.Reloads.load();
+    stats["failures"] = reloads.Failures.load();
+    stats["last_latency"] = reloads.LastLatency.load() / 1e6;
+    stats["max_latency"] = reloads.MaxLatency.load() / 1e6;
+    return stats;
+}
+
+py::list TContextWrapper::BackendGroupStats() {
+    const TBackendGroup& group = *Context_->Backends;
+    py::list stats;
+    for (size_t i = 0; i < group.Size(); i++) {
+        py::dict backend;
+        backend["host"] = group.Address(i).Host();
+        backend["port"] = group.Address(i).Port();
+        backend["outstanding"] = group.Outstanding(i);
+        backend["ejected"] = group.Ejected(i);
+        stats.append(backend);
+    }
+    return stats;
 }
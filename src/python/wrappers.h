@@ -1,44 +1,69 @@
 #pragma once
 
+#include <optional>
 #include <string_view>
 #include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
 #include <core/context.h>
+#include <core/sentinel.h>
+#include <handles/connection_pool.h>
 #include <handles/tcp.h>
 #include <handles/http.h>
 
 namespace py = pybind11;
 
+class TTcpHandleWrapper;
+class THttpHandleWrapper;
+
 class TContextWrapper {
 public:
-    TContextWrapper(TContextPtr ptr)
+    TContextWrapper(TContextPtr ptr, TConnectionPool* pool = nullptr, std::optional<TSocketAddress> client = std::nullopt)
         : Context_(ptr)
+        , Pool_(pool)
+        , Client_(std::move(client))
     {}
 
     TContextPtr& Context() {
         return Context_;
     }
 
-private:
-    TContextPtr Context_;
-};
-
-class TPyContextSwitchGuard {
-public:
-    TPyContextSwitchGuard(TContextWrapper& context)
-        : Context_(context)
-    {
-        State_ = PyThreadState_Swap(nullptr);
+    /*
+     * Returns connection to `addr` from reactor's pool, by default backend is chosen from configured group.
+     * Without pool new connection is made every time.
+     */
+    TTcpHandleWrapper Backend(std::optional<TSocketAddress> addr);
+
+    /*
+     * Chooses backend from configured group without connecting to it, e.g. for async handlers.
+     */
+    TSocketAddress PickBackend();
+
+    /*
+     * Gives backend connection back to pool, if it is idle. Otherwise connection is closed.
+     */
+    void ReleaseBackend(TTcpHandleWrapper& handle);
+    void ReleaseBackend(THttpHandleWrapper& handle);
+
+    py::dict BackendPoolStats();
+    py::list BackendGroupStats();
+    py::dict ReloadStats();
+
+    void LogError(const std::string& message) {
+        Context_->Logger->error("{}", message);
     }
 
-    ~TPyContextSwitchGuard() {
-        PyThreadState_Swap(State_);
-         const auto& internals = py::detail::get_internals();
-         PyThread_set_key_value(internals.tstate, State_);
-    }
+    /*
+     * Relays HTTP requests of `client` to backend group through `sentinel` until connection is over,
+     * GIL is taken only to call its predicates.
+     * @return how many requests were served.
+     */
+    size_t ServeSentinel(const TSentinel& sentinel, TTcpHandleWrapper& client);
 
 private:
-    TContextWrapper& Context_;
-    PyThreadState* State_;
+    TContextPtr Context_;
+    TConnectionPool* Pool_;
+    /* address of client connection is served for */
+    std::optional<TSocketAddress> Client_;
 };
 
 class TTcpHandleWrapper {
@@ -62,7 +87,19 @@ public:
     void WriteAll(std::string_view buf);
 
     size_t TransferExactly(TTcpHandleWrapper other, size_t size);
-
+    /*
+     * Forwards up to `size` bytes scanned by `matcher`, stops before match which stopped scan.
+     * Matcher is run with GIL, so its callback may be python code.
+     * @return how many bytes were forwarded.
+     */
+    size_t TransferUntil(TTcpHandleWrapper other, size_t size, TStreamRegexpMatcher& matcher);
+
+    /*
+     * Whether nothing read from handle is left in buffer.
+     */
+    bool Drained() const {
+        return Reader_->BufferedSize() == 0;
+    }
 
     void Close() {
         Handle_->Close();
@@ -76,10 +113,18 @@ public:
         return Context_;
     }
 
+    /*
+     * Request to backend of group handle is connected to, see `TContextWrapper::Backend`.
+     */
+    std::shared_ptr<TBackendGroup::TLease>& Lease() {
+        return Lease_;
+    }
+
 private:
     TTcpHandlePtr Handle_;
     std::shared_ptr<TBufferedReader<TTcpHandlePtr>> Reader_;
     TContextWrapper Context_;
+    std::shared_ptr<TBackendGroup::TLease> Lease_;
 };
 
 class THttpHandleWrapper {
@@ -87,14 +132,11 @@ public:
     THttpHandleWrapper(TTcpHandleWrapper wrapper)
         : Handle_(THttpHandle(wrapper.Handle()))
         , Context_(wrapper.Context())
+        , Lease_(wrapper.Lease())
     {}
 
     THttpRequest ReadRequest() {
-        TResult<THttpRequest> res;
-        {
-            TPyContextSwitchGuard guard(Context_);
-            res = Handle_.ReadRequest();
-        }
+        TResult<THttpRequest> res = Handle_.ReadRequest();
 
         if (!res) {
             ThrowErr(res.Error(), "read_request failed");
@@ -104,11 +146,7 @@ public:
     }
 
     THttpResponse ReadResponse() {
-        TResult<THttpResponse> res;
-        {
-            TPyContextSwitchGuard guard(Context_);
-            res = Handle_.ReadResponse();
-        }
+        TResult<THttpResponse> res = Handle_.ReadResponse();
 
         if (!res) {
             ThrowErr(res.Error(), "read_request failed");
@@ -118,11 +156,7 @@ public:
     }
 
     size_t WriteRequest(const THttpRequest& request) {
-        TResult<size_t> res;
-        {
-            TPyContextSwitchGuard guard(Context_);
-            res = Handle_.WriteRequest(request);
-        }
+        TResult<size_t> res = Handle_.WriteRequest(request);
 
         if (!res) {
             ThrowErr(res.Error(), "write_request failed");
@@ -132,11 +166,7 @@ public:
     }
 
     size_t WriteResponse(const THttpResponse& response) {
-        TResult<size_t> res;
-        {
-            TPyContextSwitchGuard guard(Context_);
-            res = Handle_.WriteResponse(response);
-        }
+        TResult<size_t> res = Handle_.WriteResponse(response);
 
 
         if (!res) {
@@ -147,11 +177,7 @@ public:
     }
 
     size_t TransferBodyGeneric(THttpHandleWrapper& other, const THttpMessage& message) {
-        TResult<size_t> res;
-        {
-            TPyContextSwitchGuard guard(Context_);
-            res = Handle_.TransferBody(other.Handle_, message);
-        }
+        TResult<size_t> res = Handle_.TransferBody(other.Handle_, message);
 
         if (!res) {
             ThrowErr(res.Error(), "transfer_body failed");
@@ -168,6 +194,73 @@ public:
         return TransferBodyGeneric(other, response);
     }
 
+    /*
+     * Transfers body scanning it with `matcher`, which is run with GIL.
+     * Body stopped by matcher is cut off right before the match, and transfer fails.
+     */
+    size_t TransferScannedBody(THttpHandleWrapper& other, const THttpMessage& message, TStreamRegexpMatcher& matcher) {
+        TResult<size_t> res = Handle_.TransferScannedBody(other.Handle_, message, [&matcher](TMemoryRegion piece) {
+            return matcher.ScanPrefix(piece);
+        });
+
+        if (!res) {
+            ThrowErr(res.Error(), "transfer_body failed");
+        }
+
+        return res.Result();
+    }
+
+    size_t TransferBody(THttpHandleWrapper& other, const THttpRequest& request, TStreamRegexpMatcher& matcher) {
+        return TransferScannedBody(other, request, matcher);
+    }
+
+    size_t TransferBody(THttpHandleWrapper& other, const THttpResponse& response, TStreamRegexpMatcher& matcher) {
+        return TransferScannedBody(other, response, matcher);
+    }
+
+    /*
+     * Returns next request of persistent connection or None, when connection is over.
+     */
+    py::object ReadNextRequest(std::optional<double> idleTimeout) {
+        TReactor::TDeadline deadline = TReactor::TDeadline::max();
+        if (idleTimeout) {
+            deadline = Reactor()->Now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(*idleTimeout)
+            );
+        }
+
+        TResult<std::optional<THttpRequest>> res = Handle_.ReadNextRequest(deadline);
+
+        if (!res) {
+            ThrowErr(res.Error(), "read_next_request failed");
+        }
+
+        if (!res.Result()) {
+            return py::none();
+        }
+        return py::cast(std::move(*res.Result()));
+    }
+
+    bool KeepAlive() const {
+        return Handle_.KeepAlive();
+    }
+
+    THttpHeaders Trailers() const {
+        return Handle_.Trailers();
+    }
+
+    bool Idle() const {
+        return Handle_.Idle();
+    }
+
+    TTcpHandlePtr Handle() const {
+        return Handle_.Handle();
+    }
+
+    std::shared_ptr<TBackendGroup::TLease>& Lease() {
+        return Lease_;
+    }
+
     void Close() {
         Handle_.Close();
     }
@@ -175,4 +268,5 @@ public:
 private:
     THttpHandle Handle_;
     TContextWrapper Context_;
+    std::shared_ptr<TBackendGroup::TLease> Lease_;
 };
@@ -0,0 +1,213 @@
+#include "cache.h"
+#include "database.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::mutex TRegexpCache::Lock_;
+std::string TRegexpCache::Directory_;
+std::atomic<size_t> TRegexpCache::Hits_ = 0;
+std::atomic<size_t> TRegexpCache::Misses_ = 0;
+std::atomic<size_t> TRegexpCache::Errors_ = 0;
+
+static constexpr char CacheMagic[] = "PCHSDB1\n";
+
+namespace {
+    struct THsFree {
+        void operator()(char* ptr) const {
+            ::free(ptr);
+        }
+    };
+}
+
+static hs_database_t* CompileDatabase(const std::vector<TRegexpDef>& regexps, unsigned int mode) {
+    std::unique_ptr<const char*[]> strArray(new const char*[regexps.size()]);
+    std::unique_ptr<unsigned int[]> regexpIds(new unsigned int[regexps.size()]);
+    std::unique_ptr<unsigned int[]> regexpFlags(new unsigned int[regexps.size()]);
+
+    for (size_t i = 0; i < regexps.size(); i++) {
+        strArray[i] = regexps[i].Expr.c_str();
+        regexpIds[i] = i;
+        regexpFlags[i] = regexps[i].Flags;
+    }
+
+    hs_database_t* db = nullptr;
+    hs_compile_error_t* error = nullptr;
+    hs_error_t ret = hs_compile_multi(
+        strArray.get(),
+        regexpFlags.get(),
+        regexpIds.get(),
+        regexps.size(),
+        mode,
+        nullptr,
+        &db,
+        &error
+    );
+
+    if (ret != HS_SUCCESS) {
+        TException exception = TException() << "cannot compile database: " << (error ? error->message : "unknown error");
+        hs_free_compile_error(error);
+        throw exception;
+    }
+    return db;
+}
+
+template <typename T>
+static void AppendValue(std::string& key, T value) {
+    key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+/*
+ * Everything compiled database depends on.
+ */
+static std::string MakeKey(const std::vector<TRegexpDef>& regexps, unsigned int mode) {
+    std::string key = hs_version();
+    key.push_back('\0');
+
+    hs_platform_info_t platform;
+    if (hs_populate_platform(&platform) == HS_SUCCESS) {
+        AppendValue(key, platform.tune);
+        AppendValue(key, platform.cpu_features);
+    }
+
+    AppendValue(key, mode);
+    AppendValue(key, regexps.size());
+    for (const TRegexpDef& regexp : regexps) {
+        AppendValue(key, regexp.Flags);
+        AppendValue(key, regexp.Expr.size());
+        key.append(regexp.Expr);
+    }
+    return key;
+}
+
+static std::string FileName(const std::string& key) {
+    /* FNV-1a, file content is verified by full key anyway */
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : key) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.hsdb", static_cast<unsigned long long>(hash));
+    return name;
+}
+
+static hs_database_t* Load(const std::string& path, const std::string& key, bool& corrupted) {
+    corrupted = false;
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return nullptr;
+    }
+    std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    size_t magicSize = sizeof(CacheMagic) - 1;
+    uint64_t keySize = 0;
+    if (content.size() < magicSize + sizeof(keySize) || content.compare(0, magicSize, CacheMagic) != 0) {
+        corrupted = true;
+        return nullptr;
+    }
+    memcpy(&keySize, content.data() + magicSize, sizeof(keySize));
+
+    size_t offset = magicSize + sizeof(keySize);
+    if (keySize != key.size() || content.size() < offset + keySize || content.compare(offset, keySize, key) != 0) {
+        corrupted = true;
+        return nullptr;
+    }
+    offset += keySize;
+
+    hs_database_t* db = nullptr;
+    if (hs_deserialize_database(content.data() + offset, content.size() - offset, &db) != HS_SUCCESS) {
+        corrupted = true;
+        return nullptr;
+    }
+    return db;
+}
+
+static bool Store(const std::string& directory, const std::string& name, const std::string& key, const hs_database_t* db) {
+    char* bytes = nullptr;
+    size_t size = 0;
+    if (hs_serialize_database(db, &bytes, &size) != HS_SUCCESS) {
+        return false;
+    }
+    std::unique_ptr<char, THsFree> serialized(bytes);
+
+    if (::mkdir(directory.c_str(), 0755) == -1 && errno != EEXIST) {
+        return false;
+    }
+
+    static std::atomic<uint64_t> counter = 0;
+    std::string path = directory + "/" + name;
+    std::string tmpPath = path + ".tmp." + std::to_string(::getpid()) + "." + std::to_string(counter.fetch_add(1));
+
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        uint64_t keySize = key.size();
+        file.write(CacheMagic, sizeof(CacheMagic) - 1);
+        file.write(reinterpret_cast<const char*>(&keySize), sizeof(keySize));
+        file.write(key.data(), key.size());
+        file.write(serialized.get(), size);
+        file.close();
+
+        if (!file) {
+            ::unlink(tmpPath.c_str());
+            return false;
+        }
+    }
+
+    if (::rename(tmpPath.c_str(), path.c_str()) == -1) {
+        ::unlink(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+void TRegexpCache::SetDirectory(std::string directory) {
+    while (directory.size() > 1 && directory.back() == '/') {
+        directory.pop_back();
+    }
+
+    std::lock_guard<std::mutex> guard(Lock_);
+    Directory_ = std::move(directory);
+}
+
+std::string TRegexpCache::Directory() {
+    std::lock_guard<std::mutex> guard(Lock_);
+    return Directory_;
+}
+
+hs_database_t* TRegexpCache::Compile(const std::vector<TRegexpDef>& regexps, unsigned int mode) {
+    std::string directory = Directory();
+    if (directory.empty()) {
+        return CompileDatabase(regexps, mode);
+    }
+
+    std::string key = MakeKey(regexps, mode);
+    std::string name = FileName(key);
+
+    bool corrupted = false;
+    if (hs_database_t* db = Load(directory + "/" + name, key, corrupted)) {
+        Hits_.fetch_add(1, std::memory_order_relaxed);
+        return db;
+    }
+    if (corrupted) {
+        Errors_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    Misses_.fetch_add(1, std::memory_order_relaxed);
+    hs_database_t* db = CompileDatabase(regexps, mode);
+    /* stale or colliding file is replaced */
+    if (!Store(directory, name, key, db)) {
+        Errors_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return db;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <hs/hs.h>
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct TRegexpDef;
+
+/*
+ * On-disk cache of compiled Hyperscan databases.
+ *
+ * File of database is named by hash of everything compilation depends on: regexps with their flags,
+ * mode, Hyperscan version and CPU platform. The whole key is stored in the file too and compared on load,
+ * so hash collision or foreign file makes only a miss. Files are written to temporary name and renamed,
+ * so concurrent processes never see partial database.
+ */
+class TRegexpCache {
+public:
+    /*
+     * Empty directory disables cache, it is created if missing.
+     */
+    static void SetDirectory(std::string directory);
+    static std::string Directory();
+
+    /*
+     * Loads database from cache or compiles it and stores to cache.
+     * Cache failures are not fatal, database is compiled then.
+     */
+    static hs_database_t* Compile(const std::vector<TRegexpDef>& regexps, unsigned int mode);
+
+    static size_t Hits() {
+        return Hits_.load(std::memory_order_relaxed);
+    }
+
+    static size_t Misses() {
+        return Misses_.load(std::memory_order_relaxed);
+    }
+
+    /* unreadable, mismatching or unwritable cache files */
+    static size_t Errors() {
+        return Errors_.load(std::memory_order_relaxed);
+    }
+
+private:
+    static std::mutex Lock_;
+    static std::string Directory_;
+    static std::atomic<size_t> Hits_;
+    static std::atomic<size_t> Misses_;
+    static std::atomic<size_t> Errors_;
+};
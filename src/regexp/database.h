@@ -1,7 +1,11 @@
 #pragma once
 
+#include "cache.h"
+
 #include <hs/hs.h>
 #include <util/exception.h>
+#include <atomic>
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <memory>
@@ -20,35 +24,21 @@ struct TRegexpDef {
     {}
 };
 
+/*
+ * Unique id of compiled database, as memory of freed database may be taken by another one.
+ */
+inline uint64_t NextRegexpDatabaseId() {
+    static std::atomic<uint64_t> next = 0;
+    return next.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
 template <unsigned int MODE>
 class TGenericRegexpDatabase {
 public:
-    TGenericRegexpDatabase(std::vector<TRegexpDef> regexps, unsigned int extra_mode = 0) {
-        std::unique_ptr<const char*[]> strArray(new const char*[regexps.size()]);
-        std::unique_ptr<unsigned int[]> regexpIds(new unsigned int[regexps.size()]);
-        std::unique_ptr<unsigned int[]> regexpFlags(new unsigned int[regexps.size()]);
-
-        for (size_t i = 0; i < regexps.size(); i++) {
-            strArray[i] = regexps[i].Expr.c_str();
-            regexpIds[i] = i;
-            regexpFlags[i] = regexps[i].Flags;
-        }
-
-        hs_compile_error_t* error = nullptr;
-        hs_error_t ret = hs_compile_multi(
-            strArray.get(),
-            regexpFlags.get(),
-            regexpIds.get(),
-            regexps.size(),
-            MODE | extra_mode,
-            nullptr,
-            &Db_,
-            &error
-        );
-
-        if (ret != HS_SUCCESS) {
-            throw TException() << "cannot compile database: " << error->message;
-        }
+    TGenericRegexpDatabase(std::vector<TRegexpDef> regexps, unsigned int extra_mode = 0)
+        : Id_(NextRegexpDatabaseId())
+    {
+        Db_ = TRegexpCache::Compile(regexps, MODE | extra_mode);
     }
 
     ~TGenericRegexpDatabase() {
@@ -59,7 +49,12 @@ public:
         return Db_;
     }
 
+    uint64_t Id() const {
+        return Id_;
+    }
+
 private:
+    uint64_t Id_;
     hs_database_t* Db_ = nullptr;
 };
 
@@ -0,0 +1,119 @@
+#include "headers.h"
+#include "pool.h"
+
+#include <algorithm>
+#include <cctype>
+#include <strings.h>
+
+static std::string Lowercase(std::string_view s) {
+    std::string result(s);
+    std::transform(result.begin(), result.end(), result.begin(), [](unsigned char c) {
+        return std::tolower(c);
+    });
+    return result;
+}
+
+/*
+ * Orders header names case-insensitively.
+ */
+static bool NameLess(std::string_view a, std::string_view b) {
+    int res = ::strncasecmp(a.data(), b.data(), std::min(a.size(), b.size()));
+    return res < 0 || (res == 0 && a.size() < b.size());
+}
+
+static std::vector<TRegexpDef> RegexpsOf(const std::vector<THeaderRegexpDef>& defs) {
+    if (defs.empty()) {
+        throw TException() << "no header rules";
+    }
+
+    std::vector<TRegexpDef> regexps;
+    regexps.reserve(defs.size());
+    for (const THeaderRegexpDef& def : defs) {
+        /* a rule is matched by its first match, offsets are not used */
+        regexps.emplace_back(def.Regexp.Expr, (def.Regexp.Flags & ~HS_FLAG_SOM_LEFTMOST) | HS_FLAG_SINGLEMATCH);
+    }
+    return regexps;
+}
+
+THeaderRegexpDatabase::THeaderRegexpDatabase(std::vector<THeaderRegexpDef> defs)
+    : Db_(RegexpsOf(defs))
+{
+    Targets_.reserve(defs.size());
+    for (const THeaderRegexpDef& def : defs) {
+        Targets_.push_back(Lowercase(def.Header));
+    }
+
+    Headers_ = Targets_;
+    std::sort(Headers_.begin(), Headers_.end(), NameLess);
+    Headers_.erase(std::unique(Headers_.begin(), Headers_.end()), Headers_.end());
+}
+
+std::vector<unsigned int> THeaderRegexpDatabase::Match(const THttpRequest& request) const {
+    std::string_view url = request.Url;
+    return Scan(request.Headers, &url);
+}
+
+std::vector<unsigned int> THeaderRegexpDatabase::Match(const THttpResponse& response) const {
+    return Scan(response.Headers, nullptr);
+}
+
+std::vector<unsigned int> THeaderRegexpDatabase::Match(const THttpHeaders& headers) const {
+    return Scan(headers, nullptr);
+}
+
+bool THeaderRegexpDatabase::Targeted(std::string_view name) const {
+    auto it = std::lower_bound(Headers_.begin(), Headers_.end(), name, [](const std::string& header, std::string_view name) {
+        return NameLess(header, name);
+    });
+    return it != Headers_.end() && THttpHeaders::NameEqual(*it, name);
+}
+
+namespace {
+    struct TScanContext {
+        const std::vector<std::string>* Targets;
+        std::vector<bool>* Matched;
+        std::string_view Target;
+    };
+}
+
+static int OnMatch(unsigned int id, unsigned long long, unsigned long long, unsigned int, void* context) {
+    TScanContext* scan = static_cast<TScanContext*>(context);
+    if (THttpHeaders::NameEqual((*scan->Targets)[id], scan->Target)) {
+        (*scan->Matched)[id] = true;
+    }
+    return 0;
+}
+
+std::vector<unsigned int> THeaderRegexpDatabase::Scan(const THttpHeaders& headers, const std::string_view* url) const {
+    std::vector<bool> matched(Targets_.size());
+    TScanContext context{ &Targets_, &matched, std::string_view() };
+    TRegexpPool::TScratch scratch = TRegexpPool::Local().AcquireScratch(Db_);
+
+    auto scan = [&](std::string_view value) {
+        hs_error_t res = hs_scan(Db_.Ptr(), value.data(), value.size(), 0, scratch.Get(), &OnMatch, &context);
+        if (res != HS_SUCCESS) {
+            throw TException() << "failed to scan header '" << context.Target << "': " << res;
+        }
+    };
+
+    context.Target = UrlTarget;
+    if (url && Targeted(UrlTarget)) {
+        scan(*url);
+    }
+
+    for (const THttpHeaders::THeader& header : headers) {
+        /* field can not pose as url */
+        if (header.Name != UrlTarget && Targeted(header.Name)) {
+            context.Target = header.Name;
+            scan(header.Value);
+        }
+    }
+
+    std::vector<unsigned int> ids;
+    for (unsigned int id = 0; id < matched.size(); id++) {
+        if (matched[id]) {
+            ids.push_back(id);
+        }
+    }
+    return ids;
+}
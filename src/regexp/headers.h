@@ -0,0 +1,59 @@
+#pragma once
+
+#include "database.h"
+
+#include <handles/http.h>
+#include <util/generic.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Regexp targeting one header of HTTP message, or request url if header is `UrlTarget`.
+ */
+struct THeaderRegexpDef {
+    std::string Header;
+    TRegexpDef Regexp;
+};
+
+/*
+ * Regexps of header rules compiled into one block database. Message is matched with one call:
+ * only values of targeted headers are scanned, with one scratch taken from reactor's pool,
+ * and match is counted only for rules targeting header it is found in.
+ */
+class THeaderRegexpDatabase : TMoveOnly {
+public:
+    static constexpr std::string_view UrlTarget = ":url";
+
+    THeaderRegexpDatabase(std::vector<THeaderRegexpDef> defs);
+
+    /*
+     * @return ids of matched rules, which are their indices in definition, in ascending order.
+     */
+    std::vector<unsigned int> Match(const THttpRequest& request) const;
+    std::vector<unsigned int> Match(const THttpResponse& response) const;
+
+    /*
+     * Matches header fields only, rules targeting url are not matched.
+     */
+    std::vector<unsigned int> Match(const THttpHeaders& headers) const;
+
+    size_t Size() const {
+        return Targets_.size();
+    }
+
+private:
+    std::vector<unsigned int> Scan(const THttpHeaders& headers, const std::string_view* url) const;
+
+    /*
+     * Whether some rule targets header `name`, name is compared case-insensitively without copying it.
+     */
+    bool Targeted(std::string_view name) const;
+
+    TBlockRegexpDatabase Db_;
+    /* lowercased header name of every rule */
+    std::vector<std::string> Targets_;
+    /* lowercased headers which have rules, sorted and unique */
+    std::vector<std::string> Headers_;
+};
@@ -1,9 +1,16 @@
 #include "matchers.h"
 
+#include <algorithm>
+
 int TStreamRegexpMatcher::MatchCallback(unsigned int id, unsigned long long from, unsigned long long to, unsigned int flags, void *context) {
     TStreamRegexpMatcher* matcher = reinterpret_cast<TStreamRegexpMatcher*>(context);
     try {
-        return matcher->Cb_(id, from, to);
+        if (matcher->Cb_(id, from, to)) {
+            matcher->Stopped_ = true;
+            matcher->StoppedFrom_ = from;
+            return 1;
+        }
+        return 0;
     } catch (...) {
         matcher->Exception_ = std::current_exception();
     }
@@ -13,7 +20,9 @@ int TStreamRegexpMatcher::MatchCallback(unsigned int id, unsigned long long from
 bool TStreamRegexpMatcher::Scan(TMemoryRegion region) {
     Exception_ = nullptr;
 
-    hs_error_t res = hs_scan_stream(Stream_, region.DataAs<const char*>(), region.Size(), 0, Scratch_, &TStreamRegexpMatcher::MatchCallback, this);
+    TRegexpPool::TScratch scratch = TRegexpPool::Local().AcquireScratch(Db_);
+    hs_error_t res = hs_scan_stream(Stream_, region.DataAs<const char*>(), region.Size(), 0, scratch.Get(), &TStreamRegexpMatcher::MatchCallback, this);
+    Offset_ += region.Size();
 
     if (res != HS_SUCCESS && res != HS_SCAN_TERMINATED) {
         throw TException() << "failed to parse stream";
@@ -26,19 +35,125 @@ bool TStreamRegexpMatcher::Scan(TMemoryRegion region) {
     return res == HS_SCAN_TERMINATED;
 }
 
+bool TStreamRegexpMatcher::Scan(const TMemoryRegionChain& chain) {
+    Exception_ = nullptr;
+
+    TRegexpPool::TScratch scratch = TRegexpPool::Local().AcquireScratch(Db_);
+    for (const TMemoryRegion& region : chain) {
+        hs_error_t res = hs_scan_stream(Stream_, region.DataAs<const char*>(), region.Size(), 0, scratch.Get(), &TStreamRegexpMatcher::MatchCallback, this);
+        Offset_ += region.Size();
+
+        if (res != HS_SUCCESS && res != HS_SCAN_TERMINATED) {
+            throw TException() << "failed to parse stream";
+        }
+
+        if (Exception_) {
+            std::rethrow_exception(Exception_);
+        }
+
+        if (res == HS_SCAN_TERMINATED) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+size_t TStreamRegexpMatcher::ScanPrefix(TMemoryRegion region) {
+    size_t begin = Offset_;
+    if (!Stopped_ && !Scan(region)) {
+        return region.Size();
+    }
+
+    if (!Stopped_ || StoppedFrom_ <= begin) {
+        return 0;
+    }
+    return std::min(StoppedFrom_ - begin, region.Size());
+}
+
 TStreamRegexpMatcher::TStreamRegexpMatcher(const TStreamRegexpDatabase& db, TStreamRegexpMatcher::TMatchCallback cb)
     : Db_(db)
     , Cb_(cb)
 {
+    /* pool installs stream allocator */
+    TRegexpPool::Local();
+
     hs_error_t res = hs_open_stream(Db_.Ptr(), 0, &Stream_);
 
     if (res != HS_SUCCESS) {
         throw TException() << "cannot open new Hyperscan stream: " << res;
     }
+}
 
-    res = hs_alloc_scratch(Db_.Ptr(), &Scratch_);
+int TBlockRegexpMatcher::MatchCallback(unsigned int id, unsigned long long from, unsigned long long to, unsigned int flags, void *context) {
+    TBlockRegexpMatcher* matcher = reinterpret_cast<TBlockRegexpMatcher*>(context);
+    try {
+        return matcher->Cb_(id, from, to);
+    } catch (...) {
+        matcher->Exception_ = std::current_exception();
+    }
+    return 1;
+}
 
-    if (res != HS_SUCCESS) {
-        throw TException() << "cannot allocate Hyperscan scratch: " << res;
+bool TBlockRegexpMatcher::Scan(TMemoryRegion region) {
+    Exception_ = nullptr;
+
+    TRegexpPool::TScratch scratch = TRegexpPool::Local().AcquireScratch(Db_);
+    hs_error_t res = hs_scan(Db_.Ptr(), region.DataAs<const char*>(), region.Size(), 0, scratch.Get(), &TBlockRegexpMatcher::MatchCallback, this);
+
+    if (res != HS_SUCCESS && res != HS_SCAN_TERMINATED) {
+        throw TException() << "failed to scan block";
+    }
+
+    if (Exception_) {
+        std::rethrow_exception(Exception_);
     }
+
+    return res == HS_SCAN_TERMINATED;
+}
+
+TBlockRegexpMatcher::TBlockRegexpMatcher(const TBlockRegexpDatabase& db, TBlockRegexpMatcher::TMatchCallback cb)
+    : Db_(db)
+    , Cb_(cb)
+{
+}
+
+int TVectoredRegexpMatcher::MatchCallback(unsigned int id, unsigned long long from, unsigned long long to, unsigned int flags, void *context) {
+    TVectoredRegexpMatcher* matcher = reinterpret_cast<TVectoredRegexpMatcher*>(context);
+    try {
+        return matcher->Cb_(id, from, to);
+    } catch (...) {
+        matcher->Exception_ = std::current_exception();
+    }
+    return 1;
+}
+
+bool TVectoredRegexpMatcher::Scan(const TMemoryRegionChain& chain) {
+    Exception_ = nullptr;
+
+    TSmallVector<const char*, TMemoryRegionChain::InlineCapacity> data;
+    TSmallVector<unsigned int, TMemoryRegionChain::InlineCapacity> lengths;
+    for (const TMemoryRegion& region : chain) {
+        data.PushBack(region.DataAs<const char*>());
+        lengths.PushBack(region.Size());
+    }
+
+    TRegexpPool::TScratch scratch = TRegexpPool::Local().AcquireScratch(Db_);
+    hs_error_t res = hs_scan_vector(Db_.Ptr(), data.Data(), lengths.Data(), chain.Size(), 0, scratch.Get(), &TVectoredRegexpMatcher::MatchCallback, this);
+
+    if (res != HS_SUCCESS && res != HS_SCAN_TERMINATED) {
+        throw TException() << "failed to scan vector";
+    }
+
+    if (Exception_) {
+        std::rethrow_exception(Exception_);
+    }
+
+    return res == HS_SCAN_TERMINATED;
+}
+
+TVectoredRegexpMatcher::TVectoredRegexpMatcher(const TVectoredRegexpDatabase& db, TVectoredRegexpMatcher::TMatchCallback cb)
+    : Db_(db)
+    , Cb_(cb)
+{
 }
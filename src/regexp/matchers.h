@@ -1,6 +1,7 @@
 #pragma once
 
 #include "database.h"
+#include "pool.h"
 
 #include <hs/hs_runtime.h>
 #include <core/buffer.h>
@@ -8,6 +9,50 @@
 #include <functional>
 
 
+/*
+ * Scans separate regions, every region is matched from its beginning.
+ * Scratch is taken from reactor's pool for the time of scan.
+ */
+class TBlockRegexpMatcher {
+public:
+    using TMatchCallback = std::function<bool(unsigned int id, size_t from, size_t to)>;
+
+    TBlockRegexpMatcher(const TBlockRegexpDatabase& db, TMatchCallback cb);
+
+    bool Scan(TMemoryRegion region);
+
+private:
+    static int MatchCallback(unsigned int id, unsigned long long from, unsigned long long to, unsigned int flags, void *context);
+
+    const TBlockRegexpDatabase& Db_;
+    TMatchCallback Cb_;
+    std::exception_ptr Exception_;
+};
+
+/*
+ * Scans chain of regions as if it was one contiguous region, so data split between buffers is not copied.
+ * Offsets of matches are counted from the beginning of chain.
+ */
+class TVectoredRegexpMatcher {
+public:
+    using TMatchCallback = std::function<bool(unsigned int id, size_t from, size_t to)>;
+
+    TVectoredRegexpMatcher(const TVectoredRegexpDatabase& db, TMatchCallback cb);
+
+    bool Scan(const TMemoryRegionChain& chain);
+
+private:
+    static int MatchCallback(unsigned int id, unsigned long long from, unsigned long long to, unsigned int flags, void *context);
+
+    const TVectoredRegexpDatabase& Db_;
+    TMatchCallback Cb_;
+    std::exception_ptr Exception_;
+};
+
+/*
+ * Scans stream of regions. Stream state is allocated from reactor's pool,
+ * scratch is taken from it for the time of scan.
+ */
 class TStreamRegexpMatcher {
 public:
     using TMatchCallback = std::function<bool(unsigned int id, size_t from, size_t to)>;
@@ -15,18 +60,45 @@ public:
     TStreamRegexpMatcher(const TStreamRegexpDatabase& db, TMatchCallback cb);
 
     bool Scan(TMemoryRegion region);
+    /*
+     * Scans regions of chain one after another with one scratch, stops at the first region scan is terminated in.
+     */
+    bool Scan(const TMemoryRegionChain& chain);
+
+    /*
+     * Scans region and returns how many bytes of it precede the match scan was stopped at, size of region if it was not stopped.
+     * Start of match is known only for regexps with HS_FLAG_SOM_LEFTMOST, for others nothing of region precedes it.
+     */
+    size_t ScanPrefix(TMemoryRegion region);
+
+    /*
+     * Whether callback has stopped scan, stream is not matched any more then.
+     */
+    bool Stopped() const {
+        return Stopped_;
+    }
+
+    /*
+     * How many bytes were passed to stream.
+     */
+    size_t Offset() const {
+        return Offset_;
+    }
 
     ~TStreamRegexpMatcher() {
-        hs_close_stream(Stream_, Scratch_, nullptr, nullptr);
-        hs_free_scratch(Scratch_);
+        /* without callback matches at the end of stream are not reported, so no scratch is needed */
+        hs_close_stream(Stream_, nullptr, nullptr, nullptr);
     }
 
 private:
     static int MatchCallback(unsigned int id, unsigned long long from, unsigned long long to, unsigned int flags, void *context);
 
     hs_stream_t* Stream_ = nullptr;
-    hs_scratch_t* Scratch_ = nullptr;
     const TStreamRegexpDatabase& Db_;
     TMatchCallback Cb_;
     std::exception_ptr Exception_;
+    size_t Offset_ = 0;
+    bool Stopped_ = false;
+    /* stream offset of match scan was stopped at */
+    size_t StoppedFrom_ = 0;
 };
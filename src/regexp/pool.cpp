@@ -0,0 +1,129 @@
+#include "pool.h"
+
+#include <coro/reactor.h>
+
+#include <cstdlib>
+#include <mutex>
+
+namespace {
+    /* stream state is prefixed with its size, so it can be put to free list of any pool */
+    struct alignas(16) TStreamHeader {
+        size_t Size;
+    };
+}
+
+static void* AllocStreamCallback(size_t size) {
+    return TRegexpPool::Local().AllocStream(size);
+}
+
+static void FreeStreamCallback(void* ptr) {
+    TRegexpPool::FreeStream(ptr);
+}
+
+TRegexpPool::TRegexpPool() {
+    /* allocator is global, it is installed before the first stream is opened */
+    static std::once_flag installed;
+    std::call_once(installed, []() {
+        hs_set_stream_allocator(&AllocStreamCallback, &FreeStreamCallback);
+    });
+}
+
+TRegexpPool::~TRegexpPool() {
+    for (TEntry& entry : Scratches_) {
+        hs_free_scratch(entry.Scratch);
+    }
+
+    for (auto& [size, blocks] : FreeStreams_) {
+        for (void* block : blocks) {
+            ::free(block);
+        }
+    }
+}
+
+TRegexpPool::TScratch TRegexpPool::AcquireScratch(const hs_database_t* db, uint64_t id) {
+    if (FreeScratches_.empty()) {
+        Scratches_.emplace_back();
+        FreeScratches_.push_back(Scratches_.size() - 1);
+    }
+
+    size_t index = FreeScratches_.back();
+    TEntry& entry = Scratches_[index];
+
+    if (entry.Databases.count(id)) {
+        ScratchHits_++;
+    } else {
+        if (entry.Databases.size() >= MaxKnownDatabases) {
+            entry.Databases.clear();
+        }
+
+        /* existing scratch is reallocated only if it is too small for database */
+        hs_error_t res = hs_alloc_scratch(db, &entry.Scratch);
+        if (res != HS_SUCCESS) {
+            throw TException() << "cannot allocate Hyperscan scratch: " << res;
+        }
+        entry.Databases.insert(id);
+        ScratchMisses_++;
+    }
+
+    FreeScratches_.pop_back();
+    return TScratch(this, index);
+}
+
+void* TRegexpPool::AllocStream(size_t size) {
+    auto it = FreeStreams_.find(size);
+    if (it != FreeStreams_.end() && !it->second.empty()) {
+        void* block = it->second.back();
+        it->second.pop_back();
+        FreeStreamBytes_ -= size;
+        StreamHits_++;
+        return static_cast<TStreamHeader*>(block) + 1;
+    }
+
+    StreamMisses_++;
+    TStreamHeader* header = static_cast<TStreamHeader*>(::malloc(sizeof(TStreamHeader) + size));
+    if (!header) {
+        return nullptr;
+    }
+    header->Size = size;
+    return header + 1;
+}
+
+void TRegexpPool::FreeStream(void* ptr) {
+    if (!ptr) {
+        return;
+    }
+
+    TStreamHeader* header = static_cast<TStreamHeader*>(ptr) - 1;
+    Local().ReleaseStream(header, header->Size);
+}
+
+void TRegexpPool::ReleaseStream(void* block, size_t size) {
+    if (FreeStreamBytes_ + size > MaxFreeStreamBytes_) {
+        ::free(block);
+        return;
+    }
+
+    FreeStreams_[size].push_back(block);
+    FreeStreamBytes_ += size;
+}
+
+void TRegexpPool::SetMaxFreeStreamBytes(size_t maxFreeBytes) {
+    MaxFreeStreamBytes_ = maxFreeBytes;
+
+    for (auto& [size, blocks] : FreeStreams_) {
+        while (FreeStreamBytes_ > MaxFreeStreamBytes_ && !blocks.empty()) {
+            ::free(blocks.back());
+            blocks.pop_back();
+            FreeStreamBytes_ -= size;
+        }
+    }
+}
+
+TRegexpPool& TRegexpPool::Local() {
+    if (TReactor* reactor = ReactorIfAny()) {
+        return reactor->RegexpPool();
+    }
+
+    static thread_local TRegexpPool pool;
+    return pool;
+}
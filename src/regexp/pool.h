@@ -0,0 +1,138 @@
+#pragma once
+
+#include "database.h"
+
+#include <hs/hs_runtime.h>
+#include <util/generic.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/*
+ * Hyperscan memory of matchers running on one reactor.
+ *
+ * Scratch is needed only for the time of a scan and scans of one thread do not overlap, unless
+ * match callback switches coroutine. So one scratch grown for every database in use serves
+ * all matchers, another one is made only for overlapping scans.
+ *
+ * Stream states are kept in free lists by their size, which is `hs_stream_size` of database,
+ * so opening stream per connection does not hit malloc.
+ */
+class TRegexpPool : TMoveOnly {
+public:
+    enum : size_t {
+        DefaultMaxFreeStreamBytes = 4 * 1024 * 1024,
+        /* databases scratch was grown for are forgotten beyond this, growing for them again is cheap */
+        MaxKnownDatabases = 1024,
+    };
+
+    /*
+     * Scratch taken from pool, it is given back on destruction.
+     */
+    class TScratch : TMoveOnly {
+    public:
+        TScratch(TScratch&& other) noexcept
+            : Pool_(other.Pool_)
+            , Index_(other.Index_)
+        {
+            other.Pool_ = nullptr;
+        }
+
+        ~TScratch() {
+            if (Pool_) {
+                Pool_->FreeScratches_.push_back(Index_);
+            }
+        }
+
+        hs_scratch_t* Get() const {
+            return Pool_->Scratches_[Index_].Scratch;
+        }
+
+    private:
+        friend class TRegexpPool;
+
+        TScratch(TRegexpPool* pool, size_t index)
+            : Pool_(pool)
+            , Index_(index)
+        {}
+
+        TRegexpPool* Pool_;
+        size_t Index_;
+    };
+
+    TRegexpPool();
+    ~TRegexpPool();
+
+    /*
+     * Returns scratch which fits `db`, it is grown with `hs_alloc_scratch` for databases it has not seen.
+     */
+    template <unsigned int MODE>
+    TScratch AcquireScratch(const TGenericRegexpDatabase<MODE>& db) {
+        return AcquireScratch(db.Ptr(), db.Id());
+    }
+
+    TScratch AcquireScratch(const hs_database_t* db, uint64_t id);
+
+    /*
+     * Memory for stream state, it is installed as Hyperscan stream allocator.
+     */
+    void* AllocStream(size_t size);
+    static void FreeStream(void* ptr);
+
+    void SetMaxFreeStreamBytes(size_t maxFreeBytes);
+
+    /*
+     * Pool of current reactor, threads without reactor get pool of their own.
+     */
+    static TRegexpPool& Local();
+
+    size_t ScratchCount() const {
+        return Scratches_.size();
+    }
+
+    /* scans which took scratch already fitting database */
+    size_t ScratchHits() const {
+        return ScratchHits_;
+    }
+
+    /* scratch allocations and growths */
+    size_t ScratchMisses() const {
+        return ScratchMisses_;
+    }
+
+    size_t FreeStreamBytes() const {
+        return FreeStreamBytes_;
+    }
+
+    size_t StreamHits() const {
+        return StreamHits_;
+    }
+
+    size_t StreamMisses() const {
+        return StreamMisses_;
+    }
+
+private:
+    struct TEntry {
+        hs_scratch_t* Scratch = nullptr;
+        /* ids of databases scratch was grown for */
+        std::unordered_set<uint64_t> Databases;
+    };
+
+    void ReleaseStream(void* block, size_t size);
+
+    std::vector<TEntry> Scratches_;
+    std::vector<size_t> FreeScratches_;
+    size_t ScratchHits_ = 0;
+    size_t ScratchMisses_ = 0;
+
+    /* size of stream state -> free blocks */
+    std::unordered_map<size_t, std::vector<void*>> FreeStreams_;
+    size_t FreeStreamBytes_ = 0;
+    size_t MaxFreeStreamBytes_ = DefaultMaxFreeStreamBytes;
+    size_t StreamHits_ = 0;
+    size_t StreamMisses_ = 0;
+};
@@ -0,0 +1,309 @@
+#include <util/buffer_pool.h>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+static size_t PageSize() {
+    static const size_t pageSize = ::sysconf(_SC_PAGESIZE);
+    return pageSize;
+}
+
+/*
+ * Maps memfd of `size` bytes twice in a row.
+ * @return nullptr on failure.
+ */
+static uint8_t* MapMirrored(size_t size) {
+    int fd = ::memfd_create("portcullis-buffer", MFD_CLOEXEC);
+    if (fd == -1) {
+        return nullptr;
+    }
+
+    if (::ftruncate(fd, size) == -1) {
+        ::close(fd);
+        return nullptr;
+    }
+
+    /* reserve address range for both copies, then put the same pages into each half */
+    void* area = ::mmap(nullptr, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (area == MAP_FAILED) {
+        ::close(fd);
+        return nullptr;
+    }
+
+    uint8_t* data = static_cast<uint8_t*>(area);
+    bool mapped = ::mmap(data, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED
+        && ::mmap(data + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED;
+
+    /* mappings keep memory alive */
+    ::close(fd);
+
+    if (!mapped) {
+        ::munmap(area, 2 * size);
+        return nullptr;
+    }
+
+    return data;
+}
+
+/*
+ * Maps arena backed by huge pages: hugetlbfs pages if they are reserved, transparent huge pages otherwise.
+ * @return nullptr on failure.
+ */
+static uint8_t* MapArena(size_t size) {
+    void* area = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (area != MAP_FAILED) {
+        return static_cast<uint8_t*>(area);
+    }
+
+    /* THP needs arena aligned to huge page size, so twice as much is mapped and the rest is cut off */
+    area = ::mmap(nullptr, 2 * size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (area == MAP_FAILED) {
+        return nullptr;
+    }
+
+    uintptr_t start = reinterpret_cast<uintptr_t>(area);
+    uintptr_t aligned = (start + size - 1) & ~(size - 1);
+    if (aligned > start) {
+        ::munmap(area, aligned - start);
+    }
+    ::munmap(reinterpret_cast<void*>(aligned + size), start + size - aligned);
+
+    ::madvise(reinterpret_cast<void*>(aligned), size, MADV_HUGEPAGE);
+    return reinterpret_cast<uint8_t*>(aligned);
+}
+
+TBufferBlock::TBufferBlock(TBufferBlock&& other) noexcept
+    : Data_(other.Data_)
+    , Size_(other.Size_)
+    , Kind_(other.Kind_)
+    , Pool_(std::move(other.Pool_))
+    , FixedIndex_(other.FixedIndex_)
+{
+    other.Data_ = nullptr;
+    other.Size_ = 0;
+    other.FixedIndex_ = -1;
+}
+
+TBufferBlock& TBufferBlock::operator=(TBufferBlock&& other) noexcept {
+    std::swap(Data_, other.Data_);
+    std::swap(Size_, other.Size_);
+    std::swap(Kind_, other.Kind_);
+    std::swap(Pool_, other.Pool_);
+    std::swap(FixedIndex_, other.FixedIndex_);
+    return *this;
+}
+
+TBufferBlock::~TBufferBlock() {
+    if (!Data_) {
+        return;
+    }
+
+    if (Pool_) {
+        TBufferPool::Release(*Pool_, Data_, Size_, Kind_, FixedIndex_);
+    } else {
+        Free(Data_, Size_, Kind_);
+    }
+}
+
+TBufferBlock TBufferBlock::Allocate(size_t size) {
+    if (size > 0 && size % PageSize() == 0) {
+        if (uint8_t* data = MapMirrored(size)) {
+            return TBufferBlock(data, size, BkMirrored, nullptr);
+        }
+    }
+
+    return TBufferBlock(new uint8_t[size], size, BkHeap, nullptr);
+}
+
+void TBufferBlock::Free(uint8_t* data, size_t size, EKind kind) {
+    switch (kind) {
+        case BkHeap:
+            delete[] data;
+            break;
+        case BkMirrored:
+            ::munmap(data, 2 * size);
+            break;
+        case BkArena:
+            /* released with the whole arena */
+            break;
+    }
+}
+
+size_t TBufferPool::ClassOf(size_t size) {
+    size_t bits = MinClassBits;
+    while ((size_t(1) << bits) < size) {
+        bits++;
+    }
+    return bits - MinClassBits;
+}
+
+TBufferPool::TBufferPool()
+    : Shared_(std::make_shared<TBufferPoolShared>())
+{
+    Shared_->Pool = this;
+}
+
+TBufferBlock TBufferPool::Acquire(size_t size) {
+    if (size > (size_t(1) << MaxClassBits)) {
+        return TBufferBlock::Allocate(size);
+    }
+
+    if (Shared_->HasReturned.load(std::memory_order_acquire)) {
+        TakeReturned();
+    }
+
+    size_t cls = ClassOf(size);
+    size_t blockSize = size_t(1) << (cls + MinClassBits);
+    UsedBytes_ += blockSize;
+
+    std::vector<TFreeBlock>& free = Free_[cls];
+    if (!free.empty()) {
+        Hits_++;
+        TFreeBlock block = free.back();
+        free.pop_back();
+        FreeBytes_ -= blockSize;
+        return TBufferBlock(block.Data, blockSize, block.Kind, Shared_, block.FixedIndex);
+    }
+
+    Misses_++;
+
+    if (HugePages_) {
+        if (uint8_t* data = AllocateFromArena(blockSize)) {
+            return TBufferBlock(data, blockSize, TBufferBlock::BkArena, Shared_);
+        }
+    }
+
+    TBufferBlock block = TBufferBlock::Allocate(blockSize);
+    block.Pool_ = Shared_;
+    AllocatedBytes_ += blockSize;
+    return block;
+}
+
+uint8_t* TBufferPool::AllocateFromArena(size_t size) {
+    /* tail of arena which is too small for the block is wasted, blocks are large powers of two, so it is rare */
+    if (Arenas_.empty() || Arenas_.back().Used + size > ArenaSize) {
+        uint8_t* data = MapArena(ArenaSize);
+        if (!data) {
+            return nullptr;
+        }
+        Arenas_.push_back({ data, 0 });
+        AllocatedBytes_ += ArenaSize;
+    }
+
+    TArena& arena = Arenas_.back();
+    uint8_t* data = arena.Data + arena.Used;
+    arena.Used += size;
+    return data;
+}
+
+void TBufferPool::Release(TBufferPoolShared& shared, uint8_t* data, size_t size, TBufferBlock::EKind kind, int fixedIndex) {
+    /* owner thread destroys pool, so pool is alive while it runs */
+    if (shared.Owner.load(std::memory_order_acquire) == std::this_thread::get_id()) {
+        shared.Pool->Release(data, size, kind, fixedIndex);
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(shared.Lock);
+    if (!shared.Pool) {
+        /* arena blocks are left with their arenas, fixed buffers table is gone with reactor */
+        TBufferBlock::Free(data, size, kind);
+        return;
+    }
+    shared.Returned.push_back({ data, size, kind, fixedIndex });
+    shared.HasReturned.store(true, std::memory_order_release);
+}
+
+void TBufferPool::TakeReturned() {
+    std::vector<TBufferPoolShared::TReturnedBlock> returned;
+    {
+        std::lock_guard<std::mutex> guard(Shared_->Lock);
+        returned.swap(Shared_->Returned);
+        Shared_->HasReturned.store(false, std::memory_order_relaxed);
+    }
+
+    for (const TBufferPoolShared::TReturnedBlock& block : returned) {
+        Release(block.Data, block.Size, block.Kind, block.FixedIndex);
+    }
+}
+
+void TBufferPool::Release(uint8_t* data, size_t size, TBufferBlock::EKind kind, int fixedIndex) {
+    UsedBytes_ -= size;
+
+    TFreeBlock block = { data, kind, fixedIndex };
+
+    if (kind != TBufferBlock::BkArena && FreeBytes_ + size > MaxFreeBytes_) {
+        Free(block, size);
+        AllocatedBytes_ -= size;
+        return;
+    }
+
+    /* blocks are reused in LIFO order, so the most recently used (and cached) memory goes first */
+    Free_[ClassOf(size)].push_back(block);
+    FreeBytes_ += size;
+}
+
+void TBufferPool::Free(const TFreeBlock& block, size_t size) {
+    if (block.FixedIndex >= 0 && FreeHook_) {
+        FreeHook_(block.FixedIndex);
+    }
+    TBufferBlock::Free(block.Data, size, block.Kind);
+}
+
+void TBufferPool::ForgetFixedIndices() {
+    for (std::vector<TFreeBlock>& free : Free_) {
+        for (TFreeBlock& block : free) {
+            block.FixedIndex = -1;
+        }
+    }
+}
+
+void TBufferPool::SetMaxFreeBytes(size_t maxFreeBytes) {
+    MaxFreeBytes_ = maxFreeBytes;
+    Trim();
+}
+
+void TBufferPool::Trim() {
+    for (size_t cls = ClassesCount; cls-- > 0 && FreeBytes_ > MaxFreeBytes_;) {
+        size_t blockSize = size_t(1) << (cls + MinClassBits);
+        std::vector<TFreeBlock>& free = Free_[cls];
+
+        /* the oldest blocks are released first, arena blocks cannot be released */
+        auto it = free.begin();
+        while (it != free.end() && FreeBytes_ > MaxFreeBytes_) {
+            if (it->Kind == TBufferBlock::BkArena) {
+                ++it;
+                continue;
+            }
+            Free(*it, blockSize);
+            AllocatedBytes_ -= blockSize;
+            FreeBytes_ -= blockSize;
+            it = free.erase(it);
+        }
+    }
+}
+
+TBufferPool::~TBufferPool() {
+    /* blocks released from now on free themselves */
+    {
+        std::lock_guard<std::mutex> guard(Shared_->Lock);
+        Shared_->Pool = nullptr;
+        Shared_->Owner.store(std::thread::id(), std::memory_order_release);
+    }
+    for (const TBufferPoolShared::TReturnedBlock& block : Shared_->Returned) {
+        Release(block.Data, block.Size, block.Kind, block.FixedIndex);
+    }
+
+    for (size_t cls = 0; cls < ClassesCount; cls++) {
+        size_t blockSize = size_t(1) << (cls + MinClassBits);
+        for (TFreeBlock& block : Free_[cls]) {
+            Free(block, blockSize);
+        }
+    }
+
+    /* blocks still handed out may lie in arenas, then arenas are left mapped */
+    if (UsedBytes_ == 0) {
+        for (TArena& arena : Arenas_) {
+            ::munmap(arena.Data, ArenaSize);
+        }
+    }
+}
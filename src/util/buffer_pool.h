@@ -0,0 +1,255 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <util/generic.h>
+
+class TBufferPool;
+struct TBufferPoolShared;
+
+/*
+ * Block of memory backing socket buffer.
+ * Pooled block is returned to its pool on destruction, otherwise it is released.
+ */
+class TBufferBlock : TMoveOnly {
+public:
+    enum EKind {
+        /* array allocated with new[] */
+        BkHeap = 0,
+        /* memory is mapped twice in a row, so `Data()[i] == Data()[i + Size()]` */
+        BkMirrored = 1,
+        /* part of hugepage arena, it is never released separately */
+        BkArena = 2,
+    };
+
+    TBufferBlock() = default;
+    TBufferBlock(TBufferBlock&& other) noexcept;
+    TBufferBlock& operator=(TBufferBlock&& other) noexcept;
+    ~TBufferBlock();
+
+    /*
+     * Allocates standalone block of exactly `size` bytes, which is mirrored if `size` is a multiple of page size.
+     */
+    static TBufferBlock Allocate(size_t size);
+
+    explicit operator bool() const {
+        return Data_ != nullptr;
+    }
+
+    uint8_t* Data() const {
+        return Data_;
+    }
+
+    size_t Size() const {
+        return Size_;
+    }
+
+    EKind Kind() const {
+        return Kind_;
+    }
+
+    bool Mirrored() const {
+        return Kind_ == BkMirrored;
+    }
+
+    /*
+     * Length of address range occupied by block.
+     */
+    size_t MappedSize() const {
+        return Mirrored() ? 2 * Size_ : Size_;
+    }
+
+    bool Pooled() const {
+        return static_cast<bool>(Pool_);
+    }
+
+    /*
+     * Slot of pooled block in io_uring fixed buffers table, it stays with block while block is reused.
+     * Pool calls its free hook before block is released, so slot can be cleared.
+     */
+    int FixedIndex() const {
+        return FixedIndex_;
+    }
+
+    void SetFixedIndex(int index) {
+        ASSERT(Pooled());
+        FixedIndex_ = index;
+    }
+
+private:
+    friend class TBufferPool;
+
+    TBufferBlock(uint8_t* data, size_t size, EKind kind, std::shared_ptr<TBufferPoolShared> pool, int fixedIndex = -1)
+        : Data_(data)
+        , Size_(size)
+        , Kind_(kind)
+        , Pool_(std::move(pool))
+        , FixedIndex_(fixedIndex)
+    {
+    }
+
+    static void Free(uint8_t* data, size_t size, EKind kind);
+
+    uint8_t* Data_ = nullptr;
+    size_t Size_ = 0;
+    EKind Kind_ = BkHeap;
+    /* if set, block is returned to this pool on destruction */
+    std::shared_ptr<TBufferPoolShared> Pool_;
+    int FixedIndex_ = -1;
+};
+
+/*
+ * Part of pool which blocks may reach from any thread. Blocks keep it alive, so they are released
+ * correctly after pool is gone too.
+ */
+struct TBufferPoolShared {
+    struct TReturnedBlock {
+        uint8_t* Data;
+        size_t Size;
+        TBufferBlock::EKind Kind;
+        int FixedIndex;
+    };
+
+    /* only owner thread touches free lists, blocks released on other threads are queued */
+    std::atomic<std::thread::id> Owner{ std::this_thread::get_id() };
+    std::atomic<bool> HasReturned{ false };
+    std::mutex Lock;
+    /* guarded by `Lock`, pool is reset when it is destroyed */
+    TBufferPool* Pool = nullptr;
+    std::vector<TReturnedBlock> Returned;
+};
+
+/*
+ * Size-classed pool of buffer blocks, one per reactor.
+ * Pool is used by thread of its reactor, blocks released on other threads (e.g. buffers of Python objects
+ * collected elsewhere) are queued and taken back on the next `Acquire`.
+
+ * Requested sizes are rounded up to power of two classes from 4 KiB to 1 MiB,
+ * larger blocks are not pooled. Free blocks beyond `maxFreeBytes` are released,
+ * so memory of idle pool stays bounded after connection spikes.
+ *
+ * With hugepages enabled, new blocks are carved from 2 MiB arenas backed by huge pages,
+ * which cuts TLB misses on the data path. Arena blocks are not mirrored and never given back
+ * to the kernel until pool is destroyed.
+ */
+class TBufferPool : TMoveOnly {
+public:
+    static constexpr size_t MinClassBits = 12;
+    static constexpr size_t MaxClassBits = 20;
+    static constexpr size_t ClassesCount = MaxClassBits - MinClassBits + 1;
+    static constexpr size_t ArenaSize = 2 * 1024 * 1024;
+
+    enum : size_t {
+        DefaultMaxFreeBytes = 64 * 1024 * 1024,
+    };
+
+    using TFreeHook = std::function<void(int fixedIndex)>;
+
+    TBufferPool();
+    ~TBufferPool();
+
+    /*
+     * Makes calling thread the owner of pool, it is the thread pool is created on until then.
+     */
+    void BindToThread() {
+        Shared_->Owner.store(std::this_thread::get_id(), std::memory_order_release);
+    }
+
+    /*
+     * Sets callback called for every released block which has fixed index.
+     */
+    void OnFree(TFreeHook hook) {
+        FreeHook_ = std::move(hook);
+    }
+
+    /*
+     * Resets fixed indices of free blocks, e.g. when fixed buffers table is gone.
+     */
+    void ForgetFixedIndices();
+
+    /*
+     * Returns block of at least `size` bytes.
+     */
+    TBufferBlock Acquire(size_t size);
+
+    void SetMaxFreeBytes(size_t maxFreeBytes);
+
+    /*
+     * Affects only blocks allocated after the call.
+     */
+    void SetHugePages(bool enabled) {
+        HugePages_ = enabled;
+    }
+
+    /* memory mapped or allocated by pool, including arenas */
+    size_t AllocatedBytes() const {
+        return AllocatedBytes_;
+    }
+
+    /* memory of blocks handed out and not returned yet */
+    size_t UsedBytes() const {
+        return UsedBytes_;
+    }
+
+    /* memory of free blocks kept in pool */
+    size_t FreeBytes() const {
+        return FreeBytes_;
+    }
+
+    size_t Hits() const {
+        return Hits_;
+    }
+
+    size_t Misses() const {
+        return Misses_;
+    }
+
+private:
+    friend class TBufferBlock;
+
+    struct TFreeBlock {
+        uint8_t* Data;
+        TBufferBlock::EKind Kind;
+        int FixedIndex;
+    };
+
+    struct TArena {
+        uint8_t* Data;
+        size_t Used;
+    };
+
+    static size_t ClassOf(size_t size);
+
+    /*
+     * Returns block to pool of `shared`, may be called on any thread.
+     */
+    static void Release(TBufferPoolShared& shared, uint8_t* data, size_t size, TBufferBlock::EKind kind, int fixedIndex);
+
+    uint8_t* AllocateFromArena(size_t size);
+    void Release(uint8_t* data, size_t size, TBufferBlock::EKind kind, int fixedIndex);
+    void TakeReturned();
+    void Free(const TFreeBlock& block, size_t size);
+    void Trim();
+
+    std::shared_ptr<TBufferPoolShared> Shared_;
+    std::array<std::vector<TFreeBlock>, ClassesCount> Free_;
+    std::vector<TArena> Arenas_;
+    TFreeHook FreeHook_;
+
+    size_t MaxFreeBytes_ = DefaultMaxFreeBytes;
+    bool HugePages_ = false;
+
+    size_t AllocatedBytes_ = 0;
+    size_t UsedBytes_ = 0;
+    size_t FreeBytes_ = 0;
+    size_t Hits_ = 0;
+    size_t Misses_ = 0;
+};
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+
+#include <util/exception.h>
+
+/*
+ * Node embedded into list element. Element may be linked into several lists
+ * simultaneously, if it inherits several items with different tags.
+ */
+template <typename Tag = void>
+class TIntrusiveListItem {
+public:
+    TIntrusiveListItem() = default;
+
+    TIntrusiveListItem(const TIntrusiveListItem&) = delete;
+    TIntrusiveListItem& operator=(const TIntrusiveListItem&) = delete;
+
+    ~TIntrusiveListItem() {
+        Unlink();
+    }
+
+    bool Linked() const {
+        return Next_ != this;
+    }
+
+    void Unlink() {
+        Prev_->Next_ = Next_;
+        Next_->Prev_ = Prev_;
+        Prev_ = this;
+        Next_ = this;
+    }
+
+private:
+    template <typename T, typename TTag>
+    friend class TIntrusiveList;
+
+    void LinkBefore(TIntrusiveListItem* next) {
+        ASSERT(!Linked());
+        Prev_ = next->Prev_;
+        Next_ = next;
+        Prev_->Next_ = this;
+        next->Prev_ = this;
+    }
+
+    TIntrusiveListItem* Prev_ = this;
+    TIntrusiveListItem* Next_ = this;
+};
+
+/*
+ * Doubly linked list, which does not own its elements and never allocates.
+ * `T` must inherit `TIntrusiveListItem<Tag>`.
+ */
+template <typename T, typename Tag = void>
+class TIntrusiveList {
+    using TItem = TIntrusiveListItem<Tag>;
+
+public:
+    class TIterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = T*;
+        using reference = T&;
+
+        TIterator(TItem* item)
+            : Item_(item)
+        {}
+
+        T& operator*() const {
+            return *static_cast<T*>(Item_);
+        }
+
+        T* operator->() const {
+            return static_cast<T*>(Item_);
+        }
+
+        TIterator& operator++() {
+            Item_ = Item_->Next_;
+            return *this;
+        }
+
+        bool operator==(const TIterator& other) const {
+            return Item_ == other.Item_;
+        }
+
+        bool operator!=(const TIterator& other) const {
+            return Item_ != other.Item_;
+        }
+
+    private:
+        TItem* Item_;
+    };
+
+    TIntrusiveList() = default;
+
+    TIntrusiveList(const TIntrusiveList&) = delete;
+    TIntrusiveList& operator=(const TIntrusiveList&) = delete;
+
+    TIntrusiveList(TIntrusiveList&& other) {
+        Append(other);
+    }
+
+    ~TIntrusiveList() {
+        Clear();
+    }
+
+    bool Empty() const {
+        return !Root_.Linked();
+    }
+
+    T* Front() const {
+        ASSERT(!Empty());
+        return static_cast<T*>(Root_.Next_);
+    }
+
+    T* Back() const {
+        ASSERT(!Empty());
+        return static_cast<T*>(Root_.Prev_);
+    }
+
+    void PushBack(T* value) {
+        static_cast<TItem*>(value)->LinkBefore(&Root_);
+    }
+
+    void PushFront(T* value) {
+        static_cast<TItem*>(value)->LinkBefore(Root_.Next_);
+    }
+
+    T* PopFront() {
+        T* front = Front();
+        Remove(front);
+        return front;
+    }
+
+    static void Remove(T* value) {
+        static_cast<TItem*>(value)->Unlink();
+    }
+
+    /*
+     * Moves all elements of `other` to the end of this list in O(1).
+     */
+    void Append(TIntrusiveList& other) {
+        if (other.Empty()) {
+            return;
+        }
+
+        TItem* first = other.Root_.Next_;
+        TItem* last = other.Root_.Prev_;
+        other.Root_.Next_ = &other.Root_;
+        other.Root_.Prev_ = &other.Root_;
+
+        first->Prev_ = Root_.Prev_;
+        Root_.Prev_->Next_ = first;
+        last->Next_ = &Root_;
+        Root_.Prev_ = last;
+    }
+
+    /*
+     * Unlinks all elements, elements themselves are untouched.
+     */
+    void Clear() {
+        while (!Empty()) {
+            Root_.Next_->Unlink();
+        }
+    }
+
+    TIterator begin() const {
+        return TIterator(Root_.Next_);
+    }
+
+    TIterator end() const {
+        return TIterator(const_cast<TItem*>(&Root_));
+    }
+
+private:
+    TItem Root_;
+};
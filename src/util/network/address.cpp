@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <vector>
 #include <cstring>
 
@@ -9,6 +10,7 @@
 TSocketAddress::TSocketAddress()
     : Len_(sizeof(sockaddr_storage))
 {
+    memset(&Addr_, 0, sizeof(Addr_));
 }
 
 TSocketAddress::TSocketAddress(const sockaddr* sa, size_t len)
@@ -50,6 +52,24 @@ bool TSocketAddress::operator==(const TSocketAddress& other) const {
     throw TException() << "unknown family " << sa1->sa_family;
 }
 
+size_t TSocketAddress::HostHash() const {
+    const sockaddr* sa = AddressAs<const sockaddr*>();
+
+    if (sa->sa_family == AF_INET) {
+        const sockaddr_in* in = reinterpret_cast<const sockaddr_in*>(sa);
+        return std::hash<std::string_view>()(std::string_view(reinterpret_cast<const char*>(&in->sin_addr), sizeof(in->sin_addr)));
+    } else if (sa->sa_family == AF_INET6) {
+        const sockaddr_in6* in6 = reinterpret_cast<const sockaddr_in6*>(sa);
+        return std::hash<std::string_view>()(std::string_view(reinterpret_cast<const char*>(&in6->sin6_addr), sizeof(in6->sin6_addr)));
+    }
+
+    throw TException() << "unknown family " << sa->sa_family;
+}
+
+size_t TSocketAddress::Hash() const {
+    return HostHash() ^ (static_cast<size_t>(Port()) * 0x9e3779b97f4a7c15ull);
+}
+
 std::string TSocketAddress::Host() const {
     char hostStr[std::max(INET_ADDRSTRLEN, INET6_ADDRSTRLEN)];
     const sockaddr* sa = reinterpret_cast<const sockaddr*>(&Addr_);
@@ -133,7 +153,7 @@ std::vector<TSocketAddress> GetAddrInfo(const std::string& host, const std::stri
     return addresses;
 }
 
-TSocketAddress Resolve(const std::string& addressString, EIpVersionMode mode) {
+std::vector<TSocketAddress> ResolveAll(const std::string& addressString, EIpVersionMode mode) {
     size_t protoDelimPos = addressString.find("://");
     if (protoDelimPos == std::string::npos) {
         throw TException() << "malformed resolve-string: '" << addressString << "'";
@@ -149,9 +169,18 @@ TSocketAddress Resolve(const std::string& addressString, EIpVersionMode mode) {
     std::string host = addressString.substr(protoDelimPos + 3, hostDelimPos - (protoDelimPos + 3));
     std::string service = addressString.substr(hostDelimPos + 1);
 
-    TSocketAddress addr = GetAddrInfo(host, service, false, proto, mode)[0];
+    std::vector<TSocketAddress> resolved;
+    for (const TSocketAddress& addr : GetAddrInfo(host, service, false, proto, mode)) {
+        if (std::find(resolved.begin(), resolved.end(), addr) == resolved.end()) {
+            resolved.push_back(addr);
+        }
+    }
+
+    return resolved;
+}
 
-    return addr;
+TSocketAddress Resolve(const std::string& addressString, EIpVersionMode mode) {
+    return ResolveAll(addressString, mode)[0];
 }
 
 TSocketAddress ResolveV46(const std::string& addressString) {
@@ -1,7 +1,9 @@
 #pragma once
 
 #include <netdb.h>
+#include <functional>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <type_traits>
 
@@ -45,11 +47,30 @@ public:
         return !(*this == other);
     };
 
+    /*
+     * Hash consistent with `operator==`: only family, host and port are taken into account.
+     */
+    size_t Hash() const;
+
+    /*
+     * Hash of host only, addresses which differ only in port have the same one.
+     */
+    size_t HostHash() const;
+
 private:
     sockaddr_storage Addr_;
     socklen_t Len_;
 };
 
+namespace std {
+    template <>
+    struct hash<TSocketAddress> {
+        size_t operator()(const TSocketAddress& addr) const {
+            return addr.Hash();
+        }
+    };
+}
+
 enum EIpVersionMode {
     V4_AND_V6 = 0,
     V4_ONLY = 1,
@@ -58,6 +79,11 @@ enum EIpVersionMode {
 
 std::vector<TSocketAddress> GetAddrInfo(const std::string& host, const std::string& service, bool listener, const std::string& protocol, EIpVersionMode = V4_AND_V6);
 
+/*
+ * Resolves string like "tcp://host:port" to all addresses of host, duplicates are removed.
+ */
+std::vector<TSocketAddress> ResolveAll(const std::string& addressString, EIpVersionMode mode);
+
 TSocketAddress Resolve(const std::string& addressString, EIpVersionMode mode);
 
 TSocketAddress ResolveV46(const std::string& addressString);
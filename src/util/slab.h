@@ -0,0 +1,80 @@
+#pragma once
+
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <util/generic.h>
+
+/*
+ * Allocates objects of type `T` from chunks of `ChunkSize` objects.
+ * Freed slots are kept in free list, so allocations in steady state
+ * never reach malloc. Memory is returned only on slab destruction.
+ */
+template <typename T, size_t ChunkSize = 64>
+class TSlab : public TMoveOnly {
+public:
+    TSlab() = default;
+
+    template <typename... Args>
+    T* New(Args&&... args) {
+        if (!FreeList_) {
+            Grow();
+        }
+
+        TSlot* slot = FreeList_;
+        FreeList_ = slot->Next;
+
+        try {
+            T* object = new (&slot->Storage) T(std::forward<Args>(args)...);
+            Allocated_++;
+            return object;
+        } catch (...) {
+            slot->Next = FreeList_;
+            FreeList_ = slot;
+            throw;
+        }
+    }
+
+    void Delete(T* object) {
+        object->~T();
+        TSlot* slot = reinterpret_cast<TSlot*>(object);
+        slot->Next = FreeList_;
+        FreeList_ = slot;
+        Allocated_--;
+    }
+
+    /*
+     * Number of live objects.
+     */
+    size_t Allocated() const {
+        return Allocated_;
+    }
+
+    /*
+     * Number of object slots, both free and used.
+     */
+    size_t Capacity() const {
+        return Chunks_.size() * ChunkSize;
+    }
+
+private:
+    union TSlot {
+        TSlot* Next;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type Storage;
+    };
+
+    void Grow() {
+        std::unique_ptr<TSlot[]>& chunk = Chunks_.emplace_back(new TSlot[ChunkSize]);
+        for (size_t i = 0; i < ChunkSize; i++) {
+            chunk[i].Next = FreeList_;
+            FreeList_ = &chunk[i];
+        }
+    }
+
+    std::vector<std::unique_ptr<TSlot[]>> Chunks_;
+    TSlot* FreeList_ = nullptr;
+    size_t Allocated_ = 0;
+};
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+#include <util/exception.h>
+
+/*
+ * Vector which keeps up to `N` elements inline and goes to heap only when it grows beyond that,
+ * so short sequences built on the data path never reach malloc.
+ * `T` must be trivially copyable, elements are moved with memcpy.
+ */
+template <typename T, size_t N>
+class TSmallVector {
+    static_assert(std::is_trivially_copyable_v<T>, "TSmallVector stores only trivially copyable types");
+
+public:
+    using value_type = T;
+    using iterator = T*;
+    using const_iterator = const T*;
+
+    TSmallVector() = default;
+
+    TSmallVector(std::initializer_list<T> items) {
+        for (const T& item : items) {
+            PushBack(item);
+        }
+    }
+
+    TSmallVector(const TSmallVector& other) {
+        Assign(other);
+    }
+
+    TSmallVector& operator=(const TSmallVector& other) {
+        if (this != &other) {
+            Clear();
+            Assign(other);
+        }
+        return *this;
+    }
+
+    TSmallVector(TSmallVector&& other) noexcept {
+        Steal(other);
+    }
+
+    TSmallVector& operator=(TSmallVector&& other) noexcept {
+        if (this != &other) {
+            Clear();
+            Steal(other);
+        }
+        return *this;
+    }
+
+    void PushBack(const T& item) {
+        if (Size_ == Capacity_) {
+            Grow(2 * Capacity_);
+        }
+        Data_[Size_++] = item;
+    }
+
+    void PopBack() {
+        ASSERT(Size_ > 0);
+        Size_--;
+    }
+
+    /*
+     * Removes element at `index`, order of the rest is preserved.
+     */
+    void Erase(size_t index) {
+        ASSERT(index < Size_);
+        ::memmove(Data_ + index, Data_ + index + 1, (Size_ - index - 1) * sizeof(T));
+        Size_--;
+    }
+
+    void Reserve(size_t capacity) {
+        if (capacity > Capacity_) {
+            Grow(capacity);
+        }
+    }
+
+    /*
+     * Drops elements, but keeps memory.
+     */
+    void Clear() {
+        Size_ = 0;
+    }
+
+    T& operator[](size_t index) {
+        ASSERT(index < Size_);
+        return Data_[index];
+    }
+
+    const T& operator[](size_t index) const {
+        ASSERT(index < Size_);
+        return Data_[index];
+    }
+
+    T& Back() {
+        return (*this)[Size_ - 1];
+    }
+
+    T* Data() {
+        return Data_;
+    }
+
+    const T* Data() const {
+        return Data_;
+    }
+
+    size_t Size() const {
+        return Size_;
+    }
+
+    bool Empty() const {
+        return Size_ == 0;
+    }
+
+    /*
+     * Whether elements are stored inline.
+     */
+    bool Inline() const {
+        return Data_ == Inline_;
+    }
+
+    T* begin() {
+        return Data_;
+    }
+
+    T* end() {
+        return Data_ + Size_;
+    }
+
+    const T* begin() const {
+        return Data_;
+    }
+
+    const T* end() const {
+        return Data_ + Size_;
+    }
+
+private:
+    void Assign(const TSmallVector& other) {
+        Reserve(other.Size_);
+        ::memcpy(Data_, other.Data_, other.Size_ * sizeof(T));
+        Size_ = other.Size_;
+    }
+
+    void Steal(TSmallVector& other) {
+        if (other.Inline()) {
+            Assign(other);
+        } else {
+            Heap_ = std::move(other.Heap_);
+            Data_ = Heap_.get();
+            Size_ = other.Size_;
+            Capacity_ = other.Capacity_;
+            other.Data_ = other.Inline_;
+            other.Capacity_ = N;
+        }
+        other.Size_ = 0;
+    }
+
+    void Grow(size_t capacity) {
+        std::unique_ptr<T[]> heap(new T[capacity]);
+        ::memcpy(heap.get(), Data_, Size_ * sizeof(T));
+        Heap_ = std::move(heap);
+        Data_ = Heap_.get();
+        Capacity_ = capacity;
+    }
+
+    T Inline_[N];
+    std::unique_ptr<T[]> Heap_;
+    T* Data_ = Inline_;
+    size_t Size_ = 0;
+    size_t Capacity_ = N;
+};
@@ -15,6 +15,19 @@ inline void SetNonBlocking(int fd) {
     }
 }
 
+inline void SetBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL);
+    if (flags == -1) {
+        char error[4096];
+        throw TException() << "fcntl failed: " << strerror_r(errno, error, sizeof(error));
+    }
+    flags &= ~O_NONBLOCK;
+    if (fcntl(fd, F_SETFL, flags) == -1) {
+        char error[4096];
+        throw TException() << "fcntl failed: " << strerror_r(errno, error, sizeof(error));
+    }
+}
+
 inline int64_t GetCurrentMillis() {
     timespec ts;
     if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1) {
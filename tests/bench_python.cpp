@@ -0,0 +1,105 @@
+#include <chrono>
+#include <cstdio>
+
+#include <pybind11/embed.h>
+
+#include <coro/reactor.h>
+#include <python/thread_states.h>
+
+/*
+ * Overhead python handlers pay for running in coroutines: entering python per connection
+ * and blocking calls made from handler. Calls which release GIL by themselves show the cost
+ * of the former model, where every blocking call swapped thread state out and in.
+ * Run `python-bench` manually and compare numbers between revisions.
+ */
+
+namespace py = pybind11;
+
+using TClock = std::chrono::steady_clock;
+
+static double NanosPerOp(TClock::time_point start, size_t ops) {
+    return std::chrono::duration<double, std::nano>(TClock::now() - start).count() / ops;
+}
+
+/*
+ * Runs `body` in python in `count` coroutines of fresh reactor, GIL of main thread is released meanwhile.
+ */
+template <typename TBody>
+static void RunPython(PyThreadState* main, size_t count, TBody body) {
+    TReactor reactor(spdlog::get("reactor"));
+    TPyThreadStates states;
+    states.Attach(&reactor, main->interp);
+
+    for (size_t i = 0; i < count; i++) {
+        reactor.StartCoroutine([&states, &body]() {
+            if (!states.Enter()) {
+                return;
+            }
+            body();
+            states.Leave();
+        });
+    }
+    reactor.Run();
+
+    PyEval_RestoreThread(main);
+    const auto& internals = py::detail::get_internals();
+    PyThread_set_key_value(internals.tstate, main);
+    states.Clear();
+    PyEval_SaveThread();
+}
+
+static void BenchHandlerCall(PyThreadState* main, const py::object& handler, const py::object& call, size_t connections) {
+    TClock::time_point start = TClock::now();
+    RunPython(main, connections, [&handler, &call]() {
+        handler(call, 0);
+    });
+    printf("handler call: %zu connections, %.1f ns/connection\n", connections, NanosPerOp(start, connections));
+}
+
+static void BenchBlockingCalls(const char* name, PyThreadState* main, const py::object& handler, const py::object& call, size_t coroutines, size_t iterations) {
+    TClock::time_point start = TClock::now();
+    RunPython(main, coroutines, [&handler, &call, iterations]() {
+        handler(call, iterations);
+    });
+    printf("%s: %zu calls, %.1f ns/call\n", name, coroutines * iterations, NanosPerOp(start, coroutines * iterations));
+}
+
+int main(int argc, char* argv[]) {
+    spdlog::stdout_color_mt("reactor");
+    py::scoped_interpreter interpreter;
+
+    {
+        py::exec(R"(
+def handler(call, n):
+    for _ in range(n):
+        call()
+)");
+        py::object handler = py::globals()["handler"];
+
+        /* blocking call which completed without switch, like read of buffered data */
+        py::object ready = py::cpp_function([]() {});
+        py::object readyReleasing = py::cpp_function([]() {
+            TPyReleaseGuard guard;
+        });
+        /* blocking call which waited, other coroutine ran meanwhile */
+        py::object waited = py::cpp_function([]() {
+            Reactor()->Yield();
+        });
+        py::object waitedReleasing = py::cpp_function([]() {
+            TPyReleaseGuard guard;
+            Reactor()->Yield();
+        });
+
+        PyThreadState* main = PyEval_SaveThread();
+
+        BenchHandlerCall(main, handler, ready, 200000);
+        BenchBlockingCalls("ready call", main, handler, ready, 1, 2000000);
+        BenchBlockingCalls("ready call, releasing GIL", main, handler, readyReleasing, 1, 2000000);
+        BenchBlockingCalls("waited call", main, handler, waited, 2, 1000000);
+        BenchBlockingCalls("waited call, releasing GIL", main, handler, waitedReleasing, 2, 1000000);
+
+        PyEval_RestoreThread(main);
+    }
+
+    return 0;
+}
@@ -0,0 +1,179 @@
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <coro/reactor.h>
+#include <core/buffer.h>
+
+/*
+ * Microbenchmarks of reactor hot paths. They are not part of test suite,
+ * run `reactor-bench` manually and compare numbers between revisions.
+ */
+
+using TClock = std::chrono::steady_clock;
+
+static double NanosPerOp(TClock::time_point start, size_t ops) {
+    return std::chrono::duration<double, std::nano>(TClock::now() - start).count() / ops;
+}
+
+static void BenchYieldPingPong(size_t iterations) {
+    TReactor reactor(spdlog::get("reactor"));
+
+    for (int i = 0; i < 2; i++) {
+        reactor.StartCoroutine([iterations]() {
+            for (size_t j = 0; j < iterations; j++) {
+                Reactor()->Yield();
+            }
+        });
+    }
+
+    TClock::time_point start = TClock::now();
+    reactor.Run();
+    printf("yield ping-pong: %zu switches, %.1f ns/switch\n", 2 * iterations, NanosPerOp(start, 2 * iterations));
+}
+
+static void BenchStartCoroutine(size_t iterations) {
+    TReactor reactor(spdlog::get("reactor"));
+
+    reactor.StartCoroutine([iterations]() {
+        for (size_t i = 0; i < iterations; i++) {
+            Reactor()->StartCoroutine([]() {});
+            Reactor()->Yield();
+        }
+    });
+
+    TClock::time_point start = TClock::now();
+    reactor.Run();
+    printf("start coroutine: %zu coroutines, %.1f ns/coroutine\n", iterations, NanosPerOp(start, iterations));
+}
+
+/*
+ * Two coroutines bounce a byte through a pair of pipes.
+ */
+static void BenchPipePingPong(const char* name, TReactor::EIoBackend backend, size_t iterations) {
+    TReactor reactor(spdlog::get("reactor"));
+    if (!reactor.SetIoBackend(backend)) {
+        return;
+    }
+
+    int ping[2];
+    int pong[2];
+    if (pipe2(ping, O_NONBLOCK) == -1 || pipe2(pong, O_NONBLOCK) == -1) {
+        return;
+    }
+    for (int fd : { ping[0], ping[1], pong[0], pong[1] }) {
+        reactor.RegisterNonBlockingFd(fd);
+    }
+
+    reactor.StartCoroutine([&ping, &pong, iterations]() {
+        char byte = 0;
+        for (size_t i = 0; i < iterations; i++) {
+            Reactor()->Write(ping[1], &byte, 1);
+            Reactor()->Read(pong[0], &byte, 1);
+        }
+    });
+
+    reactor.StartCoroutine([&ping, &pong, iterations]() {
+        char byte = 0;
+        for (size_t i = 0; i < iterations; i++) {
+            Reactor()->Read(ping[0], &byte, 1);
+            Reactor()->Write(pong[1], &byte, 1);
+        }
+    });
+
+    TClock::time_point start = TClock::now();
+    reactor.Run();
+    printf("%s pipe ping-pong: %zu round trips, %.1f ns/round trip\n", name, iterations, NanosPerOp(start, iterations));
+
+    for (int fd : { ping[0], ping[1], pong[0], pong[1] }) {
+        reactor.CloseFd(fd);
+        close(fd);
+    }
+}
+
+/*
+ * Pushes `count` timers spread over a minute, cancels half of them and expires the rest.
+ */
+static void BenchDeadlineQueue(const char* name, TReactor::TDeadlineQueue& queue, TReactor::TDeadline now, size_t count) {
+    std::unique_ptr<TReactor::TCoroutine[]> coros(new TReactor::TCoroutine[count]);
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<int64_t> delay(1, 60000000);
+
+    for (size_t i = 0; i < count; i++) {
+        coros[i].Deadline = now + std::chrono::microseconds(delay(rng));
+    }
+
+    TClock::time_point start = TClock::now();
+    for (size_t i = 0; i < count; i++) {
+        queue.Push(&coros[i]);
+    }
+    double pushTime = NanosPerOp(start, count);
+
+    start = TClock::now();
+    for (size_t i = 0; i < count; i += 2) {
+        queue.Remove(&coros[i]);
+    }
+    double removeTime = NanosPerOp(start, count / 2);
+
+    size_t expired = 0;
+    start = TClock::now();
+    for (TReactor::TDeadline t = now; !queue.Empty(); t += std::chrono::milliseconds(1)) {
+        queue.PopExpired(t, [&expired](TReactor::TCoroutine*) {
+            expired++;
+        });
+    }
+    double expireTime = NanosPerOp(start, expired);
+
+    printf("%s: %zu timers, push %.1f ns, remove %.1f ns, expire %.1f ns\n", name, count, pushTime, removeTime, expireTime);
+}
+
+static void BenchDeadlineQueues(size_t count) {
+    TReactor::TDeadline now = TClock::now();
+
+    TReactor::THeapDeadlineQueue heap;
+    BenchDeadlineQueue("heap", heap, now, count);
+
+    TReactor::TTimerWheel wheel(now);
+    BenchDeadlineQueue("timer wheel", wheel, now, count);
+}
+
+/*
+ * Connection churn: every connection allocates read buffer and frees it on close.
+ */
+static void BenchSocketBuffers(size_t iterations) {
+    TClock::time_point start = TClock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        TSocketBuffer buffer(TSocketBuffer::DefaultSize);
+        buffer.Append('x');
+    }
+    printf("socket buffer, standalone: %.1f ns/buffer\n", NanosPerOp(start, iterations));
+
+    TBufferPool pool;
+    start = TClock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        TSocketBuffer buffer(pool, TSocketBuffer::DefaultSize);
+        buffer.Append('x');
+    }
+    printf("socket buffer, pooled: %.1f ns/buffer\n", NanosPerOp(start, iterations));
+}
+
+int main(int argc, char* argv[]) {
+    spdlog::stdout_color_mt("reactor");
+
+    BenchYieldPingPong(5000000);
+    BenchStartCoroutine(1000000);
+    BenchSocketBuffers(100000);
+
+    BenchPipePingPong("epoll", TReactor::IoEpoll, 200000);
+    BenchPipePingPong("io_uring", TReactor::IoUring, 200000);
+
+    for (size_t count : { 10000, 100000, 1000000 }) {
+        BenchDeadlineQueues(count);
+    }
+
+    return 0;
+}
@@ -0,0 +1,121 @@
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <coro/reactor.h>
+#include <handles/tcp.h>
+
+/*
+ * Benchmark of body forwarding: 1 GiB is pushed through a proxy coroutine
+ * between two loopback TCP connections, once copied through user space buffer
+ * and once spliced. Run `transfer-bench` manually and compare numbers between revisions.
+ */
+
+using TClock = std::chrono::steady_clock;
+
+static constexpr size_t TransferSize = 1ull << 30;
+static constexpr size_t ChunkSize = 64 * 1024;
+
+/*
+ * Creates connected pair of loopback TCP sockets.
+ */
+static bool TcpPair(int fds[2]) {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+
+    if (bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1
+        || listen(listener, 1) == -1
+        || getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &len) == -1)
+    {
+        close(listener);
+        return false;
+    }
+
+    fds[0] = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(fds[0], reinterpret_cast<sockaddr*>(&addr), len) == -1) {
+        close(listener);
+        return false;
+    }
+    fds[1] = accept(listener, nullptr, nullptr);
+    close(listener);
+
+    for (int i = 0; i < 2; i++) {
+        fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+    }
+    return fds[1] != -1;
+}
+
+static void BenchTransfer(const char* backendName, TReactor::EIoBackend backend, bool splice) {
+    TReactor reactor(spdlog::get("reactor"));
+    if (!reactor.SetIoBackend(backend)) {
+        return;
+    }
+
+    int client[2];
+    int upstream[2];
+    if (!TcpPair(client) || !TcpPair(upstream)) {
+        return;
+    }
+
+    reactor.StartCoroutine([client]() {
+        THandle handle(Reactor(), client[0]);
+        std::vector<char> chunk(ChunkSize, 'x');
+        for (size_t sent = 0; sent < TransferSize; sent += ChunkSize) {
+            if (!handle.WriteAll(TMemoryRegion(chunk.data(), chunk.size()))) {
+                return;
+            }
+        }
+    });
+
+    reactor.StartCoroutine([client, upstream, splice]() {
+        TTcpHandle from(Reactor(), client[1]);
+        TTcpHandle to(Reactor(), upstream[0]);
+        TSocketBuffer buffer(TSocketBuffer::DefaultSize);
+        buffer.Register(Reactor());
+
+        TResult<size_t> res = splice
+            ? from.SpliceExactly(to, TransferSize)
+            : from.CopyExactly(to, buffer, TransferSize);
+        if (!res) {
+            fprintf(stderr, "transfer failed: %s\n", ErrorDescription(res.Error()).c_str());
+        }
+    });
+
+    reactor.StartCoroutine([upstream]() {
+        THandle handle(Reactor(), upstream[1]);
+        std::vector<char> chunk(ChunkSize);
+        size_t received = 0;
+        while (received < TransferSize) {
+            TResult<size_t> res = handle.Read(TMemoryRegion(chunk.data(), chunk.size()));
+            if (!res || res.Result() == 0) {
+                return;
+            }
+            received += res.Result();
+        }
+    });
+
+    TClock::time_point start = TClock::now();
+    reactor.Run();
+    double seconds = std::chrono::duration<double>(TClock::now() - start).count();
+    printf("transfer %s, %s: 1 GiB in %.3f s, %.2f GiB/s\n", splice ? "splice" : "copy", backendName, seconds, 1 / seconds);
+}
+
+int main(int argc, char* argv[]) {
+    spdlog::stdout_color_mt("reactor");
+
+    BenchTransfer("epoll", TReactor::IoEpoll, false);
+    BenchTransfer("epoll", TReactor::IoEpoll, true);
+    BenchTransfer("io_uring", TReactor::IoUring, false);
+    BenchTransfer("io_uring", TReactor::IoUring, true);
+
+    return 0;
+}
@@ -0,0 +1,162 @@
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <coro/reactor.h>
+#include <core/backend_group.h>
+#include <handles/tcp.h>
+
+#include <gtest/gtest.h>
+
+static TSocketAddress MakeAddress(const std::string& host, uint16_t port) {
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    ::inet_pton(AF_INET, host.c_str(), &addr.sin_addr);
+    return TSocketAddress(reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+}
+
+static std::vector<TSocketAddress> MakeBackends(size_t count) {
+    std::vector<TSocketAddress> backends;
+    for (size_t i = 0; i < count; i++) {
+        backends.push_back(MakeAddress("10.0.0." + std::to_string(i + 1), 8080));
+    }
+    return backends;
+}
+
+class BackendGroupTest : public ::testing::Test {
+protected:
+    BackendGroupTest()
+        : Reactor_(spdlog::get("reactor"))
+    {}
+
+    template <typename Test>
+    void Run(Test test) {
+        Reactor_.StartCoroutine(test);
+        Reactor_.Run();
+    }
+
+    TReactor Reactor_;
+};
+
+TEST_F(BackendGroupTest, RoundRobin) {
+    Run([]() {
+        TBackendGroupPtr group = std::make_shared<TBackendGroup>(MakeBackends(3), TBackendGroup::TOptions());
+        for (size_t i = 0; i < 7; i++) {
+            EXPECT_EQ(group->Pick(nullptr), i % 3);
+        }
+
+        /* tried backends are skipped */
+        TBackendGroup::TTried tried = { 0, 1 };
+        EXPECT_EQ(group->Pick(nullptr, tried), 2);
+    });
+}
+
+TEST_F(BackendGroupTest, LeastOutstanding) {
+    Run([]() {
+        TBackendGroup::TOptions options;
+        options.Policy = TBackendGroup::BpLeastOutstanding;
+        TBackendGroupPtr group = std::make_shared<TBackendGroup>(MakeBackends(3), options);
+
+        TBackendGroup::TLease first(group, 0);
+        TBackendGroup::TLease second(group, 0);
+        TBackendGroup::TLease third(group, 2);
+        EXPECT_EQ(group->Outstanding(0), 2);
+
+        for (size_t i = 0; i < 5; i++) {
+            EXPECT_EQ(group->Pick(nullptr), 1);
+        }
+
+        {
+            TBackendGroup::TLease fourth(group, 1);
+            TBackendGroup::TLease fifth(group, 1);
+            EXPECT_EQ(group->Pick(nullptr), 2);
+        }
+        EXPECT_EQ(group->Outstanding(1), 0);
+    });
+}
+
+TEST_F(BackendGroupTest, ConsistentHash) {
+    Run([]() {
+        TBackendGroup::TOptions options;
+        options.Policy = TBackendGroup::BpConsistentHash;
+        TBackendGroupPtr group = std::make_shared<TBackendGroup>(MakeBackends(4), options);
+
+        std::vector<size_t> picked;
+        std::vector<size_t> hits(group->Size());
+        for (size_t i = 0; i < 1000; i++) {
+            TSocketAddress client = MakeAddress("192.168." + std::to_string(i / 256) + "." + std::to_string(i % 256), 40000);
+            picked.push_back(group->Pick(&client));
+            hits[picked.back()]++;
+
+            /* port of client does not matter */
+            TSocketAddress sameHost = MakeAddress("192.168." + std::to_string(i / 256) + "." + std::to_string(i % 256), 50000);
+            EXPECT_EQ(group->Pick(&sameHost), picked.back());
+        }
+
+        for (size_t count : hits) {
+            EXPECT_GT(count, 100);
+        }
+
+        /* only clients of ejected backend move */
+        group->ReportFailure(0);
+        group->ReportFailure(0);
+        group->ReportFailure(0);
+        EXPECT_TRUE(group->Ejected(0));
+
+        for (size_t i = 0; i < 1000; i++) {
+            TSocketAddress client = MakeAddress("192.168." + std::to_string(i / 256) + "." + std::to_string(i % 256), 40000);
+            size_t index = group->Pick(&client);
+            if (picked[i] == 0) {
+                EXPECT_NE(index, 0);
+            } else {
+                EXPECT_EQ(index, picked[i]);
+            }
+        }
+    });
+}
+
+TEST_F(BackendGroupTest, EjectOnConnectFailure) {
+    /* nobody listens on port of closed socket, so connect is refused */
+    int closed = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(::bind(closed, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+    socklen_t len = sizeof(addr);
+    ASSERT_EQ(::getsockname(closed, reinterpret_cast<sockaddr*>(&addr), &len), 0);
+    ::close(closed);
+    TSocketAddress dead(reinterpret_cast<sockaddr*>(&addr), len);
+
+    Run([dead]() {
+        TTcpHandlePtr listener = TTcpHandle::Create(false);
+        listener->Bind(MakeAddress("127.0.0.1", 0));
+        listener->Listen(16);
+        sockaddr_storage storage;
+        socklen_t len = sizeof(storage);
+        ASSERT_EQ(::getsockname(listener->Fd(), reinterpret_cast<sockaddr*>(&storage), &len), 0);
+        TSocketAddress alive(reinterpret_cast<sockaddr*>(&storage), len);
+
+        TBackendGroup::TOptions options;
+        options.MaxFails = 1;
+        TBackendGroupPtr group = std::make_shared<TBackendGroup>(std::vector<TSocketAddress>{ dead, alive }, options);
+
+        /* the first request goes to dead backend, fails over to alive one and ejects dead one */
+        for (size_t i = 0; i < 4; i++) {
+            TResult<TBackendGroup::TConnection> res = group->Connect(nullptr, nullptr);
+            ASSERT_TRUE(res);
+            EXPECT_EQ(res.Result().Lease->Index(), 1);
+            EXPECT_EQ(group->Outstanding(1), 1);
+        }
+
+        EXPECT_TRUE(group->Ejected(0));
+        EXPECT_FALSE(group->Ejected(1));
+        EXPECT_EQ(group->Outstanding(1), 0);
+    });
+}
+
+int main(int argc, char* argv[]) {
+    auto logger = spdlog::stdout_color_mt("reactor");
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
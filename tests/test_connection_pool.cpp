@@ -0,0 +1,191 @@
+#include <sys/socket.h>
+
+#include <coro/reactor.h>
+#include <handles/connection_pool.h>
+#include <handles/tcp.h>
+
+#include <gtest/gtest.h>
+
+class ConnectionPoolTest : public ::testing::Test {
+protected:
+    ConnectionPoolTest()
+        : Reactor_(spdlog::get("reactor"))
+    {}
+
+    void Listen() {
+        Listener_ = TTcpHandle::Create(false);
+        Listener_->ReuseAddr();
+        Listener_->Bind(GetAddrInfo("127.0.0.1", "0", true, "tcp")[0]);
+        Listener_->Listen(16);
+
+        sockaddr_storage addr;
+        socklen_t len = sizeof(addr);
+        ASSERT_EQ(getsockname(Listener_->Fd(), reinterpret_cast<sockaddr*>(&addr), &len), 0);
+        BackendAddr_ = TSocketAddress(reinterpret_cast<sockaddr*>(&addr), len);
+    }
+
+    /*
+     * Runs `test` while backend accepts connections and keeps them open.
+     */
+    template <typename Test>
+    void Run(Test test) {
+        Reactor_.StartCoroutine([this, test]() {
+            Listen();
+
+            TReactor::TCoroutine* server = Reactor()->StartAwaitableCoroutine([this]() {
+                while (true) {
+                    TResult<TTcpHandlePtr> accepted = Listener_->Accept();
+                    if (!accepted) {
+                        return;
+                    }
+                    Accepted_.push_back(std::move(accepted.Result()));
+                }
+            });
+
+            test();
+            Reactor()->Cancel(server);
+            Reactor()->Await(server);
+        });
+
+        Reactor_.Run();
+    }
+
+    TReactor Reactor_;
+    TTcpHandlePtr Listener_;
+    TSocketAddress BackendAddr_;
+    std::vector<TTcpHandlePtr> Accepted_;
+    TConnectionPool Pool_;
+};
+
+TEST_F(ConnectionPoolTest, ReuseIdleConnection) {
+    Run([this]() {
+        TResult<TTcpHandlePtr> first = Pool_.Acquire(BackendAddr_);
+        ASSERT_TRUE(first);
+        EXPECT_EQ(Pool_.Misses(), 1);
+        EXPECT_TRUE(first.Result()->PeerAddress() == BackendAddr_);
+
+        TTcpHandle* raw = first.Result().get();
+        Pool_.Release(std::move(first.Result()));
+        EXPECT_EQ(Pool_.Size(), 1);
+
+        TResult<TTcpHandlePtr> second = Pool_.Acquire(BackendAddr_);
+        ASSERT_TRUE(second);
+        EXPECT_EQ(second.Result().get(), raw);
+        EXPECT_EQ(Pool_.Hits(), 1);
+        EXPECT_EQ(Pool_.Size(), 0);
+
+        Reactor()->Yield();
+        EXPECT_EQ(Accepted_.size(), 1);
+    });
+}
+
+TEST_F(ConnectionPoolTest, ConnectFresh) {
+    Run([this]() {
+        bool reused = true;
+        TResult<TTcpHandlePtr> first = Pool_.Acquire(BackendAddr_, TReactor::TDeadline::max(), &reused);
+        ASSERT_TRUE(first);
+        EXPECT_FALSE(reused);
+
+        TTcpHandle* raw = first.Result().get();
+        Pool_.Release(std::move(first.Result()));
+
+        /* idle connection is left in pool */
+        TResult<TTcpHandlePtr> fresh = Pool_.Connect(BackendAddr_);
+        ASSERT_TRUE(fresh);
+        EXPECT_NE(fresh.Result().get(), raw);
+        EXPECT_EQ(Pool_.Size(), 1);
+        EXPECT_EQ(Pool_.Misses(), 2);
+
+        TResult<TTcpHandlePtr> second = Pool_.Acquire(BackendAddr_, TReactor::TDeadline::max(), &reused);
+        ASSERT_TRUE(second);
+        EXPECT_EQ(second.Result().get(), raw);
+        EXPECT_TRUE(reused);
+    });
+}
+
+TEST_F(ConnectionPoolTest, ClosedByBackend) {
+    Run([this]() {
+        TResult<TTcpHandlePtr> conn = Pool_.Acquire(BackendAddr_);
+        ASSERT_TRUE(conn);
+        Reactor()->Yield();
+        ASSERT_EQ(Accepted_.size(), 1);
+
+        Pool_.Release(std::move(conn.Result()));
+        EXPECT_EQ(Pool_.Size(), 1);
+
+        /* backend closes idle connection, it is noticed on checkout */
+        Accepted_[0]->Close();
+
+        conn = Pool_.Acquire(BackendAddr_);
+        ASSERT_TRUE(conn);
+        EXPECT_EQ(Pool_.Hits(), 0);
+        EXPECT_EQ(Pool_.Misses(), 2);
+        EXPECT_EQ(Pool_.Evicted(), 1);
+    });
+}
+
+TEST_F(ConnectionPoolTest, UnreadDataIsNotPooled) {
+    Run([this]() {
+        TResult<TTcpHandlePtr> conn = Pool_.Acquire(BackendAddr_);
+        ASSERT_TRUE(conn);
+        Reactor()->Yield();
+        ASSERT_EQ(Accepted_.size(), 1);
+
+        ASSERT_TRUE(Accepted_[0]->WriteAll(TMemoryRegion(std::string_view("garbage"))));
+        Pool_.Release(conn.Result());
+        EXPECT_EQ(Pool_.Size(), 0);
+        EXPECT_FALSE(conn.Result()->Active());
+    });
+}
+
+TEST_F(ConnectionPoolTest, IdleTimeout) {
+    Pool_.SetIdleTimeout(std::chrono::steady_clock::duration::zero());
+
+    Run([this]() {
+        TResult<TTcpHandlePtr> conn = Pool_.Acquire(BackendAddr_);
+        ASSERT_TRUE(conn);
+        Pool_.Release(std::move(conn.Result()));
+
+        conn = Pool_.Acquire(BackendAddr_);
+        ASSERT_TRUE(conn);
+        EXPECT_EQ(Pool_.Hits(), 0);
+        EXPECT_EQ(Pool_.Evicted(), 1);
+    });
+}
+
+TEST_F(ConnectionPoolTest, Limits) {
+    Pool_.SetLimits(1, 2);
+
+    Run([this]() {
+        TResult<TTcpHandlePtr> a = Pool_.Acquire(BackendAddr_);
+        TResult<TTcpHandlePtr> b = Pool_.Acquire(BackendAddr_);
+        ASSERT_TRUE(a);
+        ASSERT_TRUE(b);
+
+        TResult<TTcpHandlePtr> c = Pool_.Acquire(BackendAddr_);
+        ASSERT_FALSE(c);
+        EXPECT_EQ(c.Error(), EBUSY);
+        EXPECT_EQ(Pool_.Rejected(), 1);
+
+        /* closed connection does not count anymore */
+        a.Result()->Close();
+        c = Pool_.Acquire(BackendAddr_);
+        ASSERT_TRUE(c);
+
+        /* only one idle connection is kept */
+        Pool_.Release(std::move(b.Result()));
+        Pool_.Release(std::move(c.Result()));
+        EXPECT_EQ(Pool_.Size(), 1);
+    });
+}
+
+int main(int argc, char* argv[]) {
+    auto logger = spdlog::stdout_color_mt("reactor");
+    /* the same suite is run against io_uring backend, see CMakeLists.txt */
+    const char* backend = getenv("PORTCULLIS_IO_BACKEND");
+    if (backend && std::string(backend) == "io_uring") {
+        TReactor::SetDefaultIoBackend(TReactor::IoUring);
+    }
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -1,3 +1,5 @@
+#include <sys/socket.h>
+
 #include <coro/reactor.h>
 #include <handles/tcp.h>
 #include <handles/http.h>
@@ -56,7 +58,7 @@ TEST_F(HttpHandleTest, GetSimpleRequestTest) {
         ASSERT_EQ(req.Url, "/");
         ASSERT_EQ(req.Method, "GET");
         ASSERT_EQ(req.MinorVersion, 1);
-        ASSERT_EQ(req.Headers.size(), 0);
+        ASSERT_EQ(req.Headers.Size(), 0);
     });
 
     Reactor_.Run();
@@ -81,8 +83,8 @@ TEST_F(HttpHandleTest, RequestPerByteWriteTest) {
         ASSERT_EQ(req.Url, "/per_byte_test");
         ASSERT_EQ(req.Method, "POST");
         ASSERT_EQ(req.MinorVersion, 1);
-        ASSERT_EQ(req.Headers.size(), 1);
-        ASSERT_EQ(req.Headers.at("User-Agent"), "portcullis-tester");
+        ASSERT_EQ(req.Headers.Size(), 1);
+        ASSERT_EQ(req.Headers.Get("User-Agent"), "portcullis-tester");
     });
 
     Reactor_.Run();
@@ -113,8 +115,8 @@ TEST_F(HttpHandleTest, MultipleRequestsTest) {
             ASSERT_EQ(req.Url, ss.str());
             ASSERT_EQ(req.Method, "GET");
             ASSERT_EQ(req.MinorVersion, 1);
-            ASSERT_EQ(req.Headers.size(), 1);
-            ASSERT_EQ(req.Headers.at("User-Agent"), "portcullis-tester");
+            ASSERT_EQ(req.Headers.Size(), 1);
+            ASSERT_EQ(req.Headers.Get("User-Agent"), "portcullis-tester");
         }
     });
 
@@ -175,8 +177,8 @@ TEST_F(HttpHandleTest, ReadRequestBodyTest) {
         ASSERT_EQ(req.Url, "/test");
         ASSERT_EQ(req.Method, "POST");
         ASSERT_EQ(req.MinorVersion, 1);
-        ASSERT_EQ(req.Headers.size(), 1);
-        ASSERT_EQ(req.Headers.at("Content-Length"), "10");
+        ASSERT_EQ(req.Headers.Size(), 1);
+        ASSERT_EQ(req.Headers.Get("Content-Length"), "10");
         TResult<TMemoryRegion> ret = httpHandle.ReadBody(req);
         ASSERT_TRUE(ret);
         const TMemoryRegion& body = ret.Result();
@@ -236,6 +238,45 @@ TEST_F(HttpHandleTest, TransferRequestBodyTest) {
     Reactor_.Run();
 }
 
+TEST_F(HttpHandleTest, TransferPipelinedRequestBodyTest) {
+    Reactor_.StartCoroutine([this]() {
+        /* second request arrives in the same read as body of the first one */
+        std::string str =
+            "POST /0 HTTP/1.1\r\nContent-Length: 5\r\n\r\nhello"
+            "GET /1 HTTP/1.1\r\n\r\n";
+        FromClient_->WriteAll(str);
+    });
+
+    Reactor_.StartCoroutine([this]() {
+        TTcpHandlePtr toBackend, fromBackend;
+        TCoroutine* coro = Reactor_.StartAwaitableCoroutine([this, &toBackend, &fromBackend]() {
+            CreateConnectedPair(toBackend, fromBackend);
+        });
+        Reactor()->Await(coro);
+
+        THttpHandle httpHandle(FromServer_);
+        TResult<THttpRequest> res = httpHandle.ReadRequest();
+        ASSERT_TRUE(res);
+        ASSERT_EQ(res.Result().Url, "/0");
+        THttpHandle handleToBackend(toBackend);
+        TResult<size_t> transfered = httpHandle.TransferBody(handleToBackend, res.Result());
+        ASSERT_TRUE(transfered);
+        ASSERT_EQ(transfered.Result(), 5);
+
+        TSocketBuffer buffer(5);
+        while (buffer.Size() < 5) {
+            ASSERT_TRUE(fromBackend->Read(buffer));
+        }
+        ASSERT_TRUE(buffer.CurrentMemoryRegion().EqualTo(std::string_view("hello")));
+
+        res = httpHandle.ReadRequest();
+        ASSERT_TRUE(res);
+        ASSERT_EQ(res.Result().Url, "/1");
+    });
+
+    Reactor_.Run();
+}
+
 TEST_F(HttpHandleTest, ReadIncompleteRequestBodyTest) {
     std::string bodyStr = "0123456789";
     Reactor_.StartCoroutine([this, bodyStr]() {
@@ -256,7 +297,7 @@ TEST_F(HttpHandleTest, ReadIncompleteRequestBodyTest) {
         ASSERT_EQ(req.Url, "/test");
         ASSERT_EQ(req.Method, "POST");
         ASSERT_EQ(req.MinorVersion, 1);
-        ASSERT_EQ(req.Headers.size(), 1);
+        ASSERT_EQ(req.Headers.Size(), 1);
         TResult<TMemoryRegion> ret = httpHandle.ReadBody(req);
         ASSERT_FALSE(ret);
     });
@@ -271,8 +312,8 @@ TEST_F(HttpHandleTest, WriteGetSimpleRequestTest) {
         request.Url = "/test_request_write?test=1&a=b";
         request.Method = "GET";
         request.MinorVersion = 1;
-        request.Headers["User-Agent"] = "portcullis-tester";
-        request.Headers["Host"] = "www.portcullis.com";
+        request.Headers.Set("User-Agent", "portcullis-tester");
+        request.Headers.Set("Host", "www.portcullis.com");
         httpHandle.WriteRequest(request);
         Reactor()->Yield();
         FromClient_->Close();
@@ -286,9 +327,9 @@ TEST_F(HttpHandleTest, WriteGetSimpleRequestTest) {
         ASSERT_EQ(req.Url, "/test_request_write?test=1&a=b");
         ASSERT_EQ(req.Method, "GET");
         ASSERT_EQ(req.MinorVersion, 1);
-        ASSERT_EQ(req.Headers.size(), 2);
-        ASSERT_EQ(req.Headers.at("Host"), "www.portcullis.com");
-        ASSERT_EQ(req.Headers.at("User-Agent"), "portcullis-tester");
+        ASSERT_EQ(req.Headers.Size(), 2);
+        ASSERT_EQ(req.Headers.Get("Host"), "www.portcullis.com");
+        ASSERT_EQ(req.Headers.Get("User-Agent"), "portcullis-tester");
     });
 
     Reactor_.Run();
@@ -308,8 +349,8 @@ TEST_F(HttpHandleTest, SimpleOkResponseTest) {
         ASSERT_EQ(req.Status, 200);
         ASSERT_EQ(req.Reason, "Ok");
         ASSERT_EQ(req.MinorVersion, 1);
-        ASSERT_EQ(req.Headers.size(), 1);
-        ASSERT_EQ(req.Headers.at("Server"), "portcullis");
+        ASSERT_EQ(req.Headers.Size(), 1);
+        ASSERT_EQ(req.Headers.Get("Server"), "portcullis");
     });
 
     Reactor_.Run();
@@ -334,8 +375,8 @@ TEST_F(HttpHandleTest, ResponsePerByteWriteTest) {
         ASSERT_EQ(resp.Status, 200);
         ASSERT_EQ(resp.Reason, "Per Byte Test Is Ok");
         ASSERT_EQ(resp.MinorVersion, 1);
-        ASSERT_EQ(resp.Headers.size(), 1);
-        ASSERT_EQ(resp.Headers.at("Server"), "portcullis");
+        ASSERT_EQ(resp.Headers.Size(), 1);
+        ASSERT_EQ(resp.Headers.Get("Server"), "portcullis");
     });
 
     Reactor_.Run();
@@ -364,8 +405,8 @@ TEST_F(HttpHandleTest, MultipleResponseTest) {
             ASSERT_EQ(resp.Status, 200 + i);
             ASSERT_EQ(resp.Reason, "Okaay");
             ASSERT_EQ(resp.MinorVersion, 1);
-            ASSERT_EQ(resp.Headers.size(), 1);
-            ASSERT_EQ(resp.Headers.at("Server"), "portcullis");
+            ASSERT_EQ(resp.Headers.Size(), 1);
+            ASSERT_EQ(resp.Headers.Get("Server"), "portcullis");
         }
     });
 
@@ -426,8 +467,8 @@ TEST_F(HttpHandleTest, ReadResponseBodyTest) {
         ASSERT_EQ(resp.Status, 200);
         ASSERT_EQ(resp.Reason, "Ok");
         ASSERT_EQ(resp.MinorVersion, 1);
-        ASSERT_EQ(resp.Headers.size(), 1);
-        ASSERT_EQ(resp.Headers.at("Content-Length"), "10");
+        ASSERT_EQ(resp.Headers.Size(), 1);
+        ASSERT_EQ(resp.Headers.Get("Content-Length"), "10");
         TResult<TMemoryRegion> ret = httpHandle.ReadBody(resp);
         ASSERT_TRUE(ret);
         const TMemoryRegion& body = ret.Result();
@@ -510,6 +551,61 @@ TEST_F(HttpHandleTest, ReadIncompleteResponseBodyTest) {
     Reactor_.Run();
 }
 
+TEST_F(HttpHandleTest, TransferCloseDelimitedBodyTest) {
+    Reactor_.StartCoroutine([this]() {
+        std::string str = "HTTP/1.1 200 Ok\r\n\r\n0123456789";
+        FromClient_->WriteAll(str);
+        Reactor()->Yield();
+        str = "abcdef";
+        FromClient_->WriteAll(str);
+        FromClient_->Close();
+    });
+
+    Reactor_.StartCoroutine([this]() {
+        int fds[2];
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+        THttpHandle to(std::make_shared<TTcpHandle>(Reactor(), fds[0]));
+        TTcpHandlePtr peer = std::make_shared<TTcpHandle>(Reactor(), fds[1]);
+
+        THttpHandle httpHandle(FromServer_);
+        TResult<THttpResponse> res = httpHandle.ReadResponse();
+        ASSERT_TRUE(res);
+        ASSERT_FALSE(httpHandle.KeepAlive());
+
+        /* body lasts until server closes connection */
+        TResult<size_t> transfered = httpHandle.TransferBody(to, res.Result());
+        ASSERT_TRUE(transfered);
+        ASSERT_EQ(transfered.Result(), 16);
+        ASSERT_FALSE(httpHandle.Idle());
+
+        char buf[32];
+        TResult<size_t> read = peer->Read(TMemoryRegion(buf, sizeof(buf)));
+        ASSERT_TRUE(read);
+        ASSERT_EQ(std::string(buf, read.Result()), "0123456789abcdef");
+    });
+
+    Reactor_.Run();
+}
+
+TEST_F(HttpHandleTest, ReadCloseDelimitedBodyTest) {
+    Reactor_.StartCoroutine([this]() {
+        std::string str = "HTTP/1.0 200 Ok\r\n\r\nhello";
+        FromClient_->WriteAll(str);
+        FromClient_->Close();
+    });
+
+    Reactor_.StartCoroutine([this]() {
+        THttpHandle httpHandle(FromServer_);
+        TResult<THttpResponse> res = httpHandle.ReadResponse();
+        ASSERT_TRUE(res);
+        TResult<TMemoryRegion> body = httpHandle.ReadBody(res.Result());
+        ASSERT_TRUE(body);
+        ASSERT_EQ(std::string(body.Result().DataAs<const char*>(), body.Result().Size()), "hello");
+    });
+
+    Reactor_.Run();
+}
+
 TEST_F(HttpHandleTest, WriteSimpleOkResponseTest) {
     Reactor_.StartCoroutine([this]() {
         THttpHandle httpHandle(FromClient_);
@@ -517,7 +613,7 @@ TEST_F(HttpHandleTest, WriteSimpleOkResponseTest) {
         resp.Status = 200;
         resp.Reason = "Ok";
         resp.MinorVersion = 1;
-        resp.Headers["Server"] = "portcullis";
+        resp.Headers.Set("Server", "portcullis");
         httpHandle.WriteResponse(resp);
         Reactor()->Yield();
         FromClient_->Close();
@@ -531,13 +627,487 @@ TEST_F(HttpHandleTest, WriteSimpleOkResponseTest) {
         ASSERT_EQ(req.Status, 200);
         ASSERT_EQ(req.Reason, "Ok");
         ASSERT_EQ(req.MinorVersion, 1);
-        ASSERT_EQ(req.Headers.size(), 1);
-        ASSERT_EQ(req.Headers.at("Server"), "portcullis");
+        ASSERT_EQ(req.Headers.Size(), 1);
+        ASSERT_EQ(req.Headers.Get("Server"), "portcullis");
+    });
+
+    Reactor_.Run();
+}
+
+TEST_F(HttpHandleTest, HeadersOutliveBufferTest) {
+    Reactor_.StartCoroutine([this]() {
+        std::string str = "GET /first HTTP/1.1\r\nHost: first\r\n\r\n";
+        FromClient_->WriteAll(str);
+        Reactor()->Yield();
+        str = "GET /second HTTP/1.1\r\nHost: second\r\n\r\n";
+        FromClient_->WriteAll(str);
+    });
+
+    Reactor_.StartCoroutine([this]() {
+        THttpHandle httpHandle(FromServer_);
+        TResult<THttpRequest> first = httpHandle.ReadRequest();
+        ASSERT_TRUE(first);
+
+        /* buffer memory is reused by the next message */
+        TResult<THttpRequest> second = httpHandle.ReadRequest();
+        ASSERT_TRUE(second);
+
+        THttpHeaders copy = first.Result().Headers;
+        ASSERT_EQ(first.Result().Headers.Get("host"), "first");
+        ASSERT_EQ(second.Result().Headers.Get("HOST"), "second");
+        ASSERT_EQ(copy.Get("Host"), "first");
+    });
+
+    Reactor_.Run();
+}
+
+TEST_F(HttpHandleTest, PipelinedKeepAliveTest) {
+    Reactor_.StartCoroutine([this]() {
+        /* all requests arrive at once, body of the second one is not read by handler */
+        std::string str =
+            "GET /0 HTTP/1.1\r\n\r\n"
+            "POST /1 HTTP/1.1\r\nContent-Length: 5\r\n\r\nhello"
+            "GET /2 HTTP/1.1\r\nConnection: close\r\n\r\n"
+            "GET /3 HTTP/1.1\r\n\r\n";
+        FromClient_->WriteAll(str);
+    });
+
+    Reactor_.StartCoroutine([this]() {
+        THttpHandle httpHandle(FromServer_);
+        std::vector<std::string> urls;
+        TResult<size_t> res = httpHandle.ServeRequests([&](const THttpRequest& request) {
+            urls.push_back(request.Url);
+            THttpResponse response;
+            response.Status = 200;
+            response.MinorVersion = 1;
+            response.Headers.Set("Content-Length", "0");
+            return bool(httpHandle.WriteResponse(response));
+        }, std::chrono::seconds(1));
+
+        ASSERT_TRUE(res);
+        ASSERT_EQ(res.Result(), 3);
+        ASSERT_EQ(urls, std::vector<std::string>({ "/0", "/1", "/2" }));
+        ASSERT_FALSE(httpHandle.KeepAlive());
+    });
+
+    Reactor_.Run();
+}
+
+TEST_F(HttpHandleTest, KeepAliveIdleTest) {
+    Reactor_.StartCoroutine([this]() {
+        std::string str = "GET / HTTP/1.1\r\n\r\n";
+        FromClient_->WriteAll(str);
+    });
+
+    Reactor_.StartCoroutine([this]() {
+        THttpHandle httpHandle(FromServer_);
+        TResult<size_t> res = httpHandle.ServeRequests([&](const THttpRequest& request) {
+            THttpResponse response;
+            response.Status = 304;
+            response.MinorVersion = 1;
+            return bool(httpHandle.WriteResponse(response));
+        }, std::chrono::milliseconds(20));
+
+        /* silent client is not an error */
+        ASSERT_TRUE(res);
+        ASSERT_EQ(res.Result(), 1);
+    });
+
+    Reactor_.Run();
+}
+
+TEST_F(HttpHandleTest, AmbiguousContentLengthTest) {
+    /* each of them could be framed differently by other peer */
+    std::vector<std::string> heads = {
+        "POST / HTTP/1.1\r\nContent-Length: 12abc\r\n\r\n",
+        "POST / HTTP/1.1\r\nContent-Length: abc\r\n\r\n",
+        "POST / HTTP/1.1\r\nContent-Length: 99999999999999999999999\r\n\r\n",
+        "POST / HTTP/1.1\r\nContent-Length: 5\r\nContent-Length: 6\r\n\r\n",
+        "POST / HTTP/1.1\r\nContent-Length: 5\r\nTransfer-Encoding: chunked\r\n\r\n",
+        "HTTP/1.1 200 OK\r\nContent-Length: 5, 6\r\n\r\n",
+        "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\nContent-Length: 5\r\n\r\n",
+        "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\nTransfer-Encoding: gzip\r\n\r\n",
+        "POST / HTTP/1.1\r\nTransfer-Encoding: chunked, chunked\r\n\r\n",
+        "POST / HTTP/1.1\r\nTransfer-Encoding: gzip\r\n\r\n",
+        "POST / HTTP/1.1\r\nTransfer-Encoding: \r\n\r\n",
+        "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\nTransfer-Encoding: chunked\r\n\r\n",
+    };
+    std::string valid = "POST / HTTP/1.1\r\nContent-Length: 5\r\ncontent-length: 5\r\n\r\nhello";
+
+    Reactor_.StartCoroutine([&heads, &valid]() {
+        for (std::string& head : heads) {
+            int fds[2];
+            ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+            TTcpHandlePtr peer = std::make_shared<TTcpHandle>(Reactor(), fds[0]);
+            THttpHandle httpHandle(std::make_shared<TTcpHandle>(Reactor(), fds[1]));
+            ASSERT_TRUE(peer->WriteAll(head));
+
+            bool read = head.compare(0, 4, "HTTP") == 0 ? bool(httpHandle.ReadResponse()) : bool(httpHandle.ReadRequest());
+            EXPECT_FALSE(read) << head;
+            EXPECT_FALSE(httpHandle.KeepAlive());
+        }
+
+        /* identical duplicates agree on length */
+        int fds[2];
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+        TTcpHandlePtr peer = std::make_shared<TTcpHandle>(Reactor(), fds[0]);
+        THttpHandle httpHandle(std::make_shared<TTcpHandle>(Reactor(), fds[1]));
+        ASSERT_TRUE(peer->WriteAll(valid));
+
+        TResult<THttpRequest> request = httpHandle.ReadRequest();
+        ASSERT_TRUE(request);
+        TResult<TMemoryRegion> body = httpHandle.ReadBody(request.Result());
+        ASSERT_TRUE(body);
+        ASSERT_EQ(std::string(body.Result().DataAs<const char*>(), body.Result().Size()), "hello");
+        ASSERT_TRUE(httpHandle.KeepAlive());
+
+        /* codings of all fields make one list, which ends with chunked */
+        ASSERT_TRUE(peer->WriteAll(TMemoryRegion(std::string_view("POST / HTTP/1.1\r\nTransfer-Encoding: gzip\r\ntransfer-encoding: chunked\r\n\r\n5\r\nhello\r\n0\r\n\r\n"))));
+        request = httpHandle.ReadRequest();
+        ASSERT_TRUE(request);
+        body = httpHandle.ReadBody(request.Result());
+        ASSERT_TRUE(body);
+        ASSERT_EQ(std::string(body.Result().DataAs<const char*>(), body.Result().Size()), "hello");
+        ASSERT_TRUE(httpHandle.KeepAlive());
+
+        /* response may be delimited by close instead */
+        ASSERT_TRUE(peer->WriteAll(TMemoryRegion(std::string_view("HTTP/1.1 200 OK\r\nTransfer-Encoding: gzip\r\n\r\n"))));
+        ASSERT_TRUE(httpHandle.ReadResponse());
+        ASSERT_FALSE(httpHandle.KeepAlive());
+    });
+
+    Reactor_.Run();
+}
+
+TEST_F(HttpHandleTest, PersistentMessageTest) {
+    THttpRequest request;
+    request.MinorVersion = 1;
+    ASSERT_TRUE(THttpHandle::Persistent(request));
+    request.Headers.Set("Connection", "Upgrade, Close");
+    ASSERT_FALSE(THttpHandle::Persistent(request));
+
+    request.MinorVersion = 0;
+    request.Headers.Remove("Connection");
+    ASSERT_FALSE(THttpHandle::Persistent(request));
+    request.Headers.Set("Connection", "keep-alive");
+    ASSERT_TRUE(THttpHandle::Persistent(request));
+
+    /* body of response without length lasts until connection is closed */
+    THttpResponse response;
+    response.MinorVersion = 1;
+    response.Status = 200;
+    ASSERT_FALSE(THttpHandle::Persistent(response));
+    response.Headers.Set("Content-Length", "0");
+    ASSERT_TRUE(THttpHandle::Persistent(response));
+}
+
+TEST_F(HttpHandleTest, TransferChunkedBodyTest) {
+    Reactor_.StartCoroutine([this]() {
+        std::string str =
+            "POST /upload HTTP/1.1\r\nTransfer-Encoding: gzip, chunked\r\n\r\n"
+            "5;ext=1\r\nhello\r\n"
+            "1\r\n,\r\n";
+        FromClient_->WriteAll(str);
+        Reactor()->Yield();
+        /* chunk split between reads */
+        str = "6\r\n wo";
+        FromClient_->WriteAll(str);
+        Reactor()->Yield();
+        str = "rld\r\n0\r\nX-Checksum: 42\r\n\r\nGET /next HTTP/1.1\r\n\r\n";
+        FromClient_->WriteAll(str);
+    });
+
+    Reactor_.StartCoroutine([this]() {
+        TTcpHandlePtr toBackend, fromBackend;
+        TCoroutine* coro = Reactor_.StartAwaitableCoroutine([this, &toBackend, &fromBackend]() {
+            CreateConnectedPair(toBackend, fromBackend);
+        });
+        Reactor()->Await(coro);
+
+        THttpHandle httpHandle(FromServer_);
+        TResult<THttpRequest> res = httpHandle.ReadRequest();
+        ASSERT_TRUE(res);
+        ASSERT_TRUE(THttpHandle::Persistent(res.Result()));
+
+        THttpHandle handleToBackend(toBackend);
+        TResult<size_t> transfered = httpHandle.TransferBody(handleToBackend, res.Result());
+        ASSERT_TRUE(transfered);
+        ASSERT_EQ(transfered.Result(), 12);
+        ASSERT_EQ(httpHandle.Trailers().Get("X-Checksum"), "42");
+        toBackend->Close();
+
+        /* body is re-encoded, chunks depend on reads, but payload and trailer are the same */
+        std::string received;
+        char buf[256];
+        while (true) {
+            TResult<size_t> read = fromBackend->Read(TMemoryRegion(buf, sizeof(buf)));
+            ASSERT_TRUE(read);
+            if (read.Result() == 0) {
+                break;
+            }
+            received.append(buf, read.Result());
+        }
+        std::string payload;
+        size_t pos = 0;
+        while (true) {
+            size_t lineEnd = received.find("\r\n", pos);
+            ASSERT_NE(lineEnd, std::string::npos);
+            size_t chunkSize = std::stoul(received.substr(pos, lineEnd - pos), nullptr, 16);
+            pos = lineEnd + 2;
+            if (chunkSize == 0) {
+                break;
+            }
+            payload += received.substr(pos, chunkSize);
+            ASSERT_EQ(received.substr(pos + chunkSize, 2), "\r\n");
+            pos += chunkSize + 2;
+        }
+        ASSERT_EQ(payload, "hello, world");
+        ASSERT_EQ(received.substr(pos), "X-Checksum: 42\r\n\r\n");
+
+        /* pipelined request after body is intact */
+        TResult<std::optional<THttpRequest>> next = httpHandle.ReadNextRequest();
+        ASSERT_TRUE(next);
+        ASSERT_TRUE(next.Result());
+        ASSERT_EQ(next.Result()->Url, "/next");
     });
 
     Reactor_.Run();
 }
 
+TEST_F(HttpHandleTest, TransferScannedBodyTest) {
+    Reactor_.StartCoroutine([this]() {
+        std::string str =
+            "POST /upload HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+            "5\r\nhello\r\n";
+        FromClient_->WriteAll(str);
+        Reactor()->Yield();
+        str = "a\r\n, UNION a\r\n0\r\n\r\n";
+        FromClient_->WriteAll(str);
+    });
+
+    Reactor_.StartCoroutine([this]() {
+        TTcpHandlePtr toBackend, fromBackend;
+        TCoroutine* coro = Reactor_.StartAwaitableCoroutine([this, &toBackend, &fromBackend]() {
+            CreateConnectedPair(toBackend, fromBackend);
+        });
+        Reactor()->Await(coro);
+
+        THttpHandle httpHandle(FromServer_);
+        TResult<THttpRequest> res = httpHandle.ReadRequest();
+        ASSERT_TRUE(res);
+
+        TStreamRegexpDatabase db({ TRegexpDef("UNION", HS_FLAG_SOM_LEFTMOST) });
+        TStreamRegexpMatcher matcher(db, [](unsigned int, size_t, size_t) {
+            return true;
+        });
+
+        THttpHandle handleToBackend(toBackend);
+        TResult<size_t> transfered = httpHandle.TransferBody(handleToBackend, res.Result(), matcher);
+        ASSERT_FALSE(transfered);
+        ASSERT_EQ(transfered.Error(), ECONNABORTED);
+        ASSERT_TRUE(matcher.Stopped());
+        ASSERT_FALSE(httpHandle.KeepAlive());
+        toBackend->Close();
+
+        /* payload is cut off right before the match, chunks depend on reads */
+        std::string received;
+        char buf[256];
+        while (true) {
+            TResult<size_t> read = fromBackend->Read(TMemoryRegion(buf, sizeof(buf)));
+            ASSERT_TRUE(read);
+            if (read.Result() == 0) {
+                break;
+            }
+            received.append(buf, read.Result());
+        }
+        std::string payload;
+        size_t pos = 0;
+        while (pos < received.size()) {
+            size_t lineEnd = received.find("\r\n", pos);
+            ASSERT_NE(lineEnd, std::string::npos);
+            size_t chunkSize = std::stoul(received.substr(pos, lineEnd - pos), nullptr, 16);
+            ASSERT_GT(chunkSize, 0);
+            payload += received.substr(lineEnd + 2, chunkSize);
+            pos = lineEnd + 2 + chunkSize + 2;
+        }
+        ASSERT_EQ(payload, "hello, ");
+    });
+
+    Reactor_.Run();
+}
+
+TEST_F(HttpHandleTest, TransferFinishedBodyTest) {
+    Reactor_.StartCoroutine([this]() {
+        std::string str = "POST /upload HTTP/1.1\r\nContent-Length: 11\r\n\r\nhello ";
+        FromClient_->WriteAll(str);
+    });
+
+    Reactor_.StartCoroutine([this]() {
+        TTcpHandlePtr toBackend, fromBackend;
+        TCoroutine* coro = Reactor_.StartAwaitableCoroutine([this, &toBackend, &fromBackend]() {
+            CreateConnectedPair(toBackend, fromBackend);
+        });
+        Reactor()->Await(coro);
+
+        THttpHandle httpHandle(FromServer_);
+        TResult<THttpRequest> res = httpHandle.ReadRequest();
+        ASSERT_TRUE(res);
+
+        /* the rest of body comes while the first piece is sent */
+        Reactor_.StartCoroutine([this]() {
+            FromClient_->WriteAll(TMemoryRegion(std::string_view("world")));
+        });
+
+        std::string scanned;
+        size_t finished = 0;
+        THttpHandle handleToBackend(toBackend);
+        TResult<size_t> transfered = httpHandle.TransferScannedBody(handleToBackend, res.Result(), [&scanned](TMemoryRegion piece) {
+            scanned.append(piece.DataAs<const char*>(), piece.Size());
+            return piece.Size();
+        }, [&finished]() {
+            finished++;
+            return false;
+        });
+        ASSERT_FALSE(transfered);
+        ASSERT_EQ(transfered.Error(), ECONNABORTED);
+        ASSERT_EQ(finished, 1);
+        ASSERT_EQ(scanned, "hello world");
+        toBackend->Close();
+
+        /* the last piece is scanned, but not sent */
+        std::string received;
+        char buf[256];
+        while (true) {
+            TResult<size_t> read = fromBackend->Read(TMemoryRegion(buf, sizeof(buf)));
+            ASSERT_TRUE(read);
+            if (read.Result() == 0) {
+                break;
+            }
+            received.append(buf, read.Result());
+        }
+        ASSERT_EQ(received, "hello ");
+    });
+
+    Reactor_.Run();
+}
+
+TEST_F(HttpHandleTest, ReadChunkedBodyTest) {
+    Reactor_.StartCoroutine([this]() {
+        std::string str =
+            "HTTP/1.1 200 Ok\r\nTransfer-Encoding: chunked\r\n\r\n"
+            "a\r\n0123456789\r\n"
+            "3\r\nabc\r\n"
+            "0\r\n\r\n"
+            "HTTP/1.1 204 No Content\r\n\r\n";
+        for (size_t i = 0; i < str.size(); i++) {
+            std::string s = str.substr(i, 1);
+            FromClient_->WriteAll(s);
+            Reactor()->Yield();
+        }
+    });
+
+    Reactor_.StartCoroutine([this]() {
+        THttpHandle httpHandle(FromServer_);
+        TResult<THttpResponse> res = httpHandle.ReadResponse();
+        ASSERT_TRUE(res);
+        TResult<TMemoryRegion> body = httpHandle.ReadBody(res.Result());
+        ASSERT_TRUE(body);
+        ASSERT_EQ(std::string(body.Result().DataAs<const char*>(), body.Result().Size()), "0123456789abc");
+        ASSERT_TRUE(httpHandle.Trailers().Empty());
+
+        res = httpHandle.ReadResponse();
+        ASSERT_TRUE(res);
+        ASSERT_EQ(res.Result().Status, 204);
+        ASSERT_TRUE(httpHandle.KeepAlive());
+    });
+
+    Reactor_.Run();
+}
+
+TEST_F(HttpHandleTest, SkipChunkedBodyTest) {
+    Reactor_.StartCoroutine([this]() {
+        std::string str =
+            "POST /0 HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+            "4\r\nbody\r\n0\r\nX-Trailer: 1\r\n\r\n"
+            "POST /1 HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nxyz\r\n";
+        FromClient_->WriteAll(str);
+    });
+
+    Reactor_.StartCoroutine([this]() {
+        THttpHandle httpHandle(FromServer_);
+        TResult<std::optional<THttpRequest>> res = httpHandle.ReadNextRequest();
+        ASSERT_TRUE(res);
+        ASSERT_EQ(res.Result()->Url, "/0");
+
+        res = httpHandle.ReadNextRequest();
+        ASSERT_TRUE(res);
+        ASSERT_EQ(res.Result()->Url, "/1");
+
+        /* malformed chunk size */
+        res = httpHandle.ReadNextRequest();
+        ASSERT_FALSE(res);
+        ASSERT_FALSE(httpHandle.KeepAlive());
+    });
+
+    Reactor_.Run();
+}
+
+TEST(HttpHeadersTest, Modification) {
+    THttpHeaders headers;
+    headers.Add("Set-Cookie", "a=1");
+    headers.Add("set-cookie", "b=2");
+    headers.Set("Server", "nginx");
+    ASSERT_EQ(headers.Size(), 3);
+    ASSERT_EQ(headers.Get("SET-COOKIE"), "a=1");
+    ASSERT_FALSE(headers.Get("Cookie"));
+
+    THttpHeaders copy = headers;
+    headers.Set("server", "portcullis");
+    ASSERT_EQ(headers.Get("Server"), "portcullis");
+    ASSERT_EQ(copy.Get("Server"), "nginx");
+
+    /* the first field keeps its place and spelling, duplicates are dropped */
+    headers.Set("SET-COOKIE", "c=3");
+    ASSERT_EQ(headers.Size(), 2);
+    ASSERT_EQ(headers.begin()->Name, "Set-Cookie");
+    ASSERT_EQ(headers.begin()->Value, "c=3");
+
+    ASSERT_TRUE(headers.Remove("set-cookie"));
+    ASSERT_FALSE(headers.Remove("set-cookie"));
+    ASSERT_EQ(headers.Size(), 1);
+    ASSERT_TRUE(headers.Has("SERVER"));
+
+    /* fields beyond inline capacity */
+    for (size_t i = 0; i < 2 * THttpHeaders::InlineCapacity; i++) {
+        headers.Add("X-Header-" + std::to_string(i), std::to_string(i));
+    }
+    ASSERT_EQ(headers.Get("x-header-20"), "20");
+    ASSERT_EQ(headers.Get("Server"), "portcullis");
+}
+
+TEST(HttpHeadersTest, RewriteKeepsStorage) {
+    THttpHeaders headers;
+    headers.Add("Via", "a");
+    headers.Add("via", "b");
+    THttpHeaders copy = headers;
+
+    /* storage of replaced fields is dropped, so rewriting field does not grow headers */
+    for (size_t i = 0; i < 100; i++) {
+        headers.Set("Via", std::to_string(i));
+    }
+    ASSERT_EQ(headers.OwnedSize(), 1);
+    ASSERT_EQ(headers.Get("Via"), "99");
+
+    ASSERT_TRUE(headers.Remove("via"));
+    ASSERT_EQ(headers.OwnedSize(), 0);
+
+    /* copy keeps storage of its own fields */
+    ASSERT_EQ(copy.Size(), 2);
+    ASSERT_EQ(copy.OwnedSize(), 2);
+    ASSERT_EQ(copy.begin()->Value, "a");
+    ASSERT_EQ((copy.begin() + 1)->Value, "b");
+}
+
 int main(int argc, char* argv[]) {
     auto logger = spdlog::stdout_color_mt("reactor");
     logger->set_level(spdlog::level::debug);
@@ -0,0 +1,459 @@
+#include <signal.h>
+#include <sys/socket.h>
+
+#include <coro/reactor.h>
+#include <core/http_proxy.h>
+#include <handles/http.h>
+
+#include <gtest/gtest.h>
+
+class HttpProxyTest : public ::testing::Test {
+protected:
+    HttpProxyTest()
+        : Reactor_(spdlog::get("reactor"))
+    {}
+
+    static TSocketAddress Listen(TTcpHandlePtr& listener) {
+        listener = TTcpHandle::Create(false);
+        listener->Bind(GetAddrInfo("127.0.0.1", "0", true, "tcp")[0]);
+        listener->Listen(16);
+
+        sockaddr_storage addr;
+        socklen_t len = sizeof(addr);
+        getsockname(listener->Fd(), reinterpret_cast<sockaddr*>(&addr), &len);
+        return TSocketAddress(reinterpret_cast<sockaddr*>(&addr), len);
+    }
+
+    /*
+     * Backend answers every request with its url, requests it got whole are kept with their bodies.
+     * Urls starting with /unframed are answered without framing, body is ended by close of connection.
+     * Urls starting with /stall are not answered until proxy closes connection.
+     * Urls starting with /interim get interim responses before final one.
+     * Urls starting with /not-modified are answered with 304, its Content-Length describes body it does not have.
+     * After url starting with /drop-next the next request on the same connection is dropped with it.
+     * Urls starting with /framing are answered with framing fields of request instead of url.
+     * Urls starting with /trickle are answered byte by byte with pauses of 40ms.
+     */
+    void StartBackend() {
+        BackendAddr_ = Listen(BackendListener_);
+        Backend_ = Reactor()->StartAwaitableCoroutine([this]() {
+            while (true) {
+                TResult<TTcpHandlePtr> accepted = BackendListener_->Accept();
+                if (!accepted) {
+                    return;
+                }
+                BackendConnections_++;
+                BackendActive_++;
+                Reactor()->StartCoroutine([this, conn = std::move(accepted.Result())]() {
+                    THttpHandle handle(conn);
+                    bool drop = false;
+                    handle.ServeRequests([this, &handle, &conn, &drop](THttpRequest& request) {
+                        BackendRequests_++;
+                        if (drop) {
+                            return false;
+                        }
+                        drop = request.Url.compare(0, 10, "/drop-next") == 0;
+                        TResult<TMemoryRegion> body = handle.ReadBody(request);
+                        if (!body) {
+                            return false;
+                        }
+                        BackendBodies_.push_back(request.Url + " " + std::string(body.Result().DataAs<const char*>(), body.Result().Size()));
+                        if (request.Url.compare(0, 9, "/unframed") == 0) {
+                            conn->WriteAll(TMemoryRegion(std::string_view("HTTP/1.1 200 OK\r\n\r\n")));
+                            conn->WriteAll(TMemoryRegion(request.Url));
+                            return false;
+                        }
+                        if (request.Url.compare(0, 6, "/stall") == 0) {
+                            char buf[64];
+                            TResult<size_t> read;
+                            do {
+                                read = conn->Read(TMemoryRegion(buf, sizeof(buf)));
+                            } while (read && read.Result() > 0);
+                            return false;
+                        }
+                        THttpResponse response;
+                        response.MinorVersion = 1;
+                        response.Status = 200;
+                        response.Reason = "OK";
+                        if (request.Url.compare(0, 13, "/not-modified") == 0) {
+                            response.Status = 304;
+                            response.Reason = "Not Modified";
+                            response.Headers.Set("Content-Length", "10");
+                            return static_cast<bool>(handle.WriteResponse(response));
+                        }
+                        if (request.Url.compare(0, 8, "/interim") == 0) {
+                            conn->WriteAll(TMemoryRegion(std::string_view("HTTP/1.1 100 Continue\r\n\r\nHTTP/1.1 103 Early Hints\r\nLink: </style.css>\r\n\r\n")));
+                        }
+                        std::string answer = request.Url;
+                        if (request.Url.compare(0, 8, "/framing") == 0) {
+                            answer = std::string(request.Headers.Get("Content-Length").value_or("-")) + " " + std::string(request.Headers.Get("Transfer-Encoding").value_or("-"));
+                        }
+                        response.Headers.Set("Content-Length", std::to_string(answer.size()));
+                        if (request.Url.compare(0, 8, "/trickle") == 0) {
+                            if (!handle.WriteResponse(response)) {
+                                return false;
+                            }
+                            for (char& c : answer) {
+                                /* nothing comes from proxy meanwhile, so read just waits */
+                                char buf[1];
+                                conn->Read(TMemoryRegion(buf, sizeof(buf)), Reactor()->Now() + std::chrono::milliseconds(40));
+                                if (!conn->WriteAll(TMemoryRegion(&c, 1))) {
+                                    return false;
+                                }
+                            }
+                            return true;
+                        }
+                        return handle.WriteResponse(response) && conn->WriteAll(TMemoryRegion(answer));
+                    }, std::chrono::seconds(5));
+                    conn->Close();
+                    BackendActive_--;
+                });
+            }
+        });
+    }
+
+    /*
+     * Serves one client connection with `proxy`, client sends `requests` and reads all responses.
+     * @return "status body" of every response.
+     */
+    std::vector<std::string> Exchange(THttpProxy& proxy, const std::string& requests) {
+        TTcpHandlePtr listener;
+        TSocketAddress proxyAddr = Listen(listener);
+
+        TReactor::TCoroutine* server = Reactor()->StartAwaitableCoroutine([&]() {
+            TResult<TTcpHandlePtr> accepted = listener->Accept();
+            ASSERT_TRUE(accepted);
+            Served_ = proxy.Serve(accepted.Result());
+            accepted.Result()->Close();
+        });
+
+        std::vector<std::string> responses;
+        TTcpHandlePtr client = TTcpHandle::Create(false);
+        EXPECT_TRUE(client->Connect(proxyAddr));
+        EXPECT_TRUE(client->WriteAll(TMemoryRegion(std::string_view(requests))));
+        client->ShutdownWrite();
+
+        THttpHandle handle(client);
+        while (true) {
+            TResult<THttpResponse> response = handle.ReadResponse();
+            if (!response) {
+                break;
+            }
+            std::string status = std::to_string(response.Result().Status);
+            if (status == "304") {
+                responses.push_back(status + " ");
+                continue;
+            }
+            TResult<TMemoryRegion> body = handle.ReadBody(response.Result());
+            EXPECT_TRUE(body);
+            responses.push_back(status + " " + std::string(body.Result().DataAs<const char*>(), body.Result().Size()));
+        }
+
+        Reactor()->Await(server);
+        return responses;
+    }
+
+    template <typename Test>
+    void Run(Test test) {
+        Reactor_.StartCoroutine([this, test]() {
+            StartBackend();
+            test();
+            Reactor()->Cancel(Backend_);
+            Reactor()->Await(Backend_);
+        });
+        Reactor_.Run();
+    }
+
+    TReactor Reactor_;
+    TTcpHandlePtr BackendListener_;
+    TSocketAddress BackendAddr_;
+    TReactor::TCoroutine* Backend_ = nullptr;
+    size_t BackendConnections_ = 0;
+    size_t BackendRequests_ = 0;
+    /* backend connections not closed yet */
+    size_t BackendActive_ = 0;
+    std::vector<std::string> BackendBodies_;
+    TResult<size_t> Served_;
+};
+
+TEST_F(HttpProxyTest, RelayPersistentConnection) {
+    Run([this]() {
+        TConnectionPool pool;
+        TBackendGroupPtr backends = std::make_shared<TBackendGroup>(std::vector<TSocketAddress>{ BackendAddr_ }, TBackendGroup::TOptions());
+        THttpProxy::TOptions options;
+        THttpProxy proxy(options, backends, &pool);
+
+        std::vector<std::string> responses = Exchange(proxy,
+            "GET /first HTTP/1.1\r\nHost: test\r\n\r\n"
+            "POST /second HTTP/1.1\r\nHost: test\r\nContent-Length: 4\r\n\r\nbody"
+            "GET /third HTTP/1.1\r\nHost: test\r\n\r\n"
+        );
+
+        EXPECT_EQ(responses, std::vector<std::string>({ "200 /first", "200 /second", "200 /third" }));
+        ASSERT_TRUE(Served_);
+        EXPECT_EQ(Served_.Result(), 3);
+        EXPECT_EQ(BackendRequests_, 3);
+        /* backend connection is reused */
+        EXPECT_EQ(BackendConnections_, 1);
+        EXPECT_EQ(pool.Hits(), 2);
+    });
+}
+
+TEST_F(HttpProxyTest, HookOnMatchingRequests) {
+    Run([this]() {
+        TBackendGroupPtr backends = std::make_shared<TBackendGroup>(std::vector<TSocketAddress>{ BackendAddr_ }, TBackendGroup::TOptions());
+        THttpProxy::TOptions options;
+        options.Rules.push_back({ "", "/admin", "" });
+        options.Rules.push_back({ "DELETE", "", "" });
+
+        std::vector<std::string> hooked;
+        THttpProxy proxy(options, backends, nullptr, [&hooked](THttpRequest& request) -> std::optional<THttpResponse> {
+            hooked.push_back(request.Url);
+            if (request.Method == "DELETE") {
+                /* request is changed and forwarded */
+                request.Url = "/rewritten";
+                return std::nullopt;
+            }
+
+            THttpResponse response;
+            response.MinorVersion = 1;
+            response.Status = 403;
+            response.Reason = "Forbidden";
+            return response;
+        });
+
+        std::vector<std::string> responses = Exchange(proxy,
+            "GET /admin/panel HTTP/1.1\r\nHost: test\r\n\r\n"
+            "GET /index HTTP/1.1\r\nHost: test\r\n\r\n"
+            "DELETE /item HTTP/1.1\r\nHost: test\r\n\r\n"
+        );
+
+        EXPECT_EQ(responses, std::vector<std::string>({ "403 ", "200 /index", "200 /rewritten" }));
+        EXPECT_EQ(hooked, std::vector<std::string>({ "/admin/panel", "/item" }));
+        EXPECT_EQ(BackendRequests_, 2);
+    });
+}
+
+TEST_F(HttpProxyTest, CloseDelimitedResponse) {
+    Run([this]() {
+        TConnectionPool pool;
+        TBackendGroupPtr backends = std::make_shared<TBackendGroup>(std::vector<TSocketAddress>{ BackendAddr_ }, TBackendGroup::TOptions());
+        THttpProxy::TOptions options;
+        THttpProxy proxy(options, backends, &pool);
+
+        std::vector<std::string> responses = Exchange(proxy,
+            "GET /first HTTP/1.1\r\nHost: test\r\n\r\n"
+            "GET /unframed HTTP/1.1\r\nHost: test\r\n\r\n"
+            "GET /third HTTP/1.1\r\nHost: test\r\n\r\n"
+        );
+
+        /* body is relayed whole and client connection is closed after it */
+        EXPECT_EQ(responses, std::vector<std::string>({ "200 /first", "200 /unframed" }));
+        ASSERT_TRUE(Served_);
+        EXPECT_EQ(Served_.Result(), 2);
+        EXPECT_EQ(BackendRequests_, 2);
+        EXPECT_EQ(pool.Size(), 0);
+    });
+}
+
+TEST_F(HttpProxyTest, InterimAndBodylessResponses) {
+    Run([this]() {
+        TConnectionPool pool;
+        TBackendGroupPtr backends = std::make_shared<TBackendGroup>(std::vector<TSocketAddress>{ BackendAddr_ }, TBackendGroup::TOptions());
+        THttpProxy::TOptions options;
+        THttpProxy proxy(options, backends, &pool);
+
+        std::vector<std::string> responses = Exchange(proxy,
+            "GET /interim HTTP/1.1\r\nHost: test\r\n\r\n"
+            "GET /not-modified HTTP/1.1\r\nHost: test\r\nIf-None-Match: \"1\"\r\n\r\n"
+            "GET /third HTTP/1.1\r\nHost: test\r\n\r\n"
+        );
+
+        EXPECT_EQ(responses, std::vector<std::string>({ "200 /interim", "304 ", "200 /third" }));
+        ASSERT_TRUE(Served_);
+        EXPECT_EQ(Served_.Result(), 3);
+        /* nothing is left unread after 304, so backend connection is reused */
+        EXPECT_EQ(BackendConnections_, 1);
+        EXPECT_EQ(pool.Hits(), 2);
+    });
+}
+
+TEST_F(HttpProxyTest, RetryOnPooledConnection) {
+    Run([this]() {
+        TConnectionPool pool;
+        TBackendGroupPtr backends = std::make_shared<TBackendGroup>(std::vector<TSocketAddress>{ BackendAddr_ }, TBackendGroup::TOptions());
+        THttpProxy::TOptions options;
+        options.RelayTimeout = std::chrono::milliseconds(100);
+        THttpProxy proxy(options, backends, &pool);
+
+        std::vector<std::string> responses = Exchange(proxy,
+            "GET /drop-next HTTP/1.1\r\nHost: test\r\n\r\n"
+            "GET /second HTTP/1.1\r\nHost: test\r\n\r\n"
+        );
+
+        /* idempotent request is repeated on new connection */
+        EXPECT_EQ(responses, std::vector<std::string>({ "200 /drop-next", "200 /second" }));
+        EXPECT_EQ(BackendConnections_, 2);
+        EXPECT_EQ(BackendRequests_, 3);
+
+        responses = Exchange(proxy,
+            "GET /drop-next HTTP/1.1\r\nHost: test\r\n\r\n"
+            "POST /fourth HTTP/1.1\r\nHost: test\r\nContent-Length: 4\r\n\r\nbody"
+        );
+
+        /* the other is not, as backend could have processed it */
+        EXPECT_EQ(responses, std::vector<std::string>({ "200 /drop-next", "502 " }));
+        EXPECT_EQ(BackendConnections_, 2);
+        EXPECT_EQ(BackendRequests_, 5);
+
+        responses = Exchange(proxy,
+            "GET /first HTTP/1.1\r\nHost: test\r\n\r\n"
+            "GET /stall HTTP/1.1\r\nHost: test\r\n\r\n"
+        );
+
+        /* backend which timed out has got request, so even idempotent one is not repeated */
+        EXPECT_EQ(responses, std::vector<std::string>({ "200 /first", "502 " }));
+        EXPECT_EQ(BackendConnections_, 3);
+        EXPECT_EQ(BackendRequests_, 7);
+    });
+}
+
+TEST_F(HttpProxyTest, RelayTimeout) {
+    Run([this]() {
+        TBackendGroupPtr backends = std::make_shared<TBackendGroup>(std::vector<TSocketAddress>{ BackendAddr_ }, TBackendGroup::TOptions());
+        THttpProxy::TOptions options;
+        options.RelayTimeout = std::chrono::milliseconds(100);
+        THttpProxy proxy(options, backends, nullptr);
+
+        /* slow response which keeps making progress is relayed whole */
+        std::vector<std::string> responses = Exchange(proxy,
+            "GET /stall HTTP/1.1\r\nHost: test\r\n\r\n"
+            "GET /trickle HTTP/1.1\r\nHost: test\r\n\r\n"
+            "GET /second HTTP/1.1\r\nHost: test\r\n\r\n"
+        );
+
+        EXPECT_EQ(responses, std::vector<std::string>({ "502 ", "200 /trickle", "200 /second" }));
+    });
+}
+
+TEST_F(HttpProxyTest, BadGateway) {
+    Run([this]() {
+        /* port of backend listener which is closed */
+        TTcpHandlePtr listener;
+        TSocketAddress dead = Listen(listener);
+        listener->Close();
+
+        TBackendGroupPtr backends = std::make_shared<TBackendGroup>(std::vector<TSocketAddress>{ dead }, TBackendGroup::TOptions());
+        THttpProxy::TOptions options;
+        THttpProxy proxy(options, backends, nullptr);
+
+        std::vector<std::string> responses = Exchange(proxy,
+            "GET /first HTTP/1.1\r\nHost: test\r\n\r\n"
+            "GET /second HTTP/1.1\r\nHost: test\r\n\r\n"
+        );
+
+        EXPECT_EQ(responses, std::vector<std::string>({ "502 ", "502 " }));
+    });
+}
+
+TEST_F(HttpProxyTest, Sentinel) {
+    Run([this]() {
+        TBackendGroupPtr backends = std::make_shared<TBackendGroup>(std::vector<TSocketAddress>{ BackendAddr_ }, TBackendGroup::TOptions());
+        THttpProxy::TOptions options;
+        THttpProxy proxy(options, backends, nullptr);
+
+        std::vector<TSentinel::TSectionDef> sections(2);
+        sections[0].UrlPrefix = "/deny";
+        sections[0].Policy = TSentinel::SpDeny;
+        sections[0].Blocks = { { TSentinel::TCondition::BodyContains(false, TRegexpDef("SELECT|UNION")) } };
+        sections[1].UrlPrefix = "/allow";
+        sections[1].Policy = TSentinel::SpAllow;
+        sections[1].Blocks = { { TSentinel::TCondition::HasHeader(false, "X-Token") } };
+        TSentinel sentinel(std::move(sections));
+        proxy.SetSentinel(&sentinel);
+
+        std::vector<std::string> responses = Exchange(proxy,
+            "GET /allow/first HTTP/1.1\r\nHost: test\r\n\r\n"
+            "GET /allow/second HTTP/1.1\r\nHost: test\r\nX-Token: 1\r\n\r\n"
+            "POST /deny/third HTTP/1.1\r\nHost: test\r\nContent-Length: 4\r\n\r\nbody"
+            "POST /deny/fourth HTTP/1.1\r\nHost: test\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nSEL\r\n3\r\nECT\r\n0\r\n\r\n"
+            "GET /allow/fifth HTTP/1.1\r\nHost: test\r\nX-Token: 1\r\n\r\n"
+        );
+
+        /* connection is closed after request denied in the middle of body */
+        EXPECT_EQ(responses, std::vector<std::string>({ "403 ", "200 /allow/second", "200 /deny/third", "403 " }));
+        /* body is streamed, so backend gets head of the request denied by body, which is cut off then */
+        EXPECT_EQ(BackendRequests_, 3);
+    });
+}
+
+TEST_F(HttpProxyTest, SentinelHoldsBackDeniedBody) {
+    Run([this]() {
+        TBackendGroupPtr backends = std::make_shared<TBackendGroup>(std::vector<TSocketAddress>{ BackendAddr_ }, TBackendGroup::TOptions());
+        THttpProxy::TOptions options;
+        THttpProxy proxy(options, backends, nullptr);
+
+        /* body without token is denied only once it is over */
+        std::vector<TSentinel::TSectionDef> sections(1);
+        sections[0].UrlPrefix = "/upload";
+        sections[0].Policy = TSentinel::SpAllow;
+        sections[0].Blocks = { { TSentinel::TCondition::BodyContains(false, TRegexpDef("token")) } };
+        TSentinel sentinel(std::move(sections));
+        proxy.SetSentinel(&sentinel);
+
+        std::vector<std::string> responses = Exchange(proxy,
+            "POST /upload/first HTTP/1.1\r\nHost: test\r\nContent-Length: 9\r\n\r\ntoken=abc"
+            "GET /upload/empty HTTP/1.1\r\nHost: test\r\n\r\n"
+            "POST /upload/third HTTP/1.1\r\nHost: test\r\nContent-Length: 4\r\n\r\nnone"
+        );
+        EXPECT_EQ(responses, std::vector<std::string>({ "200 /upload/first", "403 ", "403 " }));
+
+        responses = Exchange(proxy,
+            "POST /upload/fourth HTTP/1.1\r\nHost: test\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nnon\r\n1\r\ne\r\n0\r\n\r\n"
+        );
+        EXPECT_EQ(responses, std::vector<std::string>({ "403 " }));
+
+        while (BackendActive_ > 0) {
+            Reactor()->Yield();
+        }
+        /* streamed bodies reach backend, but it never gets them whole */
+        EXPECT_EQ(BackendBodies_, std::vector<std::string>({ "/upload/first token=abc" }));
+        EXPECT_EQ(BackendRequests_, 3);
+    });
+}
+
+TEST_F(HttpProxyTest, SentinelKeepsFramingOfRequestWithoutBody) {
+    Run([this]() {
+        TBackendGroupPtr backends = std::make_shared<TBackendGroup>(std::vector<TSocketAddress>{ BackendAddr_ }, TBackendGroup::TOptions());
+        THttpProxy::TOptions options;
+        THttpProxy proxy(options, backends, nullptr);
+
+        std::vector<TSentinel::TSectionDef> sections(1);
+        sections[0].UrlPrefix = "/framing";
+        sections[0].Policy = TSentinel::SpDeny;
+        sections[0].Blocks = { { TSentinel::TCondition::BodyContains(false, TRegexpDef("SELECT"), true) } };
+        TSentinel sentinel(std::move(sections));
+        proxy.SetSentinel(&sentinel);
+
+        std::vector<std::string> responses = Exchange(proxy,
+            "GET /framing HTTP/1.1\r\nHost: test\r\n\r\n"
+            "POST /framing HTTP/1.1\r\nHost: test\r\nTransfer-Encoding: chunked\r\n\r\n4\r\nbody\r\n0\r\n\r\n"
+        );
+
+        /* buffered body is sent with its length, request without body is sent as is */
+        EXPECT_EQ(responses, std::vector<std::string>({ "200 - -", "200 4 -" }));
+    });
+}
+
+int main(int argc, char* argv[]) {
+    auto logger = spdlog::stdout_color_mt("reactor");
+    /* backend may answer request which proxy drops, like portcullis does, writes to closed sockets just fail */
+    ::signal(SIGPIPE, SIG_IGN);
+    /* the same suite is run against io_uring backend, see CMakeLists.txt */
+    const char* backend = getenv("PORTCULLIS_IO_BACKEND");
+    if (backend && std::string(backend) == "io_uring") {
+        TReactor::SetDefaultIoBackend(TReactor::IoUring);
+    }
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
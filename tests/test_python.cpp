@@ -0,0 +1,225 @@
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <fstream>
+
+#include <pybind11/embed.h>
+
+#include <core/service.h>
+#include <coro/reactor.h>
+#include <handles/common.h>
+#include <handles/tcp.h>
+#include <python/thread_states.h>
+
+#include <gtest/gtest.h>
+
+namespace py = pybind11;
+
+/*
+ * Python code is run in coroutines of fresh reactor as in worker of service,
+ * GIL of main thread is released meanwhile.
+ */
+class PythonTest : public ::testing::Test {
+protected:
+    PythonTest()
+        : Reactor_(spdlog::get("reactor"))
+    {}
+
+    void SetUp() override {
+        Main_ = PyEval_SaveThread();
+        States_.Attach(&Reactor_, Main_->interp);
+    }
+
+    void TearDown() override {
+        PyEval_RestoreThread(Main_);
+        const auto& internals = py::detail::get_internals();
+        PyThread_set_key_value(internals.tstate, Main_);
+        States_.Clear();
+    }
+
+    TReactor Reactor_;
+    /* declared after reactor, so its switch hook is removed first */
+    TPyThreadStates States_;
+    PyThreadState* Main_ = nullptr;
+};
+
+static const char AsyncHandlers[] = R"(
+class Context:
+    def __init__(self):
+        self.errors = []
+
+    def log_error(self, message):
+        self.errors.append(message)
+
+async def echo(ctx, client):
+    while True:
+        data = await client.read()
+        if not data:
+            break
+        await client.write_all(data)
+)";
+
+TEST_F(PythonTest, AsyncHandlerCanceled) {
+    int echoed[2];
+    int idle[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, echoed), 0);
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, idle), 0);
+
+    TReactor::TCoroutine* loopCoro = Reactor_.StartAwaitableCoroutine([this, &echoed, &idle]() {
+        ASSERT_TRUE(States_.Enter());
+        try {
+            py::module aio = py::module::import("portcullis.aio");
+            py::dict scope;
+            py::exec(AsyncHandlers, scope);
+            py::object ctx = scope["Context"]();
+
+            py::object loop = aio.attr("ReactorEventLoop")();
+            /* sockets of loop own fds from now on */
+            aio.attr("serve")(loop, scope["echo"], ctx, echoed[1]);
+            aio.attr("serve")(loop, scope["echo"], ctx, idle[1]);
+            aio.attr("run")(loop);
+
+            EXPECT_TRUE(loop.attr("is_closed")().cast<bool>());
+            EXPECT_EQ(py::len(loop.attr("clients")), 0);
+            EXPECT_EQ(py::len(ctx.attr("errors")), 0);
+        } catch (const std::exception& e) {
+            ADD_FAILURE() << e.what();
+        }
+        States_.Leave();
+    });
+
+    Reactor_.StartCoroutine([loopCoro, &echoed, &idle]() {
+        THandle client(Reactor(), echoed[0]);
+        THandle other(Reactor(), idle[0]);
+
+        ASSERT_TRUE(client.WriteAll(TMemoryRegion(std::string_view("hello"))));
+        char buf[16];
+        TResult<size_t> res = client.Read(TMemoryRegion(buf, sizeof(buf)));
+        ASSERT_TRUE(res);
+        EXPECT_EQ(std::string_view(buf, res.Result()), "hello");
+
+        /* both handlers wait for data, loop canceled on shutdown closes their connections */
+        Reactor()->Cancel(loopCoro);
+        Reactor()->Await(loopCoro);
+        for (THandle* handle : {&client, &other}) {
+            res = handle->Read(TMemoryRegion(buf, sizeof(buf)), Reactor()->Now() + std::chrono::seconds(1));
+            ASSERT_TRUE(res);
+            EXPECT_EQ(res.Result(), 0);
+        }
+    });
+
+    Reactor_.Run();
+}
+
+static void WriteFile(const std::string& path, const std::string& content) {
+    std::ofstream file(path, std::ios::trunc);
+    file << content;
+}
+
+/*
+ * Port which is free at the moment, listener bound to it is closed.
+ */
+static std::string FreePort() {
+    TTcpHandlePtr probe = TTcpHandle::Create(false);
+    probe->Bind(GetAddrInfo("127.0.0.1", "0", true, "tcp")[0]);
+
+    sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    getsockname(probe->Fd(), reinterpret_cast<sockaddr*>(&addr), &len);
+    probe->Close();
+    return std::to_string(TSocketAddress(reinterpret_cast<sockaddr*>(&addr), len).Port());
+}
+
+/*
+ * Whole answer of service to new connection, it is empty if connection fails.
+ */
+static std::string Ask(const TSocketAddress& addr) {
+    TTcpHandlePtr client = TTcpHandle::Create(false);
+    std::string answer;
+    if (client->Connect(addr)) {
+        char buf[64];
+        TResult<size_t> res;
+        while ((res = client->Read(TMemoryRegion(buf, sizeof(buf)), Reactor()->Now() + std::chrono::seconds(5))) && res.Result() > 0) {
+            answer.append(buf, res.Result());
+        }
+    }
+    client->Close();
+    return answer;
+}
+
+TEST(PythonServiceTest, Reload) {
+    char dirTemplate[] = "/tmp/portcullis-test-XXXXXX";
+    ASSERT_NE(mkdtemp(dirTemplate), nullptr);
+    std::string dir = dirTemplate;
+
+    /* handler answers with version of its file and reloads done so far */
+    static const char Handler[] = R"(
+def handler(ctx, client):
+    client.write_all(f"{VERSION} {ctx.reload_stats()['reloads']}".encode())
+)";
+    WriteFile(dir + "/handler.py", std::string("VERSION = 1\n") + Handler);
+
+    {
+        TReactor reactor(spdlog::get("reactor"));
+        TService service(spdlog::get("service"), dir + "/config.py");
+        std::string port;
+
+        reactor.StartCoroutine([&service, &dir, &port]() {
+            port = FreePort();
+            WriteFile(dir + "/config.py",
+                "host = \"127.0.0.1\"\n"
+                "port = \"" + port + "\"\n"
+                "backlog = 16\n"
+                "handler_file = \"" + dir + "/handler.py\"\n"
+                "protocol = \"tcp\"\n"
+                "backend_ip = \"127.0.0.1\"\n"
+                "backend_port = \"1\"\n"
+                "coroutine_stack_size = 4096 * 100\n"
+                "workers = 1\n");
+            service.Start();
+        });
+
+        reactor.StartCoroutine([&dir, &port]() {
+            TSocketAddress addr = GetAddrInfo("127.0.0.1", port, false, "tcp")[0];
+            EXPECT_EQ(Ask(addr), "1 0");
+
+            WriteFile(dir + "/handler.py", std::string("VERSION = 2\n") + Handler);
+            ::kill(::getpid(), SIGUSR1);
+
+            /* reload is done by its own thread, connections are served by old context meanwhile */
+            int pause[2];
+            ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, pause), 0);
+            THandle idle(Reactor(), pause[0]);
+            THandle peer(Reactor(), pause[1]);
+            std::string answer;
+            for (size_t i = 0; i < 250 && (answer = Ask(addr)) != "2 1"; i++) {
+                char buf[1];
+                idle.Read(TMemoryRegion(buf, sizeof(buf)), Reactor()->Now() + std::chrono::milliseconds(20));
+            }
+            EXPECT_EQ(answer, "2 1");
+
+            ::kill(::getpid(), SIGTERM);
+        });
+
+        reactor.Run();
+    }
+
+    ::unlink((dir + "/config.py").c_str());
+    ::unlink((dir + "/handler.py").c_str());
+    ::rmdir(dir.c_str());
+}
+
+int main(int argc, char* argv[]) {
+    auto logger = spdlog::stdout_color_mt("reactor");
+    auto serviceLogger = spdlog::stdout_color_mt("service");
+    /* the same suite is run against io_uring backend, see CMakeLists.txt */
+    const char* backend = getenv("PORTCULLIS_IO_BACKEND");
+    if (backend && std::string(backend) == "io_uring") {
+        TReactor::SetDefaultIoBackend(TReactor::IoUring);
+    }
+    py::scoped_interpreter interpreter;
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
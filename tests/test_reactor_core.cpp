@@ -1,6 +1,8 @@
 #include <unistd.h>
 #include <signal.h>
 
+#include <thread>
+
 #include <coro/reactor.h>
 
 #include <gtest/gtest.h>
@@ -209,9 +211,184 @@ TEST(ReactorCoreTest, MultipleCancel) {
     reactor.Run();
 }
 
+TEST(ReactorCoreTest, StacksReused) {
+    TReactor reactor(spdlog::get("reactor"));
+
+    for (int i = 0; i < 10; i++) {
+        reactor.StartCoroutine([]() {
+            Reactor()->Yield();
+        });
+        reactor.Run();
+    }
+
+    EXPECT_EQ(reactor.StackPool().Misses(), 1);
+    EXPECT_EQ(reactor.StackPool().Hits(), 9);
+    EXPECT_EQ(reactor.StackPool().Size(), 1);
+}
+
+TEST(ReactorCoreTest, StackPoolLimits) {
+    TReactor reactor(spdlog::get("reactor"));
+    reactor.StackPool().SetLimits(4, 2);
+
+    for (int i = 0; i < 10; i++) {
+        reactor.StartCoroutine([]() {
+            Reactor()->Yield();
+        });
+    }
+    reactor.Run();
+
+    EXPECT_EQ(reactor.StackPool().Misses(), 10);
+    EXPECT_EQ(reactor.StackPool().Size(), 4);
+}
+
+/*
+ * Hook keeps data of running coroutine active, like python thread state.
+ */
+static void TrackActive(void* arg, TCoroutine* from, TCoroutine* to) {
+    void** active = static_cast<void**>(arg);
+    EXPECT_EQ(*active, from ? from->HookData : nullptr);
+    EXPECT_NE(from, to);
+    *active = to ? to->HookData : nullptr;
+}
+
+static size_t Polls = 0;
+
+static void CountPolls(void* arg, TCoroutine* from, TCoroutine* to) {
+    TrackActive(arg, from, to);
+    if (!to) {
+        Polls++;
+    }
+}
+
+TEST(ReactorCoreTest, SwitchHook) {
+    TReactor reactor(spdlog::get("reactor"));
+    void* active = nullptr;
+    reactor.SetSwitchHook(&CountPolls, &active);
+
+    int first = 0;
+    int second = 0;
+    for (int* data : { &first, &second }) {
+        reactor.StartCoroutine([&active, data]() {
+            /* like thread state taken by coroutine */
+            Reactor()->Current()->HookData = data;
+            active = data;
+            for (int i = 0; i < 3; i++) {
+                Reactor()->Yield();
+                EXPECT_EQ(active, data);
+                (*data)++;
+            }
+
+            Reactor()->Current()->HookData = nullptr;
+            active = nullptr;
+        });
+    }
+    reactor.Run();
+
+    EXPECT_EQ(first, 3);
+    EXPECT_EQ(second, 3);
+    EXPECT_EQ(active, nullptr);
+    /* hook is told that nobody runs while reactor polls between rounds of yields */
+    EXPECT_GE(Polls, 3);
+}
+
+TEST(ReactorCoreTest, PostFromOtherThread) {
+    TReactor reactor(spdlog::get("reactor"));
+
+    bool called = false;
+    reactor.StartCoroutine([&called]() {
+        while (!called) {
+            Reactor()->Yield();
+        }
+    });
+
+    std::thread poster([&reactor, &called]() {
+        reactor.Post([&called]() {
+            called = true;
+        });
+    });
+
+    reactor.Run();
+    poster.join();
+
+    EXPECT_TRUE(called);
+}
+
+TEST(ReactorCoreTest, ReactorPerThread) {
+    std::vector<std::thread> threads;
+    std::vector<int> counters(4, 0);
+
+    for (size_t i = 0; i < counters.size(); i++) {
+        threads.emplace_back([&counter = counters[i]]() {
+            TReactor reactor(spdlog::get("reactor"));
+            TReactor* reactorPtr = &reactor;
+            for (int j = 0; j < 10; j++) {
+                reactor.StartCoroutine([&counter, reactorPtr]() {
+                    EXPECT_EQ(Reactor(), reactorPtr);
+                    Reactor()->Yield();
+                    counter++;
+                });
+            }
+            reactor.Run();
+        });
+    }
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    for (int counter : counters) {
+        EXPECT_EQ(counter, 10);
+    }
+}
+
+TEST(ReactorCoreTest, TimerWheelCascade) {
+    TReactor::TDeadline now = std::chrono::steady_clock::now();
+    TReactor::TTimerWheel wheel(now);
+
+    /* deadlines on every level of the wheel, including overflowing one */
+    std::vector<std::chrono::milliseconds> delays = {
+        std::chrono::milliseconds(0),
+        std::chrono::milliseconds(1),
+        std::chrono::milliseconds(255),
+        std::chrono::milliseconds(256),
+        std::chrono::milliseconds(70000),
+        std::chrono::hours(5),
+        std::chrono::hours(24 * 60),
+    };
+
+    std::vector<TReactor::TCoroutine> coros(delays.size());
+    for (size_t i = 0; i < delays.size(); i++) {
+        coros[i].Deadline = now + delays[i];
+        wheel.Push(&coros[i]);
+    }
+
+    std::vector<TReactor::TCoroutine*> expired;
+    TReactor::TDeadline t = now;
+    while (!wheel.Empty()) {
+        TReactor::TDeadline next = wheel.NextDeadline();
+        EXPECT_LE(next, coros[expired.size()].Deadline + std::chrono::milliseconds(1));
+        t = std::max(t, next);
+        wheel.PopExpired(t, [&expired, t](TReactor::TCoroutine* coro) {
+            EXPECT_LE(coro->Deadline, t);
+            expired.push_back(coro);
+        });
+    }
+
+    ASSERT_EQ(expired.size(), coros.size());
+    for (size_t i = 0; i < coros.size(); i++) {
+        EXPECT_EQ(expired[i], &coros[i]);
+        EXPECT_LE(expired[i]->Deadline, t);
+    }
+}
+
 int main(int argc, char* argv[]) {
     auto logger = spdlog::stdout_color_mt("reactor");
     logger->set_level(spdlog::level::debug);
+    /* the same suite is run against io_uring backend, see CMakeLists.txt */
+    const char* backend = getenv("PORTCULLIS_IO_BACKEND");
+    if (backend && std::string(backend) == "io_uring") {
+        TReactor::SetDefaultIoBackend(TReactor::IoUring);
+    }
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
 }
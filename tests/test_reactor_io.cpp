@@ -1,6 +1,12 @@
 #include <unistd.h>
+#include <sys/socket.h>
+#include <thread>
 
 #include <coro/reactor.h>
+#include <core/buffer.h>
+#include <handles/buffered.h>
+#include <handles/tcp.h>
+#include <util/network/address.h>
 
 #include <gtest/gtest.h>
 
@@ -123,8 +129,522 @@ TEST_F(ReactorIoTest, TestEcho) {
     Reactor_.Run();
 }
 
+static void CheckReadDeadline(TReactor& reactor, int fd) {
+    reactor.StartCoroutine([fd]() {
+        char buf[30];
+        TReactor::TDeadline start = std::chrono::steady_clock::now();
+        TResult<size_t> res = Reactor()->Read(fd, buf, sizeof(buf), start + std::chrono::milliseconds(20));
+        EXPECT_FALSE(res);
+        EXPECT_TRUE(res.TimedOut());
+        EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(20));
+    });
+
+    reactor.Run();
+}
+
+TEST_F(ReactorIoTest, ReadDeadlineHeap) {
+    Reactor_.SetDeadlineQueue(TReactor::DqHeap);
+    CheckReadDeadline(Reactor_, Pipe1_[0]);
+}
+
+TEST_F(ReactorIoTest, ReadDeadlineTimerWheel) {
+    Reactor_.SetDeadlineQueue(TReactor::DqTimerWheel);
+    CheckReadDeadline(Reactor_, Pipe1_[0]);
+}
+
+TEST_F(ReactorIoTest, ReplaceDeadlineQueue) {
+    Reactor_.SetDeadlineQueue(TReactor::DqTimerWheel);
+
+    Reactor_.StartCoroutine([this]() {
+        char buf[30];
+        TReactor::TDeadline start = std::chrono::steady_clock::now();
+        TResult<size_t> res = Reactor()->Read(Pipe1_[0], buf, sizeof(buf), start + std::chrono::milliseconds(20));
+        EXPECT_TRUE(res.TimedOut());
+        EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(20));
+    });
+
+    /* sleeping coroutine is kept by queue of the same kind and moved to the new one */
+    Reactor_.StartCoroutine([this]() {
+        Reactor()->SetDeadlineQueue(TReactor::DqTimerWheel);
+        EXPECT_EQ(Reactor()->DeadlineQueueKind(), TReactor::DqTimerWheel);
+        Reactor()->SetDeadlineQueue(TReactor::DqHeap);
+        EXPECT_EQ(Reactor()->DeadlineQueueKind(), TReactor::DqHeap);
+    });
+
+    Reactor_.Run();
+}
+
+TEST_F(ReactorIoTest, ReadBeforeDeadline) {
+    const char testStr[] = "hello, portcullis";
+
+    for (TReactor::EDeadlineQueueKind kind : { TReactor::DqHeap, TReactor::DqTimerWheel }) {
+        Reactor_.SetDeadlineQueue(kind);
+
+        Reactor_.StartCoroutine([this, testStr]() {
+            char buf[30];
+            TResult<size_t> res = Reactor()->Read(Pipe1_[0], buf, sizeof(buf), Reactor()->Now() + std::chrono::seconds(10));
+            EXPECT_TRUE(res);
+            EXPECT_EQ(res.Result(), sizeof(testStr));
+        });
+
+        Reactor_.StartCoroutine([this, testStr]() {
+            write(Pipe1_[1], testStr, sizeof(testStr));
+        });
+
+        /* woken up coroutine must leave deadline queue, otherwise reactor would sleep for 10 seconds */
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        Reactor_.Run();
+        EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+    }
+}
+
+TEST_F(ReactorIoTest, ReadFixed) {
+    const char testStr[] = "hello, portcullis";
+
+    Reactor_.StartCoroutine([this, testStr]() {
+        TSocketBuffer buffer(TSocketBuffer::DefaultSize);
+        buffer.Register(Reactor());
+        if (Reactor()->IoBackend() == TReactor::IoUring) {
+            EXPECT_GE(buffer.BufferIndex(), 0);
+        } else {
+            EXPECT_EQ(buffer.BufferIndex(), -1);
+        }
+
+        TResult<size_t> res = Reactor()->ReadFixed(Pipe1_[0], buffer.End(), buffer.Remaining(), buffer.BufferIndex());
+        EXPECT_TRUE(res);
+        EXPECT_EQ(res.Result(), sizeof(testStr));
+        EXPECT_EQ(memcmp(buffer.Data(), testStr, sizeof(testStr)), 0);
+    });
+
+    Reactor_.StartCoroutine([this, testStr]() {
+        write(Pipe1_[1], testStr, sizeof(testStr));
+    });
+
+    Reactor_.Run();
+}
+
+TEST_F(ReactorIoTest, AcceptConnect) {
+    int listener = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    ASSERT_NE(listener, -1);
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+    ASSERT_EQ(listen(listener, 16), 0);
+
+    socklen_t len = sizeof(addr);
+    ASSERT_EQ(getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &len), 0);
+    TSocketAddress listenAddr(reinterpret_cast<sockaddr*>(&addr), len);
+
+    Reactor_.RegisterNonBlockingFd(listener);
+
+    static constexpr int ClientsCount = 3;
+
+    Reactor_.StartCoroutine([listener]() {
+        for (int i = 0; i < ClientsCount; i++) {
+            TSocketAddress peer;
+            TResult<int> accepted = Reactor()->Accept(listener, &peer);
+            ASSERT_TRUE(accepted);
+            EXPECT_EQ(peer.Host(), "127.0.0.1");
+
+            Reactor()->RegisterNonBlockingFd(accepted.Result());
+            int id = 0;
+            TResult<size_t> res = Reactor()->Read(accepted.Result(), &id, sizeof(id));
+            EXPECT_TRUE(res);
+            EXPECT_EQ(res.Result(), sizeof(id));
+            Reactor()->CloseFd(accepted.Result());
+            close(accepted.Result());
+        }
+
+        /* nobody connects anymore */
+        TSocketAddress peer;
+        TResult<int> accepted = Reactor()->Accept(listener, &peer, std::chrono::steady_clock::now() + std::chrono::milliseconds(10));
+        EXPECT_TRUE(accepted.TimedOut());
+    });
+
+    for (int i = 0; i < ClientsCount; i++) {
+        Reactor_.StartCoroutine([i, listenAddr]() {
+            int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+            Reactor()->RegisterNonBlockingFd(fd);
+
+            TResult<bool> connected = Reactor()->Connect(fd, listenAddr);
+            EXPECT_TRUE(connected);
+
+            TResult<size_t> res = Reactor()->Write(fd, &i, sizeof(i));
+            EXPECT_TRUE(res);
+
+            Reactor()->CloseFd(fd);
+            close(fd);
+        });
+    }
+
+    Reactor_.Run();
+
+    Reactor_.CloseFd(listener);
+    close(listener);
+}
+
+static void CheckSocketBufferWrap(TSocketBuffer& buffer) {
+    std::string payload;
+    for (size_t i = 0; i < buffer.Capacity(); i++) {
+        payload.push_back('a' + i % 26);
+    }
+
+    size_t head = buffer.Capacity() * 3 / 4;
+    buffer.Append(payload.data(), head);
+    buffer.ChopBegin(head - 10);
+    EXPECT_EQ(buffer.Size(), 10);
+    EXPECT_EQ(buffer.Remaining(), buffer.Capacity() - 10);
+
+    /* free space crosses the end of underlying memory, but it is still contiguous */
+    size_t tail = buffer.Remaining();
+    memcpy(buffer.End(), payload.data() + head, tail - head);
+    memcpy(static_cast<char*>(buffer.End()) + tail - head, payload.data(), head);
+    buffer.Advance(tail);
+    EXPECT_TRUE(buffer.Full());
+
+    std::string expected = payload.substr(head - 10, 10) + payload.substr(head, tail - head) + payload.substr(0, head);
+    EXPECT_EQ(std::string(buffer.DataAs<const char*>(), buffer.Size()), expected);
+}
+
+TEST_F(ReactorIoTest, SocketBufferRing) {
+    TSocketBuffer ring(TSocketBuffer::DefaultSize);
+    EXPECT_TRUE(ring.Mirrored());
+    CheckSocketBufferWrap(ring);
+
+    TSocketBuffer plain(1000);
+    EXPECT_FALSE(plain.Mirrored());
+    CheckSocketBufferWrap(plain);
+}
+
+TEST_F(ReactorIoTest, BufferPool) {
+    TBufferPool pool;
+    pool.SetMaxFreeBytes(32768);
+
+    {
+        TSocketBuffer buffer(pool, 10000);
+        EXPECT_EQ(buffer.Capacity(), 16384);
+        EXPECT_TRUE(buffer.Mirrored());
+        CheckSocketBufferWrap(buffer);
+        EXPECT_EQ(pool.UsedBytes(), 16384);
+    }
+    EXPECT_EQ(pool.UsedBytes(), 0);
+    EXPECT_EQ(pool.FreeBytes(), 16384);
+
+    {
+        /* the same block is reused */
+        TSocketBuffer first(pool, 16384);
+        EXPECT_EQ(pool.Hits(), 1);
+        TSocketBuffer second(pool, 16384);
+        TSocketBuffer third(pool, 16384);
+        EXPECT_EQ(pool.Misses(), 3);
+        EXPECT_EQ(pool.AllocatedBytes(), 3 * 16384);
+    }
+
+    /* only blocks fitting into free limit are kept */
+    EXPECT_EQ(pool.FreeBytes(), 32768);
+    EXPECT_EQ(pool.AllocatedBytes(), 32768);
+
+    pool.SetMaxFreeBytes(0);
+    EXPECT_EQ(pool.FreeBytes(), 0);
+    EXPECT_EQ(pool.AllocatedBytes(), 0);
+
+    pool.SetHugePages(true);
+    {
+        TSocketBuffer buffer(pool, 4096);
+        EXPECT_FALSE(buffer.Mirrored());
+        EXPECT_EQ(pool.AllocatedBytes(), TBufferPool::ArenaSize);
+        CheckSocketBufferWrap(buffer);
+    }
+    EXPECT_EQ(pool.FreeBytes(), 4096);
+}
+
+TEST_F(ReactorIoTest, BufferPoolForeignRelease) {
+    TBufferPool pool;
+
+    /* block released on another thread waits until owner takes it back */
+    std::unique_ptr<TSocketBuffer> buffer = std::make_unique<TSocketBuffer>(pool, 4096);
+    std::thread([&buffer]() {
+        buffer.reset();
+    }).join();
+    EXPECT_EQ(pool.UsedBytes(), 4096);
+    EXPECT_EQ(pool.FreeBytes(), 0);
+
+    {
+        TSocketBuffer reused(pool, 4096);
+        EXPECT_EQ(pool.Hits(), 1);
+        EXPECT_EQ(pool.UsedBytes(), 4096);
+    }
+    EXPECT_EQ(pool.FreeBytes(), 4096);
+
+    /* block which outlives its pool frees itself */
+    std::unique_ptr<TBufferPool> gone = std::make_unique<TBufferPool>();
+    TSocketBuffer late(*gone, 4096);
+    gone.reset();
+    CheckSocketBufferWrap(late);
+}
+
+TEST_F(ReactorIoTest, TransferExactlySplice) {
+    int from[2];
+    int to[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, from), 0);
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, to), 0);
+
+    static constexpr size_t PayloadSize = 1 << 20;
+    std::vector<char> payload(PayloadSize);
+    for (size_t i = 0; i < PayloadSize; i++) {
+        payload[i] = i * 7 + i / 4096;
+    }
+
+    Reactor_.StartCoroutine([&]() {
+        TTcpHandle source(Reactor(), from[1]);
+        TTcpHandle destination(Reactor(), to[0]);
+        TSocketBuffer buffer(4096);
+
+        TResult<size_t> res = source.TransferExactly(destination, buffer, PayloadSize);
+        ASSERT_TRUE(res);
+        EXPECT_EQ(res.Result(), PayloadSize);
+
+        /* pipe is returned to pool and reused by the next transfer, which reaches end of stream */
+        EXPECT_EQ(Reactor()->PipePool().Size(), 1);
+        res = source.TransferExactly(destination, buffer, PayloadSize);
+        ASSERT_TRUE(res);
+        EXPECT_EQ(res.Result(), 0);
+        EXPECT_EQ(Reactor()->PipePool().Hits(), 1);
+        EXPECT_EQ(Reactor()->PipePool().Misses(), 1);
+    });
+
+    Reactor_.StartCoroutine([&]() {
+        THandle writer(Reactor(), from[0]);
+        TResult<size_t> res = writer.WriteAll(TMemoryRegion(payload.data(), payload.size()));
+        EXPECT_TRUE(res);
+    });
+
+    Reactor_.StartCoroutine([&]() {
+        THandle reader(Reactor(), to[1]);
+        std::vector<char> received(PayloadSize);
+        size_t offset = 0;
+        while (offset < PayloadSize) {
+            TResult<size_t> res = reader.Read(TMemoryRegion(received.data() + offset, PayloadSize - offset));
+            ASSERT_TRUE(res);
+            ASSERT_GT(res.Result(), 0);
+            offset += res.Result();
+        }
+        EXPECT_EQ(received, payload);
+    });
+
+    Reactor_.Run();
+}
+
+TEST_F(ReactorIoTest, LazyBufferedReader) {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+    TBufferPool& pool = Reactor_.BufferPool();
+
+    Reactor_.StartCoroutine([&]() {
+        TBufferedReader<TTcpHandlePtr> reader(std::make_shared<TTcpHandle>(Reactor(), fds[1]));
+
+        /* reader waiting for data holds no buffer */
+        TResult<TMemoryRegion> res = reader.Read();
+        ASSERT_TRUE(res);
+        EXPECT_EQ(std::string(res.Result().DataAs<char*>(), res.Result().Size()), "ping");
+        EXPECT_EQ(pool.UsedBytes(), TSocketBuffer::DefaultSize);
+
+        reader.ChopBegin(2);
+        EXPECT_EQ(pool.UsedBytes(), TSocketBuffer::DefaultSize);
+        reader.ChopBegin(2);
+        EXPECT_EQ(pool.UsedBytes(), 0);
+
+        /* the same block is taken again */
+        res = reader.Read();
+        ASSERT_TRUE(res);
+        EXPECT_EQ(res.Result().Size(), 4);
+        EXPECT_EQ(pool.Hits(), 1);
+    });
+
+    Reactor_.StartCoroutine([&]() {
+        THandle writer(Reactor(), fds[0]);
+        for (int i = 0; i < 3; i++) {
+            Reactor()->Yield();
+        }
+        EXPECT_EQ(pool.UsedBytes(), 0);
+        ASSERT_TRUE(writer.WriteAll(std::string_view("ping")));
+
+        for (int i = 0; i < 3; i++) {
+            Reactor()->Yield();
+        }
+        ASSERT_TRUE(writer.WriteAll(std::string_view("pong")));
+    });
+
+    Reactor_.Run();
+}
+
+TEST_F(ReactorIoTest, TransferUntilMatch) {
+    int source[2];
+    int destination[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, source), 0);
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, destination), 0);
+
+    TStreamRegexpDatabase db({ TRegexpDef("EVIL", HS_FLAG_SOM_LEFTMOST), TRegexpDef("BAD") });
+
+    Reactor_.StartCoroutine([&]() {
+        TBufferedReader<TTcpHandlePtr> reader(std::make_shared<TTcpHandle>(Reactor(), source[1]));
+        THandle writer(Reactor(), source[0]);
+        THandle to(Reactor(), destination[0]);
+        THandle from(Reactor(), destination[1]);
+
+        auto stop = [](unsigned int, size_t, size_t) {
+            return true;
+        };
+
+        /* data is forwarded up to the start of match, the rest is held back in buffer */
+        ASSERT_TRUE(writer.WriteAll(std::string_view("aaaabbEVILcc")));
+        TStreamRegexpMatcher matcher(db, stop);
+        TResult<size_t> res = reader.TransferUntil(to, 100, matcher);
+        ASSERT_TRUE(res);
+        EXPECT_EQ(res.Result(), 6);
+        EXPECT_TRUE(matcher.Stopped());
+        EXPECT_EQ(std::string(reader.CurrentMemoryRegion().DataAs<const char*>(), reader.BufferedSize()), "EVILcc");
+
+        char buf[64];
+        TResult<size_t> read = from.Read(TMemoryRegion(buf, sizeof(buf)));
+        ASSERT_TRUE(read);
+        EXPECT_EQ(std::string(buf, read.Result()), "aaaabb");
+        reader.ChopBegin(reader.BufferedSize());
+
+        /* without start of match the whole piece containing it is held back */
+        ASSERT_TRUE(writer.WriteAll(std::string_view("xBADy")));
+        TStreamRegexpMatcher another(db, stop);
+        res = reader.TransferUntil(to, 100, another);
+        ASSERT_TRUE(res);
+        EXPECT_EQ(res.Result(), 0);
+        EXPECT_TRUE(another.Stopped());
+        EXPECT_EQ(reader.BufferedSize(), 5);
+        reader.ChopBegin(reader.BufferedSize());
+
+        /* nothing matched, transfer stops at size */
+        ASSERT_TRUE(writer.WriteAll(std::string_view("okay")));
+        TStreamRegexpMatcher clean(db, stop);
+        res = reader.TransferUntil(to, 3, clean);
+        ASSERT_TRUE(res);
+        EXPECT_EQ(res.Result(), 3);
+        EXPECT_FALSE(clean.Stopped());
+        EXPECT_EQ(reader.BufferedSize(), 1);
+    });
+
+    Reactor_.Run();
+}
+
+TEST_F(ReactorIoTest, WriteChain) {
+    /* chain is longer than inline storage and than one writev */
+    std::vector<std::string> parts;
+    std::string expected;
+    for (size_t i = 0; i < 2 * THandle::MaxWriteIovecs + 3; i++) {
+        parts.push_back(std::to_string(i) + ",");
+        expected += parts.back();
+    }
+
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+    /* reader end stays open until writer is done */
+    THandle reader(&Reactor_, fds[1]);
+
+    Reactor_.StartCoroutine([&]() {
+        THandle writer(Reactor(), fds[0]);
+        TMemoryRegionChain chain;
+        for (std::string& part : parts) {
+            chain.Add(part);
+        }
+
+        TResult<size_t> res = writer.Write(chain);
+        ASSERT_TRUE(res);
+        EXPECT_EQ(chain.Size(), parts.size() - THandle::MaxWriteIovecs);
+
+        res = writer.WriteAll(chain);
+        ASSERT_TRUE(res);
+        EXPECT_TRUE(chain.Empty());
+
+        /* nobody reads the other end, so socket fills up and write times out */
+        std::string chunk(1 << 16, 'x');
+        TReactor::TDeadline deadline = Reactor()->Now() + std::chrono::milliseconds(20);
+        do {
+            TMemoryRegionChain filler = { chunk };
+            res = writer.WriteAll(filler, deadline);
+        } while (res);
+        EXPECT_TRUE(res.TimedOut());
+    });
+
+    Reactor_.StartCoroutine([&]() {
+        std::string received(expected.size(), '\0');
+        size_t offset = 0;
+        while (offset < received.size()) {
+            TResult<size_t> res = reader.Read(TMemoryRegion(received.data() + offset, received.size() - offset));
+            ASSERT_TRUE(res);
+            ASSERT_GT(res.Result(), 0);
+            offset += res.Result();
+        }
+        EXPECT_EQ(received, expected);
+    });
+
+    Reactor_.Run();
+}
+
+TEST_F(ReactorIoTest, WaitForLevel) {
+    Reactor_.StartCoroutine([this]() {
+        TResult<int> res = Reactor()->WaitForLevel(Pipe1_[0], TReactor::EvRead);
+        ASSERT_TRUE(res);
+        EXPECT_EQ(res.Result(), TReactor::EvRead);
+
+        /* data is read past reactor, so readiness it saw is stale now */
+        char buf[30];
+        EXPECT_EQ(::read(Pipe1_[0], buf, sizeof(buf)), 1);
+        res = Reactor()->WaitForLevel(Pipe1_[0], TReactor::EvRead, Reactor()->Now() + std::chrono::milliseconds(20));
+        EXPECT_TRUE(res.TimedOut());
+
+        res = Reactor()->WaitForLevel(Pipe1_[0], TReactor::EvRead);
+        ASSERT_TRUE(res);
+        EXPECT_EQ(::read(Pipe1_[0], buf, sizeof(buf)), 1);
+    });
+
+    Reactor_.StartCoroutine([this]() {
+        EXPECT_EQ(::write(Pipe1_[1], "a", 1), 1);
+
+        /* sleeps until the reader timed out */
+        char buf[1];
+        TResult<size_t> res = Reactor()->Read(Pipe2_[0], buf, sizeof(buf), Reactor()->Now() + std::chrono::milliseconds(40));
+        EXPECT_TRUE(res.TimedOut());
+        EXPECT_EQ(::write(Pipe1_[1], "b", 1), 1);
+    });
+
+    Reactor_.Run();
+}
+
+TEST_F(ReactorIoTest, HandleRelease) {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+    THandle peer(&Reactor_, fds[1]);
+
+    size_t fd = InvalidFd;
+    {
+        THandle handle(&Reactor_, fds[0]);
+        fd = handle.Release();
+        EXPECT_FALSE(handle.Active());
+        EXPECT_EQ(handle.Release(), InvalidFd);
+    }
+
+    /* released fd outlives handle */
+    EXPECT_EQ(::write(fd, "a", 1), 1);
+    ::close(fd);
+}
+
 int main(int argc, char* argv[]) {
     auto logger = spdlog::stdout_color_mt("reactor");
+    /* the same suite is run against io_uring backend, see CMakeLists.txt */
+    const char* backend = getenv("PORTCULLIS_IO_BACKEND");
+    if (backend && std::string(backend) == "io_uring") {
+        TReactor::SetDefaultIoBackend(TReactor::IoUring);
+    }
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
 }
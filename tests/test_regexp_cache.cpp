@@ -0,0 +1,132 @@
+#include <regexp/cache.h>
+#include <regexp/database.h>
+#include <regexp/matchers.h>
+
+#include <dirent.h>
+#include <fstream>
+
+#include <gtest/gtest.h>
+
+class RegexpCacheTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        char dir[] = "/tmp/portcullis-regexp-cache-XXXXXX";
+        ASSERT_NE(mkdtemp(dir), nullptr);
+        /* cache creates missing directory */
+        Directory_ = std::string(dir) + "/cache";
+        TRegexpCache::SetDirectory(Directory_);
+    }
+
+    void TearDown() override {
+        TRegexpCache::SetDirectory("");
+        for (const std::string& file : Files()) {
+            ::unlink((Directory_ + "/" + file).c_str());
+        }
+        ::rmdir(Directory_.c_str());
+        ::rmdir(Directory_.substr(0, Directory_.rfind('/')).c_str());
+    }
+
+    std::vector<std::string> Files() const {
+        std::vector<std::string> files;
+        DIR* dir = ::opendir(Directory_.c_str());
+        if (!dir) {
+            return files;
+        }
+        while (dirent* entry = ::readdir(dir)) {
+            if (entry->d_name[0] != '.') {
+                files.push_back(entry->d_name);
+            }
+        }
+        ::closedir(dir);
+        return files;
+    }
+
+    static size_t Matches(const TBlockRegexpDatabase& db, std::string_view text) {
+        size_t matches = 0;
+        TBlockRegexpMatcher matcher(db, [&matches](unsigned int, size_t, size_t) {
+            matches++;
+            return false;
+        });
+        matcher.Scan(TMemoryRegion(text));
+        return matches;
+    }
+
+    std::string Directory_;
+};
+
+TEST_F(RegexpCacheTest, LoadsCompiledDatabase) {
+    size_t hits = TRegexpCache::Hits();
+    size_t misses = TRegexpCache::Misses();
+
+    {
+        TBlockRegexpDatabase db({ TRegexpDef("needle"), TRegexpDef("hay", HS_FLAG_CASELESS) });
+        EXPECT_EQ(Matches(db, "HAY needle"), 2);
+    }
+    EXPECT_EQ(TRegexpCache::Misses(), misses + 1);
+    EXPECT_EQ(Files().size(), 1);
+
+    {
+        TBlockRegexpDatabase db({ TRegexpDef("needle"), TRegexpDef("hay", HS_FLAG_CASELESS) });
+        EXPECT_EQ(Matches(db, "HAY needle"), 2);
+    }
+    EXPECT_EQ(TRegexpCache::Hits(), hits + 1);
+    EXPECT_EQ(TRegexpCache::Misses(), misses + 1);
+}
+
+TEST_F(RegexpCacheTest, KeyedByFlagsAndMode) {
+    size_t misses = TRegexpCache::Misses();
+
+    TBlockRegexpDatabase plain({ TRegexpDef("needle") });
+    TBlockRegexpDatabase caseless({ TRegexpDef("needle", HS_FLAG_CASELESS) });
+    TStreamRegexpDatabase stream({ TRegexpDef("needle") });
+
+    EXPECT_EQ(TRegexpCache::Misses(), misses + 3);
+    EXPECT_EQ(Files().size(), 3);
+    EXPECT_EQ(Matches(plain, "NEEDLE"), 0);
+    EXPECT_EQ(Matches(caseless, "NEEDLE"), 1);
+}
+
+TEST_F(RegexpCacheTest, CorruptedFileIsReplaced) {
+    {
+        TBlockRegexpDatabase db({ TRegexpDef("needle") });
+    }
+    ASSERT_EQ(Files().size(), 1);
+    {
+        std::ofstream file(Directory_ + "/" + Files()[0], std::ios::binary | std::ios::trunc);
+        file << "garbage";
+    }
+
+    size_t hits = TRegexpCache::Hits();
+    size_t errors = TRegexpCache::Errors();
+    {
+        TBlockRegexpDatabase db({ TRegexpDef("needle") });
+        EXPECT_EQ(Matches(db, "needle"), 1);
+    }
+    EXPECT_EQ(TRegexpCache::Errors(), errors + 1);
+    EXPECT_EQ(TRegexpCache::Hits(), hits);
+
+    {
+        TBlockRegexpDatabase db({ TRegexpDef("needle") });
+    }
+    EXPECT_EQ(TRegexpCache::Hits(), hits + 1);
+}
+
+TEST_F(RegexpCacheTest, Disabled) {
+    TRegexpCache::SetDirectory("");
+    size_t misses = TRegexpCache::Misses();
+
+    TBlockRegexpDatabase db({ TRegexpDef("needle") });
+    EXPECT_EQ(Matches(db, "needle"), 1);
+    EXPECT_EQ(TRegexpCache::Misses(), misses);
+    EXPECT_TRUE(Files().empty());
+}
+
+TEST_F(RegexpCacheTest, CompileError) {
+    EXPECT_THROW(TBlockRegexpDatabase({ TRegexpDef("(unbalanced") }), TException);
+    EXPECT_TRUE(Files().empty());
+}
+
+int main(int argc, char* argv[]) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,126 @@
+#include <regexp/headers.h>
+#include <regexp/matchers.h>
+
+#include <gtest/gtest.h>
+
+using TMatch = std::tuple<unsigned int, size_t, size_t>;
+
+TEST(RegexpMatchers, VectoredScanSpansRegions) {
+    TVectoredRegexpDatabase db({ TRegexpDef("needle", HS_FLAG_SOM_LEFTMOST), TRegexpDef("hay", HS_FLAG_SOM_LEFTMOST) });
+
+    std::vector<TMatch> matches;
+    TVectoredRegexpMatcher matcher(db, [&matches](unsigned int id, size_t from, size_t to) {
+        matches.emplace_back(id, from, to);
+        return false;
+    });
+
+    std::string first = "ha";
+    std::string second = "y ne";
+    std::string third = "edle";
+    EXPECT_FALSE(matcher.Scan({ TMemoryRegion(first), TMemoryRegion(second), TMemoryRegion(third) }));
+
+    /* offsets are counted from the beginning of chain */
+    EXPECT_EQ(matches, std::vector<TMatch>({ { 1, 0, 3 }, { 0, 4, 10 } }));
+}
+
+TEST(RegexpMatchers, VectoredScanTerminated) {
+    TVectoredRegexpDatabase db({ TRegexpDef("a") });
+
+    size_t calls = 0;
+    TVectoredRegexpMatcher matcher(db, [&calls](unsigned int, size_t, size_t) {
+        calls++;
+        return true;
+    });
+
+    std::string data = "aaa";
+    EXPECT_TRUE(matcher.Scan({ TMemoryRegion(data), TMemoryRegion(data) }));
+    EXPECT_EQ(calls, 1);
+}
+
+TEST(RegexpMatchers, StreamScanChain) {
+    TStreamRegexpDatabase db({ TRegexpDef("needle"), TRegexpDef("stop") });
+
+    std::vector<unsigned int> matches;
+    TStreamRegexpMatcher matcher(db, [&matches](unsigned int id, size_t, size_t) {
+        matches.push_back(id);
+        return id == 1;
+    });
+
+    std::string first = "nee";
+    std::string second = "dle";
+    EXPECT_FALSE(matcher.Scan({ TMemoryRegion(first), TMemoryRegion(second) }));
+    EXPECT_EQ(matches, std::vector<unsigned int>({ 0 }));
+
+    /* stream goes on with the next chain, regions after terminated one are not scanned */
+    std::string third = "st";
+    std::string fourth = "op";
+    std::string fifth = "needle";
+    EXPECT_TRUE(matcher.Scan({ TMemoryRegion(third), TMemoryRegion(fourth), TMemoryRegion(fifth) }));
+    EXPECT_EQ(matches, std::vector<unsigned int>({ 0, 1 }));
+}
+
+TEST(RegexpMatchers, CallbackException) {
+    TVectoredRegexpDatabase db({ TRegexpDef("a") });
+    TVectoredRegexpMatcher matcher(db, [](unsigned int, size_t, size_t) -> bool {
+        throw TException() << "callback failed";
+    });
+
+    std::string data = "a";
+    EXPECT_THROW(matcher.Scan({ TMemoryRegion(data) }), TException);
+}
+
+TEST(RegexpMatchers, BlockScan) {
+    TBlockRegexpDatabase db({ TRegexpDef("needle"), TRegexpDef("stop") });
+
+    std::vector<unsigned int> matches;
+    TBlockRegexpMatcher matcher(db, [&matches](unsigned int id, size_t, size_t) {
+        matches.push_back(id);
+        return id == 1;
+    });
+
+    std::string data = "haystack with needle";
+    EXPECT_FALSE(matcher.Scan(TMemoryRegion(data)));
+    EXPECT_EQ(matches, std::vector<unsigned int>({ 0 }));
+
+    /* every block is matched from its beginning */
+    std::string stop = "stop needle";
+    EXPECT_TRUE(matcher.Scan(TMemoryRegion(stop)));
+    EXPECT_EQ(matches, std::vector<unsigned int>({ 0, 1 }));
+}
+
+TEST(RegexpMatchers, HeaderTargets) {
+    THeaderRegexpDatabase db({
+        { "User-Agent", TRegexpDef("sqlmap") },
+        { "cookie", TRegexpDef("admin=1") },
+        { std::string(THeaderRegexpDatabase::UrlTarget), TRegexpDef("\\.\\./") },
+        { "X-Forwarded-For", TRegexpDef("^10\\.") },
+    });
+    EXPECT_EQ(db.Size(), 4);
+
+    THttpRequest request;
+    request.Method = "GET";
+    request.Url = "/static/../etc/passwd";
+    request.Headers.Add("user-agent", "curl");
+    /* regexp of another header does not count */
+    request.Headers.Add("Referer", "sqlmap");
+    request.Headers.Add("Cookie", "session=1");
+    request.Headers.Add("COOKIE", "admin=1");
+    EXPECT_EQ(db.Match(request), std::vector<unsigned int>({ 1, 2 }));
+
+    request.Url = "/index";
+    request.Headers.Set("User-Agent", "sqlmap/1.0");
+    request.Headers.Add("X-Forwarded-For", "10.0.0.1");
+    EXPECT_EQ(db.Match(request), std::vector<unsigned int>({ 0, 1, 3 }));
+
+    THttpResponse response;
+    response.Status = 200;
+    response.Headers.Add("Cookie", "admin=1");
+    /* response has no url to match */
+    response.Headers.Add(THeaderRegexpDatabase::UrlTarget, "../");
+    EXPECT_EQ(db.Match(response), std::vector<unsigned int>({ 1 }));
+}
+
+int main(int argc, char* argv[]) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
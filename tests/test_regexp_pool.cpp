@@ -0,0 +1,108 @@
+#include <coro/reactor.h>
+#include <regexp/matchers.h>
+#include <regexp/pool.h>
+
+#include <gtest/gtest.h>
+
+class RegexpPoolTest : public ::testing::Test {
+protected:
+    RegexpPoolTest()
+        : Reactor_(spdlog::get("reactor"))
+    {}
+
+    template <typename Test>
+    void Run(Test test) {
+        Reactor_.StartCoroutine(test);
+        Reactor_.Run();
+    }
+
+    TReactor Reactor_;
+};
+
+TEST_F(RegexpPoolTest, ScratchSharedBetweenDatabases) {
+    Run([]() {
+        TRegexpPool& pool = Reactor()->RegexpPool();
+        TBlockRegexpDatabase first({ TRegexpDef("first") });
+        TBlockRegexpDatabase second({ TRegexpDef("sec[o]nd") });
+
+        size_t matches = 0;
+        auto callback = [&matches](unsigned int, size_t, size_t) {
+            matches++;
+            return false;
+        };
+
+        for (size_t i = 0; i < 3; i++) {
+            TBlockRegexpMatcher firstMatcher(first, callback);
+            TBlockRegexpMatcher secondMatcher(second, callback);
+            firstMatcher.Scan(TMemoryRegion(std::string_view("the first one")));
+            secondMatcher.Scan(TMemoryRegion(std::string_view("the second one")));
+        }
+
+        EXPECT_EQ(matches, 6);
+        /* one scratch is grown for both databases once */
+        EXPECT_EQ(pool.ScratchCount(), 1);
+        EXPECT_EQ(pool.ScratchMisses(), 2);
+        EXPECT_EQ(pool.ScratchHits(), 4);
+    });
+}
+
+TEST_F(RegexpPoolTest, OverlappingScans) {
+    Run([]() {
+        TRegexpPool& pool = Reactor()->RegexpPool();
+        TBlockRegexpDatabase outer({ TRegexpDef("outer") });
+        TBlockRegexpDatabase inner({ TRegexpDef("inner") });
+
+        size_t innerMatches = 0;
+        TBlockRegexpMatcher innerMatcher(inner, [&innerMatches](unsigned int, size_t, size_t) {
+            innerMatches++;
+            return false;
+        });
+        /* scratch of outer scan is in use while callback scans again */
+        TBlockRegexpMatcher outerMatcher(outer, [&innerMatcher](unsigned int, size_t, size_t) {
+            innerMatcher.Scan(TMemoryRegion(std::string_view("inner")));
+            return false;
+        });
+
+        outerMatcher.Scan(TMemoryRegion(std::string_view("outer")));
+        EXPECT_EQ(innerMatches, 1);
+        EXPECT_EQ(pool.ScratchCount(), 2);
+
+        /* both are free afterwards */
+        innerMatcher.Scan(TMemoryRegion(std::string_view("inner")));
+        outerMatcher.Scan(TMemoryRegion(std::string_view("outer")));
+        EXPECT_EQ(innerMatches, 3);
+        EXPECT_EQ(pool.ScratchCount(), 2);
+    });
+}
+
+TEST_F(RegexpPoolTest, StreamStateReused) {
+    Run([]() {
+        TRegexpPool& pool = Reactor()->RegexpPool();
+        TStreamRegexpDatabase db({ TRegexpDef("needle") });
+
+        size_t matches = 0;
+        for (size_t i = 0; i < 4; i++) {
+            TStreamRegexpMatcher matcher(db, [&matches](unsigned int, size_t, size_t) {
+                matches++;
+                return false;
+            });
+            matcher.Scan(TMemoryRegion(std::string_view("hay nee")));
+            matcher.Scan(TMemoryRegion(std::string_view("dle hay")));
+        }
+
+        EXPECT_EQ(matches, 4);
+        /* state of closed stream is taken by the next one */
+        EXPECT_EQ(pool.StreamMisses(), 1);
+        EXPECT_EQ(pool.StreamHits(), 3);
+        EXPECT_GT(pool.FreeStreamBytes(), 0);
+
+        pool.SetMaxFreeStreamBytes(0);
+        EXPECT_EQ(pool.FreeStreamBytes(), 0);
+    });
+}
+
+int main(int argc, char* argv[]) {
+    auto logger = spdlog::stdout_color_mt("reactor");
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
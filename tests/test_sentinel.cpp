@@ -0,0 +1,184 @@
+#include <core/sentinel.h>
+
+#include <gtest/gtest.h>
+
+static THttpRequest MakeRequest(const std::string& url, const std::vector<std::pair<std::string, std::string>>& headers = {}) {
+    THttpRequest request;
+    request.Method = "GET";
+    request.Url = url;
+    request.MinorVersion = 1;
+    for (const auto& [name, value] : headers) {
+        request.Headers.Add(name, value);
+    }
+    return request;
+}
+
+static TSentinel::TSectionDef MakeSection(std::string prefix, TSentinel::EPolicy policy, std::vector<TSentinel::TBlock> blocks) {
+    TSentinel::TSectionDef section;
+    section.UrlPrefix = std::move(prefix);
+    section.Policy = policy;
+    section.Blocks = std::move(blocks);
+    return section;
+}
+
+using TCondition = TSentinel::TCondition;
+
+TEST(Sentinel, SectionsByUrlPrefix) {
+    std::vector<TSentinel::TSectionDef> sections;
+    sections.push_back(MakeSection("/deny", TSentinel::SpDeny, { { TCondition::HasHeader(false, "X-Bad") } }));
+    sections.push_back(MakeSection("/allow", TSentinel::SpAllow, { { TCondition::HasHeader(false, "X-Good") } }));
+    TSentinel sentinel(std::move(sections));
+
+    /* requests out of sections are not inspected */
+    EXPECT_EQ(TSentinel::TInspection(sentinel, MakeRequest("/other", { { "X-Bad", "1" } })).Verdict(), TSentinel::SvAllow);
+
+    EXPECT_EQ(TSentinel::TInspection(sentinel, MakeRequest("/deny/1", { { "x-bad", "1" } })).Verdict(), TSentinel::SvDeny);
+    EXPECT_EQ(TSentinel::TInspection(sentinel, MakeRequest("/deny/1")).Verdict(), TSentinel::SvAllow);
+    EXPECT_EQ(TSentinel::TInspection(sentinel, MakeRequest("/allow/1", { { "X-Good", "1" } })).Verdict(), TSentinel::SvAllow);
+    EXPECT_EQ(TSentinel::TInspection(sentinel, MakeRequest("/allow/1")).Verdict(), TSentinel::SvDeny);
+}
+
+TEST(Sentinel, HeaderConditions) {
+    std::vector<TSentinel::TSectionDef> sections;
+    sections.push_back(MakeSection("/", TSentinel::SpAllow, {
+        { TCondition::HeaderMatches(false, "User-Agent", TRegexpDef(R"(python-requests/\d+\.\d+)")) },
+        /* both headers are required */
+        { TCondition::HasHeader(false, "X-First"), TCondition::HasHeader(false, "X-Second") },
+    }));
+    /* databases of all sections are built in one call of compiler */
+    size_t compiled = 0;
+    TSentinel::TRunner compiler = [&compiled](const std::function<bool()>& compile) {
+        compiled++;
+        return compile();
+    };
+    TSentinel sentinel(std::move(sections), &compiler);
+    EXPECT_EQ(compiled, 1);
+
+    EXPECT_EQ(TSentinel::TInspection(sentinel, MakeRequest("/", { { "User-Agent", "python-requests/2.25" } })).Verdict(), TSentinel::SvAllow);
+    EXPECT_EQ(TSentinel::TInspection(sentinel, MakeRequest("/", { { "USER-AGENT", "python-requests/2.25" } })).Verdict(), TSentinel::SvAllow);
+    EXPECT_EQ(TSentinel::TInspection(sentinel, MakeRequest("/", { { "User-Agent", "curl/7.68" } })).Verdict(), TSentinel::SvDeny);
+    /* regexp of one header is not matched against another one */
+    EXPECT_EQ(TSentinel::TInspection(sentinel, MakeRequest("/", { { "Referer", "python-requests/2.25" } })).Verdict(), TSentinel::SvDeny);
+
+    EXPECT_EQ(TSentinel::TInspection(sentinel, MakeRequest("/", { { "X-First", "" }, { "X-Second", "" } })).Verdict(), TSentinel::SvAllow);
+    EXPECT_EQ(TSentinel::TInspection(sentinel, MakeRequest("/", { { "X-First", "" } })).Verdict(), TSentinel::SvDeny);
+}
+
+TEST(Sentinel, StreamedBody) {
+    std::vector<TSentinel::TSectionDef> sections;
+    sections.push_back(MakeSection("/", TSentinel::SpDeny, {
+        { TCondition::BodyContains(false, TRegexpDef("SELECT|UNION")) },
+        { TCondition::BodyContains(true, TRegexpDef("secret")) },
+    }));
+    TSentinel sentinel(std::move(sections));
+
+    {
+        TSentinel::TInspection inspection(sentinel, MakeRequest("/"));
+        EXPECT_EQ(inspection.Verdict(), TSentinel::SvUndecided);
+        EXPECT_TRUE(inspection.InspectsBody(false));
+        EXPECT_FALSE(inspection.BufferedBody(false));
+
+        /* match spans pieces */
+        EXPECT_EQ(inspection.BodyPiece(false, TMemoryRegion(std::string_view("name=1 SEL"))), TSentinel::SvUndecided);
+        EXPECT_EQ(inspection.BodyPiece(false, TMemoryRegion(std::string_view("ECT *"))), TSentinel::SvDeny);
+        EXPECT_FALSE(inspection.InspectsBody(true));
+    }
+
+    {
+        TSentinel::TInspection inspection(sentinel, MakeRequest("/"));
+        EXPECT_EQ(inspection.BodyPiece(false, TMemoryRegion(std::string_view("name=1"))), TSentinel::SvUndecided);
+        EXPECT_EQ(inspection.BodyEnd(false), TSentinel::SvUndecided);
+
+        THttpResponse response;
+        response.Status = 200;
+        EXPECT_EQ(inspection.ResponseHead(response), TSentinel::SvUndecided);
+        EXPECT_TRUE(inspection.InspectsBody(true));
+        EXPECT_EQ(inspection.BodyPiece(true, TMemoryRegion(std::string_view("nothing"))), TSentinel::SvUndecided);
+        EXPECT_EQ(inspection.BodyEnd(true), TSentinel::SvAllow);
+    }
+}
+
+TEST(Sentinel, PredicatesOnlyWhenNeeded) {
+    size_t requestCalls = 0;
+    size_t runnerCalls = 0;
+    TSentinel::TRunner runner = [&runnerCalls](const std::function<bool()>& predicate) {
+        runnerCalls++;
+        return predicate();
+    };
+
+    std::vector<TSentinel::TSectionDef> sections;
+    sections.push_back(MakeSection("/deny", TSentinel::SpDeny, {
+        { TCondition::HasHeader(false, "X-Bad") },
+        { TCondition::RequestIf([&requestCalls](const THttpRequest& request) {
+            requestCalls++;
+            return request.Url.find("SELECT") != std::string::npos;
+        }) },
+    }));
+    sections.push_back(MakeSection("/allow", TSentinel::SpAllow, {
+        { TCondition::HasHeader(false, "X-Good"), TCondition::RequestIf([&requestCalls](const THttpRequest&) {
+            requestCalls++;
+            return true;
+        }) },
+    }));
+    TSentinel sentinel(std::move(sections));
+
+    /* native condition decides, predicate is not called */
+    EXPECT_EQ(TSentinel::TInspection(sentinel, MakeRequest("/deny", { { "X-Bad", "1" } }), &runner).Verdict(), TSentinel::SvDeny);
+    EXPECT_EQ(requestCalls, 0);
+
+    EXPECT_EQ(TSentinel::TInspection(sentinel, MakeRequest("/deny?q=SELECT"), &runner).Verdict(), TSentinel::SvDeny);
+    EXPECT_EQ(TSentinel::TInspection(sentinel, MakeRequest("/deny?q=1"), &runner).Verdict(), TSentinel::SvAllow);
+    EXPECT_EQ(requestCalls, 2);
+
+    /* block cannot be satisfied without header, so its predicate is not called */
+    EXPECT_EQ(TSentinel::TInspection(sentinel, MakeRequest("/allow"), &runner).Verdict(), TSentinel::SvDeny);
+    EXPECT_EQ(requestCalls, 2);
+    EXPECT_EQ(TSentinel::TInspection(sentinel, MakeRequest("/allow", { { "X-Good", "1" } }), &runner).Verdict(), TSentinel::SvAllow);
+    EXPECT_EQ(requestCalls, 3);
+    EXPECT_EQ(runnerCalls, 3);
+}
+
+TEST(Sentinel, BufferedBody) {
+    std::vector<std::string> bodies;
+
+    std::vector<TSentinel::TSectionDef> sections;
+    sections.push_back(MakeSection("/", TSentinel::SpAllow, {
+        { TCondition::BodyIf(true, [&bodies](TMemoryRegion body) {
+            bodies.emplace_back(body.DataAs<const char*>(), body.Size());
+            return body.Size() > 0 && body.DataAs<const char*>()[0] == '{';
+        }) },
+        { TCondition::BodyContains(true, TRegexpDef("good_action"), true, 64) },
+    }));
+    TSentinel sentinel(std::move(sections));
+
+    THttpResponse response;
+    response.Status = 200;
+
+    {
+        TSentinel::TInspection inspection(sentinel, MakeRequest("/"));
+        EXPECT_FALSE(inspection.InspectsBody(false));
+        EXPECT_EQ(inspection.ResponseHead(response), TSentinel::SvUndecided);
+        EXPECT_EQ(inspection.BufferedBody(true), 64);
+        /* regexp decides, predicate is not called */
+        EXPECT_EQ(inspection.BodyEnd(true, TMemoryRegion(std::string_view("do good_action"))), TSentinel::SvAllow);
+        EXPECT_TRUE(bodies.empty());
+    }
+
+    {
+        TSentinel::TInspection inspection(sentinel, MakeRequest("/"));
+        EXPECT_EQ(inspection.ResponseHead(response), TSentinel::SvUndecided);
+        EXPECT_EQ(inspection.BodyEnd(true, TMemoryRegion(std::string_view("{}"))), TSentinel::SvAllow);
+        EXPECT_EQ(bodies, std::vector<std::string>({ "{}" }));
+    }
+
+    {
+        TSentinel::TInspection inspection(sentinel, MakeRequest("/"));
+        EXPECT_EQ(inspection.ResponseHead(response), TSentinel::SvUndecided);
+        EXPECT_EQ(inspection.BodyTooBig(), TSentinel::SvDeny);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}